@@ -4,14 +4,10 @@
 
 TEMPLATE = app
 TARGET = 
-DEPENDPATH += . src
-INCLUDEPATH += . src
-QT += network
+DEPENDPATH += .
+INCLUDEPATH += .
+
+include(src/imap.pri)
 
 # Input
-HEADERS += src/imap.h src/imapaddress.h src/imapmailbox.h src/imapmessage.h
-SOURCES += main.cpp \
-           src/imap.cpp \
-           src/imapaddress.cpp \
-           src/imapmailbox.cpp \
-           src/imapmessage.cpp
+SOURCES += main.cpp
@@ -1,15 +1,33 @@
 #include <QCryptographicHash>
 #include <QStringList>
 #include <QRegExp>
+#include <QHash>
+#include <QBuffer>
+#include <QLocale>
 
 #ifndef QT_NO_OPENSSL
     #include <QSslSocket>
-#else
-    #include <QTcpSocket>
+    #include <QMutex>
 #endif
 
+#include "imapbodystructure.h"
+#include "imapaddress.h"
+#include "imapcompressdevice.h"
+#include "imapfolder.h"
 #include "imapmessage.h"
 #include "imapmailbox.h"
+#include "imaplisting.h"
+#include "imapparser.h"
+#include "imapcache.h"
+#include "imapcanceltoken.h"
+#include "imapcodec.h"
+#include "imapsearchresult.h"
+#include "imaptextindex.h"
+#include "imapstats.h"
+#include "imapsync.h"
+#include "imapsort.h"
+#include "imapthread.h"
+#include "imap_p.h"
 #include "imap.h"
 
 #ifdef IMAP_DEBUG
@@ -24,134 +42,433 @@
 
 #define IMAP_TAG        "THIMAP"
 
+#define IMAP_APPEND_CHUNK_SIZE          (64 * 1024)
+#define IMAP_APPEND_BUFFER_SIZE         (1024 * 1024)
+#define IMAP_APPEND_BATCH_SIZE          (64)
+#define IMAP_STATUS_BATCH_SIZE          (256)
+#define IMAP_PIPELINE_BATCH_SIZE        (64)
+#define IMAP_COMMAND_MAX_LENGTH         (8000)
+
+#define IMAP_DEFAULT_TIMEOUT            (30000)
+#define IMAP_WAIT_SLICE                 (100)
+
+#if !defined(QT_NO_OPENSSL) && QT_VERSION >= 0x050200
+    #define IMAP_SSL_SESSION_RESUMPTION
+#endif
+
 // ===========================================================================
 //  PRIVATE Functions
 // ===========================================================================
-static ImapMessage *_imapParseMessage (const QString& responseText) {
-    if (!responseText.startsWith('*'))
-        return(NULL);
+#ifdef IMAP_SSL_SESSION_RESUMPTION
+/* TLS session tickets by "host:port", shared by the connections of
+ * the process: a reconnect resumes the session instead of a full
+ * handshake.
+ */
+typedef QHash<QString, QByteArray> ImapSslSessions;
+Q_GLOBAL_STATIC(ImapSslSessions, _imapSslSessions)
+static QMutex _imapSslSessionsMutex;
+#endif
 
-    QString response = responseText;
+/* Returns the size of the literal announced at the end of line
+ * ("... {size}\r\n"), or -1 if the line doesn't end with a literal.
+ */
+static int _imapLiteralSize (const QByteArray& line) {
+    int end = line.size();
+    while (end > 0 && (line[end - 1] == '\r' || line[end - 1] == '\n'))
+        end--;
 
-    QRegExp regexId("\\* (\\d*)");    
-    QRegExp regexMessageId("\"<([^>]+)>\"\\)\\)");
-    QRegExp regexFlags("\\(FLAGS \\(([^\\)]*)\\)");
-    QRegExp regexInternalDate("INTERNALDATE \"([^\"]+)\"");
-    QRegExp regexSize("RFC822.SIZE (\\d+)");
-    QRegExp regexEnvelope("ENVELOPE");   
+    if (end < 3 || line[end - 1] != '}')
+        return(-1);
 
-    ImapMessage *message = new ImapMessage;
-    if (regexId.indexIn(response) != -1)
-        message->setId(regexId.cap(1).toInt());
-    if (regexFlags.indexIn(response) != -1)
-        message->setFlags(regexFlags.cap(1));
-    if (regexInternalDate.indexIn(response) != -1)
-        message->setReceived(regexInternalDate.cap(1));
-    if (regexSize.indexIn(response) != -1)
-        message->setSize(regexSize.cap(1).toInt());
-    
-    if (regexEnvelope.indexIn(response) != -1) {
-        int rmSize = regexEnvelope.pos() + regexEnvelope.matchedLength();
-        response = response.remove(0, rmSize);
-    }
- 
-    QRegExp regexSent("\(\"(?:\\w{3}\\, )?([^\"]+)\"");
-    if (regexSent.indexIn(response) != -1) {
-        QRegExp subRegex("([\\-\\+]\\d{4}.*|NIL.*)");
-        subRegex.indexIn(regexSent.cap(1));
-
-        message->setSent(regexSent.cap(1).remove(subRegex.pos()));
-        message->setTimeZone(subRegex.cap(1));
-        response = response.remove(0, regexSent.pos() + regexSent.matchedLength());
-    }
- 
-    QString token = "((";
-    int tokenOffset;        
-    if (response.contains(token)) {
-        tokenOffset = 0;
-    } else {
-        token = "\" NIL";
-        tokenOffset = 2;
+    int begin = line.lastIndexOf('{', end - 1);
+    if (begin < 0 || begin + 2 >= end)
+        return(-1);
+
+    int size = 0;
+    for (int i = begin + 1; i < end - 1; ++i) {
+        if (line[i] < '0' || line[i] > '9')
+            return(-1);
+        size = (size * 10) + (line[i] - '0');
     }
-    
-    QRegExp regexSubject(" \"(.*)\"");
-    QString subject = response.mid(0, response.indexOf(token) + tokenOffset).trimmed();
-    if (subject == "NIL")
-        subject.clear();
-    else if (regexSubject.indexIn(subject) != -1)
-        subject = regexSubject.cap(1);
-    message->setSubject(Imap::decode(subject.toLatin1()));
-
-    if (response.contains("((")) {
-        response = response.remove(0, response.indexOf("(("));
-    } else {
-        if (message->subject().isEmpty())
-            message->setSubject(response);
+    return(size);
+}
+
+/* Status of the tagged completion of a pipelined command,
+ * whose tag isn't the last one sent. */
+static bool _imapTaggedOk (const QByteArray& response) {
+    int status = response.indexOf(' ') + 1;
+    return(status > 0 && response.mid(status, 3).toUpper() == "OK ");
+}
+
+/* Body part data as delivered, in the local newline convention. */
+static QByteArray _imapDecodeBodyPart (const QByteArray& data,
+                                       ImapMessageBodyPart::Encoding encoding)
+{
+    QByteArray decoded = ImapCodec::decode(data, encoding);
+    if (encoding != ImapMessageBodyPart::Base64Encoding)
+        decoded.replace("\r\n", IMAP_MESSAGE_BODY_NEWLINE);
+    return(decoded);
+}
+
+/*
+ * Cut a partial section (BODY[1]<0.n>) at the last complete unit of
+ * its transfer encoding: whole base64 quads, no dangling QP escape.
+ */
+static QByteArray _imapTrimPartial (const QByteArray& data,
+                                    ImapMessageBodyPart::Encoding encoding)
+{
+    if (encoding == ImapMessageBodyPart::Base64Encoding) {
+        int chars = 0;
+        int end = 0;
+        for (int i = 0; i < data.size(); ++i) {
+            char c = data[i];
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+                continue;
+            if (++chars % 4 == 0)
+                end = i + 1;
+        }
+        return(data.left(end));
     }
-    
-    if (regexMessageId.indexIn(response)) {
-        message->setMessageId(regexMessageId.cap(1));
-        response = response.remove(regexMessageId.pos()).trimmed();
+
+    if (encoding == ImapMessageBodyPart::QuotedPrintableEncoding) {
+        int escape = data.lastIndexOf('=');
+        if (escape >= 0 && escape >= data.size() - 2)
+            return(data.left(escape));
     }
-    
-    if (response.endsWith("NIL")) {
-        response = response.remove(response.size() - 3);
-    } else {
-        QRegExp regexReference("\"<([^>]+)>\"");
-        if (regexReference.indexIn(response) != -1)
-        message->setReference(regexReference.cap(1));
+    return(data);
+}
+
+/* "<command> <set>[ <arguments>]" commands, each below IMAP_COMMAND_MAX_LENGTH. */
+static void _imapUidCommands (QStringList *commands,
+                              const QString& command,
+                              const ImapSequenceSet& uids,
+                              const QString& arguments = QString())
+{
+    int maxLength = IMAP_COMMAND_MAX_LENGTH - command.size() - arguments.size() - 16;
+    foreach (const ImapSequenceSet& part, uids.split(maxLength)) {
+        if (arguments.isEmpty())
+            commands->append(command + ' ' + part.toString());
+        else
+            commands->append(command + ' ' + part.toString() + ' ' + arguments);
     }
-    
-    message->setAddresses(response.trimmed());
-    return(message);
 }
 
-// ===========================================================================
-//  PRIVATE Class
-// ===========================================================================
-class ImapPrivate {
-    public:
-        QString responseErrorMsg;
-        QTcpSocket *socket;
+/* "UID FETCH <set> (<items>)" commands, each below IMAP_COMMAND_MAX_LENGTH. */
+static void _imapUidFetchCommands (QStringList *commands,
+                                   const ImapSequenceSet& uids,
+                                   const QString& items)
+{
+    _imapUidCommands(commands, "UID FETCH", uids, '(' + items + ')');
+}
+
+/*
+ * Search criteria as sent: quoted strings and atoms with non-ASCII
+ * characters (or CR, LF) become UTF-8 literals, their bytes held as
+ * Latin-1 characters so sendDataLine() writes them unchanged. utf8 is
+ * set if there is one, the command then needs "CHARSET UTF-8".
+ */
+static QString _imapSearchLiterals (const QString& criteria, bool literalPlus, bool *utf8) {
+    QString encoded;
+    *utf8 = false;
+
+    int n = criteria.size();
+    for (int i = 0; i < n; ) {
+        QChar c = criteria[i];
+        if (c == ' ' || c == '(' || c == ')') {
+            encoded += c;
+            i++;
+            continue;
+        }
+
+        int start = i;
+        QString value;
+        if (c == '"') {
+            for (++i; i < n && criteria[i] != '"'; ++i) {
+                if (criteria[i] == '\\' && (i + 1) < n)
+                    i++;
+                value += criteria[i];
+            }
+            i = qMin(i + 1, n);
+        } else {
+            while (i < n && criteria[i] != ' ' && criteria[i] != '(' &&
+                   criteria[i] != ')' && criteria[i] != '"')
+            {
+                value += criteria[i++];
+            }
+        }
+
+        bool plain = true;
+        foreach (QChar v, value) {
+            if (v.unicode() > 0x7f || v == '\r' || v == '\n') {
+                plain = false;
+                break;
+            }
+        }
+
+        if (plain) {
+            encoded += criteria.mid(start, i - start);
+        } else {
+            QByteArray data = value.toUtf8();
+            encoded += QString("{%1%2}\r\n").arg(data.size()).arg(literalPlus ? "+" : "");
+            encoded += QString::fromLatin1(data.constData(), data.size());
+            *utf8 = true;
+        }
+    }
+    return(encoded);
+}
+
+/* End of the next synchronizing literal size ("{n}\r\n") of a line
+ * from offset, skipping the data of LITERAL+ ones. -1 if none. */
+static int _imapSyncLiteralEnd (const QByteArray& line, int offset) {
+    int end;
+    while ((end = line.indexOf("}\r\n", offset)) >= 0) {
+        int open = line.lastIndexOf('{', end);
+        bool plus = (line[end - 1] == '+');
+        bool isNumber = false;
+        int size = 0;
+        if (open >= offset)
+            size = line.mid(open + 1, end - open - (plus ? 2 : 1)).toInt(&isNumber);
+
+        end += 3;
+        if (isNumber && !plus)
+            return(end < line.size() ? end : -1);
+        offset = isNumber ? end + size : end;
+    }
+    return(-1);
+}
+
+/* "[UID] SEARCH UID <set> <criteria>" commands, each below
+ * IMAP_COMMAND_MAX_LENGTH. Non-ASCII criteria are sent as UTF-8
+ * literals, with their CHARSET. */
+static void _imapSearchCommands (QStringList *commands,
+                                 const ImapSequenceSet& uids,
+                                 const QString& text,
+                                 bool uid,
+                                 bool literalPlus)
+{
+    bool utf8;
+    QString criteria = _imapSearchLiterals(text, literalPlus, &utf8);
+    QString command = uid ? "UID SEARCH " : "SEARCH ";
+    command += utf8 ? "CHARSET UTF-8 UID " : "UID ";
+    int maxLength = IMAP_COMMAND_MAX_LENGTH - command.size() - criteria.size() - 16;
+    foreach (const ImapSequenceSet& part, uids.split(maxLength)) {
+        if (criteria.isEmpty())
+            commands->append(command + part.toString());
+        else
+            commands->append(command + part.toString() + ' ' + criteria);
+    }
+}
+
+/* Numbers of a "* SEARCH 2 3 5" response, added to result. */
+static void _imapSearchNumbers (const QByteArray& response, ImapSequenceSet *result) {
+    const char *s = response.constData();
+    int n = response.size();
+    for (int i = 8; i < n; ++i) {
+        if (s[i] == '(')        // (MODSEQ n)
+            break;
+
+        if (s[i] < '0' || s[i] > '9')
+            continue;
+
+        uint value = 0;
+        while (i < n && s[i] >= '0' && s[i] <= '9')
+            value = (value * 10) + (s[i++] - '0');
+        result->add(value);
+    }
+}
+
+/* Quote a mailbox name, unless the caller already did. */
+static QString _imapQuote (const QString& text) {
+    if (text.startsWith('"'))
+        return(text);
 
-    public:
-        bool connectToHost (const QString& host, quint16 port, bool useSsl);
+    QString quoted = text;
+    quoted.replace("\\", "\\\\").replace("\"", "\\\"");
+    return(QString("\"%1\"").arg(quoted));
+}
+
+/* Text of a quoted search criteria, as given by the caller. */
+static QString _imapUnquote (const QString& text) {
+    if (text.size() < 2 || !text.startsWith('"') || !text.endsWith('"'))
+        return(text);
+
+    QString unquoted;
+    for (int i = 1; i < text.size() - 1; ++i) {
+        if (text[i] == '\\' && i + 1 < text.size() - 1)
+            i++;
+        unquoted.append(text[i]);
+    }
+    return(unquoted);
+}
 
-        bool setFlag (int uid, const QString& flag, bool append);
+/**
+ * UID set of a response code, the last one of
+ * "[APPENDUID 38505 3955:3957]" or "[COPYUID 38505 304,319 3956:3957]".
+ */
+static bool _imapParseUidCode (const QByteArray& response,
+                               const QByteArray& code,
+                               ImapSequenceSet *uids)
+{
+    int index = response.toUpper().indexOf('[' + code + ' ');
+    if (index < 0)
+        return(false);
+
+    ImapParser parser(response, index + code.size() + 1);
+    parser.readNumber();
+    QByteArray set = parser.readAtom();
+    if (code == "COPYUID")
+        set = parser.readAtom();
+
+    if (uids != NULL)
+        uids->add(ImapSequenceSet::fromString(set));
+    return(true);
+}
+
+/* "<id@host>" without the brackets, the first of a list. */
+static QString _imapMessageId (const QByteArray& text) {
+    int begin = text.indexOf('<');
+    int end = text.indexOf('>', begin + 1);
+    if (begin < 0 || end < 0)
+        return(QString::fromLatin1(text.trimmed()));
+    return(QString::fromLatin1(text.mid(begin + 1, end - begin - 1)));
+}
 
-    public:
-        QByteArray readLine (bool *ok = NULL);
+/* Zone of an RFC 2822 date, "-0700" of "Fri, 17 Jul 2009 02:44:25 -0700". */
+static QString _imapDateZone (const QByteArray& date) {
+    foreach (const QByteArray& token, date.split(' ')) {
+        if (token.size() == 5 && (token[0] == '+' || token[0] == '-'))
+            return(QString::fromLatin1(token));
+    }
+    return(QString());
+}
 
-        bool isMultiline   (const QString& data) const;
-        bool isResponseOk  (const QByteArray& response) const;
-        bool isResponseEnd (const QString& response) const;
+/* ENVELOPE (date subject from sender reply-to to cc bcc in-reply-to message-id) */
+static bool _imapReadEnvelope (ImapParser *parser,
+                               ImapMessage *message,
+                               ImapAddressTable *addresses)
+{
+    if (!parser->skipChar('('))
+        return(parser->skipAtom("NIL"));
+
+    QByteArray date = parser->readString();
+    message->setSent(ImapParser::parseDateTime(date));
+    message->setTimeZone(_imapDateZone(date));
+    message->setSubject(ImapCodec::decodeHeader(parser->readString()));
+    if (!message->setAddresses(parser, addresses))
+        return(false);
 
-        bool sendDataLine (const QString& data);
-        bool sendCommand  (const QString& command, 
-                           const QStringList& args = QStringList());
+    message->setReference(_imapMessageId(parser->readString()));
+    message->setMessageId(_imapMessageId(parser->readString()));
 
-    public:
-        QByteArray hmacMd5 (const QString& username,
-                            const QString& password,
-                            const QString& serverResponse);
+    while (!parser->atListEnd()) {
+        if (!parser->skipValue())
+            return(false);
+    }
+    return(parser->skipChar(')'));
+}
 
-        ImapMailbox *parseMailbox (const QString& mailboxName);
-        ImapMailbox *parseMessages (ImapMailbox *mailbox);
+/*
+ * "* n FETCH (UID FLAGS INTERNALDATE RFC822.SIZE ENVELOPE)", read in
+ * place with the literals inline (see ImapPrivate::readResponse()).
+ * Returns NULL if it isn't a FETCH response.
+ */
+static ImapMessage *_imapParseMessage (const QByteArray& response,
+                                       ImapAddressTable *addresses = NULL)
+{
+    ImapParser parser(response);
+    if (!parser.skipChar('*'))
+        return(NULL);
 
-        QByteArray parseBodyPart (ImapMessageBodyPart::Encoding encoding);
-        QList<ImapMessageBodyPart *> bodyPartSplit (const QByteArray& response);
+    bool isNumber;
+    int id = parser.readNumber(&isNumber);
+    if (!isNumber || !parser.skipAtom("FETCH") || !parser.skipChar('('))
+        return(NULL);
 
-        QString rfcDate (const QDateTime& date) const;
+    ImapMessage *message = new ImapMessage;
+    message->setId(id);
+
+    while (!parser.atListEnd()) {
+        QByteArray item = parser.readAtom().toUpper();
+        if (item == "UID") {
+            message->setUid(QString::number(parser.readNumber()));
+        } else if (item == "FLAGS") {
+            message->setFlags(parser.readFlags());
+        } else if (item == "INTERNALDATE") {
+            message->setReceived(ImapParser::parseDateTime(parser.readString()));
+        } else if (item == "RFC822.SIZE") {
+            message->setSize(parser.readNumber());
+        } else if (item == "ENVELOPE") {
+            if (!_imapReadEnvelope(&parser, message, addresses))
+                break;
+        } else if (item.isEmpty() || !parser.skipValue()) {
+            break;
+        }
+    }
+    return(message);
+}
 
-    private:
-        QString buildId (void) const;
+/*
+ * Message-IDs of the "BODY[HEADER.FIELDS (REFERENCES)]" item of a FETCH
+ * response, from the thread root to the direct parent.
+ */
+static QStringList _imapReferences (const QByteArray& response) {
+    ImapParser parser(response);
+    parser.skipChar('*');
+    parser.readNumber();
+    if (!parser.skipAtom("FETCH") || !parser.skipChar('('))
+        return(QStringList());
+
+    QByteArray header;
+    while (!parser.atListEnd()) {
+        QByteArray item = parser.readAtom().toUpper();
+        if (item.startsWith("BODY[HEADER.FIELDS")) {
+            header = parser.readString();
+            break;
+        } else if (item.isEmpty() || !parser.skipValue()) {
+            break;
+        }
+    }
 
-    private:
-        QString m_lastId;
-};
+    QStringList references;
+    QRegExp messageId("<([^<>\\s]+)>");
+    QString text = QString::fromLatin1(header);
+    int index = text.indexOf(':') + 1;
+    while ((index = messageId.indexIn(text, index)) >= 0) {
+        references.append(messageId.cap(1));
+        index += messageId.matchedLength();
+    }
+    return(references);
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+ImapPrivate::ImapPrivate()
+    : textIndex(NULL), verifyTextIndex(false), cache(NULL), socket(NULL), device(NULL),
+      qresyncEnabled(false), compression(false), stats(NULL),
+      cancelToken(NULL), timeout(IMAP_DEFAULT_TIMEOUT),
+      selectedUidValidity(0), sortListing(NULL), sortSorter(NULL),
+      m_commandPending(false)
+{
+}
+
+ImapPrivate::~ImapPrivate() {
+    clearSort();
+}
 
 bool ImapPrivate::connectToHost (const QString& host, quint16 port, bool useSsl)
 {
+    capabilities.clear();
+    qresyncEnabled = false;
+    responseErrorMsg.clear();
+    selectedMailbox.clear();
+    clearSort();
+
+    // Left behind by an aborted operation.
+    if (device != socket)
+        delete device;
+    delete socket;
+
 #ifndef QT_NO_OPENSSL
     if (useSsl)
         socket = new QSslSocket;       
@@ -162,78 +479,423 @@ bool ImapPrivate::connectToHost (const QString& host, quint16 port, bool useSsl)
     socket = new QTcpSocket;
 #endif
 
+    device = socket;
+
 #ifndef QT_NO_OPENSSL
     if (useSsl) {
         QSslSocket *sslSocket = static_cast<QSslSocket *>(socket);
+        sslSessionKey = QString("%1:%2").arg(host).arg(port);
+#ifdef IMAP_SSL_SESSION_RESUMPTION
+        QSslConfiguration config = sslSocket->sslConfiguration();
+        config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        _imapSslSessionsMutex.lock();
+        config.setSessionTicket(_imapSslSessions()->value(sslSessionKey));
+        _imapSslSessionsMutex.unlock();
+        sslSocket->setSslConfiguration(config);
+#endif
         sslSocket->connectToHostEncrypted(host, port);
-        return(sslSocket->waitForEncrypted());
+        return(waitFor(WaitEncrypted));
     } else {
         socket->connectToHost(host, port);
-        return(socket->waitForConnected());
+        return(waitFor(WaitConnected));
     }
 #else
     socket->connectToHost(host, port);
-    return(socket->waitForConnected());
+    return(waitFor(WaitConnected));
 #endif
 }
 
-bool ImapPrivate::setFlag (int uid, const QString& flag, bool append) {
-    QString method = (append ? "+flags" : "-flags");
+/**
+ * Keep the TLS session ticket of the connection for the next one to
+ * the same host. Tickets may arrive after the handshake (TLS 1.3),
+ * so this is done once the server has spoken.
+ */
+void ImapPrivate::saveSslSession (void) {
+#ifdef IMAP_SSL_SESSION_RESUMPTION
+    QSslSocket *sslSocket = qobject_cast<QSslSocket *>(socket);
+    if (sslSocket == NULL || !sslSocket->isEncrypted())
+        return;
+
+    QByteArray ticket = sslSocket->sslConfiguration().sessionTicket();
+    if (ticket.isEmpty())
+        return;
+
+    QMutexLocker locker(&_imapSslSessionsMutex);
+    _imapSslSessions()->insert(sslSessionKey, ticket);
+#endif
+}
 
-    QString command = "UID STORE %1 %2 (%3)";
-    if (!sendCommand(command.arg(uid).arg(method).arg(flag)))
+bool ImapPrivate::setFlag (int uid, ImapMessageFlags flag, bool append) {
+    if (uid <= 0)
         return(false);
 
-    QByteArray response = readLine();
-    if (!response.startsWith('*'))
-        return(false);
+    return(storeFlags(ImapSequenceSet(uid), append ? flag : 0, append ? 0 : flag));
+}
 
-    bool ok = false;
-    readLine(&ok);
+/**
+ * UID STORE of a flag delta: "-FLAGS" for removed, "+FLAGS" for added.
+ * uids is split to keep each command under IMAP_COMMAND_MAX_LENGTH
+ * (RFC 7162 asks servers to take 8192 octets), and the commands are
+ * pipelined in batches of IMAP_PIPELINE_BATCH_SIZE. The FETCH FLAGS
+ * replies update the cache in place.
+ */
+bool ImapPrivate::storeFlags (const ImapSequenceSet& uids,
+                              ImapMessageFlags added,
+                              ImapMessageFlags removed)
+{
+    QStringList items;
+    QString removedText = ImapMessage::flagsString(removed);
+    QString addedText = ImapMessage::flagsString(added);
+    if (!removedText.isEmpty())
+        items.append("-FLAGS (" + removedText + ')');
+    if (!addedText.isEmpty())
+        items.append("+FLAGS (" + addedText + ')');
+    if (items.isEmpty() || uids.isEmpty())
+        return(true);
+
+    // "<tag> UID STORE <set> <item>"
+    QStringList commands;
+    foreach (const QString& item, items) {
+        int maxLength = IMAP_COMMAND_MAX_LENGTH - item.size() - 32;
+        foreach (const ImapSequenceSet& part, uids.split(maxLength))
+            commands.append("UID STORE " + part.toString() + ' ' + item);
+    }
+
+    bool ok = true;
+    for (int i = 0; i < commands.size(); i += IMAP_PIPELINE_BATCH_SIZE) {
+        if (!sendCommands(commands.mid(i, IMAP_PIPELINE_BATCH_SIZE)))
+            return(false);
+
+        int pending = qMin(IMAP_PIPELINE_BATCH_SIZE, commands.size() - i);
+        while (pending > 0) {
+            bool readOk;
+            QByteArray response = readResponse(&readOk);
+            if (!readOk)
+                return(false);
+
+            if (response.startsWith('*')) {
+                updateFlags(response);
+            } else if (response.startsWith(IMAP_TAG)) {
+                if (!_imapTaggedOk(response)) {
+                    responseErrorMsg = response;
+                    ok = false;
+                }
+                pending--;
+            }
+        }
+    }
     return(ok);
 }
 
+/**
+ * Store the flags of an untagged "* n FETCH (UID n FLAGS (...))" in the
+ * cache, when open. Flags with a keyword dropped, the keyword table
+ * being full, aren't written: the server did apply them, the STORE
+ * still succeeds. Other responses are ignored.
+ */
+void ImapPrivate::updateFlags (const QByteArray& response) {
+    if (cache == NULL || !cache->isOpen())
+        return;
+
+    ImapParser parser(response);
+    if (!parser.skipChar('*'))
+        return;
+
+    bool isNumber;
+    parser.readNumber(&isNumber);
+    if (!isNumber || !parser.skipAtom("FETCH"))
+        return;
+
+    ImapMessageFlags flags;
+    uint uid;
+    if (!parser.readFlagUpdate(&uid, &flags) || uid == 0)
+        return;
+
+    // The cache keeps its flags rather than losing a keyword.
+    if (parser.droppedKeywords() == 0)
+        cache->setFlags(uid, flags);
+}
+
 bool ImapPrivate::sendDataLine (const QString& data) {
 #ifdef IMAP_DEBUG
     qDebug() << "sendDataLine()" << data;
 #endif
 
     responseErrorMsg.clear();
-    socket->write(QString("%1\r\n").arg(data).toLatin1());
-    return(socket->waitForBytesWritten());
+    QByteArray line = QString("%1\r\n").arg(data).toLatin1();
+
+    // Synchronizing literals in the line wait for "+" to go on.
+    int offset = 0;
+    int end;
+    while ((end = _imapSyncLiteralEnd(line, offset)) > 0) {
+        device->write(line.constData() + offset, end - offset);
+        if (!waitFor(WaitBytesWritten) || !waitContinuation())
+            return(false);
+        offset = end;
+    }
+
+    device->write(line.constData() + offset, line.size() - offset);
+    bool written = waitFor(WaitBytesWritten);
+
+    if (stats != NULL && m_commandPending) {
+        m_commandStats.addBytesOut(line.size());
+        m_commandStats.setSendTime(m_commandTimer.elapsed());
+    }
+    return(written);
 }
 
 bool ImapPrivate::sendCommand (const QString& command, const QStringList& args)
 {
     m_lastId = buildId();
+    m_lastTag = m_lastId.toLatin1() + ' ';
 
     QString fullCommand = QString("%1 %2").arg(m_lastId).arg(command);
     foreach (QString arg, args)
         fullCommand = fullCommand.arg(arg);
 
+    if (stats != NULL)
+        beginStats(command);
+
     return(sendDataLine(fullCommand));
 }
 
-QByteArray ImapPrivate::readLine (bool *ok) {
-    quint8 attempts = 0;
-    while (!socket->canReadLine() && attempts < 2) {
-        if (!socket->waitForReadyRead())
-            attempts++;
+/**
+ * Send a batch of commands at once (see IMAP_PIPELINE_BATCH_SIZE) and
+ * read the responses until each command is tagged. The untagged ones
+ * are appended to untagged, the tagged ones to tagged (when not NULL).
+ * Returns false if the connection failed or a command wasn't OK.
+ */
+bool ImapPrivate::runBatch (const QStringList& commands,
+                            QList<QByteArray> *untagged,
+                            QList<QByteArray> *tagged)
+{
+    if (!sendCommands(commands))
+        return(false);
+
+    bool ok = true;
+    int pending = commands.size();
+    while (pending > 0) {
+        bool readOk;
+        QByteArray response = readResponse(&readOk);
+        if (!readOk)
+            return(false);
+
+        if (response.startsWith('*')) {
+            if (untagged != NULL)
+                untagged->append(response);
+        } else if (response.startsWith(IMAP_TAG)) {
+            if (tagged != NULL)
+                tagged->append(response);
+            if (!_imapTaggedOk(response)) {
+                responseErrorMsg = response;
+                ok = false;
+            }
+            pending--;
+        }
     }
+    return(ok);
+}
 
-    if (attempts >= 2) {
-        if (ok != NULL) *ok = false;
-        return(QByteArray());
+/**
+ * Run SEARCH commands pipelined, adding the numbers found to result.
+ */
+bool ImapPrivate::runSearches (const QStringList& commands, ImapSequenceSet *result) {
+    // Waiting for "+" drops untagged responses, one command at a time.
+    int batchSize = IMAP_PIPELINE_BATCH_SIZE;
+    foreach (const QString& command, commands) {
+        if (_imapSyncLiteralEnd(command.toLatin1(), 0) > 0) {
+            batchSize = 1;
+            break;
+        }
+    }
+
+    for (int i = 0; i < commands.size(); i += batchSize) {
+        QList<QByteArray> responses;
+        if (!runBatch(commands.mid(i, batchSize), &responses))
+            return(false);
+
+        foreach (const QByteArray& response, responses) {
+            if (response.startsWith("* SEARCH"))
+                _imapSearchNumbers(response, result);
+        }
+    }
+    return(true);
+}
+
+/**
+ * Run UID COPY, MOVE or EXPUNGE commands pipelined. The COPYUID codes,
+ * tagged or untagged (MOVE sends them before its expunges), are added
+ * to newUids: the new UIDs of the parts copied, even on failure.
+ */
+bool ImapPrivate::runUidCommands (const QStringList& commands, ImapSequenceSet *newUids) {
+    for (int i = 0; i < commands.size(); i += IMAP_PIPELINE_BATCH_SIZE) {
+        QList<QByteArray> responses;
+        bool ok = runBatch(commands.mid(i, IMAP_PIPELINE_BATCH_SIZE), &responses, &responses);
+        foreach (const QByteArray& response, responses)
+            _imapParseUidCode(response, "COPYUID", newUids);
+        if (!ok)
+            return(false);
+    }
+    return(true);
+}
+
+/**
+ * Pipeline commands, without arguments to format, in a single write.
+ * Each one gets its own tag; the last one is the current command.
+ * Stats record the batch as one command.
+ */
+bool ImapPrivate::sendCommands (const QStringList& commands) {
+    QStringList lines;
+    foreach (const QString& command, commands) {
+        m_lastId = buildId();
+        lines.append(QString("%1 %2").arg(m_lastId).arg(command));
+    }
+    m_lastTag = m_lastId.toLatin1() + ' ';
+
+    if (stats != NULL && !commands.isEmpty())
+        beginStats(commands.first());
+
+    return(sendDataLine(lines.join("\r\n")));
+}
+
+/**
+ * Wait for the "+" continuation request of a synchronizing literal.
+ */
+bool ImapPrivate::waitContinuation (void) {
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*'))
+        ;
+
+    if (!ok || !response.startsWith('+')) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+/**
+ * Stream size bytes of source as literal data. The socket buffer is
+ * kept bounded, so large messages are not held in memory twice.
+ * On failure the command can't be completed: disconnect.
+ */
+bool ImapPrivate::sendLiteral (QIODevice *source, qint64 size) {
+    QByteArray chunk(IMAP_APPEND_CHUNK_SIZE, '\0');
+
+    while (size > 0) {
+        qint64 length = source->read(chunk.data(), qMin(size, (qint64)chunk.size()));
+        if (length <= 0) {
+            responseErrorMsg = "Message source ended before its size";
+            return(false);
+        }
+
+        if (device->write(chunk.constData(), length) != length)
+            return(false);
+        size -= length;
+
+        if (stats != NULL && m_commandPending)
+            m_commandStats.addBytesOut(length);
+
+        while (device->bytesToWrite() > IMAP_APPEND_BUFFER_SIZE) {
+            if (!waitFor(WaitBytesWritten))
+                return(false);
+        }
+    }
+
+    if (stats != NULL && m_commandPending)
+        m_commandStats.setSendTime(m_commandTimer.elapsed());
+    return(true);
+}
+
+QByteArray ImapPrivate::readLine (bool *ok) {
+    while (!device->canReadLine()) {
+        if (!waitForReadyRead()) {
+            if (ok != NULL) *ok = false;
+            return(QByteArray());
+        }
     }
 
     if (ok != NULL) *ok = true;
+    QByteArray response = device->readLine();
 #ifdef IMAP_DEBUG
-    QByteArray response = socket->readLine();
     qDebug() << "readLine()" << response;
-    return(response);
-#else
-    return(socket->readLine());
 #endif
+
+    if (stats != NULL && m_commandPending)
+        lineStats(response);
+    return(response);
+}
+
+QByteArray ImapPrivate::readBytes (int size, bool *ok) {
+    QByteArray data;
+    data.reserve(size);
+
+    while (data.size() < size) {
+        if (device->bytesAvailable() > 0)
+            data.append(device->read(size - data.size()));
+        else if (!waitForReadyRead())
+            break;
+    }
+
+    if (stats != NULL && m_commandPending)
+        m_commandStats.addBytesIn(data.size());
+
+    if (ok != NULL) *ok = (data.size() == size);
+    return(data);
+}
+
+/**
+ * Read a whole response line, including the literals it announces.
+ * Literal data is kept inline, right after its "{size}\r\n" marker.
+ */
+QByteArray ImapPrivate::readResponse (bool *ok) {
+    QByteArray response;
+    bool lineOk = false;
+
+    while (true) {
+        QByteArray line = readLine(&lineOk);
+        if (!lineOk) break;
+        response.append(line);
+
+        int literalSize = _imapLiteralSize(line);
+        if (literalSize < 0) break;
+
+        response.append(readBytes(literalSize, &lineOk));
+        if (!lineOk) break;
+    }
+
+    if (ok != NULL) *ok = lineOk;
+    return(response);
+}
+
+/**
+ * Read the buffered part of a response, without waiting for more:
+ * returns true once response is whole (see readResponse()).
+ * literalSize holds the bytes still expected of the last literal,
+ * -1 between lines: start with an empty response and -1.
+ */
+bool ImapPrivate::readBufferedResponse (QByteArray *response, int *literalSize) {
+    while (true) {
+        if (*literalSize >= 0) {
+            int size = (int)qMin((qint64)*literalSize, device->bytesAvailable());
+            response->append(readBytes(size));
+            *literalSize -= size;
+            if (*literalSize > 0)
+                return(false);
+            *literalSize = -1;
+        }
+
+        if (!device->canReadLine())
+            return(false);
+
+        QByteArray line = readLine();
+        response->append(line);
+
+        *literalSize = _imapLiteralSize(line);
+        if (*literalSize < 0)
+            return(true);
+    }
 }
 
 bool ImapPrivate::isMultiline (const QString& data) const {
@@ -250,6 +912,18 @@ bool ImapPrivate::isResponseOk (const QByteArray& response) const {
     return(false);
 }
 
+/**
+ * Returns true if response is the NO or BAD completion
+ * of the last command.
+ */
+bool ImapPrivate::isResponseRejected (const QByteArray& response) const {
+    if (!response.startsWith(m_lastTag))
+        return(false);
+
+    QByteArray status = response.mid(m_lastTag.size(), 3).toUpper();
+    return(status.startsWith("NO") || status == "BAD");
+}
+
 bool ImapPrivate::isResponseEnd (const QString& response) const {
     QString trimmed = response.trimmed().toUpper();
 
@@ -266,6 +940,31 @@ bool ImapPrivate::isResponseEnd (const QString& response) const {
     return(false);
 }
 
+bool ImapPrivate::isTaggedResponse (const QByteArray& response) const {
+    return(response.startsWith(m_lastTag));
+}
+
+/**
+ * Cache the capabilities of a "* CAPABILITY ..." response, or of a
+ * "[CAPABILITY ...]" response code (greeting, tagged OK of a login).
+ * Returns false if the response holds none.
+ */
+bool ImapPrivate::parseCapabilities (const QByteArray& response) {
+    QByteArray text;
+    if (response.startsWith("* CAPABILITY ")) {
+        text = response.mid(13);
+    } else {
+        int begin = response.indexOf("[CAPABILITY ");
+        int end = response.indexOf(']', begin);
+        if (begin < 0 || end < 0)
+            return(false);
+        text = response.mid(begin + 12, end - begin - 12);
+    }
+
+    text = text.trimmed().toUpper();
+    capabilities = QString::fromLatin1(text).split(' ', QString::SkipEmptyParts);
+    return(true);
+}
 
 QString ImapPrivate::buildId (void) const {
     QString id;
@@ -275,6 +974,131 @@ QString ImapPrivate::buildId (void) const {
     return(id);
 }
 
+/**
+ * Wait for a socket event: at most timeout ms without progress, and
+ * within the deadline of the cancel token. The wait is sliced to
+ * notice a cancellation. Once the server stalls, or the operation is
+ * cancelled or out of time, the connection is in the middle of a
+ * response and can't be used again: it is aborted.
+ */
+bool ImapPrivate::waitFor (WaitEvent event) {
+    QTime timer;
+    timer.start();
+
+    while (true) {
+        if (event == WaitBytesWritten && device->bytesToWrite() == 0)
+            return(true);
+
+        if (cancelToken != NULL && cancelToken->isCancelled()) {
+            abortOperation("Operation cancelled");
+            return(false);
+        }
+
+        int slice = IMAP_WAIT_SLICE;
+        if (cancelToken != NULL && cancelToken->hasDeadline()) {
+            int remaining = cancelToken->remainingTime();
+            if (remaining == 0) {
+                abortOperation("Operation deadline expired");
+                return(false);
+            }
+            slice = qMin(slice, remaining);
+        }
+        if (timeout >= 0) {
+            int remaining = timeout - timer.elapsed();
+            if (remaining <= 0) {
+                abortOperation("Server timed out");
+                return(false);
+            }
+            slice = qMin(slice, remaining);
+        }
+
+        bool ready = false;
+        switch (event) {
+            case WaitConnected:
+                ready = socket->waitForConnected(slice);
+                break;
+#ifndef QT_NO_OPENSSL
+            case WaitEncrypted:
+                ready = static_cast<QSslSocket *>(socket)->waitForEncrypted(slice);
+                break;
+#else
+            case WaitEncrypted:
+                break;
+#endif
+            case WaitReadyRead:
+                ready = device->waitForReadyRead(slice);
+                break;
+            case WaitBytesWritten:
+                ready = device->waitForBytesWritten(slice);
+                break;
+        }
+        if (ready)
+            return(true);
+
+        // Not a timeout of the slice: the socket failed.
+        if (socket->state() == QAbstractSocket::UnconnectedState)
+            return(false);
+        if ((event == WaitReadyRead || event == WaitBytesWritten) &&
+            socket->state() != QAbstractSocket::ConnectedState)
+        {
+            return(false);
+        }
+    }
+}
+
+bool ImapPrivate::waitForReadyRead (void) {
+    if (stats == NULL || !m_commandPending)
+        return(waitFor(WaitReadyRead));
+
+    QTime timer;
+    timer.start();
+    bool ready = waitFor(WaitReadyRead);
+    m_commandStats.addWaitTime(timer.elapsed());
+    return(ready);
+}
+
+void ImapPrivate::abortOperation (const QString& reason) {
+    responseErrorMsg = reason;
+    socket->abort();
+}
+
+/**
+ * Start measuring a command. Only its name is kept ("UID FETCH"),
+ * arguments may contain credentials.
+ */
+void ImapPrivate::beginStats (const QString& command) {
+    // Previous command never got its tagged response.
+    if (m_commandPending)
+        finishStats(false);
+
+    QStringList words = command.section(' ', 0, 1).split(' ');
+    QString name = words.first().toUpper();
+    if (name == "UID" && words.size() > 1)
+        name += ' ' + words[1].toUpper();
+
+    m_commandStats = ImapCommandStats(name);
+    m_commandPending = true;
+    m_commandTimer.start();
+}
+
+void ImapPrivate::lineStats (const QByteArray& line) {
+    if (m_commandStats.lines() == 0)
+        m_commandStats.setFirstByteTime(m_commandTimer.elapsed());
+
+    m_commandStats.addBytesIn(line.size());
+    m_commandStats.addLines(1);
+
+    if (line.startsWith(m_lastTag))
+        finishStats(isResponseOk(line));
+}
+
+void ImapPrivate::finishStats (bool ok) {
+    m_commandStats.setCompleteTime(m_commandTimer.elapsed());
+    m_commandStats.setOk(ok);
+    m_commandPending = false;
+    stats->record(m_commandStats);
+}
+
 QByteArray ImapPrivate::hmacMd5 (const QString& username,
                                  const QString& password,
                                  const QString& serverResponse)
@@ -311,141 +1135,607 @@ QByteArray ImapPrivate::hmacMd5 (const QString& username,
     return(response.toBase64());
 }
 
-ImapMailbox *ImapPrivate::parseMailbox (const QString& mailboxName) {
-    ImapMailbox *mailbox = NULL;       
-    
-    QByteArray response = readLine();
-    if (response.startsWith('*')) {
-        QRegExp regexUnseen("\\[UNSEEN (\\d+)\\]");
-        QRegExp regexExists("(\\d+) EXISTS");
-        QRegExp regexRecent("(\\d+) RECENT");
-        QRegExp regexFlags(" FLAGS \\((.*)\\)");
-        
-        mailbox = new ImapMailbox(mailboxName);
-        do {
-            if (regexExists.indexIn(response) != -1) {
-                mailbox->setExists(regexExists.cap(1).toInt());
-            } else if (regexRecent.indexIn(response) != -1) {
-                mailbox->setRecent(regexRecent.cap(1).toInt());
-            } else if (regexFlags.indexIn(response) != -1) {
-                mailbox->setFlags(regexFlags.cap(1));
-            } else if (regexUnseen.indexIn(response) != -1) {
-                mailbox->setUnseen(regexUnseen.cap(1).toInt());
-            }
-            
-            response = readLine();
-        } while (response.startsWith('*'));
-        
-        response = response.toUpper();
-        if (isResponseOk(response) &&
-           (response.contains("READ/WRITE") || response.contains("READ-WRITE")))
-        {
-            mailbox->setReadWrite(true);
+ImapMailbox *ImapPrivate::parseMailbox (const QString& mailboxName,
+                                        ImapSyncDelta *delta)
+{
+    ImapMailbox *mailbox = NULL;
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        if (mailbox == NULL)
+            mailbox = new ImapMailbox(mailboxName);
+        parseUntagged(response, mailbox, delta);
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        delete mailbox;
+        selectedMailbox.clear();
+        clearSort();
+        return(NULL);
+    }
+
+    if (mailbox == NULL)
+        mailbox = new ImapMailbox(mailboxName);
+
+    // The sort listing only holds the messages of one mailbox.
+    if (mailboxName != selectedMailbox || mailbox->uidValidity() != selectedUidValidity)
+        clearSort();
+    selectedMailbox = mailboxName;
+    selectedUidValidity = mailbox->uidValidity();
+
+    response = response.toUpper();
+    if (response.contains("READ/WRITE") || response.contains("READ-WRITE"))
+        mailbox->setReadWrite(true);
+
+    return(mailbox);
+}
+
+/**
+ * Apply an untagged response to the mailbox status:
+ * EXISTS, RECENT, FLAGS, OK [UIDVALIDITY/UIDNEXT/HIGHESTMODSEQ/UNSEEN].
+ * Flag updates (FETCH) and VANISHED are reported to the delta, if any.
+ */
+void ImapPrivate::parseUntagged (const QByteArray& response,
+                                 ImapMailbox *mailbox,
+                                 ImapSyncDelta *delta)
+{
+    ImapParser parser(response);
+    if (!parser.skipChar('*'))
+        return;
+
+    bool isNumber;
+    qint64 number = parser.readNumber(&isNumber);
+    if (isNumber) {
+        if (parser.skipAtom("EXISTS")) {
+            mailbox->setExists(number);
+        } else if (parser.skipAtom("RECENT")) {
+            mailbox->setRecent(number);
+        } else if (delta != NULL && parser.skipAtom("FETCH")) {
+            ImapMessageFlags flags;
+            uint uid;
+
+            if (parser.readFlagUpdate(&uid, &flags) && uid != 0)
+                delta->addChanged(uid, flags);
+        }
+        return;
+    }
+
+    if (parser.skipAtom("FLAGS")) {
+        // Keywords allowed, not set: they don't take table entries.
+        mailbox->setFlags(parser.readFlags(false));
+    } else if (parser.skipAtom("VANISHED")) {
+        if (parser.skipChar('(')) {         // (EARLIER)
+            while (!parser.atListEnd())
+                parser.skipValue();
+            parser.skipChar(')');
+        }
+        if (delta != NULL)
+            delta->addRemoved(ImapSequenceSet::fromString(parser.readAtom()));
+    } else if (parser.skipAtom("OK") && parser.skipChar('[')) {
+        QByteArray code = parser.readAtom().toUpper();
+        if (code == "UNSEEN")
+            mailbox->setUnseen(parser.readNumber());
+        else if (code == "UIDVALIDITY")
+            mailbox->setUidValidity(parser.readNumber());
+        else if (code == "UIDNEXT")
+            mailbox->setUidNext(parser.readNumber());
+        else if (code == "HIGHESTMODSEQ")
+            mailbox->setHighestModSeq(parser.readNumber());
+        else if (code == "NOMODSEQ")
+            mailbox->setHighestModSeq(0);
+    }
+}
+
+/**
+ * Read "* SEARCH n n n..." responses (there may be more than one)
+ * up to the tagged completion. Numbers are scanned in place,
+ * ascending runs are appended to the set without searching.
+ */
+bool ImapPrivate::parseSearch (ImapSequenceSet *result) {
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        if (response.startsWith("* SEARCH"))
+            _imapSearchNumbers(response, result);
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+/**
+ * Read the "* SORT 2 84 882" responses, keeping the order.
+ */
+bool ImapPrivate::parseSort (QList<uint> *result) {
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        if (!response.startsWith("* SORT"))
+            continue;
+
+        const char *s = response.constData();
+        int n = response.size();
+        for (int i = 6; i < n; ++i) {
+            if (s[i] < '0' || s[i] > '9')
+                continue;
+
+            uint value = 0;
+            while (i < n && s[i] >= '0' && s[i] <= '9')
+                value = (value * 10) + (s[i++] - '0');
+            result->append(value);
+        }
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+/**
+ * Read "* ESEARCH (TAG "x") [UID] MIN n MAX n COUNT n ALL set"
+ * up to the tagged completion.
+ */
+bool ImapPrivate::parseESearch (ImapSearchResult *result) {
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        ImapParser parser(response);
+        parser.skipChar('*');
+        if (!parser.skipAtom("ESEARCH"))
+            continue;
+
+        if (parser.peek() == '(')           // (TAG "x")
+            parser.skipValue();
+
+        while (!parser.atEnd()) {
+            QByteArray item = parser.readAtom().toUpper();
+            if (item == "UID") {
+                result->setUid(true);
+            } else if (item == "MIN") {
+                result->setMin(parser.readNumber());
+            } else if (item == "MAX") {
+                result->setMax(parser.readNumber());
+            } else if (item == "COUNT") {
+                result->setCount(parser.readNumber());
+            } else if (item == "ALL") {
+                result->setAll(ImapSequenceSet::fromString(parser.readAtom()));
+            } else if (item.isEmpty() || !parser.skipValue()) {
+                break;
+            }
+        }
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+/**
+ * Read responses up to the tagged completion of the last command.
+ * Untagged responses update the mailbox (and the delta) when given.
+ */
+bool ImapPrivate::waitCompletion (ImapMailbox *mailbox, ImapSyncDelta *delta) {
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        if (mailbox != NULL)
+            parseUntagged(response, mailbox, delta);
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+/**
+ * Read the FETCH (ENVELOPE) responses of new messages, skipping the
+ * ones below firstUid ("n:*" always matches the last message).
+ */
+bool ImapPrivate::parseNewMessages (ImapMailbox *mailbox, uint firstUid) {
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        if (!response.contains("ENVELOPE"))
+            continue;
+
+        ImapMessage *message = _imapParseMessage(response, mailbox->addressTable());
+        if (message == NULL)
+            continue;
+
+        if (message->uid().toUInt() >= firstUid)
+            mailbox->addMessage(message);
+        else
+            delete message;
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+ImapMailbox *ImapPrivate::parseMessages (ImapMailbox *mailbox) {
+    QByteArray response;
+
+    while ((response = readResponse()).startsWith('*')) {
+        ImapMessage *message = _imapParseMessage(response, mailbox->addressTable());
+        if (message != NULL) mailbox->addMessage(message);
+    }
+
+    return(mailbox);
+}
+
+bool ImapPrivate::parseListing (ImapListing *listing) {
+    QByteArray response;
+    bool ok;
+
+    while (true) {
+        response = readResponse(&ok);
+        if (!ok)
+            return(false);
+
+        if (isTaggedResponse(response))
+            break;
+
+        if (response.startsWith('*'))
+            listing->appendFetchResponse(response);
+    }
+
+    if (!isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    return(true);
+}
+
+/**
+ * Append the messages added since the sort listing was fetched, with
+ * "UID FETCH last+1:*". Returns false if that can't be done: an error,
+ * or sequence numbers showing that messages were expunged meanwhile.
+ * The listing is only changed on success.
+ */
+bool ImapPrivate::updateSortListing (void) {
+    int count = sortListing->count();
+    int last = sortListing->indexOfId(count);
+    if (count == 0 || last < 0)
+        return(false);
+
+    uint lastUid = sortListing->uid(last);
+    QString command = QString("UID FETCH %1:* %2").arg((qint64)lastUid + 1)
+                                                  .arg(sortListing->fetchItems());
+    if (!sendCommand(command))
+        return(false);
+
+    // Rows follow the listing (n + 1, n + 2...), or the last one is
+    // echoed back (n) when there is none. Unsolicited flag updates carry
+    // no UID and are merged into their rows.
+    QList<QByteArray> updated;
+    QList<QByteArray> added;
+    bool consistent = false;
+    bool expunged = false;
+    QByteArray response;
+    bool ok;
+
+    while ((response = readResponse(&ok)).startsWith('*')) {
+        ImapParser parser(response);
+        parser.skipChar('*');
+
+        bool isNumber;
+        int id = parser.readNumber(&isNumber);
+        if (!isNumber)
+            continue;
+        if (parser.skipAtom("EXPUNGE")) {
+            expunged = true;
+            continue;
+        }
+        if (!parser.skipAtom("FETCH"))
+            continue;
+
+        ImapMessageFlags flags;
+        uint uid;
+        parser.readFlagUpdate(&uid, &flags);
+
+        if (uid == 0 && id <= count) {
+            updated.append(response);
+            continue;
+        }
+
+        if (uid <= lastUid) {
+            consistent = (id == count && uid == lastUid && added.isEmpty());
+        } else {
+            consistent = (id == count + added.size() + 1);
+            added.append(response);
+        }
+        if (!consistent)
+            expunged = true;
+    }
+
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
+    if (expunged || !consistent)
+        return(false);
+
+    foreach (const QByteArray& row, updated)
+        sortListing->appendFetchResponse(row);
+    foreach (const QByteArray& row, added)
+        sortListing->appendFetchResponse(row);
+    return(true);
+}
+
+void ImapPrivate::clearSort (void) {
+    delete sortSorter;
+    delete sortListing;
+    sortSorter = NULL;
+    sortListing = NULL;
+    sortCriteria.clear();
+}
+
+/**
+ * STATUS of every selectable folder of the tree, pipelined in batches
+ * of IMAP_STATUS_BATCH_SIZE commands. A folder that can't be opened
+ * (NO) is left without status.
+ */
+bool ImapPrivate::fetchFolderStatus (ImapFolder *root, const QString& items) {
+    QList<ImapFolder *> folders;
+    foreach (ImapFolder *folder, root->descendants()) {
+        if (folder->isSelectable())
+            folders.append(folder);
+    }
+
+    for (int i = 0; i < folders.size(); i += IMAP_STATUS_BATCH_SIZE) {
+        QStringList commands;
+        for (int j = i; j < folders.size() && j < i + IMAP_STATUS_BATCH_SIZE; ++j) {
+            commands.append(QString("STATUS %1 (%2)")
+                            .arg(_imapQuote(folders[j]->path())).arg(items));
+        }
+
+        if (!sendCommands(commands))
+            return(false);
+
+        int pending = commands.size();
+        while (pending > 0) {
+            bool ok;
+            QByteArray response = readResponse(&ok);
+            if (!ok)
+                return(false);
+
+            if (response.startsWith("* STATUS "))
+                root->appendStatusResponse(response);
+            else if (response.startsWith(IMAP_TAG))
+                pending--;
+        }
+    }
+    return(true);
+}
+
+QByteArray ImapPrivate::parseBodyPart (const QByteArray& response,
+                                       ImapMessageBodyPart::Encoding encoding)
+{
+    QByteArray data;
+
+    // Body is sent as "BODY[n] {size}" literal, or inline as quoted string.
+    int literalSize = _imapLiteralSize(response);
+    if (literalSize >= 0) {
+        data = readBytes(literalSize);
+    } else {
+        int begin = response.indexOf('"', response.indexOf("BODY["));
+        int end = response.lastIndexOf('"');
+        if (begin >= 0 && end > begin)
+            data = response.mid(begin + 1, end - begin - 1);
+    }
+
+    // Skip the rest of the response, up to the tagged completion.
+    QByteArray line;
+    bool ok = true;
+    do {
+        line = readLine(&ok);
+    } while (ok && !isResponseEnd(line));
+
+    return(_imapDecodeBodyPart(data, encoding));
+}
+
+/**
+ * FETCH command for the message, by UID when the sequence number
+ * is unknown (e.g. messages loaded from the cache).
+ */
+QString ImapPrivate::messageCommand (const ImapMessage *message,
+                                     const QString& items) const
+{
+    if (message->id() <= 0 && !message->uid().isEmpty())
+        return(QString("UID FETCH %1 %2").arg(message->uid()).arg(items));
+    return(QString("FETCH %1 %2").arg(message->id()).arg(items));
+}
+
+/**
+ * Parse the BODYSTRUCTURE into the message MIME tree and its parts.
+ */
+bool ImapPrivate::setBodyStructure (ImapMessage *message, const QByteArray& data) {
+    ImapBodyStructure *structure = ImapBodyStructure::parse(data);
+    if (structure == NULL)
+        return(false);
+
+    QList<ImapMessageBodyPart *> bodyParts;
+    foreach (ImapBodyStructure *part, structure->leaves())
+        bodyParts.append(new ImapMessageBodyPart(part));
+
+    message->setBodyStructure(structure);
+    message->setBodyParts(bodyParts);
+    for (int i = 0; i < 2 && i < bodyParts.size(); ++i) {
+        QString contentType = bodyParts[i]->contentType().toUpper();
+        if (contentType == "TEXT/PLAIN") {
+            message->setTextPartIndex(i);
+        } else if (contentType == "TEXT/HTML") {
+            message->setHtmlPartIndex(i);
         }
     }
-    
-    return(mailbox);
+    return(true);
 }
 
-ImapMailbox *ImapPrivate::parseMessages (ImapMailbox *mailbox) {
-    QByteArray response;
+/**
+ * Apply a "* n FETCH (UID n BODYSTRUCTURE (...) BODY[1]<0> {n} ...)"
+ * response to the message with its UID, the structure first whatever
+ * the order of the items. Sections are stored in the body part of the
+ * same number; complete ones go to the cache, when open. Sections cut
+ * at maxBytes are decoded up to their last complete unit and marked
+ * partial.
+ * Returns false if the response isn't for one of the messages.
+ */
+bool ImapPrivate::parseBodies (const QByteArray& response,
+                               const QHash<uint, ImapMessage *>& messages,
+                               int maxBytes)
+{
+    ImapParser parser(response);
+    if (!parser.skipChar('*'))
+        return(false);
 
-    while (true) {
-        // Read Message
-        response.clear();       
-        do {
-            if (response.size() > 0) {
-                response.remove(response.lastIndexOf('}'), 
-                                response.size() - response.lastIndexOf('{'));
-            }
-            response.append(readLine());
-        } while (isMultiline(response));
+    bool isNumber;
+    parser.readNumber(&isNumber);
+    if (!isNumber || !parser.skipAtom("FETCH") || !parser.skipChar('('))
+        return(false);
 
-        // Break if End Response Found.
-        if (isResponseEnd(response))
+    QByteArray structure;
+    QList<QByteArray> sections;
+    QList<QByteArray> sectionData;
+    uint uid = 0;
+
+    while (!parser.atListEnd()) {
+        QByteArray item = parser.readAtom().toUpper();
+        if (item == "UID") {
+            uid = parser.readNumber();
+        } else if (item == "BODYSTRUCTURE") {
+            int begin = parser.position();
+            if (!parser.skipValue())
+                return(false);
+            structure = response.mid(begin, parser.position() - begin).trimmed();
+        } else if (item.startsWith("BODY[")) {
+            int end = item.indexOf(']');
+            sections.append(item.mid(5, end - 5));
+            sectionData.append(parser.readString());
+        } else if (item.isEmpty() || !parser.skipValue()) {
             break;
-
-        // Parse and Add Message to Mailbox
-        ImapMessage *message = _imapParseMessage(response.trimmed());
-        if (message != NULL) mailbox->addMessage(message);
+        }
     }
-    
-    return(mailbox);
-}
 
-QList<ImapMessageBodyPart *> ImapPrivate::bodyPartSplit (const QByteArray& response) {
-    QList<ImapMessageBodyPart *> partList;
-    int count = 0;
-    int index = 1;
-    int i = 0;
+    ImapMessage *message = messages.value(uid);
+    if (message == NULL)
+        return(false);
 
-    do {
-        int next = index;
-        do {
-            if (response[next] == '(')
-                i++;
-            else if (response[next] == ')')
-                i--;
-            next++;
-        } while (i > 0 || response[next - 1] != ')');
-
-        if (i >= 0 && response[index] == '(') {
-            count++;
-
-            if (response.indexOf("((", index) == index) {
-                QByteArray part = response.mid(index, next);
-                QList<ImapMessageBodyPart *> tempParts = bodyPartSplit(part);
-                foreach (ImapMessageBodyPart *p, tempParts) {
-                    p->setBodyPart(QString("%1.%2").arg(count).arg(p->bodyPart()));
-                    partList.append(p);
-                }
-            } else {
-                QByteArray part = response.mid(index, next - index);
-                ImapMessageBodyPart *bodyPart = new ImapMessageBodyPart(part);
-                bodyPart->setBodyPart(QString::number(count));
-                partList.append(bodyPart);
-            }
-        } else if (partList.size() == 0) {
-            ImapMessageBodyPart *bodyPart = new ImapMessageBodyPart(response);
-            bodyPart->setBodyPart("1");
-            partList.append(bodyPart);
-        }
+    bool useCache = (cache != NULL && cache->isOpen());
+    if (!structure.isEmpty() && message->bodyStructure() == NULL &&
+        setBodyStructure(message, structure) && useCache)
+    {
+        cache->insertBodyStructure(uid, structure);
+    }
 
-        index = next;
-    } while (i >= 0);    
+    for (int i = 0; i < sections.size(); ++i) {
+        QString section = QString::fromLatin1(sections[i]);
+        for (int part = 0; part < message->bodyPartCount(); ++part) {
+            ImapMessageBodyPart *bodyPart = message->bodyPartAt(part);
+            if (bodyPart->bodyPart() != section)
+                continue;
+
+            // Fewer bytes than asked for, or the whole size: complete.
+            QByteArray data = sectionData[i];
+            bool partial = (maxBytes > 0 && data.size() >= maxBytes &&
+                            (bodyPart->size() == 0 || (quint32)data.size() < bodyPart->size()));
+            if (partial)
+                data = _imapTrimPartial(data, bodyPart->encoding());
+
+            bodyPart->setData(_imapDecodeBodyPart(data, bodyPart->encoding()), partial);
+            if (useCache && !partial)
+                cache->insertBodyPart(uid, section, bodyPart->data());
+            break;
+        }
+    }
+    return(true);
+}
 
-    return(partList);
+QString ImapPrivate::rfcDate (const QDateTime& date) const {
+    return(date.toString("dd-MMM-yyyy HH:mm:ss +0000"));
 }
 
-QByteArray ImapPrivate::parseBodyPart (ImapMessageBodyPart::Encoding encoding) {
-    QByteArray response;
-    QByteArray data;
+/* "17-Jul-1996 09:44:25 +0000", english month names whatever the locale */
+QString ImapPrivate::internalDate (const QDateTime& date) const {
+    return(QLocale::c().toString(date.toUTC(), "dd-MMM-yyyy HH:mm:ss +0000"));
+}
 
-    while (!isResponseEnd((response = readLine()))) {
-        response.remove(response.size() - 2, 2);
-        if (encoding == ImapMessageBodyPart::Base64Encoding) {
-            data += response;
-        } else if (encoding == ImapMessageBodyPart::QuotedPrintableEncoding) {
-            if (response.endsWith('=') || response.endsWith(')'))
-                data += response.mid(0, response.size() - 1);
-            else
-                data += response + IMAP_MESSAGE_BODY_NEWLINE;
-        } else {
-            data += response + IMAP_MESSAGE_BODY_NEWLINE;
+/**
+ * Send the messages in a single APPEND command (several messages
+ * need MULTIAPPEND). With LITERAL+ the data follows each size without
+ * waiting for the server, otherwise each literal waits for "+".
+ */
+bool ImapPrivate::appendMessages (const QString& mailbox,
+                                  const QList<QIODevice *>& messages,
+                                  const QList<ImapMessageFlags>& flags,
+                                  const QList<QDateTime>& received,
+                                  bool literalPlus,
+                                  ImapSequenceSet *uids)
+{
+    for (int i = 0; i < messages.size(); ++i) {
+        QIODevice *source = messages[i];
+
+        // Sequential sources have no size until read.
+        QBuffer buffer;
+        if (source->isSequential()) {
+            buffer.setData(source->readAll());
+            buffer.open(QIODevice::ReadOnly);
+            source = &buffer;
         }
+        qint64 size = source->size() - source->pos();
+
+        QString part;
+        if (i < flags.size() && flags[i] != 0)
+            part += QString("(%1) ").arg(ImapMessage::flagsString(flags[i]));
+        if (i < received.size() && received[i].isValid())
+            part += QString("\"%1\" ").arg(internalDate(received[i]));
+        part += QString("{%1%2}").arg(size).arg(literalPlus ? "+" : "");
+
+        bool sent;
+        if (i == 0)
+            sent = sendCommand(QString("APPEND %1 %2").arg(_imapQuote(mailbox)).arg(part));
+        else
+            sent = sendDataLine(" " + part);
+
+        if (!sent || (!literalPlus && !waitContinuation()))
+            return(false);
+        if (!sendLiteral(source, size))
+            return(false);
     }
 
-    if (data.trimmed().endsWith(')'))
-        data = data.remove(data.lastIndexOf(')'), 1);
+    if (!sendDataLine(QString()))
+        return(false);
 
-    if (encoding != ImapMessageBodyPart::Base64Encoding)
-        return(Imap::decode(data));
-    return(data);
-}
+    QByteArray response;
+    bool ok;
+    while ((response = readResponse(&ok)).startsWith('*'))
+        ;
 
+    if (!ok || !isResponseOk(response)) {
+        responseErrorMsg = response;
+        return(false);
+    }
 
-QString ImapPrivate::rfcDate (const QDateTime& date) const {
-    return(date.toString("dd-MMM-yyyy HH:mm:ss +0000"));
+    _imapParseUidCode(response, "APPENDUID", uids);
+    return(true);
 }
 
 // ===========================================================================
@@ -465,42 +1755,11 @@ Imap::~Imap() {
 //  PUBLIC STATIC Methods (Decode)
 // ===========================================================================
 QString Imap::decode (const QString& text) {
-    return(decode(text.toLatin1()));
+    return(ImapCodec::decodeHeader(text.toLatin1()));
 }
 
 QByteArray Imap::decode (const QByteArray& text) {
-    QRegExp rx("=\\?([^\\?]+)\\?([^\\?]+)\\?([^\\?]+)\\?=");
-    QByteArray output;
-    int pos = 0;
-
-    while ((pos = rx.indexIn(text, pos)) != -1) {
-        QString method = rx.cap(2).toLower();
-        QString data = rx.cap(3);
-
-        if (method == "b") {
-            output += QByteArray::fromBase64(data.toLatin1());
-        } else if (!data.isEmpty()) {
-            bool ok;
-            for (int i = 0; i < data.size(); ++i) {
-                if (data[i] == '=') {
-                    i++;
-                    int chr = data.mid(i, 2).toInt(&ok, 16);
-                    if (data.size() >= (i + 2) && ok) {
-                        output += (char)chr;
-                        i++;
-                    }
-                } else if (data[i] == '_') {
-                    output += ' ';
-                } else {
-                    output += data[i].toAscii();
-                }
-            }
-        }
-
-        pos += rx.matchedLength();
-    }
-
-    return(output.size() > 0 ? output : text);
+    return(ImapCodec::decodeEncodedWords(text));
 }
 
 // ===========================================================================
@@ -517,6 +1776,9 @@ bool Imap::connectToHost (const QString& host, quint16 port, bool useSsl) {
     if (!response.startsWith("* OK"))
         return(false);
 
+    // Servers usually announce their capabilities in the greeting.
+    d->parseCapabilities(response);
+    d->saveSslSession();
     return(true);
 }
 
@@ -539,10 +1801,15 @@ bool Imap::disconnectFromHost (void) {
     if (d->socket->state() == QAbstractSocket::UnconnectedState)
         return(true);
 
+    d->saveSslSession();
     d->socket->disconnectFromHost();
     if (!d->socket->waitForDisconnected())
         return(false);
 
+    if (d->device != d->socket)
+        delete d->device;
+    d->device = NULL;
+
     delete d->socket;
     d->socket = NULL;
     return(true);
@@ -553,20 +1820,54 @@ bool Imap::disconnectFromHost (void) {
 // ===========================================================================
 /**
  * Login to the IMAP Server, using the specified username/password.
- * TODO: Need to check server capabilities before use specified login type.
+ * LoginAuto picks the mechanism from the server capabilities, preferring
+ * those completed in a single round trip.
  */
 bool Imap::login (const QString& username,
                   const QString& password,
                   LoginType type)
 {
-    // TODO: Check Capabilities before use specified Login Type.
-    //QString capabilities = capability();
+    if (type == LoginAuto) {
+        bool plain = hasCapability("AUTH=PLAIN");
+        if (plain && hasCapability("SASL-IR"))
+            type = LoginAuthenticatePlain;
+        else if (!hasCapability("LOGINDISABLED"))
+            type = LoginPlain;
+        else if (plain)
+            type = LoginAuthenticatePlain;
+        else if (hasCapability("AUTH=CRAM-MD5"))
+            type = LoginCramMd5;
+        else
+            type = LoginAuthenticate;
+    }
 
     switch (type) {
+        case LoginAuto:
         case LoginPlain:
             if (!d->sendCommand("LOGIN %1 %2", QStringList() << username << password))
                 return(false);
             break;
+        case LoginAuthenticatePlain: {
+            // RFC 4616: authzid NUL authcid NUL passwd, sent with the
+            // command when the server supports SASL-IR (RFC 4959).
+            QByteArray message;
+            message.append('\0');
+            message.append(username.toUtf8());
+            message.append('\0');
+            message.append(password.toUtf8());
+            QString initial = message.toBase64();
+
+            if (hasCapability("SASL-IR")) {
+                if (!d->sendCommand("AUTHENTICATE PLAIN %1", QStringList() << initial))
+                    return(false);
+            } else {
+                if (!d->sendCommand("AUTHENTICATE PLAIN") || !d->waitContinuation())
+                    return(false);
+                if (!d->sendDataLine(initial))
+                    return(false);
+            }
+            break;
+        }
         case LoginAuthenticate:
             if (!d->sendCommand("AUTHENTICATE LOGIN"))
                 return(false);
@@ -592,12 +1893,53 @@ bool Imap::login (const QString& username,
                 return(false);
             break;
     }
-    
-    QByteArray result = d->readLine();
-    if (!d->isResponseOk(result)) {
+
+    // Capabilities change once authenticated: keep the ones sent with
+    // the response, if any, instead of asking again.
+    bool capabilities = false;
+    QByteArray result;
+    bool ok;
+    while ((result = d->readResponse(&ok)).startsWith('*')) {
+        if (d->parseCapabilities(result))
+            capabilities = true;
+    }
+
+    if (!ok || !d->isResponseOk(result)) {
         d->responseErrorMsg = result;
         return(false);
     }
+
+    if (!d->parseCapabilities(result) && !capabilities)
+        d->capabilities.clear();
+
+    // Optional, the session goes on uncompressed if refused.
+    if (d->compression && hasCapability("COMPRESS=DEFLATE"))
+        compress();
+    return(true);
+}
+
+/**
+ * Enable COMPRESS=DEFLATE (RFC 4978), once authenticated: everything
+ * sent and received afterwards goes through a deflate layer.
+ */
+bool Imap::compress (void) {
+    if (d->device != d->socket)
+        return(true);
+
+    if (!d->sendCommand("COMPRESS DEFLATE"))
+        return(false);
+
+    QByteArray response;
+    bool ok;
+    while ((response = d->readResponse(&ok)).startsWith('*'))
+        ;
+
+    if (!ok || !d->isResponseOk(response)) {
+        d->responseErrorMsg = response;
+        return(false);
+    }
+
+    d->device = new ImapCompressDevice(d->socket);
     return(true);
 }
 
@@ -625,10 +1967,23 @@ QString Imap::capability (void) {
     
     QByteArray capability = d->readLine();
     d->readLine();
-    
+
+    d->parseCapabilities(capability);
     return(capability.trimmed());
 }
 
+/**
+ * Returns true if the server announces the specified capability
+ * (e.g. "CONDSTORE", "AUTH=PLAIN"). The capability list is cached,
+ * from the greeting and login responses when the server sends it.
+ */
+bool Imap::hasCapability (const QString& name) {
+    if (d->capabilities.isEmpty())
+        capability();
+
+    return(d->capabilities.contains(name.toUpper()));
+}
+
 // ===========================================================================
 //  PUBLIC Methods (IMAP Mailbox Related)
 // ===========================================================================
@@ -694,6 +2049,50 @@ QStringList Imap::list (const QString& directory, const QString& pattern) {
     return(folders);
 }
 
+/**
+ * Folder hierarchy with the STATUS items of each folder, or NULL on
+ * error. Uses LIST-STATUS (RFC 5819) when available, a single LIST
+ * and pipelined STATUS commands otherwise. The caller owns the tree.
+ */
+ImapFolder *Imap::folderTree (const QString& reference,
+                              const QString& pattern,
+                              ImapFolder::StatusItems items)
+{
+    QString status = ImapFolder::statusItemsString(items);
+    bool listStatus = !status.isEmpty() && hasCapability("LIST-STATUS");
+
+    QString command = QString("LIST %1 %2").arg(_imapQuote(reference))
+                                           .arg(_imapQuote(pattern));
+    if (listStatus)
+        command += QString(" RETURN (STATUS (%1))").arg(status);
+
+    if (!d->sendCommand(command))
+        return(NULL);
+
+    ImapFolder *root = new ImapFolder;
+
+    QByteArray response;
+    bool ok;
+    while ((response = d->readResponse(&ok)).startsWith('*')) {
+        if (response.startsWith("* LIST "))
+            root->appendListResponse(response);
+        else if (response.startsWith("* STATUS "))
+            root->appendStatusResponse(response);
+    }
+
+    if (!ok || !d->isResponseOk(response)) {
+        d->responseErrorMsg = response;
+        delete root;
+        return(NULL);
+    }
+
+    if (!listStatus && !status.isEmpty() && !d->fetchFolderStatus(root, status)) {
+        delete root;
+        return(NULL);
+    }
+    return(root);
+}
+
 /*
  * Create Mailbox with specified name.
  */
@@ -773,6 +2172,124 @@ bool Imap::copyMailbox (const QString& mailbox, int begin, int end) {
     return(true);
 }
 
+// ===========================================================================
+//  PUBLIC Methods (IMAP Message Transfer)
+// ===========================================================================
+/**
+ * Upload a message (RFC 822 data, CRLF line ends) to the mailbox,
+ * read from the current position of the device to its end.
+ * If the server supports UIDPLUS, uid is set to the new message UID.
+ */
+bool Imap::append (const QString& mailbox,
+                   QIODevice *message,
+                   ImapMessageFlags flags,
+                   const QDateTime& received,
+                   uint *uid)
+{
+    ImapSequenceSet uids;
+    bool literalPlus = hasCapability("LITERAL+");
+    if (!d->appendMessages(mailbox, QList<QIODevice *>() << message,
+                           QList<ImapMessageFlags>() << flags,
+                           QList<QDateTime>() << received,
+                           literalPlus, &uids))
+    {
+        return(false);
+    }
+
+    if (uid != NULL)
+        *uid = uids.isEmpty() ? 0 : uids.first();
+    return(true);
+}
+
+bool Imap::append (const QString& mailbox,
+                   const QByteArray& message,
+                   ImapMessageFlags flags,
+                   const QDateTime& received,
+                   uint *uid)
+{
+    QBuffer buffer;
+    buffer.setData(message);
+    buffer.open(QIODevice::ReadOnly);
+    return(append(mailbox, &buffer, flags, received, uid));
+}
+
+/**
+ * Upload several messages, flags and received dates are optional
+ * and match the messages by index. With MULTIAPPEND (RFC 3502) they
+ * are sent in batches of one command each, a failed batch adds none
+ * of its messages; otherwise one APPEND per message is sent.
+ * If the server supports UIDPLUS, uids gets the new messages UIDs.
+ */
+bool Imap::multiAppend (const QString& mailbox,
+                        const QList<QIODevice *>& messages,
+                        const QList<ImapMessageFlags>& flags,
+                        const QList<QDateTime>& received,
+                        ImapSequenceSet *uids)
+{
+    bool literalPlus = hasCapability("LITERAL+");
+    int batchSize = hasCapability("MULTIAPPEND") ? IMAP_APPEND_BATCH_SIZE : 1;
+
+    for (int i = 0; i < messages.size(); i += batchSize) {
+        if (!d->appendMessages(mailbox, messages.mid(i, batchSize),
+                               flags.mid(i, batchSize), received.mid(i, batchSize),
+                               literalPlus, uids))
+        {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+/**
+ * Copy messages to the mailbox. If the server supports UIDPLUS,
+ * newUids gets the UIDs of the copies.
+ */
+bool Imap::uidCopy (const ImapSequenceSet& uids,
+                    const QString& mailbox,
+                    ImapSequenceSet *newUids)
+{
+    if (uids.isEmpty())
+        return(true);
+
+    QStringList commands;
+    _imapUidCommands(&commands, "UID COPY", uids, _imapQuote(mailbox));
+    return(d->runUidCommands(commands, newUids));
+}
+
+/**
+ * Move messages to the mailbox, with MOVE (RFC 6851) if available.
+ * Otherwise they are copied and flagged \Deleted, then expunged by UID
+ * with UIDPLUS. Without UIDPLUS they are left flagged \Deleted: a plain
+ * EXPUNGE would also remove the other messages flagged \Deleted, it
+ * is up to the caller to expunge().
+ * If the server supports UIDPLUS, newUids gets the new UIDs.
+ */
+bool Imap::uidMove (const ImapSequenceSet& uids,
+                    const QString& mailbox,
+                    ImapSequenceSet *newUids)
+{
+    if (uids.isEmpty())
+        return(true);
+
+    if (!hasCapability("MOVE")) {
+        if (!uidCopy(uids, mailbox, newUids))
+            return(false);
+
+        if (!d->storeFlags(uids, ImapMessageDeleted, 0))
+            return(false);
+        if (!hasCapability("UIDPLUS"))
+            return(true);
+
+        QStringList commands;
+        _imapUidCommands(&commands, "UID EXPUNGE", uids);
+        return(d->runUidCommands(commands, NULL));
+    }
+
+    QStringList commands;
+    _imapUidCommands(&commands, "UID MOVE", uids, _imapQuote(mailbox));
+    return(d->runUidCommands(commands, newUids));
+}
+
 // ===========================================================================
 //  PUBLIC Methods (IMAP Message Related)
 // ===========================================================================
@@ -828,95 +2345,334 @@ ImapMailbox *Imap::fetch (ImapMailbox *mailbox) {
     return(d->parseMessages(mailbox));
 }
 
-/**
- * Fetch messages of selected mailbox from 'begin' to 'end'.
- */
-ImapMailbox *Imap::fetch (ImapMailbox *mailbox, int begin, int end) {
-    if (!d->sendCommand(QString("FETCH %1:%2 ALL").arg(begin).arg(end)))
-        return(NULL);
+/**
+ * Fetch messages of selected mailbox from 'begin' to 'end'.
+ */
+ImapMailbox *Imap::fetch (ImapMailbox *mailbox, int begin, int end) {
+    if (!d->sendCommand(QString("FETCH %1:%2 ALL").arg(begin).arg(end)))
+        return(NULL);
+
+    return(d->parseMessages(mailbox));
+}
+
+/**
+ * Fetch messages of selected mailbox.
+ */
+ImapMailbox *Imap::fetch (ImapMailbox *mailbox, const QList<int>& messages) {
+    if (messages.size() < 1)
+        return(NULL);
+
+    QString messageList;
+    foreach (int messageNr, messages)
+        messageList += QString("%1,").arg(messageNr);
+    messageList.remove(messageList.size() - 1, 1);
+    
+    if (!d->sendCommand(QString("FETCH %1 ALL").arg(messageList)))
+        return(NULL);
+
+    return(d->parseMessages(mailbox));
+}
+
+/**
+ * Fetch UID, FLAGS, INTERNALDATE, RFC822.SIZE and ENVELOPE
+ * of the messages with the specified UIDs.
+ */
+ImapMailbox *Imap::uidFetch (ImapMailbox *mailbox, const ImapSequenceSet& uids) {
+    if (uids.isEmpty())
+        return(mailbox);
+
+    // Split, a sparse set would not fit in one command.
+    QStringList commands;
+    _imapUidFetchCommands(&commands, uids, "UID FLAGS INTERNALDATE RFC822.SIZE ENVELOPE");
+
+    for (int i = 0; i < commands.size(); i += IMAP_PIPELINE_BATCH_SIZE) {
+        QStringList batch = commands.mid(i, IMAP_PIPELINE_BATCH_SIZE);
+        if (!d->sendCommands(batch))
+            return(NULL);
+
+        bool ok = true;
+        int pending = batch.size();
+        while (pending > 0) {
+            bool readOk;
+            QByteArray response = d->readResponse(&readOk);
+            if (!readOk)
+                return(NULL);
+
+            if (response.startsWith('*')) {
+                if (!response.contains("ENVELOPE"))
+                    continue;
+
+                ImapMessage *message = _imapParseMessage(response, mailbox->addressTable());
+                if (message != NULL)
+                    mailbox->addMessage(message);
+            } else if (response.startsWith(IMAP_TAG)) {
+                if (!_imapTaggedOk(response)) {
+                    d->responseErrorMsg = response;
+                    ok = false;
+                }
+                pending--;
+            }
+        }
+
+        if (!ok)
+            return(NULL);
+    }
+    return(mailbox);
+}
+
+/**
+ * Fetch headers of specified message.
+ */
+ImapMessage *Imap::fetchHeaders (int messageNumber) {
+    ImapMailbox mailbox;
+    fetch(&mailbox, messageNumber, messageNumber);
+    ImapMessage *message = mailbox.takeAt(0);
+    mailbox.clearMessages();    
+    return(message);
+}
+
+/**
+ * Fetch a compact listing of all mailbox messages.
+ * Only the fields requested by the listing are fetched.
+ */
+bool Imap::fetchListing (ImapListing *listing) {
+    if (!d->sendCommand(QString("FETCH 1:* %1").arg(listing->fetchItems())))
+        return(false);
+
+    return(d->parseListing(listing));
+}
+
+/**
+ * Fetch a compact listing of messages from 'begin' to 'end'.
+ */
+bool Imap::fetchListing (ImapListing *listing, int begin, int end) {
+    listing->reserve(listing->count() + (end - begin) + 1);
+
+    QString command = "FETCH %1:%2 %3";
+    if (!d->sendCommand(command.arg(begin).arg(end).arg(listing->fetchItems())))
+        return(false);
+
+    return(d->parseListing(listing));
+}
+
+// ===========================================================================
+//  PUBLIC Methods (IMAP Synchronization)
+// ===========================================================================
+/**
+ * Select state->mailbox() and bring the state up to date, reporting to
+ * delta the messages added, removed and whose flags changed since the
+ * previous call. Only what changed is transferred:
+ *  - QRESYNC: changes and VANISHED UIDs come with the SELECT itself.
+ *  - CONDSTORE: UID FETCH (CHANGEDSINCE modseq) plus a UID SEARCH of
+ *    the known range to find removed messages.
+ *  - Otherwise: UID FETCH (UID FLAGS) of the known range.
+ * New messages are fetched starting from the first unknown UID.
+ * Changes are those from the flags kept by the state.
+ * A UIDVALIDITY change resets the state (delta->isReset()).
+ */
+bool Imap::synchronize (ImapSyncState *state, ImapSyncDelta *delta) {
+    delta->clear();
+
+    bool condStore = hasCapability("CONDSTORE") || hasCapability("QRESYNC");
+    if (!d->qresyncEnabled && hasCapability("QRESYNC")) {
+        if (d->sendCommand("ENABLE QRESYNC") && d->waitCompletion())
+            d->qresyncEnabled = true;
+    }
+
+    ImapSequenceSet known = state->uids();
+    bool resync = d->qresyncEnabled && state->uidValidity() != 0 &&
+                  state->highestModSeq() != 0;
+
+    QString command = QString("SELECT %1").arg(_imapQuote(state->mailbox()));
+    if (resync) {
+        command += QString(" (QRESYNC (%1 %2").arg(state->uidValidity())
+                                              .arg(state->highestModSeq());
+        if (!known.isEmpty())
+            command += QString(" %1").arg(known.toString());
+        command += "))";
+    } else if (condStore) {
+        command += " (CONDSTORE)";
+    }
+
+    // Changes reported by the server, filtered on known UIDs at the end.
+    ImapSyncDelta changes;
+    if (!d->sendCommand(command))
+        return(false);
+
+    ImapMailbox *mailbox = d->parseMailbox(state->mailbox(), &changes);
+    if (mailbox == NULL)
+        return(false);
+
+    delta->setUidValidity(mailbox->uidValidity());
+    if (state->uidValidity() != 0 && state->uidValidity() != mailbox->uidValidity()) {
+        delta->setReset(true);
+        delta->addRemoved(known);
+        changes.clear();
+        state->clear();
+        known.clear();
+        resync = false;
+    }
+
+    quint64 modSeq = condStore ? mailbox->highestModSeq() : 0;
+    ImapSequenceSet removed;
+
+    if (!known.isEmpty() && !(resync && modSeq != 0)) {
+        QString range = QString("1:%1").arg(known.last());
+        ImapSequenceSet present;
+        bool ok;
+
+        if (modSeq != 0 && state->highestModSeq() != 0) {
+            // Flags changed since the last synchronization,
+            // and known UIDs still on the server.
+            command = QString("UID FETCH %1 (UID FLAGS) (CHANGEDSINCE %2)");
+            ok = d->sendCommand(command.arg(range).arg(state->highestModSeq())) &&
+                 d->waitCompletion(mailbox, &changes) &&
+                 d->sendCommand(QString("UID SEARCH UID %1").arg(range)) &&
+                 d->parseSearch(&present);
+        } else {
+            // No modseq to compare with, flags of every known message.
+            ok = d->sendCommand(QString("UID FETCH %1 (UID FLAGS)").arg(range)) &&
+                 d->waitCompletion(mailbox, &changes);
+
+            foreach (uint uid, changes.changed().keys())
+                present.add(uid);
+        }
+
+        if (!ok) {
+            delete mailbox;
+            return(false);
+        }
+        removed = known.subtracted(present);
+    }
 
-    return(d->parseMessages(mailbox));
-}
+    removed.add(changes.removed().intersected(known));
+    delta->addRemoved(removed);
 
-/**
- * Fetch messages of selected mailbox.
- */
-ImapMailbox *Imap::fetch (ImapMailbox *mailbox, const QList<int>& messages) {
-    if (messages.size() < 1)
-        return(NULL);
+    // Without CONDSTORE every known message is here: compare
+    // with the flags of the state, to report real changes only.
+    QHash<uint, ImapMessageFlags> changed = changes.changed();
+    QHash<uint, ImapMessageFlags>::const_iterator it;
+    for (it = changed.constBegin(); it != changed.constEnd(); ++it) {
+        if (!known.contains(it.key()) || removed.contains(it.key()))
+            continue;
 
-    QString messageList;
-    foreach (int messageNr, messages)
-        messageList += QString("%1,").arg(messageNr);
-    messageList.remove(messageList.size() - 1, 1);
-    
-    if (!d->sendCommand(QString("FETCH %1 ALL").arg(messageList)))
-        return(NULL);
+        if (!state->hasFlags(it.key()) || state->flags(it.key()) != it.value()) {
+            delta->addChanged(it.key(), it.value());
+            state->setFlags(it.key(), it.value());
+        }
+    }
+    state->removeFlags(removed);
+    known.remove(removed);
+
+    // New messages
+    uint firstUid = known.isEmpty() ? 1 : known.last() + 1;
+    firstUid = qMax(firstUid, state->uidNext());
+    if (mailbox->exists() > 0 && (mailbox->uidNext() == 0 || firstUid < mailbox->uidNext())) {
+        command = "UID FETCH %1:* (UID FLAGS INTERNALDATE RFC822.SIZE ENVELOPE)";
+        if (!d->sendCommand(command.arg(firstUid)) ||
+            !d->parseNewMessages(delta->added(), firstUid))
+        {
+            delete mailbox;
+            return(false);
+        }
 
-    return(d->parseMessages(mailbox));
-}
+        foreach (ImapMessage *message, delta->added()->messages()) {
+            known.add(message->uid().toUInt());
+            state->setFlags(message->uid().toUInt(), message->flags());
+        }
+    }
 
-/**
- * Fetch headers of specified message.
- */
-ImapMessage *Imap::fetchHeaders (int messageNumber) {
-    ImapMailbox mailbox;
-    fetch(&mailbox, messageNumber, messageNumber);
-    ImapMessage *message = mailbox.takeAt(0);
-    mailbox.clearMessages();    
-    return(message);
+    state->setUids(known);
+    state->setUidValidity(mailbox->uidValidity());
+    state->setHighestModSeq(modSeq);
+    state->setUidNext(mailbox->uidNext() != 0 ? mailbox->uidNext() :
+                      (known.isEmpty() ? 1 : known.last() + 1));
+    delete mailbox;
+    return(true);
 }
 
 /**
  * Set seen flag at specified value to message.
  */
 bool Imap::setSeen (int messageNumber, bool value) {
-    return(d->setFlag(fetchUid(messageNumber), "\\Seen", value));
+    return(d->setFlag(fetchUid(messageNumber), ImapMessageSeen, value));
 }
 
 /**
  * Set draft flag at specified value to message.
  */
 bool Imap::setDraft (int messageNumber, bool value) {
-    return(d->setFlag(fetchUid(messageNumber), "\\Draft", value));
+    return(d->setFlag(fetchUid(messageNumber), ImapMessageDraft, value));
 }
 
 /**
  * Set recent flag at specified value to message.
+ * Clients can't change \Recent (RFC 3501), nothing is sent.
  */
 bool Imap::setRecent (int messageNumber, bool value) {
-    return(d->setFlag(fetchUid(messageNumber), "\\Recent", value));
+    return(d->setFlag(fetchUid(messageNumber), ImapMessageRecent, value));
 }
 
 /**
  * Set flagged flag at specified value to message.
  */
 bool Imap::setFlagged (int messageNumber, bool value) {
-    return(d->setFlag(fetchUid(messageNumber), "\\Flagged", value));
+    return(d->setFlag(fetchUid(messageNumber), ImapMessageFlagged, value));
 }
 
 /**
  * Set deleted flag at specified value to message.
  */
 bool Imap::setDeleted (int messageNumber, bool value) {
-    return(d->setFlag(fetchUid(messageNumber), "\\Deleted", value));
+    return(d->setFlag(fetchUid(messageNumber), ImapMessageDeleted, value));
 }
 
 /**
  * Set answered flag at specified value to message.
  */
 bool Imap::setAnswered (int messageNumber, bool value) {
-    return(d->setFlag(fetchUid(messageNumber), "\\Answered", value));
+    return(d->setFlag(fetchUid(messageNumber), ImapMessageAnswered, value));
+}
+
+/**
+ * Add and remove flags (keywords included) of the messages with the
+ * specified UIDs, in as few UID STORE commands as the set allows:
+ *
+ *   imap->storeFlags(read, ImapMessageSeen, ImapMessageFlagged);
+ *
+ * The flags returned by the server update the cache, when open.
+ * Fails without flags to store, as when keywordFlag() returned 0.
+ */
+bool Imap::storeFlags (const ImapSequenceSet& uids,
+                       ImapMessageFlags added,
+                       ImapMessageFlags removed)
+{
+    if ((added | removed) == 0) {
+        d->responseErrorMsg = "No flags to store";
+        return(false);
+    }
+    return(d->storeFlags(uids, added, removed));
 }
 
 /**
  * Fetch message body structure.
  */
 bool Imap::fetchBodyStructure (ImapMessage *message) {
+    uint uid = message->uid().toUInt();
     QByteArray response;
     QByteArray data;
-    
-    if (!d->sendCommand(QString("FETCH %1 BODYSTRUCTURE").arg(message->id())))
+
+    if (message->bodyStructure() != NULL)
+        return(true);
+
+    bool useCache = (d->cache != NULL && d->cache->isOpen() && uid != 0);
+    if (useCache && d->cache->hasBodyStructure(uid) &&
+        d->setBodyStructure(message, d->cache->bodyStructure(uid)))
+    {
+        return(true);
+    }
+
+    if (!d->sendCommand(d->messageCommand(message, "BODYSTRUCTURE")))
         return(false);
 
     while (!d->isResponseEnd((response = d->readLine())))
@@ -928,17 +2684,14 @@ bool Imap::fetchBodyStructure (ImapMessage *message) {
     }
     
     data.remove(0, data.indexOf(" (", data.indexOf("BODYSTRUCTURE")));
-    QList<ImapMessageBodyPart *> bodyParts = d->bodyPartSplit(data.trimmed());
-    message->setBodyParts(bodyParts);
-    for (int i = 0; i < 2 && i < bodyParts.size(); ++i) {
-        QString contentType = bodyParts[i]->contentType().toUpper();
-        if (contentType == "TEXT/PLAIN") {
-            message->setTextPartIndex(i);
-        } else if (contentType == "TEXT/HTML") {
-            message->setHtmlPartIndex(i);
-        }
+    data = data.trimmed();
+    if (!d->setBodyStructure(message, data)) {
+        d->responseErrorMsg = "Malformed BODYSTRUCTURE";
+        return(false);
     }
 
+    if (useCache)
+        d->cache->insertBodyStructure(uid, data);
     return(true);
 }
 
@@ -948,9 +2701,16 @@ bool Imap::fetchBodyStructure (ImapMessage *message) {
 bool Imap::fetchBodyPart (ImapMessage *message, int part) {
     ImapMessageBodyPart *msgPart = message->bodyPartAt(part);
     QString bodyPart = msgPart->bodyPart();
-    int msgId = message->id();
+    uint uid = message->uid().toUInt();
 
-    if (!d->sendCommand(QString("FETCH %1 BODY[%2]").arg(msgId).arg(bodyPart)))
+    bool useCache = (d->cache != NULL && d->cache->isOpen() && uid != 0);
+    if (useCache && d->cache->hasBodyPart(uid, bodyPart)) {
+        msgPart->setData(d->cache->bodyPart(uid, bodyPart));
+        return(true);
+    }
+
+    QString items = QString("BODY[%1]").arg(bodyPart);
+    if (!d->sendCommand(d->messageCommand(message, items)))
         return(false);
 
     QByteArray response = d->readLine();
@@ -959,10 +2719,115 @@ bool Imap::fetchBodyPart (ImapMessage *message, int part) {
         return(false);
     }
 
-    msgPart->setData(d->parseBodyPart(msgPart->encoding()));
+    msgPart->setData(d->parseBodyPart(response, msgPart->encoding()));
+    if (useCache)
+        d->cache->insertBodyPart(uid, bodyPart, msgPart->data());
     return(true);
 }
 
+/**
+ * Fetch the BODYSTRUCTURE (when bodyStructure is true) and the given
+ * body parts ("1", "1.2", as ImapMessageBodyPart::bodyPart()) of many
+ * messages at once, by UID. A single UID FETCH is sent per
+ * IMAP_COMMAND_MAX_LENGTH of UID set, and each response is applied to
+ * its message as it arrives:
+ *
+ *   imap->fetchBodies(page, true, QStringList() << "1", 2048);
+ *
+ * With maxBytes > 0 only the first maxBytes of each part are fetched
+ * (BODY.PEEK[1]<0.2048>), enough for a preview; the parts cut short
+ * are marked ImapMessageBodyPart::isPartial() and aren't cached.
+ * The cache serves what it holds, when open.
+ * The BODYSTRUCTURE of messages without one is always fetched along,
+ * sections are matched to their parts by it.
+ * Parts the server didn't send, or that aren't leaves of the
+ * structure, are left untouched.
+ */
+bool Imap::fetchBodies (const QList<ImapMessage *>& messages,
+                        bool bodyStructure,
+                        const QStringList& sections,
+                        int maxBytes)
+{
+    bool useCache = (d->cache != NULL && d->cache->isOpen());
+    QHash<uint, ImapMessage *> byUid;
+    ImapSequenceSet withStructure;
+    ImapSequenceSet uids;
+
+    foreach (ImapMessage *message, messages) {
+        uint uid = message->uid().toUInt();
+        if (uid == 0)
+            continue;
+
+        if (useCache && message->bodyStructure() == NULL &&
+            d->cache->hasBodyStructure(uid))
+        {
+            d->setBodyStructure(message, d->cache->bodyStructure(uid));
+        }
+
+        bool missing = (bodyStructure && message->bodyStructure() == NULL);
+        foreach (const QString& section, sections) {
+            if (!useCache || !d->cache->hasBodyPart(uid, section)) {
+                missing = true;
+                continue;
+            }
+
+            for (int part = 0; part < message->bodyPartCount(); ++part) {
+                ImapMessageBodyPart *bodyPart = message->bodyPartAt(part);
+                if (bodyPart->bodyPart() == section)
+                    bodyPart->setData(d->cache->bodyPart(uid, section));
+            }
+        }
+
+        if (!missing)
+            continue;
+
+        byUid.insert(uid, message);
+        if (message->bodyStructure() == NULL && (bodyStructure || !sections.isEmpty()))
+            withStructure.add(uid);
+        else
+            uids.add(uid);
+    }
+
+    if (byUid.isEmpty())
+        return(true);
+
+    QString items = "UID";
+    foreach (const QString& section, sections) {
+        items += " BODY.PEEK[" + section + ']';
+        if (maxBytes > 0)
+            items += "<0." + QString::number(maxBytes) + '>';
+    }
+
+    QStringList commands;
+    if (!uids.isEmpty())
+        _imapUidFetchCommands(&commands, uids, items);
+    if (!withStructure.isEmpty())
+        _imapUidFetchCommands(&commands, withStructure, items + " BODYSTRUCTURE");
+
+    if (!d->sendCommands(commands))
+        return(false);
+
+    bool ok = true;
+    int pending = commands.size();
+    while (pending > 0) {
+        bool readOk;
+        QByteArray response = d->readResponse(&readOk);
+        if (!readOk)
+            return(false);
+
+        if (response.startsWith('*')) {
+            d->parseBodies(response, byUid, maxBytes);
+        } else if (response.startsWith(IMAP_TAG)) {
+            if (!_imapTaggedOk(response)) {
+                d->responseErrorMsg = response;
+                ok = false;
+            }
+            pending--;
+        }
+    }
+    return(ok);
+}
+
 // ===========================================================================
 //  PUBLIC Methods (IMAP Message Search Related)
 // ===========================================================================
@@ -971,43 +2836,130 @@ bool Imap::fetchBodyPart (ImapMessage *message, int part) {
  *  The IMAP protocol requires that at least one criterion be specified.
  */
 QList<int> Imap::search (const QString& criteria) {
-    QList<int> messageList;
+    return(searchSet(criteria).toList());
+}
 
-    if (criteria.isEmpty())
-        return(messageList);
+/**
+ * Search mailbox for matching messages, returning message numbers
+ * (or UIDs, if uid is true) as a sequence set.
+ */
+ImapSequenceSet Imap::searchSet (const QString& criteria, bool uid) {
+    ImapSearchResult result;
+    search(criteria, &result, ImapSearchResult::ReturnAll, uid);
+    return(result.all());
+}
 
-    if (!d->sendCommand("SEARCH %1", QStringList() << criteria))
-        return(messageList);    
+/**
+ * Search mailbox for matching messages.
+ * With ESEARCH only the requested items are returned by the server,
+ * e.g. ReturnCount doesn't transfer the matching message list.
+ * Otherwise a plain SEARCH fills every item of the result.
+ * Strings with non-ASCII characters are sent as UTF-8 literals,
+ * with CHARSET UTF-8.
+ */
+bool Imap::search (const QString& criteria,
+                   ImapSearchResult *result,
+                   ImapSearchResult::ReturnOptions options,
+                   bool uid)
+{
+    result->clear();
+    result->setUid(uid);
 
-    QByteArray response = d->readLine();
-    if (!response.startsWith("* SEARCH")) {
-        d->responseErrorMsg = response;
-        return(messageList);
+    if (criteria.isEmpty())
+        return(false);
+
+    bool utf8;
+    QString key = _imapSearchLiterals(criteria, hasCapability("LITERAL+"), &utf8);
+    if (utf8)
+        key = "CHARSET UTF-8 " + key;
+
+    QString command = uid ? "UID SEARCH" : "SEARCH";
+    if (hasCapability("ESEARCH")) {
+        QStringList items;
+        if (options & ImapSearchResult::ReturnMin) items.append("MIN");
+        if (options & ImapSearchResult::ReturnMax) items.append("MAX");
+        if (options & ImapSearchResult::ReturnCount) items.append("COUNT");
+        if (options & ImapSearchResult::ReturnAll) items.append("ALL");
+
+        command += QString(" RETURN (%1) %2").arg(items.join(" ")).arg(key);
+        if (!d->sendCommand(command))
+            return(false);
+        return(d->parseESearch(result));
     }
 
-    // Parse Search Results
-    int lastIndex = 8;
-    int index = 9;
-    while ((index = response.indexOf(' ', index)) >= 0) {        
-        QByteArray number = response.mid(lastIndex + 1, index - lastIndex - 1);
-        messageList.append(number.toInt());
+    ImapSequenceSet all;
+    if (!d->sendCommand(QString("%1 %2").arg(command).arg(key)))
+        return(false);
+    if (!d->parseSearch(&all))
+        return(false);
+
+    result->setFromSet(all);
+    return(true);
+}
 
-        lastIndex = index;
-        index++;
+/**
+ * Search mailbox for messages matching the query, in one SEARCH.
+ * Fails without a round trip if the query isn't valid.
+ *
+ * If the server rejects it (NO or BAD), UID searches fall back on the
+ * cache (when set and open): the local keys of the query are evaluated
+ * on the cached messages and intersected with a SEARCH of the other
+ * keys. The cache must be up to date (see synchronize()).
+ */
+bool Imap::search (const ImapSearchQuery& query,
+                   ImapSearchResult *result,
+                   ImapSearchResult::ReturnOptions options,
+                   bool uid)
+{
+    if (!query.isValid()) {
+        result->clear();
+        d->responseErrorMsg = "Invalid search query";
+        return(false);
     }
 
-    if ((index = response.indexOf('\r', lastIndex)) >= 0) {
-        int size = (index - lastIndex - 1);
-        if (size > 0) {
-            QByteArray number = response.mid(lastIndex + 1, size);  
-            messageList.append(number.toInt());
+    if (search(query.toString(), result, options, uid))
+        return(true);
+
+    // Connection errors and timeouts aren't the server's answer.
+    if (!d->isResponseRejected(d->responseErrorMsg.toLatin1()))
+        return(false);
+
+    if (!uid || d->cache == NULL || !d->cache->isOpen())
+        return(false);
+
+    QList<ImapSearchQuery> operands;
+    if (query.key() == ImapSearchQuery::And)
+        operands = query.operands();
+    else
+        operands.append(query);
+
+    ImapSearchQuery serverQuery;
+    ImapSearchQuery localQuery;
+    bool hasLocalKeys = false;
+    foreach (const ImapSearchQuery& operand, operands) {
+        if (operand.isLocal()) {
+            localQuery = localQuery && operand;
+            hasLocalKeys = true;
+        } else {
+            serverQuery = serverQuery && operand;
         }
     }
 
-    // Ok Response Line.
-    d->readLine();
+    // Nothing the cache can answer, the server was right to complain.
+    if (!hasLocalKeys)
+        return(false);
+
+    ImapSequenceSet uids = d->cache->search(localQuery);
+    if (serverQuery.key() != ImapSearchQuery::All) {
+        ImapSearchResult serverResult;
+        if (!search(serverQuery.toString(), &serverResult, ImapSearchResult::ReturnAll, true))
+            return(false);
+        uids = uids.intersected(serverResult.all());
+    }
 
-    return(messageList);
+    result->setFromSet(uids);
+    result->setUid(true);
+    return(true);
 }
 
 /** Search for Messages with specified TO criteria. */
@@ -1015,6 +2967,37 @@ QList<int> Imap::searchTo (const QString& criteria) {
     return(search(QString("TO %1").arg(criteria)));
 }
 
+/**
+ * Search the UIDs of the messages containing text.
+ * With a text index (set and open) the indexed messages are answered
+ * by the index, the server only searches the others: offline, only
+ * the index answers. Text of several words (or of words too short to
+ * be indexed) is matched word by word by the index, its candidates are
+ * then checked by the server, as they all are with setVerifyTextIndex().
+ * The index holds the envelope and the fetched text parts, a match
+ * elsewhere in an indexed message (other headers, attachments) is missed.
+ */
+ImapSequenceSet Imap::uidSearchText (const QString& text) {
+    ImapSequenceSet uids;
+    uidSearchIndexed(text, false, &uids, true);
+    return(uids);
+}
+
+/**
+ * Search within uids, split into commands below IMAP_COMMAND_MAX_LENGTH
+ * and pipelined. result gets the matching UIDs, or message numbers if
+ * uid is false. Empty criteria matches every message of uids.
+ */
+bool Imap::searchUids (const ImapSequenceSet& uids,
+                       const QString& criteria,
+                       ImapSequenceSet *result,
+                       bool uid)
+{
+    QStringList commands;
+    _imapSearchCommands(&commands, uids, criteria, uid, hasCapability("LITERAL+"));
+    return(d->runSearches(commands, result));
+}
+
 /** Search for Messages with specified CC criteria. */
 QList<int> Imap::searchCc (const QString& criteria) {
     return(search(QString("CC %1").arg(criteria)));
@@ -1030,14 +3013,30 @@ QList<int> Imap::searchFrom (const QString& criteria) {
     return(search(QString("FROM %1").arg(criteria)));
 }
 
-/** Search for Messages with specified TEXT criteria. */
+/**
+ * Search for Messages with specified TEXT criteria.
+ * Answered by the text index when set, as uidSearchText().
+ */
 QList<int> Imap::searchText (const QString& criteria) {
-    return(search(QString("TEXT %1").arg(criteria)));
+    if (d->textIndex == NULL || !d->textIndex->isOpen())
+        return(search(QString("TEXT %1").arg(criteria)));
+
+    ImapSequenceSet numbers;
+    uidSearchIndexed(_imapUnquote(criteria), false, &numbers, false);
+    return(numbers.toList());
 }
 
-/** Search for Messages with specified BODY criteria. */
+/**
+ * Search for Messages with specified BODY criteria.
+ * Answered by the text index when set, without the envelope words.
+ */
 QList<int> Imap::searchBody (const QString& criteria) {
-    return(search(QString("BODY %1").arg(criteria)));
+    if (d->textIndex == NULL || !d->textIndex->isOpen())
+        return(search(QString("BODY %1").arg(criteria)));
+
+    ImapSequenceSet numbers;
+    uidSearchIndexed(_imapUnquote(criteria), true, &numbers, false);
+    return(numbers.toList());
 }
 
 /** Search for Messages with specified SUBJECT criteria. */
@@ -1110,12 +3109,337 @@ QList<int> Imap::searchRecentUnseen (void) {
     return(search("RECENT UNSEEN"));
 }
 
+// ===========================================================================
+//  PUBLIC Methods (IMAP Message Sorting)
+// ===========================================================================
+/**
+ * UIDs of the messages of the selected mailbox matching query, ordered
+ * by criteria: a paged view fetches the envelopes of the visible ones.
+ *
+ * Uses SORT (RFC 5256) when available. Otherwise the sort keys are
+ * fetched as a listing and sorted locally (see ImapSorter). The
+ * listing is kept for the selected mailbox: later calls fetch and merge
+ * only the messages appended since, or start over if some were expunged.
+ */
+bool Imap::sort (const ImapSortCriteria& criteria,
+                 QList<uint> *uids,
+                 const ImapSearchQuery& query)
+{
+    uids->clear();
+    if (criteria.isEmpty())
+        return(false);
+
+    if (hasCapability("SORT")) {
+        bool utf8;
+        QString key = _imapSearchLiterals(query.toString(), hasCapability("LITERAL+"), &utf8);
+        QString command = "UID SORT %1 UTF-8 %2";
+        if (!d->sendCommand(command.arg(criteria.toString()).arg(key)))
+            return(false);
+        return(d->parseSort(uids));
+    }
+
+    if (!ImapSorter::isSupported(criteria)) {
+        d->responseErrorMsg = "Sorting by Cc or To needs SORT on the server";
+        return(false);
+    }
+
+    // Kept for the selected mailbox, only new messages are fetched.
+    ImapListing::Fields fields = ImapSorter::listingFields(criteria);
+    if (d->sortListing != NULL && (d->sortListing->fields() & fields) == fields &&
+        d->updateSortListing())
+    {
+        if (d->sortCriteria != criteria.toString()) {
+            delete d->sortSorter;
+            d->sortSorter = new ImapSorter(d->sortListing, criteria);
+            d->sortCriteria = criteria.toString();
+        }
+    } else {
+        if (d->sortListing != NULL)
+            fields |= d->sortListing->fields();
+        d->clearSort();
+
+        d->sortListing = new ImapListing(fields);
+        if (!fetchListing(d->sortListing)) {
+            d->clearSort();
+            return(false);
+        }
+        d->sortSorter = new ImapSorter(d->sortListing, criteria);
+        d->sortCriteria = criteria.toString();
+    }
+
+    d->sortSorter->update();
+    *uids = d->sortSorter->uids();
+
+    if (query.key() != ImapSearchQuery::All) {
+        ImapSearchResult result;
+        if (!search(query, &result, ImapSearchResult::ReturnAll, true))
+            return(false);
+
+        ImapSequenceSet matches = result.all();
+        QList<uint> sorted = *uids;
+        uids->clear();
+        foreach (uint uid, sorted) {
+            if (matches.contains(uid))
+                uids->append(uid);
+        }
+    }
+    return(true);
+}
+
+// ===========================================================================
+//  PUBLIC Methods (IMAP Message Threading)
+// ===========================================================================
+/**
+ * Thread the messages of the selected mailbox matching query, by UID.
+ *
+ * Uses THREAD (RFC 5256) when the server supports the algorithm.
+ * Otherwise the messages are threaded locally, from the envelopes of
+ * the cache (when set and open) and fetched for the ones it misses.
+ * For REFERENCES the References header is fetched with them, the
+ * envelope only has In-Reply-To (which is all the cache keeps).
+ * The caller owns the returned root, NULL on failure.
+ */
+ImapThread *Imap::thread (ImapThreader::Algorithm algorithm, const ImapSearchQuery& query) {
+    QString name = ImapThreader::algorithmName(algorithm);
+    if (hasCapability("THREAD=" + name)) {
+        bool utf8;
+        QString key = _imapSearchLiterals(query.toString(), hasCapability("LITERAL+"), &utf8);
+        QString command = "UID THREAD %1 UTF-8 %2";
+        if (!d->sendCommand(command.arg(name).arg(key)))
+            return(NULL);
+
+        ImapThread *root = new ImapThread;
+        QByteArray response;
+        bool ok;
+        while ((response = d->readResponse(&ok)).startsWith('*')) {
+            if (response.startsWith("* THREAD"))
+                root->appendThreadResponse(response);
+        }
+
+        if (!ok || !d->isResponseOk(response)) {
+            d->responseErrorMsg = response;
+            delete root;
+            return(NULL);
+        }
+        return(root);
+    }
+
+    ImapSearchResult result;
+    if (!search(query, &result, ImapSearchResult::ReturnAll, true))
+        return(NULL);
+    ImapSequenceSet uids = result.all();
+
+    ImapThreader threader(algorithm);
+    threader.reserve(uids.count());
+
+    ImapSequenceSet missing;
+    if (d->cache != NULL && d->cache->isOpen()) {
+        QString messageId, reference, subject;
+        QDateTime sent;
+
+        for (int i = 0; i < uids.rangeCount(); ++i) {
+            quint64 last = uids.rangeLast(i);
+            for (quint64 uid = uids.rangeFirst(i); uid <= last; ++uid) {
+                if (!d->cache->threadFields(uid, &messageId, &reference, &subject, &sent)) {
+                    missing.add(uid);
+                    continue;
+                }
+
+                QStringList references;
+                if (!reference.isEmpty())
+                    references.append(reference);
+                threader.addMessage(uid, messageId, references, subject, sent);
+            }
+        }
+    } else {
+        missing = uids;
+    }
+
+    if (!missing.isEmpty()) {
+        QString command = "UID FETCH %1 (UID ENVELOPE%2)";
+        QString headers;
+        if (algorithm == ImapThreader::References)
+            headers = " BODY.PEEK[HEADER.FIELDS (REFERENCES)]";
+        if (!d->sendCommand(command.arg(missing.toString()).arg(headers)))
+            return(NULL);
+
+        QByteArray response;
+        bool ok;
+        while ((response = d->readResponse(&ok)).startsWith('*')) {
+            // Unsolicited flag updates have no UID.
+            ImapMessage *message = _imapParseMessage(response);
+            if (message == NULL || message->uid().isEmpty()) {
+                delete message;
+                continue;
+            }
+
+            QStringList references = _imapReferences(response);
+            if (references.isEmpty() && !message->reference().isEmpty())
+                references.append(message->reference());
+            threader.addMessage(message->uid().toUInt(), message->messageId(),
+                                references, message->subject(), message->sent());
+            delete message;
+        }
+
+        if (!ok || !d->isResponseOk(response)) {
+            d->responseErrorMsg = response;
+            return(NULL);
+        }
+    }
+
+    return(threader.thread());
+}
+
 // ===========================================================================
 //  PUBLIC Properties
 // ===========================================================================
+ImapCache *Imap::cache (void) const {
+    return(d->cache);
+}
+
+/**
+ * Serve BODYSTRUCTUREs and body parts from the cache, when open,
+ * and store the ones fetched. The cache is not owned.
+ */
+void Imap::setCache (ImapCache *cache) {
+    d->cache = cache;
+}
+
+ImapTextIndex *Imap::textIndex (void) const {
+    return(d->textIndex);
+}
+
+/**
+ * Answer the TEXT and BODY searches from the index, when open.
+ * The index is not owned.
+ */
+void Imap::setTextIndex (ImapTextIndex *index) {
+    d->textIndex = index;
+}
+
+bool Imap::verifyTextIndex (void) const {
+    return(d->verifyTextIndex);
+}
+
+/**
+ * Have the server check the messages found by the text index too,
+ * rather than trusting it for the messages it holds. Off by default.
+ */
+void Imap::setVerifyTextIndex (bool verify) {
+    d->verifyTextIndex = verify;
+}
+
+ImapStats *Imap::stats (void) const {
+    return(d->stats);
+}
+
+/**
+ * Record the timings and sizes of each command, NULL to disable.
+ * The stats are not owned.
+ */
+void Imap::setStats (ImapStats *stats) {
+    d->stats = stats;
+}
+
+ImapCancelToken *Imap::cancelToken (void) const {
+    return(d->cancelToken);
+}
+
+/**
+ * Bound the following calls by the deadline of token, and let another
+ * thread cancel them. NULL to disable. The token is not owned.
+ * A cancelled or expired call aborts the connection.
+ */
+void Imap::setCancelToken (ImapCancelToken *token) {
+    d->cancelToken = token;
+}
+
+int Imap::timeout (void) const {
+    return(d->timeout);
+}
+
+/**
+ * Longest wait for the server (connect, write, read) without progress,
+ * in ms, -1 for no limit. Defaults to 30 seconds.
+ * A server stalled longer is disconnected.
+ */
+void Imap::setTimeout (int msecs) {
+    d->timeout = msecs;
+}
+
+/**
+ * Negotiate COMPRESS=DEFLATE after login, if the server supports it.
+ */
+bool Imap::compression (void) const {
+    return(d->compression);
+}
+
+void Imap::setCompression (bool enable) {
+    d->compression = enable;
+}
+
+bool Imap::isCompressed (void) const {
+    return(d->device != NULL && d->device != d->socket);
+}
+
 QString Imap::errorString (void) const {
     if (d->responseErrorMsg.isEmpty())
         return(d->socket->errorString());
     return(d->responseErrorMsg);
 }
 
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+/*
+ * TEXT (or BODY) search, as UIDs or message numbers. The indexed
+ * messages are answered by the text index when it is exact for text
+ * (a single indexable word, matched as a substring like the server
+ * does), the server searches the others. When it isn't exact, or with
+ * verifyTextIndex, the server checks the index candidates as well.
+ * Message numbers of the index matches come with the same batch,
+ * it takes one round trip. Criteria without an indexable word are
+ * searched on the whole mailbox.
+ */
+bool Imap::uidSearchIndexed (const QString& text,
+                             bool bodyOnly,
+                             ImapSequenceSet *result,
+                             bool uid)
+{
+    ImapSearchQuery query = bodyOnly ? ImapSearchQuery::body(text)
+                                     : ImapSearchQuery::text(text);
+    QStringList words = ImapTextIndex::tokenize(text);
+    if (d->textIndex == NULL || !d->textIndex->isOpen() || words.isEmpty()) {
+        ImapSearchResult found;
+        if (!search(query.toString(), &found, ImapSearchResult::ReturnAll, uid))
+            return(false);
+        *result = found.all();
+        return(true);
+    }
+
+    ImapSequenceSet matches = d->textIndex->search(text, bodyOnly);
+    ImapSequenceSet others(1, 0xffffffff);
+    others = others.subtracted(d->textIndex->indexed());
+
+    bool exact = (words.size() == 1 && words.first() == text.trimmed().toLower());
+    if (!exact || d->verifyTextIndex) {
+        others.add(matches);
+        matches.clear();
+    }
+
+    // Offline the index answers alone, for the messages it holds.
+    if (d->socket == NULL || d->socket->state() != QAbstractSocket::ConnectedState) {
+        if (!uid)
+            return(false);
+        *result = matches;
+        return(true);
+    }
+
+    QStringList commands;
+    _imapSearchCommands(&commands, others, query.toString(), uid, hasCapability("LITERAL+"));
+    if (uid)
+        result->add(matches);
+    else
+        _imapSearchCommands(&commands, matches, QString(), false, true);
+    return(d->runSearches(commands, result));
+}
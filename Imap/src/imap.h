@@ -1,12 +1,32 @@
 #ifndef _IMAP_H_
 #define _IMAP_H_
 
+#include "imapsearchresult.h"
+#include "imapsearchquery.h"
+#include "imapfolder.h"
+#include "imapthread.h"
+#include "imapsort.h"
+
+class QIODevice;
 class ImapMessage;
 class ImapMailbox;
+class ImapListing;
+class ImapTextIndex;
+class ImapCache;
+class ImapStats;
+class ImapCancelToken;
+class ImapSyncState;
+class ImapSyncDelta;
 class ImapPrivate;
 class Imap {
     public:
-        enum LoginType { LoginPlain, LoginAuthenticate, LoginCramMd5 };
+        enum LoginType {
+            LoginPlain,
+            LoginAuthenticate,
+            LoginCramMd5,
+            LoginAuthenticatePlain,
+            LoginAuto
+        };
 
     public:
         Imap();
@@ -34,8 +54,11 @@ class Imap {
                     LoginType type = LoginPlain);
         bool logout (void);
 
+        bool compress (void);
+
         // Methods (IMAP Commands)
         QString capability (void);
+        bool hasCapability (const QString& name);
 
         // Methods (Imap Mailbox Related)
         bool expunge (void);
@@ -45,6 +68,11 @@ class Imap {
 
         QStringList list (const QString& directory = "\"\"", 
                           const QString& pattern = "*");
+        ImapFolder *folderTree (const QString& reference = QString(),
+                                const QString& pattern = "*",
+                                ImapFolder::StatusItems items = ImapFolder::Messages |
+                                                                ImapFolder::Unseen |
+                                                                ImapFolder::UidNext);
 
         bool createMailbox (const QString& mailbox);
         bool createMailbox (const QString& folder, const QString& name);
@@ -56,6 +84,30 @@ class Imap {
 
         bool copyMailbox (const QString& mailbox, int begin, int end);
 
+        // Methods (Imap Message Transfer)
+        bool append (const QString& mailbox,
+                     QIODevice *message,
+                     ImapMessageFlags flags = 0,
+                     const QDateTime& received = QDateTime(),
+                     uint *uid = NULL);
+        bool append (const QString& mailbox,
+                     const QByteArray& message,
+                     ImapMessageFlags flags = 0,
+                     const QDateTime& received = QDateTime(),
+                     uint *uid = NULL);
+        bool multiAppend (const QString& mailbox,
+                          const QList<QIODevice *>& messages,
+                          const QList<ImapMessageFlags>& flags = QList<ImapMessageFlags>(),
+                          const QList<QDateTime>& received = QList<QDateTime>(),
+                          ImapSequenceSet *uids = NULL);
+
+        bool uidCopy (const ImapSequenceSet& uids,
+                      const QString& mailbox,
+                      ImapSequenceSet *newUids = NULL);
+        bool uidMove (const ImapSequenceSet& uids,
+                      const QString& mailbox,
+                      ImapSequenceSet *newUids = NULL);
+
         // Methods (Imap Message Related)
         int fetchUid (int messageNumber);
 
@@ -64,11 +116,19 @@ class Imap {
         ImapMailbox *fetch (ImapMailbox *mailbox);
         ImapMailbox *fetch (ImapMailbox *mailbox, int begin, int end);
         ImapMailbox *fetch (ImapMailbox *mailbox, const QList<int>& messages);
+        ImapMailbox *uidFetch (ImapMailbox *mailbox, const ImapSequenceSet& uids);
 
         ImapMessage *fetchHeaders (int message);
 
+        bool fetchListing (ImapListing *listing);
+        bool fetchListing (ImapListing *listing, int begin, int end);
+
         bool fetchBodyStructure (ImapMessage *message);
         bool fetchBodyPart (ImapMessage *message, int part);
+        bool fetchBodies (const QList<ImapMessage *>& messages,
+                          bool bodyStructure,
+                          const QStringList& sections = QStringList(),
+                          int maxBytes = 0);
 
         bool setSeen (int messageNumber, bool value);
         bool setDraft (int messageNumber, bool value);
@@ -76,14 +136,31 @@ class Imap {
         bool setFlagged (int messageNumber, bool value);
         bool setDeleted (int messageNumber, bool value);
         bool setAnswered (int messageNumber, bool value);
+        bool storeFlags (const ImapSequenceSet& uids,
+                         ImapMessageFlags added,
+                         ImapMessageFlags removed = 0);
 
         // Methods (Imap Message Search Related)
         QList<int> search (const QString& criteria);
+        ImapSequenceSet searchSet (const QString& criteria, bool uid = false);
+        bool search (const QString& criteria,
+                     ImapSearchResult *result,
+                     ImapSearchResult::ReturnOptions options = ImapSearchResult::ReturnAll,
+                     bool uid = false);
+        bool search (const ImapSearchQuery& query,
+                     ImapSearchResult *result,
+                     ImapSearchResult::ReturnOptions options = ImapSearchResult::ReturnAll,
+                     bool uid = false);
         QList<int> searchTo (const QString& criteria);
         QList<int> searchCc (const QString& criteria);
         QList<int> searchBcc (const QString& criteria);
         QList<int> searchFrom (const QString& criteria);
         QList<int> searchText (const QString& criteria);
+        ImapSequenceSet uidSearchText (const QString& text);
+        bool searchUids (const ImapSequenceSet& uids,
+                         const QString& criteria,
+                         ImapSequenceSet *result,
+                         bool uid = true);
         QList<int> searchBody (const QString& criteria);
         QList<int> searchSubject (const QString& criteria);
         QList<int> searchSince (const QDateTime& criteria);
@@ -101,10 +178,52 @@ class Imap {
         QList<int> searchUnanswered (void);
         QList<int> searchRecentUnseen (void);
 
+        // Methods (Imap Message Sorting)
+        bool sort (const ImapSortCriteria& criteria,
+                   QList<uint> *uids,
+                   const ImapSearchQuery& query = ImapSearchQuery::all());
+
+        // Methods (Imap Message Threading)
+        ImapThread *thread (ImapThreader::Algorithm algorithm = ImapThreader::References,
+                            const ImapSearchQuery& query = ImapSearchQuery::all());
+
+        // Methods (Imap Synchronization)
+        bool synchronize (ImapSyncState *state, ImapSyncDelta *delta);
+
         // Properties
+        ImapCache *cache (void) const;
+        void setCache (ImapCache *cache);
+
+        ImapTextIndex *textIndex (void) const;
+        void setTextIndex (ImapTextIndex *index);
+
+        bool verifyTextIndex (void) const;
+        void setVerifyTextIndex (bool verify);
+
+        ImapStats *stats (void) const;
+        void setStats (ImapStats *stats);
+
+        ImapCancelToken *cancelToken (void) const;
+        void setCancelToken (ImapCancelToken *token);
+
+        int timeout (void) const;
+        void setTimeout (int msecs);
+
+        bool compression (void) const;
+        void setCompression (bool enable);
+        bool isCompressed (void) const;
+
         QString errorString (void) const;
 
     private:
+        bool uidSearchIndexed (const QString& text,
+                               bool bodyOnly,
+                               ImapSequenceSet *result,
+                               bool uid);
+
+    private:
+        friend class ImapIdleWatcher;
+
         ImapPrivate *d;
 };
 
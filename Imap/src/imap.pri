@@ -0,0 +1,60 @@
+######################################################################
+# Imap library sources, shared by the application and the tests
+######################################################################
+
+DEPENDPATH += $$PWD
+INCLUDEPATH += $$PWD
+QT += network
+LIBS += -lz
+
+HEADERS += $$PWD/imap.h \
+           $$PWD/imap_p.h \
+           $$PWD/imapaddress.h \
+           $$PWD/imapbodystructure.h \
+           $$PWD/imapcache.h \
+           $$PWD/imapcanceltoken.h \
+           $$PWD/imapclient.h \
+           $$PWD/imapcodec.h \
+           $$PWD/imapcompressdevice.h \
+           $$PWD/imapfolder.h \
+           $$PWD/imapidlewatcher.h \
+           $$PWD/imaplisting.h \
+           $$PWD/imapmailbox.h \
+           $$PWD/imapmailboxmodel.h \
+           $$PWD/imapmessage.h \
+           $$PWD/imappagedmailbox.h \
+           $$PWD/imapparallelfetch.h \
+           $$PWD/imapparser.h \
+           $$PWD/imapsearchquery.h \
+           $$PWD/imapsearchresult.h \
+           $$PWD/imapsequenceset.h \
+           $$PWD/imapsort.h \
+           $$PWD/imapstats.h \
+           $$PWD/imapsync.h \
+           $$PWD/imaptextindex.h \
+           $$PWD/imapthread.h
+SOURCES += $$PWD/imap.cpp \
+           $$PWD/imapaddress.cpp \
+           $$PWD/imapbodystructure.cpp \
+           $$PWD/imapcache.cpp \
+           $$PWD/imapcanceltoken.cpp \
+           $$PWD/imapclient.cpp \
+           $$PWD/imapcodec.cpp \
+           $$PWD/imapcompressdevice.cpp \
+           $$PWD/imapfolder.cpp \
+           $$PWD/imapidlewatcher.cpp \
+           $$PWD/imaplisting.cpp \
+           $$PWD/imapmailbox.cpp \
+           $$PWD/imapmailboxmodel.cpp \
+           $$PWD/imapmessage.cpp \
+           $$PWD/imappagedmailbox.cpp \
+           $$PWD/imapparallelfetch.cpp \
+           $$PWD/imapparser.cpp \
+           $$PWD/imapsearchquery.cpp \
+           $$PWD/imapsearchresult.cpp \
+           $$PWD/imapsequenceset.cpp \
+           $$PWD/imapsort.cpp \
+           $$PWD/imapstats.cpp \
+           $$PWD/imapsync.cpp \
+           $$PWD/imaptextindex.cpp \
+           $$PWD/imapthread.cpp
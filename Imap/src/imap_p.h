@@ -0,0 +1,157 @@
+#ifndef _IMAP_PRIVATE_H_
+#define _IMAP_PRIVATE_H_
+
+#include <QStringList>
+#include <QHash>
+#include <QTcpSocket>
+#include <QDateTime>
+#include <QTime>
+
+#include "imapmessage.h"
+#include "imapstats.h"
+
+class ImapSearchResult;
+class ImapSequenceSet;
+class ImapTextIndex;
+class ImapCancelToken;
+class ImapCache;
+class ImapSyncDelta;
+class ImapMailbox;
+class ImapListing;
+class ImapFolder;
+class ImapSorter;
+
+class ImapPrivate {
+    public:
+        QStringList capabilities;
+        ImapTextIndex *textIndex;
+        bool verifyTextIndex;
+        ImapCache *cache;
+        QString responseErrorMsg;
+        QTcpSocket *socket;
+        QIODevice *device;
+        bool qresyncEnabled;
+        bool compression;
+        ImapStats *stats;
+        ImapCancelToken *cancelToken;
+        int timeout;
+
+        // "host:port" of the TLS connection, for session resumption.
+        QString sslSessionKey;
+
+        // Client side SORT of the selected mailbox, see Imap::sort().
+        QString selectedMailbox;
+        quint32 selectedUidValidity;
+        ImapListing *sortListing;
+        ImapSorter *sortSorter;
+        QString sortCriteria;
+
+    public:
+        ImapPrivate();
+        ~ImapPrivate();
+
+        bool connectToHost (const QString& host, quint16 port, bool useSsl);
+        void saveSslSession (void);
+
+        bool setFlag (int uid, ImapMessageFlags flag, bool append);
+        bool storeFlags (const ImapSequenceSet& uids,
+                         ImapMessageFlags added,
+                         ImapMessageFlags removed);
+        void updateFlags (const QByteArray& response);
+
+    public:
+        QByteArray readLine (bool *ok = NULL);
+        QByteArray readBytes (int size, bool *ok = NULL);
+        QByteArray readResponse (bool *ok = NULL);
+        bool readBufferedResponse (QByteArray *response, int *literalSize);
+
+        bool isMultiline   (const QString& data) const;
+        bool isResponseOk  (const QByteArray& response) const;
+        bool isResponseRejected (const QByteArray& response) const;
+        bool isResponseEnd (const QString& response) const;
+        bool isTaggedResponse (const QByteArray& response) const;
+        bool parseCapabilities (const QByteArray& response);
+
+        bool sendDataLine (const QString& data);
+        bool sendCommand  (const QString& command, 
+                           const QStringList& args = QStringList());
+        bool sendCommands (const QStringList& commands);
+        bool runBatch (const QStringList& commands,
+                       QList<QByteArray> *untagged,
+                       QList<QByteArray> *tagged = NULL);
+        bool runSearches (const QStringList& commands, ImapSequenceSet *result);
+        bool runUidCommands (const QStringList& commands, ImapSequenceSet *newUids);
+
+        bool waitContinuation (void);
+        bool sendLiteral (QIODevice *source, qint64 size);
+
+    public:
+        QByteArray hmacMd5 (const QString& username,
+                            const QString& password,
+                            const QString& serverResponse);
+
+        ImapMailbox *parseMailbox (const QString& mailboxName,
+                                   ImapSyncDelta *delta = NULL);
+        void parseUntagged (const QByteArray& response,
+                            ImapMailbox *mailbox,
+                            ImapSyncDelta *delta = NULL);
+        bool parseSearch (ImapSequenceSet *result);
+        bool parseSort (QList<uint> *result);
+        bool parseESearch (ImapSearchResult *result);
+        bool waitCompletion (ImapMailbox *mailbox = NULL,
+                             ImapSyncDelta *delta = NULL);
+        bool parseNewMessages (ImapMailbox *mailbox, uint firstUid);
+        ImapMailbox *parseMessages (ImapMailbox *mailbox);
+        bool parseListing (ImapListing *listing);
+        bool updateSortListing (void);
+        void clearSort (void);
+        bool fetchFolderStatus (ImapFolder *root, const QString& items);
+
+        QByteArray parseBodyPart (const QByteArray& response,
+                                  ImapMessageBodyPart::Encoding encoding);
+
+        QString rfcDate (const QDateTime& date) const;
+        QString internalDate (const QDateTime& date) const;
+        QString messageCommand (const ImapMessage *message,
+                                const QString& items) const;
+        bool setBodyStructure (ImapMessage *message, const QByteArray& data);
+        bool parseBodies (const QByteArray& response,
+                          const QHash<uint, ImapMessage *>& messages,
+                          int maxBytes);
+
+        bool appendMessages (const QString& mailbox,
+                             const QList<QIODevice *>& messages,
+                             const QList<ImapMessageFlags>& flags,
+                             const QList<QDateTime>& received,
+                             bool literalPlus,
+                             ImapSequenceSet *uids);
+
+    private:
+        enum WaitEvent {
+            WaitConnected,
+            WaitEncrypted,
+            WaitReadyRead,
+            WaitBytesWritten
+        };
+
+        QString buildId (void) const;
+
+        bool waitFor (WaitEvent event);
+        bool waitForReadyRead (void);
+        void abortOperation (const QString& reason);
+        void beginStats (const QString& command);
+        void lineStats (const QByteArray& line);
+        void finishStats (bool ok);
+
+    private:
+        QByteArray m_lastTag;
+        QString m_lastId;
+
+        // Command being measured, when stats are enabled.
+        ImapCommandStats m_commandStats;
+        bool m_commandPending;
+        QTime m_commandTimer;
+};
+
+#endif /* !_IMAP_PRIVATE_H_ */
+
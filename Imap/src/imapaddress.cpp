@@ -1,6 +1,8 @@
 #include <QString>
 
 #include "imapaddress.h"
+#include "imapparser.h"
+#include "imapcodec.h"
 
 // ===========================================================================
 //  PUBLIC Constructors/Destructor
@@ -76,3 +78,118 @@ void ImapAddress::setSmtpDomain (const QString& smtpDomain) {
     d->smtpDomain = smtpDomain;
 }
 
+// ===========================================================================
+//  DataStream Operators
+// ===========================================================================
+QDataStream& operator<< (QDataStream& stream, const ImapAddress& address) {
+    stream << address.address() << address.displayName() << address.smtpDomain();
+    return(stream);
+}
+
+QDataStream& operator>> (QDataStream& stream, ImapAddress& address) {
+    QString displayName, smtpDomain, email;
+
+    stream >> email >> displayName >> smtpDomain;
+    address.setAddress(email);
+    address.setDisplayName(displayName);
+    address.setSmtpDomain(smtpDomain);
+    return(stream);
+}
+
+
+// ===========================================================================
+//  ImapAddressTable
+// ===========================================================================
+ImapAddressTable::ImapAddressTable() {
+}
+
+ImapAddressTable::~ImapAddressTable() {
+}
+
+void ImapAddressTable::clear (void) {
+    m_envelopes.clear();
+    m_addresses.clear();
+    m_shared.clear();
+}
+
+/**
+ * Number of distinct addresses.
+ */
+int ImapAddressTable::count (void) const {
+    return(m_addresses.size());
+}
+
+/**
+ * Read an address list, "((name route mailbox host) ...)" or NIL,
+ * appending its addresses. Group markers (NIL host, RFC 3501) are
+ * skipped. Returns false if the list is malformed.
+ */
+bool ImapAddressTable::readList (ImapParser *parser, QList<ImapAddress> *addresses) {
+    if (!parser->skipChar('('))
+        return(parser->skipAtom("NIL"));
+
+    while (parser->skipChar('(')) {
+        int begin = parser->position();
+        for (int i = 0; i < 4; ++i) {
+            if (!parser->skipValue())
+                return(false);
+        }
+        if (!parser->skipChar(')'))
+            return(false);
+
+        // Seen before: no copy, no decoding.
+        const QByteArray& data = parser->data();
+        QByteArray key = QByteArray::fromRawData(data.constData() + begin,
+                                                 parser->position() - begin);
+        QHash<QByteArray, ImapAddress>::const_iterator it = m_envelopes.find(key);
+        if (it != m_envelopes.constEnd()) {
+            if (!it.value().isNull())
+                addresses->append(it.value());
+            continue;
+        }
+
+        int end = parser->position();
+        parser->setPosition(begin);
+        QByteArray name = parser->readString();
+        QByteArray route = parser->readString();
+        QByteArray mailbox = parser->readString();
+        QByteArray host = parser->readString();
+        parser->setPosition(end);
+
+        ImapAddress address;
+        if (!host.isEmpty()) {
+            QByteArray email = (mailbox.isEmpty() ? QByteArray("unknown") : mailbox);
+            email += '@';
+            email += host;
+
+            address.setAddress(QString::fromLatin1(email));
+            if (!name.isEmpty())
+                address.setDisplayName(ImapCodec::decodeHeader(name));
+            if (!route.isEmpty())
+                address.setSmtpDomain(ImapCodec::decodeHeader(route));
+            address = intern(address);
+            addresses->append(address);
+        }
+
+        m_envelopes.insert(QByteArray(key.constData(), key.size()), address);
+    }
+    return(parser->skipChar(')'));
+}
+
+/**
+ * Returns the shared copy of an equal address, adding it if new.
+ */
+ImapAddress ImapAddressTable::intern (const ImapAddress& address) {
+    if (address.isNull() || m_shared.contains(address.d.constData()))
+        return(address);
+
+    QString key = address.address() + QChar(0) + address.displayName() +
+                  QChar(0) + address.smtpDomain();
+    QHash<QString, ImapAddress>::const_iterator it = m_addresses.find(key);
+    if (it != m_addresses.constEnd())
+        return(it.value());
+
+    m_addresses.insert(key, address);
+    m_shared.insert(address.d.constData());
+    return(address);
+}
@@ -2,6 +2,13 @@
 #define _IMAP_ADDRESS_H_
 
 #include <QSharedDataPointer>
+#include <QDataStream>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+
+class ImapParser;
 
 class ImapAddressData : public QSharedData {
     public:
@@ -33,8 +40,40 @@ class ImapAddress {
         QString toString (void) const;
 
     private:
+        friend class ImapAddressTable;
+
         QSharedDataPointer<ImapAddressData> d;
 };
 
+QDataStream& operator<< (QDataStream& stream, const ImapAddress& address);
+QDataStream& operator>> (QDataStream& stream, ImapAddress& address);
+
+/**
+ * Shared storage for the addresses of many messages.
+ *
+ * readList() parses an ENVELOPE address list in place: each address
+ * is looked up by its raw bytes, so a sender seen before costs a hash
+ * lookup, and is decoded only the first time. intern() shares
+ * addresses built elsewhere.
+ */
+class ImapAddressTable {
+    public:
+        ImapAddressTable();
+        ~ImapAddressTable();
+
+        void clear (void);
+        int count (void) const;
+
+        bool readList (ImapParser *parser, QList<ImapAddress> *addresses);
+        ImapAddress intern (const ImapAddress& address);
+
+    private:
+        Q_DISABLE_COPY(ImapAddressTable)
+
+        QHash<QByteArray, ImapAddress> m_envelopes;
+        QHash<QString, ImapAddress> m_addresses;
+        QSet<const ImapAddressData *> m_shared;
+};
+
 #endif /* !_IMAP_ADDRESS_H_ */
 
@@ -0,0 +1,365 @@
+#include <QStringList>
+
+#include "imapbodystructure.h"
+#include "imapparser.h"
+#include "imapcodec.h"
+
+#define IMAP_BODY_STRUCTURE_MAX_DEPTH       (64)
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+/* Malformed values move the cursor to the end, to stop the parse. */
+static QString _bodyString (ImapParser *parser) {
+    if (parser->peek() == ')')
+        return(QString());
+
+    int position = parser->position();
+    QByteArray value = parser->readString();
+    if (parser->position() == position && !parser->skipValue())
+        parser->setPosition(parser->data().size());
+    return(QString::fromLatin1(value));
+}
+
+static quint32 _bodyNumber (ImapParser *parser) {
+    bool ok;
+    quint32 value = parser->readNumber(&ok);
+    if (!ok) parser->skipValue();
+    return(ok ? value : 0);
+}
+
+/* ("NAME" "value" ...) or NIL */
+static void _bodyParameters (ImapParser *parser, QMap<QString, QString> *parameters) {
+    if (!parser->skipChar('(')) {
+        parser->skipValue();
+        return;
+    }
+
+    while (!parser->atListEnd()) {
+        QString name = _bodyString(parser).toUpper();
+        if (parser->atListEnd())
+            break;
+        parameters->insert(name, _bodyString(parser));
+    }
+    parser->skipChar(')');
+}
+
+/* "EN" or ("EN" "DE") or NIL */
+static QString _bodyLanguage (ImapParser *parser) {
+    if (!parser->skipChar('('))
+        return(_bodyString(parser));
+
+    QStringList languages;
+    while (!parser->atListEnd())
+        languages.append(_bodyString(parser));
+    parser->skipChar(')');
+    return(languages.join(", "));
+}
+
+/* Peek whether the body at the cursor is a multipart one, "((" */
+static bool _bodyIsMultipart (ImapParser *parser) {
+    int position = parser->position();
+    bool multipart = parser->skipChar('(') && parser->peek() == '(';
+    parser->setPosition(position);
+    return(multipart);
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapBodyStructurePrivate {
+    public:
+        QList<ImapBodyStructure *> children;
+        ImapBodyStructure *parent;
+
+        QMap<QString, QString> dispositionParameters;
+        QMap<QString, QString> parameters;
+        QString contentDescription;
+        QString disposition;
+        QString contentId;
+        QString encoding;
+        QString language;
+        QString location;
+        QString section;
+        QString subtype;
+        QString type;
+        QString md5;
+        quint32 lines;
+        quint32 size;
+        bool multipart;
+};
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapBodyStructure::ImapBodyStructure()
+    : d(new ImapBodyStructurePrivate)
+{
+    d->parent = NULL;
+    d->multipart = false;
+    d->lines = d->size = 0;
+}
+
+ImapBodyStructure::~ImapBodyStructure() {
+    qDeleteAll(d->children);
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods
+// ===========================================================================
+/**
+ * Parse the BODYSTRUCTURE list starting at position.
+ * Returns NULL if the data is malformed.
+ */
+ImapBodyStructure *ImapBodyStructure::parse (const QByteArray& data, int position) {
+    ImapParser parser(data, position);
+
+    ImapBodyStructure *root = new ImapBodyStructure;
+    if (!root->parseNode(&parser, QString(), 0)) {
+        delete root;
+        return(NULL);
+    }
+    return(root);
+}
+
+// ===========================================================================
+//  PUBLIC Methods (Tree)
+// ===========================================================================
+ImapBodyStructure *ImapBodyStructure::parent (void) const {
+    return(d->parent);
+}
+
+int ImapBodyStructure::childCount (void) const {
+    return(d->children.size());
+}
+
+ImapBodyStructure *ImapBodyStructure::childAt (int index) const {
+    return(d->children[index]);
+}
+
+QList<ImapBodyStructure *> ImapBodyStructure::children (void) const {
+    return(d->children);
+}
+
+/**
+ * Non-multipart parts, in section order. Embedded messages are
+ * returned as a single part.
+ */
+QList<ImapBodyStructure *> ImapBodyStructure::leaves (void) const {
+    QList<ImapBodyStructure *> parts;
+    if (!d->multipart) {
+        parts.append(const_cast<ImapBodyStructure *>(this));
+        return(parts);
+    }
+
+    foreach (ImapBodyStructure *child, d->children)
+        parts += child->leaves();
+    return(parts);
+}
+
+ImapBodyStructure *ImapBodyStructure::findSection (const QString& section) const {
+    if (d->section == section)
+        return(const_cast<ImapBodyStructure *>(this));
+
+    foreach (ImapBodyStructure *child, d->children) {
+        ImapBodyStructure *node = child->findSection(section);
+        if (node != NULL)
+            return(node);
+    }
+    return(NULL);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapBodyStructure::isMultipart (void) const {
+    return(d->multipart);
+}
+
+bool ImapBodyStructure::isMessage (void) const {
+    return(!d->multipart && !d->children.isEmpty());
+}
+
+QString ImapBodyStructure::section (void) const {
+    return(d->section);
+}
+
+QString ImapBodyStructure::type (void) const {
+    return(d->type);
+}
+
+QString ImapBodyStructure::subtype (void) const {
+    return(d->subtype);
+}
+
+QString ImapBodyStructure::mimeType (void) const {
+    return(d->type + '/' + d->subtype);
+}
+
+QMap<QString, QString> ImapBodyStructure::parameters (void) const {
+    return(d->parameters);
+}
+
+QString ImapBodyStructure::parameter (const QString& name) const {
+    return(d->parameters.value(name.toUpper()));
+}
+
+QString ImapBodyStructure::charset (void) const {
+    return(d->parameters.value("CHARSET"));
+}
+
+QString ImapBodyStructure::contentId (void) const {
+    return(d->contentId);
+}
+
+QString ImapBodyStructure::contentDescription (void) const {
+    return(d->contentDescription);
+}
+
+QString ImapBodyStructure::encoding (void) const {
+    return(d->encoding);
+}
+
+quint32 ImapBodyStructure::size (void) const {
+    return(d->size);
+}
+
+quint32 ImapBodyStructure::lines (void) const {
+    return(d->lines);
+}
+
+QString ImapBodyStructure::md5 (void) const {
+    return(d->md5);
+}
+
+QString ImapBodyStructure::disposition (void) const {
+    return(d->disposition);
+}
+
+QMap<QString, QString> ImapBodyStructure::dispositionParameters (void) const {
+    return(d->dispositionParameters);
+}
+
+QString ImapBodyStructure::language (void) const {
+    return(d->language);
+}
+
+QString ImapBodyStructure::location (void) const {
+    return(d->location);
+}
+
+/**
+ * Disposition FILENAME, or the NAME parameter, decoded.
+ */
+QString ImapBodyStructure::fileName (void) const {
+    QString name = d->dispositionParameters.value("FILENAME");
+    if (name.isEmpty())
+        name = d->parameters.value("NAME");
+    return(name.isEmpty() ? name : ImapCodec::decodeHeader(name.toLatin1()));
+}
+
+bool ImapBodyStructure::isAttachment (void) const {
+    if (d->multipart)
+        return(false);
+    if (d->disposition.compare("ATTACHMENT", Qt::CaseInsensitive) == 0)
+        return(true);
+    return(!fileName().isEmpty());
+}
+
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+/**
+ * Read one body "(...)" at the cursor, and its parts.
+ * Unknown trailing extension data is skipped.
+ */
+bool ImapBodyStructure::parseNode (ImapParser *parser,
+                                   const QString& section,
+                                   int depth)
+{
+    if (depth > IMAP_BODY_STRUCTURE_MAX_DEPTH || !parser->skipChar('('))
+        return(false);
+
+    d->section = section;
+    if (parser->peek() == '(') {
+        // Multipart: parts, subtype [params [disposition [language [location]]]]
+        d->multipart = true;
+        d->type = "MULTIPART";
+
+        while (parser->peek() == '(') {
+            ImapBodyStructure *child = new ImapBodyStructure;
+            child->d->parent = this;
+            d->children.append(child);
+
+            QString number = QString::number(d->children.size());
+            if (!child->parseNode(parser, section.isEmpty() ? number : (section + '.' + number), depth + 1))
+                return(false);
+        }
+
+        d->subtype = _bodyString(parser);
+        if (!parser->atListEnd())
+            _bodyParameters(parser, &d->parameters);
+    } else {
+        // Single part: type subtype params id description encoding size
+        if (d->section.isEmpty())
+            d->section = "1";
+
+        d->type = _bodyString(parser);
+        d->subtype = _bodyString(parser);
+        _bodyParameters(parser, &d->parameters);
+        d->contentId = _bodyString(parser);
+        d->contentDescription = _bodyString(parser);
+        d->encoding = _bodyString(parser);
+        d->size = _bodyNumber(parser);
+
+        if (d->type.compare("MESSAGE", Qt::CaseInsensitive) == 0 &&
+            d->subtype.compare("RFC822", Qt::CaseInsensitive) == 0 &&
+            parser->peek() == '(')
+        {
+            // envelope body lines
+            if (!parser->skipValue())
+                return(false);
+
+            ImapBodyStructure *child = new ImapBodyStructure;
+            child->d->parent = this;
+            d->children.append(child);
+
+            QString childSection = _bodyIsMultipart(parser) ? d->section : (d->section + ".1");
+            if (!child->parseNode(parser, childSection, depth + 1))
+                return(false);
+
+            d->lines = _bodyNumber(parser);
+        } else if (d->type.compare("TEXT", Qt::CaseInsensitive) == 0) {
+            d->lines = _bodyNumber(parser);
+        }
+
+        if (!parser->atListEnd())
+            d->md5 = _bodyString(parser);
+    }
+
+    // Extension data: disposition language location
+    if (!parser->atListEnd()) {
+        if (parser->skipChar('(')) {
+            d->disposition = _bodyString(parser);
+            if (!parser->atListEnd())
+                _bodyParameters(parser, &d->dispositionParameters);
+            while (!parser->atListEnd() && parser->skipValue())
+                ;
+            parser->skipChar(')');
+        } else {
+            parser->skipValue();
+        }
+    }
+    if (!parser->atListEnd())
+        d->language = _bodyLanguage(parser);
+    if (!parser->atListEnd())
+        d->location = _bodyString(parser);
+
+    while (!parser->atListEnd()) {
+        if (!parser->skipValue())
+            return(false);
+    }
+    return(parser->skipChar(')'));
+}
+
@@ -0,0 +1,76 @@
+#ifndef _IMAP_BODY_STRUCTURE_H_
+#define _IMAP_BODY_STRUCTURE_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QMap>
+
+class ImapParser;
+class ImapBodyStructurePrivate;
+
+/**
+ * MIME tree of a message, as described by its BODYSTRUCTURE:
+ * multipart nodes hold their parts, MESSAGE/RFC822 parts hold the
+ * body of the embedded message. Each node knows its section number
+ * ("2.1"), as used by BODY[section].
+ *
+ * parse() walks the response once, without copying its sub-lists.
+ * Parameter names are upper case, values are kept as sent.
+ */
+class ImapBodyStructure {
+    public:
+        ImapBodyStructure();
+        ~ImapBodyStructure();
+
+        static ImapBodyStructure *parse (const QByteArray& data, int position = 0);
+
+        // Tree
+        ImapBodyStructure *parent (void) const;
+
+        int childCount (void) const;
+        ImapBodyStructure *childAt (int index) const;
+        QList<ImapBodyStructure *> children (void) const;
+
+        QList<ImapBodyStructure *> leaves (void) const;
+        ImapBodyStructure *findSection (const QString& section) const;
+
+        // Properties
+        bool isMultipart (void) const;
+        bool isMessage (void) const;
+        QString section (void) const;
+
+        QString type (void) const;
+        QString subtype (void) const;
+        QString mimeType (void) const;
+
+        QMap<QString, QString> parameters (void) const;
+        QString parameter (const QString& name) const;
+        QString charset (void) const;
+
+        QString contentId (void) const;
+        QString contentDescription (void) const;
+        QString encoding (void) const;
+        quint32 size (void) const;
+        quint32 lines (void) const;
+        QString md5 (void) const;
+
+        QString disposition (void) const;
+        QMap<QString, QString> dispositionParameters (void) const;
+        QString language (void) const;
+        QString location (void) const;
+
+        QString fileName (void) const;
+        bool isAttachment (void) const;
+
+    private:
+        bool parseNode (ImapParser *parser, const QString& section, int depth);
+
+    private:
+        Q_DISABLE_COPY(ImapBodyStructure)
+
+        ImapBodyStructurePrivate *d;
+};
+
+#endif /* !_IMAP_BODY_STRUCTURE_H_ */
+
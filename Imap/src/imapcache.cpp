@@ -0,0 +1,908 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QDir>
+
+#include <string.h>
+
+#include "imapsearchquery.h"
+#include "imapaddress.h"
+#include "imapmailbox.h"
+#include "imapcache.h"
+#include "imapsync.h"
+
+#define IMAP_CACHE_DATA_MAGIC           (0x31434d49)        // "IMC1"
+#define IMAP_CACHE_INDEX_MAGIC          (0x31494d49)        // "IMI1"
+#define IMAP_CACHE_RECORD_MAGIC         (0x52434d49)        // "IMCR"
+#define IMAP_CACHE_VERSION              (1)
+
+// ===========================================================================
+//  PRIVATE Types
+// ===========================================================================
+// Files are written in host byte order, the cache is not meant to be shared.
+enum ImapCacheRecordKind {
+    ImapCacheEnvelope = 1,
+    ImapCacheFlags,
+    ImapCacheBodyStructure,
+    ImapCacheBodyPart,
+    ImapCacheRemoved,
+    ImapCacheSyncState
+};
+
+struct ImapCacheFileHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 uidValidity;
+    quint32 reserved;
+};
+
+// Followed by the section name (body parts) and the payload.
+struct ImapCacheRecordHeader {
+    quint32 magic;
+    quint8 kind;
+    quint8 reserved;
+    quint16 sectionLength;
+    quint32 uid;
+    quint32 length;
+};
+
+// Body part section ("1", "2.1", ...) -> record offset
+typedef QHash<QString, qint64> ImapCacheSections;
+
+struct ImapCacheIndexEntry {
+    quint64 offset;
+    quint32 uid;
+    quint8 kind;
+    quint8 reserved[3];
+};
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+static bool _cacheWriteHeader (QFile *file, quint32 magic, quint32 uidValidity) {
+    ImapCacheFileHeader header;
+    memset(&header, 0, sizeof(ImapCacheFileHeader));
+    header.magic = magic;
+    header.version = IMAP_CACHE_VERSION;
+    header.uidValidity = uidValidity;
+
+    if (!file->resize(0) || !file->seek(0))
+        return(false);
+    return(file->write((const char *)&header, sizeof(ImapCacheFileHeader)) ==
+           sizeof(ImapCacheFileHeader));
+}
+
+static bool _cacheCheckHeader (QFile *file, quint32 magic, quint32 uidValidity) {
+    ImapCacheFileHeader header;
+
+    if (file->size() < (qint64)sizeof(ImapCacheFileHeader) || !file->seek(0))
+        return(false);
+
+    if (file->read((char *)&header, sizeof(ImapCacheFileHeader)) !=
+        sizeof(ImapCacheFileHeader))
+    {
+        return(false);
+    }
+
+    return(header.magic == magic && header.version == IMAP_CACHE_VERSION &&
+           header.uidValidity == uidValidity);
+}
+
+/* Append a record to the data file and its entry to the index. */
+static qint64 _cacheWriteRecord (QFile *data, QFile *index,
+                                 quint8 kind, uint uid,
+                                 const QByteArray& section,
+                                 const QByteArray& payload)
+{
+    ImapCacheRecordHeader header;
+    memset(&header, 0, sizeof(ImapCacheRecordHeader));
+    header.magic = IMAP_CACHE_RECORD_MAGIC;
+    header.kind = kind;
+    header.sectionLength = section.size();
+    header.uid = uid;
+    header.length = payload.size();
+
+    qint64 offset = data->size();
+    if (!data->seek(offset))
+        return(-1);
+
+    QByteArray record;
+    record.reserve(sizeof(ImapCacheRecordHeader) + section.size() + payload.size());
+    record.append((const char *)&header, sizeof(ImapCacheRecordHeader));
+    record.append(section);
+    record.append(payload);
+    if (data->write(record) != record.size() || !data->flush()) {
+        data->resize(offset);
+        return(-1);
+    }
+
+    ImapCacheIndexEntry entry;
+    memset(&entry, 0, sizeof(ImapCacheIndexEntry));
+    entry.offset = offset;
+    entry.uid = uid;
+    entry.kind = kind;
+
+    // A missing index entry is recovered from the data file on open.
+    if (index->seek(index->size()))
+        index->write((const char *)&entry, sizeof(ImapCacheIndexEntry));
+    index->flush();
+
+    return(offset);
+}
+
+/* Keyword bits are only valid in this process: the record holds the
+ * system flags, followed by the keyword names separated by spaces. */
+/* Erase the UIDs of set from hash: key by key when the set is the
+ * smaller, otherwise in one pass over the hash. */
+template <typename T>
+static void _cacheRemoveKeys (QHash<uint, T> *hash, const ImapSequenceSet& set) {
+    if (set.count() <= (quint64)hash->size()) {
+        for (int i = 0; i < set.rangeCount(); ++i) {
+            uint last = set.rangeLast(i);
+            for (uint uid = set.rangeFirst(i); ; ++uid) {
+                hash->remove(uid);
+                if (uid == last)
+                    break;
+            }
+        }
+        return;
+    }
+
+    typename QHash<uint, T>::iterator it = hash->begin();
+    while (it != hash->end()) {
+        if (set.contains(it.key())) it = hash->erase(it); else ++it;
+    }
+}
+
+static QByteArray _cacheEncodeFlags (ImapMessageFlags flags) {
+    quint32 value = flags & ImapMessageSystemFlags;
+    QByteArray data((const char *)&value, sizeof(quint32));
+
+    for (uint bit = ImapMessageFirstKeyword; bit != 0; bit <<= 1) {
+        if (!(flags & bit))
+            continue;
+
+        if (data.size() > (int)sizeof(quint32))
+            data += ' ';
+        data += ImapMessage::keywordName(bit);
+    }
+    return(data);
+}
+
+static ImapMessageFlags _cacheDecodeFlags (const QByteArray& data) {
+    if (data.size() < (int)sizeof(quint32))
+        return(0);
+
+    quint32 value;
+    memcpy(&value, data.constData(), sizeof(quint32));
+
+    ImapMessageFlags flags = value & ImapMessageSystemFlags;
+    foreach (const QByteArray& keyword, data.mid(sizeof(quint32)).split(' '))
+        flags |= ImapMessage::keywordFlag(keyword);
+    return(flags);
+}
+
+static QByteArray _cacheEncodeEnvelope (const ImapMessage *message) {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    stream << message->messageId() << message->reference() << message->subject();
+    stream << message->sent() << message->received() << message->timeZone();
+    stream << (qint32)message->size();
+    stream << message->fromAddress() << message->senderAddress();
+    stream << message->replyAddresses() << message->toAddresses();
+    stream << message->ccAddresses() << message->bccAddresses();
+    return(data);
+}
+
+static void _cacheDecodeEnvelope (const QByteArray& data, ImapMessage *message) {
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    QString messageId, reference, subject, timeZone;
+    QDateTime sent, received;
+    qint32 size;
+
+    stream >> messageId >> reference >> subject;
+    stream >> sent >> received >> timeZone;
+    stream >> size;
+    message->setMessageId(messageId);
+    message->setReference(reference);
+    message->setSubject(subject);
+    message->setSent(sent);
+    message->setReceived(received);
+    message->setTimeZone(timeZone);
+    message->setSize(size);
+
+    ImapAddress from, sender;
+    stream >> from >> sender;
+    message->setFromAddress(from);
+    message->setSenderAddress(sender);
+
+    QList<ImapAddress> reply, to, cc, bcc;
+    stream >> reply >> to >> cc >> bcc;
+    message->setReplyAddresses(reply);
+    message->setToAddresses(to);
+    message->setCcAddresses(cc);
+    message->setBccAddresses(bcc);
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapCachePrivate {
+    public:
+        QHash<uint, ImapCacheSections> parts;
+        QHash<uint, ImapMessageFlags> flags;
+        QHash<uint, qint64> structures;
+        QHash<uint, qint64> envelopes;
+        qint64 stateOffset;
+        ImapSequenceSet uids;
+
+        QString errorString;
+        QString mailbox;
+        QString server;
+        QString path;
+        quint32 uidValidity;
+
+        QFile indexFile;
+        QFile dataFile;
+        qint64 mapSize;
+        uchar *map;
+
+    public:
+        bool load (void);
+        void clearIndex (void);
+
+        const char *bytes (qint64 offset, qint64 length, QByteArray *buffer);
+        void remap (qint64 size);
+
+        bool record (qint64 offset, ImapCacheRecordHeader *header);
+        QByteArray payload (qint64 offset);
+        QString section (qint64 offset);
+
+        qint64 append (quint8 kind, uint uid,
+                       const QByteArray& payload,
+                       const QString& section = QString());
+        void applyRecord (qint64 offset, const ImapCacheRecordHeader& header);
+        void removeUids (const ImapSequenceSet& uids);
+
+        bool setError (const QString& message);
+};
+
+/**
+ * Load the index, then index the records written after it
+ * (a crash between the data and the index write).
+ * A truncated last record is dropped.
+ */
+bool ImapCachePrivate::load (void) {
+    qint64 dataEnd = sizeof(ImapCacheFileHeader);
+    ImapCacheRecordHeader header;
+    ImapCacheIndexEntry entry;
+
+    indexFile.seek(sizeof(ImapCacheFileHeader));
+    QByteArray entries = indexFile.readAll();
+
+    int count = entries.size() / sizeof(ImapCacheIndexEntry);
+    const char *p = entries.constData();
+    int valid = 0;
+    for (; valid < count; ++valid, p += sizeof(ImapCacheIndexEntry)) {
+        memcpy(&entry, p, sizeof(ImapCacheIndexEntry));
+        if (!record(entry.offset, &header) ||
+            header.kind != entry.kind || header.uid != entry.uid)
+        {
+            break;
+        }
+
+        applyRecord(entry.offset, header);
+        dataEnd = qMax(dataEnd, (qint64)entry.offset + (qint64)sizeof(ImapCacheRecordHeader) +
+                                header.sectionLength + header.length);
+    }
+
+    if (valid != count || entries.size() % sizeof(ImapCacheIndexEntry) != 0)
+        indexFile.resize(sizeof(ImapCacheFileHeader) + valid * sizeof(ImapCacheIndexEntry));
+
+    while (dataEnd < dataFile.size()) {
+        if (!record(dataEnd, &header)) {
+            // Unmap the dropped tail before truncating it.
+            if (mapSize > dataEnd)
+                remap(dataEnd);
+            dataFile.resize(dataEnd);
+            break;
+        }
+
+        memset(&entry, 0, sizeof(ImapCacheIndexEntry));
+        entry.offset = dataEnd;
+        entry.uid = header.uid;
+        entry.kind = header.kind;
+        indexFile.seek(indexFile.size());
+        indexFile.write((const char *)&entry, sizeof(ImapCacheIndexEntry));
+
+        applyRecord(dataEnd, header);
+        dataEnd += sizeof(ImapCacheRecordHeader) + header.sectionLength + header.length;
+    }
+
+    return(indexFile.flush());
+}
+
+void ImapCachePrivate::clearIndex (void) {
+    structures.clear();
+    envelopes.clear();
+    stateOffset = -1;
+    flags.clear();
+    parts.clear();
+    uids.clear();
+}
+
+/**
+ * Returns the bytes [offset, offset + length) of the data file, or NULL.
+ * They come from the mapping when it covers them, else from a read into
+ * buffer. The mapping is renewed only once the file has doubled, so the
+ * records appended since are read rather than remapped each time.
+ */
+const char *ImapCachePrivate::bytes (qint64 offset, qint64 length, QByteArray *buffer) {
+    if (offset + length > mapSize) {
+        qint64 fileSize = dataFile.size();
+        if (offset + length > fileSize)
+            return(NULL);
+        if (fileSize >= 2 * mapSize)
+            remap(fileSize);
+    }
+
+    if (offset + length <= mapSize)
+        return((const char *)map + offset);
+
+    if (!dataFile.seek(offset))
+        return(NULL);
+    *buffer = dataFile.read(length);
+    return(buffer->size() == length ? buffer->constData() : NULL);
+}
+
+void ImapCachePrivate::remap (qint64 size) {
+    if (map != NULL)
+        dataFile.unmap(map);
+
+    map = (size > 0) ? dataFile.map(0, size) : NULL;
+    mapSize = (map != NULL) ? size : 0;
+}
+
+/**
+ * Read and check the record header at offset.
+ */
+bool ImapCachePrivate::record (qint64 offset, ImapCacheRecordHeader *header) {
+    QByteArray buffer;
+    const char *data = bytes(offset, sizeof(ImapCacheRecordHeader), &buffer);
+    if (data == NULL)
+        return(false);
+
+    memcpy(header, data, sizeof(ImapCacheRecordHeader));
+    if (header->magic != IMAP_CACHE_RECORD_MAGIC)
+        return(false);
+
+    qint64 end = offset + sizeof(ImapCacheRecordHeader) +
+                 header->sectionLength + header->length;
+    return(end <= dataFile.size());
+}
+
+QByteArray ImapCachePrivate::payload (qint64 offset) {
+    ImapCacheRecordHeader header;
+    if (!record(offset, &header))
+        return(QByteArray());
+
+    QByteArray buffer;
+    offset += sizeof(ImapCacheRecordHeader) + header.sectionLength;
+    const char *data = bytes(offset, header.length, &buffer);
+    if (data == NULL)
+        return(QByteArray());
+    return(data == buffer.constData() ? buffer : QByteArray(data, header.length));
+}
+
+QString ImapCachePrivate::section (qint64 offset) {
+    ImapCacheRecordHeader header;
+    if (!record(offset, &header))
+        return(QString());
+
+    QByteArray buffer;
+    offset += sizeof(ImapCacheRecordHeader);
+    const char *data = bytes(offset, header.sectionLength, &buffer);
+    return(data == NULL ? QString() : QString::fromUtf8(data, header.sectionLength));
+}
+
+qint64 ImapCachePrivate::append (quint8 kind, uint uid,
+                                 const QByteArray& payload,
+                                 const QString& section)
+{
+    if (!dataFile.isOpen()) {
+        setError("Cache is not open");
+        return(-1);
+    }
+
+    QByteArray sectionData = section.toUtf8();
+    qint64 offset = _cacheWriteRecord(&dataFile, &indexFile, kind, uid,
+                                      sectionData, payload);
+    if (offset < 0) {
+        setError(dataFile.errorString());
+        return(-1);
+    }
+
+    // Just written, no need to read the header back.
+    ImapCacheRecordHeader header;
+    memset(&header, 0, sizeof(ImapCacheRecordHeader));
+    header.magic = IMAP_CACHE_RECORD_MAGIC;
+    header.kind = kind;
+    header.sectionLength = sectionData.size();
+    header.uid = uid;
+    header.length = payload.size();
+    applyRecord(offset, header);
+    return(offset);
+}
+
+void ImapCachePrivate::applyRecord (qint64 offset, const ImapCacheRecordHeader& header) {
+    switch (header.kind) {
+        case ImapCacheEnvelope:
+            envelopes.insert(header.uid, offset);
+            uids.add(header.uid);
+            break;
+        case ImapCacheFlags:
+            flags.insert(header.uid, _cacheDecodeFlags(payload(offset)));
+            break;
+        case ImapCacheBodyStructure:
+            structures.insert(header.uid, offset);
+            break;
+        case ImapCacheBodyPart:
+            parts[header.uid].insert(section(offset), offset);
+            break;
+        case ImapCacheRemoved:
+            removeUids(ImapSequenceSet::fromString(payload(offset)));
+            break;
+        case ImapCacheSyncState:
+            stateOffset = offset;
+            break;
+    }
+}
+
+void ImapCachePrivate::removeUids (const ImapSequenceSet& set) {
+    _cacheRemoveKeys(&parts, set);
+    _cacheRemoveKeys(&flags, set);
+    _cacheRemoveKeys(&structures, set);
+    _cacheRemoveKeys(&envelopes, set);
+    uids.remove(set);
+}
+
+bool ImapCachePrivate::setError (const QString& message) {
+    errorString = message;
+    return(false);
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+/**
+ * Create a cache stored in the 'path' directory.
+ */
+ImapCache::ImapCache (const QString& path)
+    : d(new ImapCachePrivate)
+{
+    d->path = path;
+    d->uidValidity = 0;
+    d->stateOffset = -1;
+    d->mapSize = 0;
+    d->map = NULL;
+}
+
+ImapCache::~ImapCache() {
+    close();
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Open the cache of the specified mailbox.
+ * If the stored UIDVALIDITY doesn't match, the content is discarded.
+ */
+bool ImapCache::open (const QString& server,
+                      const QString& mailbox,
+                      quint32 uidValidity)
+{
+    close();
+
+    QDir directory(d->path);
+    if (!directory.exists() && !directory.mkpath("."))
+        return(d->setError(QString("Unable to create %1").arg(d->path)));
+
+    QByteArray key = QString("%1\n%2").arg(server).arg(mailbox).toUtf8();
+    QString baseName = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    d->dataFile.setFileName(directory.filePath(baseName + ".data"));
+    d->indexFile.setFileName(directory.filePath(baseName + ".index"));
+
+    // A compact() interrupted before the new data was in place.
+    QString dataName = d->dataFile.fileName();
+    if (!QFile::exists(dataName) && QFile::exists(dataName + ".old")) {
+        QString indexName = d->indexFile.fileName();
+        QFile::rename(dataName + ".old", dataName);
+        QFile::remove(indexName);
+        QFile::rename(indexName + ".old", indexName);
+    }
+
+    if (!d->dataFile.open(QIODevice::ReadWrite))
+        return(d->setError(d->dataFile.errorString()));
+
+    if (!d->indexFile.open(QIODevice::ReadWrite)) {
+        d->setError(d->indexFile.errorString());
+        d->dataFile.close();
+        return(false);
+    }
+
+    d->uidValidity = uidValidity;
+    d->mailbox = mailbox;
+    d->server = server;
+
+    bool ok = true;
+    if (!_cacheCheckHeader(&(d->dataFile), IMAP_CACHE_DATA_MAGIC, uidValidity)) {
+        ok = _cacheWriteHeader(&(d->dataFile), IMAP_CACHE_DATA_MAGIC, uidValidity) &&
+             _cacheWriteHeader(&(d->indexFile), IMAP_CACHE_INDEX_MAGIC, uidValidity);
+    } else if (!_cacheCheckHeader(&(d->indexFile), IMAP_CACHE_INDEX_MAGIC, uidValidity)) {
+        ok = _cacheWriteHeader(&(d->indexFile), IMAP_CACHE_INDEX_MAGIC, uidValidity);
+    }
+
+    if (!ok || !d->dataFile.flush() || !d->load()) {
+        d->setError(d->dataFile.errorString());
+        close();
+        return(false);
+    }
+
+    return(true);
+}
+
+void ImapCache::close (void) {
+    if (d->map != NULL) {
+        d->dataFile.unmap(d->map);
+        d->map = NULL;
+    }
+    d->mapSize = 0;
+
+    d->indexFile.close();
+    d->dataFile.close();
+    d->clearIndex();
+}
+
+/**
+ * Rewrite the cache keeping only the live records.
+ */
+bool ImapCache::compact (void) {
+    if (!isOpen())
+        return(d->setError("Cache is not open"));
+
+    QFile data(d->dataFile.fileName() + ".tmp");
+    QFile index(d->indexFile.fileName() + ".tmp");
+    if (!data.open(QIODevice::ReadWrite | QIODevice::Truncate) ||
+        !index.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+        return(d->setError(data.errorString()));
+    }
+
+    bool ok = _cacheWriteHeader(&data, IMAP_CACHE_DATA_MAGIC, d->uidValidity) &&
+              _cacheWriteHeader(&index, IMAP_CACHE_INDEX_MAGIC, d->uidValidity);
+
+    QList<qint64> offsets = d->envelopes.values();
+    offsets += d->structures.values();
+    foreach (const ImapCacheSections& sections, d->parts)
+        offsets += sections.values();
+    if (d->stateOffset >= 0)
+        offsets.append(d->stateOffset);
+    qSort(offsets);
+
+    ImapCacheRecordHeader header;
+    foreach (qint64 offset, offsets) {
+        if (!ok) break;
+        if (!d->record(offset, &header))
+            continue;
+
+        QByteArray section = d->section(offset).toUtf8();
+        ok = _cacheWriteRecord(&data, &index, header.kind, header.uid,
+                               section, d->payload(offset)) >= 0;
+    }
+
+    QHash<uint, ImapMessageFlags>::const_iterator it;
+    for (it = d->flags.constBegin(); ok && it != d->flags.constEnd(); ++it) {
+        ok = _cacheWriteRecord(&data, &index, ImapCacheFlags, it.key(),
+                               QByteArray(), _cacheEncodeFlags(it.value())) >= 0;
+    }
+
+    data.close();
+    index.close();
+    if (!ok) {
+        data.remove();
+        index.remove();
+        return(d->setError("Unable to write the compacted cache"));
+    }
+
+    QString dataName = d->dataFile.fileName();
+    QString indexName = d->indexFile.fileName();
+    QString server = d->server;
+    QString mailbox = d->mailbox;
+    quint32 uidValidity = d->uidValidity;
+
+    close();
+
+    // The live files are kept as ".old" until the new data is in place.
+    // Without its index, the data gets a new one from open().
+    QString dataOld = dataName + ".old";
+    QString indexOld = indexName + ".old";
+    QFile::remove(dataOld);
+    QFile::remove(indexOld);
+    bool swapped = QFile::rename(dataName, dataOld);
+    if (swapped && !QFile::rename(indexName, indexOld)) {
+        QFile::rename(dataOld, dataName);
+        swapped = false;
+    }
+    if (swapped && !data.rename(dataName)) {
+        QFile::rename(dataOld, dataName);
+        QFile::rename(indexOld, indexName);
+        swapped = false;
+    }
+
+    if (!swapped) {
+        data.remove();
+        index.remove();
+        if (open(server, mailbox, uidValidity))
+            d->setError("Unable to replace the cache files");
+        return(false);
+    }
+
+    if (!index.rename(indexName))
+        index.remove();
+    QFile::remove(dataOld);
+    QFile::remove(indexOld);
+    return(open(server, mailbox, uidValidity));
+}
+
+bool ImapCache::contains (uint uid) const {
+    return(d->envelopes.contains(uid));
+}
+
+/**
+ * Returns a new message with the cached envelope and flags, or NULL.
+ * The message sequence number is not cached, id() is 0:
+ * Imap fetches such messages by UID.
+ */
+ImapMessage *ImapCache::message (uint uid) const {
+    qint64 offset = d->envelopes.value(uid, -1);
+    if (offset < 0)
+        return(NULL);
+
+    ImapMessage *message = new ImapMessage;
+    _cacheDecodeEnvelope(d->payload(offset), message);
+    message->setFlags(d->flags.value(uid, 0));
+    message->setUid(QString::number(uid));
+    message->setId(0);
+    return(message);
+}
+
+/**
+ * The envelope fields used to thread a message, read without
+ * decoding the addresses. Returns false if uid is not cached.
+ */
+bool ImapCache::threadFields (uint uid,
+                              QString *messageId,
+                              QString *reference,
+                              QString *subject,
+                              QDateTime *sent) const
+{
+    qint64 offset = d->envelopes.value(uid, -1);
+    if (offset < 0)
+        return(false);
+
+    QDataStream stream(d->payload(offset));
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream >> *messageId >> *reference >> *subject >> *sent;
+    return(stream.status() == QDataStream::Ok);
+}
+
+/**
+ * Store envelope and flags of a message with a known UID.
+ */
+bool ImapCache::insertMessage (const ImapMessage *message) {
+    uint uid = message->uid().toUInt();
+    if (uid == 0)
+        return(d->setError("Message without UID"));
+
+    if (d->append(ImapCacheEnvelope, uid, _cacheEncodeEnvelope(message)) < 0)
+        return(false);
+    return(setFlags(uid, message->flags()));
+}
+
+ImapMessageFlags ImapCache::flags (uint uid) const {
+    return(d->flags.value(uid, 0));
+}
+
+bool ImapCache::setFlags (uint uid, ImapMessageFlags flags) {
+    QHash<uint, ImapMessageFlags>::const_iterator it = d->flags.find(uid);
+    if (it != d->flags.constEnd() && it.value() == flags)
+        return(true);
+
+    return(d->append(ImapCacheFlags, uid, _cacheEncodeFlags(flags)) >= 0);
+}
+
+bool ImapCache::hasBodyStructure (uint uid) const {
+    return(d->structures.contains(uid));
+}
+
+/**
+ * Returns the raw BODYSTRUCTURE, as stored by Imap::fetchBodyStructure().
+ */
+QByteArray ImapCache::bodyStructure (uint uid) const {
+    qint64 offset = d->structures.value(uid, -1);
+    return(offset < 0 ? QByteArray() : d->payload(offset));
+}
+
+bool ImapCache::insertBodyStructure (uint uid, const QByteArray& bodyStructure) {
+    return(d->append(ImapCacheBodyStructure, uid, bodyStructure) >= 0);
+}
+
+/**
+ * Returns the sections of the cached body parts of a message.
+ */
+QStringList ImapCache::bodyPartSections (uint uid) const {
+    return(d->parts.value(uid).keys());
+}
+
+bool ImapCache::hasBodyPart (uint uid, const QString& section) const {
+    QHash<uint, ImapCacheSections>::const_iterator it = d->parts.find(uid);
+    return(it != d->parts.constEnd() && it.value().contains(section));
+}
+
+/**
+ * Returns the decoded data of the body part 'section' ("1", "2.1", ...).
+ */
+QByteArray ImapCache::bodyPart (uint uid, const QString& section) const {
+    QHash<uint, ImapCacheSections>::const_iterator it = d->parts.find(uid);
+    if (it == d->parts.constEnd())
+        return(QByteArray());
+
+    qint64 offset = it.value().value(section, -1);
+    return(offset < 0 ? QByteArray() : d->payload(offset));
+}
+
+bool ImapCache::insertBodyPart (uint uid,
+                                const QString& section,
+                                const QByteArray& data)
+{
+    return(d->append(ImapCacheBodyPart, uid, data, section) >= 0);
+}
+
+/**
+ * Returns the UIDs of the cached messages matching a local query
+ * (see ImapSearchQuery::isLocal()). A single message is filled for
+ * each UID, envelopes are decoded only if the query needs them.
+ */
+ImapSequenceSet ImapCache::search (const ImapSearchQuery& query) const {
+    bool envelope = query.needsEnvelope();
+    ImapMessage message;
+    QList<uint> uids;
+
+    QHash<uint, qint64>::const_iterator it;
+    for (it = d->envelopes.constBegin(); it != d->envelopes.constEnd(); ++it) {
+        if (envelope)
+            _cacheDecodeEnvelope(d->payload(it.value()), &message);
+        message.setFlags(d->flags.value(it.key(), 0));
+        message.setUid(QString::number(it.key()));
+
+        if (query.matches(&message))
+            uids.append(it.key());
+    }
+
+    // Added in order, each UID extends the last range.
+    qSort(uids);
+    ImapSequenceSet result;
+    foreach (uint uid, uids)
+        result.add(uid);
+    return(result);
+}
+
+/**
+ * Drop everything stored for the specified UIDs.
+ */
+bool ImapCache::remove (const ImapSequenceSet& uids) {
+    if (uids.isEmpty())
+        return(true);
+
+    QByteArray payload = uids.toString().toLatin1();
+    return(d->append(ImapCacheRemoved, 0, payload) >= 0);
+}
+
+/**
+ * Store the changes found by Imap::synchronize(). On a reset
+ * (UIDVALIDITY changed) the cache is reopened with the new
+ * UIDVALIDITY, which discards its content, before adding the
+ * new messages.
+ */
+bool ImapCache::apply (const ImapSyncDelta& delta) {
+    bool ok;
+    if (delta.isReset() && delta.uidValidity() != d->uidValidity) {
+        QString server = d->server;
+        QString mailbox = d->mailbox;
+        if (!open(server, mailbox, delta.uidValidity()))
+            return(false);
+        ok = true;
+    } else {
+        ok = remove(delta.removed());
+    }
+
+    foreach (ImapMessage *message, delta.added()->messages())
+        ok = insertMessage(message) && ok;
+
+    QHash<uint, ImapMessageFlags> changed = delta.changed();
+    QHash<uint, ImapMessageFlags>::const_iterator it;
+    for (it = changed.constBegin(); it != changed.constEnd(); ++it)
+        ok = setFlags(it.key(), it.value()) && ok;
+
+    return(ok);
+}
+
+/**
+ * Returns the last stored synchronization state,
+ * to be passed to Imap::synchronize() when the mailbox is reopened.
+ */
+ImapSyncState ImapCache::syncState (void) const {
+    ImapSyncState state(d->mailbox);
+    if (d->stateOffset < 0)
+        return(state);
+
+    QDataStream stream(d->payload(d->stateOffset));
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream >> state;
+    return(state);
+}
+
+bool ImapCache::setSyncState (const ImapSyncState& state) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << state;
+
+    return(d->append(ImapCacheSyncState, 0, payload) >= 0);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapCache::isOpen (void) const {
+    return(d->dataFile.isOpen());
+}
+
+QString ImapCache::path (void) const {
+    return(d->path);
+}
+
+QString ImapCache::server (void) const {
+    return(d->server);
+}
+
+QString ImapCache::mailbox (void) const {
+    return(d->mailbox);
+}
+
+quint32 ImapCache::uidValidity (void) const {
+    return(d->uidValidity);
+}
+
+/**
+ * UIDs of the messages with a cached envelope.
+ */
+ImapSequenceSet ImapCache::uids (void) const {
+    return(d->uids);
+}
+
+qint64 ImapCache::size (void) const {
+    return(d->dataFile.size());
+}
+
+QString ImapCache::errorString (void) const {
+    return(d->errorString);
+}
+
@@ -0,0 +1,89 @@
+#ifndef _IMAP_CACHE_H_
+#define _IMAP_CACHE_H_
+
+#include <QStringList>
+#include <QByteArray>
+#include <QString>
+
+#include "imapsequenceset.h"
+#include "imapmessage.h"
+
+class ImapSearchQuery;
+class ImapSyncState;
+class ImapSyncDelta;
+class ImapCachePrivate;
+
+/**
+ * Local store of envelopes, flags, BODYSTRUCTUREs and body parts of a
+ * mailbox, keyed by server, mailbox, UIDVALIDITY and UID.
+ *
+ * Each mailbox is kept in an append-only data file, read through a
+ * memory mapping (renewed each time the file doubles, the records
+ * appended since are read from the file), and a fixed-size index of
+ * its records. Updates are
+ * appended, the latest record wins; compact() drops the stale ones.
+ * Opening a mailbox with a different UIDVALIDITY discards its content.
+ */
+class ImapCache {
+    public:
+        ImapCache (const QString& path);
+        ~ImapCache();
+
+        // Methods
+        bool open (const QString& server,
+                   const QString& mailbox,
+                   quint32 uidValidity);
+        void close (void);
+        bool compact (void);
+
+        bool contains (uint uid) const;
+        ImapMessage *message (uint uid) const;
+        bool insertMessage (const ImapMessage *message);
+        bool threadFields (uint uid,
+                           QString *messageId,
+                           QString *reference,
+                           QString *subject,
+                           QDateTime *sent) const;
+
+        ImapMessageFlags flags (uint uid) const;
+        bool setFlags (uint uid, ImapMessageFlags flags);
+
+        bool hasBodyStructure (uint uid) const;
+        QByteArray bodyStructure (uint uid) const;
+        bool insertBodyStructure (uint uid, const QByteArray& bodyStructure);
+
+        QStringList bodyPartSections (uint uid) const;
+        bool hasBodyPart (uint uid, const QString& section) const;
+        QByteArray bodyPart (uint uid, const QString& section) const;
+        bool insertBodyPart (uint uid,
+                             const QString& section,
+                             const QByteArray& data);
+
+        ImapSequenceSet search (const ImapSearchQuery& query) const;
+
+        bool remove (const ImapSequenceSet& uids);
+        bool apply (const ImapSyncDelta& delta);
+
+        ImapSyncState syncState (void) const;
+        bool setSyncState (const ImapSyncState& state);
+
+        // Properties
+        bool isOpen (void) const;
+        QString path (void) const;
+        QString server (void) const;
+        QString mailbox (void) const;
+        quint32 uidValidity (void) const;
+
+        ImapSequenceSet uids (void) const;
+        qint64 size (void) const;
+
+        QString errorString (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapCache)
+
+        ImapCachePrivate *d;
+};
+
+#endif /* !_IMAP_CACHE_H_ */
+
@@ -0,0 +1,65 @@
+#include "imapcanceltoken.h"
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapCancelToken::ImapCancelToken()
+    : m_cancelled(0), m_deadline(-1)
+{
+}
+
+ImapCancelToken::~ImapCancelToken() {
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Clear the cancellation and the deadline, to reuse the token.
+ */
+void ImapCancelToken::reset (void) {
+    m_cancelled = 0;
+    m_deadline = -1;
+}
+
+/**
+ * Ask the operation to stop. Thread-safe.
+ */
+void ImapCancelToken::cancel (void) {
+    m_cancelled.fetchAndStoreOrdered(1);
+}
+
+bool ImapCancelToken::isCancelled (void) const {
+    return(const_cast<QAtomicInt&>(m_cancelled).fetchAndAddAcquire(0) != 0);
+}
+
+bool ImapCancelToken::hasDeadline (void) const {
+    return(m_deadline >= 0);
+}
+
+/**
+ * The operation must be over msecs from now.
+ */
+void ImapCancelToken::setDeadline (int msecs) {
+    m_timer.start();
+    m_deadline = qMax(0, msecs);
+}
+
+void ImapCancelToken::clearDeadline (void) {
+    m_deadline = -1;
+}
+
+/**
+ * Milliseconds left before the deadline, 0 once expired,
+ * -1 without a deadline.
+ */
+int ImapCancelToken::remainingTime (void) const {
+    if (m_deadline < 0)
+        return(-1);
+    return(qMax(0, m_deadline - m_timer.elapsed()));
+}
+
+bool ImapCancelToken::isExpired (void) const {
+    return(m_deadline >= 0 && m_timer.elapsed() >= m_deadline);
+}
+
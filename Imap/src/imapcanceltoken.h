@@ -0,0 +1,40 @@
+#ifndef _IMAP_CANCEL_TOKEN_H_
+#define _IMAP_CANCEL_TOKEN_H_
+
+#include <QAtomicInt>
+#include <QTime>
+
+/**
+ * Cancellation and deadline of an operation, spanning the commands
+ * it sends (see Imap::setCancelToken()).
+ *
+ * cancel() may be called from any thread, socket waits notice it
+ * within a fraction of a second. Set the deadline before the operation
+ * starts, from the thread that runs it (or before handing it over).
+ */
+class ImapCancelToken {
+    public:
+        ImapCancelToken();
+        ~ImapCancelToken();
+
+        void reset (void);
+
+        void cancel (void);
+        bool isCancelled (void) const;
+
+        bool hasDeadline (void) const;
+        void setDeadline (int msecs);
+        void clearDeadline (void);
+
+        int remainingTime (void) const;
+        bool isExpired (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapCancelToken)
+
+        QAtomicInt m_cancelled;
+        QTime m_timer;
+        int m_deadline;
+};
+
+#endif /* !_IMAP_CANCEL_TOKEN_H_ */
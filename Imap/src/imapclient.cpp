@@ -0,0 +1,428 @@
+#include <QWaitCondition>
+#include <QAtomicPointer>
+#include <QSemaphore>
+#include <QThread>
+#include <QMutex>
+
+#include <limits.h>
+
+#include "imapcanceltoken.h"
+#include "imapmailbox.h"
+#include "imapclient.h"
+
+// ===========================================================================
+//  PRIVATE Classes (Queue)
+// ===========================================================================
+/* A queued reply, NULL asks the I/O thread to stop. */
+class ImapClientNode {
+    public:
+        QAtomicPointer<ImapClientNode> next;
+        ImapReply *reply;
+};
+
+/* Qt 4 has no loadAcquire() */
+static inline ImapClientNode *_clientLoad (QAtomicPointer<ImapClientNode>& pointer) {
+    return(pointer.fetchAndAddAcquire(0));
+}
+
+/*
+ * Intrusive MPSC queue (D. Vyukov): producers swap the head, then link
+ * the previous node, so a push never waits for another thread. Only
+ * the consumer pops. pop() returns NULL while a push is half done.
+ */
+class ImapClientQueue {
+    public:
+        ImapClientQueue();
+
+        void push (ImapClientNode *node);
+        ImapClientNode *pop (void);
+
+    private:
+        QAtomicPointer<ImapClientNode> m_head;
+        ImapClientNode *m_tail;
+        ImapClientNode m_stub;
+};
+
+ImapClientQueue::ImapClientQueue()
+    : m_head(&m_stub), m_tail(&m_stub)
+{
+    m_stub.next = NULL;
+    m_stub.reply = NULL;
+}
+
+void ImapClientQueue::push (ImapClientNode *node) {
+    node->next = NULL;
+    ImapClientNode *previous = m_head.fetchAndStoreOrdered(node);
+    previous->next.fetchAndStoreRelease(node);
+}
+
+ImapClientNode *ImapClientQueue::pop (void) {
+    ImapClientNode *tail = m_tail;
+    ImapClientNode *next = _clientLoad(tail->next);
+
+    if (tail == &m_stub) {
+        if (next == NULL)
+            return(NULL);
+        m_tail = next;
+        tail = next;
+        next = _clientLoad(next->next);
+    }
+
+    if (next != NULL) {
+        m_tail = next;
+        return(tail);
+    }
+
+    // Last node: put the stub back behind it before taking it.
+    if (tail != _clientLoad(m_head))
+        return(NULL);
+
+    push(&m_stub);
+    next = _clientLoad(tail->next);
+    if (next != NULL) {
+        m_tail = next;
+        return(tail);
+    }
+    return(NULL);
+}
+
+// ===========================================================================
+//  PRIVATE Classes (Replies)
+// ===========================================================================
+class ImapReplyPrivate {
+    public:
+        ImapCancelToken token;
+        mutable QMutex mutex;
+        QWaitCondition done;
+        QString errorString;
+        bool finished;
+        bool notified;
+        bool ok;
+};
+
+class ImapConnectReply : public ImapReply {
+    public:
+        ImapConnectReply (const QString& host, quint16 port, bool useSsl)
+            : m_host(host), m_port(port), m_useSsl(useSsl)
+        {
+        }
+
+    protected:
+        bool execute (Imap *imap) {
+            if (imap->connectToHost(m_host, m_port, m_useSsl))
+                return(true);
+            setErrorString(QString("Unable to connect to %1").arg(m_host));
+            return(false);
+        }
+
+    private:
+        QString m_host;
+        quint16 m_port;
+        bool m_useSsl;
+};
+
+class ImapLoginReply : public ImapReply {
+    public:
+        ImapLoginReply (const QString& username,
+                        const QString& password,
+                        Imap::LoginType type)
+            : m_username(username), m_password(password), m_type(type)
+        {
+        }
+
+    protected:
+        bool execute (Imap *imap) {
+            bool ok = imap->login(m_username, m_password, m_type);
+            m_password.clear();
+            return(ok);
+        }
+
+    private:
+        QString m_username;
+        QString m_password;
+        Imap::LoginType m_type;
+};
+
+class ImapLogoutReply : public ImapReply {
+    protected:
+        bool execute (Imap *imap) {
+            bool ok = imap->logout();
+            imap->disconnectFromHost();
+            return(ok);
+        }
+};
+
+// ===========================================================================
+//  PRIVATE Class (Client)
+// ===========================================================================
+class ImapClientPrivate : public QThread {
+    public:
+        ImapClientQueue queue;
+        QSemaphore available;
+
+    public:
+        void enqueue (ImapReply *reply);
+
+    protected:
+        void run (void);
+};
+
+void ImapClientPrivate::enqueue (ImapReply *reply) {
+    ImapClientNode *node = new ImapClientNode;
+    node->reply = reply;
+    queue.push(node);
+    available.release();
+}
+
+/* The I/O thread: owns the connection, runs the replies in order. */
+void ImapClientPrivate::run (void) {
+    Imap imap;
+
+    while (true) {
+        available.acquire();
+
+        ImapClientNode *node;
+        while ((node = queue.pop()) == NULL)
+            QThread::yieldCurrentThread();
+
+        ImapReply *reply = node->reply;
+        delete node;
+
+        if (reply == NULL)
+            break;
+        reply->run(&imap);
+    }
+
+    imap.disconnectFromHost();
+}
+
+// ===========================================================================
+//  ImapReply
+// ===========================================================================
+ImapReply::ImapReply (QObject *parent)
+    : QObject(parent), d(new ImapReplyPrivate)
+{
+    d->finished = d->notified = false;
+    d->ok = false;
+}
+
+ImapReply::~ImapReply() {
+    delete d;
+}
+
+bool ImapReply::isFinished (void) const {
+    QMutexLocker locker(&(d->mutex));
+    return(d->finished);
+}
+
+bool ImapReply::isOk (void) const {
+    QMutexLocker locker(&(d->mutex));
+    return(d->ok);
+}
+
+QString ImapReply::errorString (void) const {
+    QMutexLocker locker(&(d->mutex));
+    return(d->errorString);
+}
+
+/**
+ * Block until the command has run, at most msecs (-1 for no limit).
+ * Returns false on timeout. Never call it from the I/O thread.
+ */
+bool ImapReply::waitForFinished (int msecs) {
+    QMutexLocker locker(&(d->mutex));
+    if (!d->notified)
+        d->done.wait(&(d->mutex), msecs < 0 ? ULONG_MAX : (unsigned long)msecs);
+    return(d->notified);
+}
+
+/**
+ * Stop the command. Thread-safe.
+ */
+void ImapReply::cancel (void) {
+    d->token.cancel();
+}
+
+/**
+ * The command must be done msecs from now, queueing included,
+ * or the connection is aborted. Call it before submitting the reply.
+ */
+void ImapReply::setDeadline (int msecs) {
+    d->token.setDeadline(msecs);
+}
+
+void ImapReply::setErrorString (const QString& error) {
+    QMutexLocker locker(&(d->mutex));
+    d->errorString = error;
+}
+
+void ImapReply::run (Imap *imap) {
+    if (d->token.isCancelled() || d->token.isExpired()) {
+        setErrorString(d->token.isCancelled() ? "Operation cancelled"
+                                              : "Operation deadline expired");
+        finish(false);
+        return;
+    }
+
+    imap->setCancelToken(&(d->token));
+    bool ok = execute(imap);
+    imap->setCancelToken(NULL);
+    if (!ok && errorString().isEmpty())
+        setErrorString(imap->errorString());
+    finish(ok);
+}
+
+/* All done in one locked section, this is the last use of the reply:
+ * a waiter may delete it as soon as it wakes up. finished() is posted
+ * to the thread of the reply, rather than emitted from the I/O thread,
+ * so it can't run while the reply is being deleted there.
+ */
+void ImapReply::finish (bool ok) {
+    QMutexLocker locker(&(d->mutex));
+    d->finished = true;
+    d->ok = ok;
+    QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+    d->notified = true;
+    d->done.wakeAll();
+}
+
+// ===========================================================================
+//  ImapMailboxReply
+// ===========================================================================
+ImapMailboxReply::ImapMailboxReply (Command command,
+                                    const QString& mailbox,
+                                    const ImapSequenceSet& uids,
+                                    QObject *parent)
+    : ImapReply(parent), m_uids(uids), m_mailbox(NULL),
+      m_name(mailbox), m_command(command)
+{
+}
+
+ImapMailboxReply::~ImapMailboxReply() {
+    delete m_mailbox;
+}
+
+ImapMailbox *ImapMailboxReply::mailbox (void) const {
+    return(m_mailbox);
+}
+
+/**
+ * The mailbox, owned by the caller from now on.
+ */
+ImapMailbox *ImapMailboxReply::takeMailbox (void) {
+    ImapMailbox *mailbox = m_mailbox;
+    m_mailbox = NULL;
+    return(mailbox);
+}
+
+bool ImapMailboxReply::execute (Imap *imap) {
+    switch (m_command) {
+        case Select:
+            m_mailbox = imap->select(m_name);
+            break;
+        case Examine:
+            m_mailbox = imap->examine(m_name);
+            break;
+        case UidFetch:
+            m_mailbox = new ImapMailbox(m_name);
+            if (imap->uidFetch(m_mailbox, m_uids) == NULL) {
+                delete m_mailbox;
+                m_mailbox = NULL;
+            }
+            break;
+    }
+    return(m_mailbox != NULL);
+}
+
+// ===========================================================================
+//  ImapSearchReply
+// ===========================================================================
+ImapSearchReply::ImapSearchReply (const QString& criteria, bool uid, QObject *parent)
+    : ImapReply(parent), m_criteria(criteria), m_uid(uid)
+{
+}
+
+ImapSequenceSet ImapSearchReply::result (void) const {
+    return(m_result);
+}
+
+bool ImapSearchReply::execute (Imap *imap) {
+    ImapSearchResult result;
+    bool ok = imap->search(m_criteria, &result, ImapSearchResult::ReturnAll, m_uid);
+    m_result = result.all();
+    return(ok);
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapClient::ImapClient (QObject *parent)
+    : QObject(parent), d(new ImapClientPrivate)
+{
+    d->start();
+}
+
+ImapClient::~ImapClient() {
+    d->enqueue(NULL);
+    d->wait();
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Queue a reply, to run in the I/O thread after the ones already
+ * submitted. Thread-safe, never blocks. Returns reply.
+ */
+ImapReply *ImapClient::submit (ImapReply *reply) {
+    d->enqueue(reply);
+    return(reply);
+}
+
+ImapReply *ImapClient::connectToHost (const QString& host, quint16 port, bool useSsl) {
+    return(submit(new ImapConnectReply(host, port, useSsl)));
+}
+
+ImapReply *ImapClient::login (const QString& username,
+                              const QString& password,
+                              Imap::LoginType type)
+{
+    return(submit(new ImapLoginReply(username, password, type)));
+}
+
+/**
+ * Logout and disconnect.
+ */
+ImapReply *ImapClient::logout (void) {
+    return(submit(new ImapLogoutReply));
+}
+
+ImapMailboxReply *ImapClient::select (const QString& mailbox) {
+    ImapMailboxReply *reply = new ImapMailboxReply(ImapMailboxReply::Select, mailbox);
+    submit(reply);
+    return(reply);
+}
+
+ImapMailboxReply *ImapClient::examine (const QString& mailbox) {
+    ImapMailboxReply *reply = new ImapMailboxReply(ImapMailboxReply::Examine, mailbox);
+    submit(reply);
+    return(reply);
+}
+
+/**
+ * Fetch the envelopes of uids from the selected mailbox,
+ * named mailbox in the reply.
+ */
+ImapMailboxReply *ImapClient::uidFetch (const QString& mailbox, const ImapSequenceSet& uids) {
+    ImapMailboxReply *reply = new ImapMailboxReply(ImapMailboxReply::UidFetch, mailbox, uids);
+    submit(reply);
+    return(reply);
+}
+
+ImapSearchReply *ImapClient::searchSet (const QString& criteria, bool uid) {
+    ImapSearchReply *reply = new ImapSearchReply(criteria, uid);
+    submit(reply);
+    return(reply);
+}
+
@@ -0,0 +1,157 @@
+#ifndef _IMAP_CLIENT_H_
+#define _IMAP_CLIENT_H_
+
+#include <QObject>
+
+#include "imapsequenceset.h"
+#include "imap.h"
+
+class ImapMailbox;
+class ImapReplyPrivate;
+class ImapClientPrivate;
+
+/**
+ * Pending result of a command submitted to an ImapClient.
+ *
+ * finished() is delivered through the event loop of the thread the
+ * reply lives in, or block on waitForFinished() from a thread other
+ * than the I/O one. The caller owns the reply: delete it (deleteLater()
+ * from a slot) once finished() was delivered or waitForFinished()
+ * returned true; a reply deleted first never emits finished().
+ *
+ * cancel() stops the command from any thread: before it runs, it is
+ * skipped, while it runs, the connection is aborted.
+ *
+ * Subclass and reimplement execute() to run any Imap code
+ * in the I/O thread.
+ */
+class ImapReply : public QObject {
+    Q_OBJECT
+
+    public:
+        ImapReply (QObject *parent = 0);
+        virtual ~ImapReply();
+
+        bool isFinished (void) const;
+        bool isOk (void) const;
+        QString errorString (void) const;
+
+        bool waitForFinished (int msecs = -1);
+
+        void cancel (void);
+        void setDeadline (int msecs);
+
+    Q_SIGNALS:
+        void finished (void);
+
+    protected:
+        /**
+         * Run in the I/O thread, on the connection of the client.
+         * Returns false and sets errorString on failure.
+         */
+        virtual bool execute (Imap *imap) = 0;
+
+        void setErrorString (const QString& error);
+
+    private:
+        friend class ImapClientPrivate;
+
+        void run (Imap *imap);
+        void finish (bool ok);
+
+    private:
+        Q_DISABLE_COPY(ImapReply)
+
+        ImapReplyPrivate *d;
+};
+
+/**
+ * Reply of select(), examine() and uidFetch().
+ */
+class ImapMailboxReply : public ImapReply {
+    Q_OBJECT
+
+    public:
+        enum Command { Select, Examine, UidFetch };
+
+    public:
+        ImapMailboxReply (Command command,
+                          const QString& mailbox,
+                          const ImapSequenceSet& uids = ImapSequenceSet(),
+                          QObject *parent = 0);
+        ~ImapMailboxReply();
+
+        ImapMailbox *mailbox (void) const;
+        ImapMailbox *takeMailbox (void);
+
+    protected:
+        bool execute (Imap *imap);
+
+    private:
+        ImapSequenceSet m_uids;
+        ImapMailbox *m_mailbox;
+        QString m_name;
+        Command m_command;
+};
+
+/**
+ * Reply of searchSet().
+ */
+class ImapSearchReply : public ImapReply {
+    Q_OBJECT
+
+    public:
+        ImapSearchReply (const QString& criteria, bool uid, QObject *parent = 0);
+
+        ImapSequenceSet result (void) const;
+
+    protected:
+        bool execute (Imap *imap);
+
+    private:
+        ImapSequenceSet m_result;
+        QString m_criteria;
+        bool m_uid;
+};
+
+/**
+ * Thread-safe front end of an Imap connection.
+ *
+ * A dedicated I/O thread owns the connection and runs the submitted
+ * commands in order. Any thread may submit: commands go through a
+ * lock-free multiple producer, single consumer queue, and results come
+ * back as ImapReply objects, so callers never block on the socket.
+ *
+ * The destructor waits for the submitted commands, then disconnects.
+ */
+class ImapClient : public QObject {
+    Q_OBJECT
+
+    public:
+        ImapClient (QObject *parent = 0);
+        ~ImapClient();
+
+        // Methods
+        ImapReply *submit (ImapReply *reply);
+
+        ImapReply *connectToHost (const QString& host,
+                                  quint16 port = 143,
+                                  bool useSsl = false);
+        ImapReply *login (const QString& username,
+                          const QString& password,
+                          Imap::LoginType type = Imap::LoginPlain);
+        ImapReply *logout (void);
+
+        ImapMailboxReply *select (const QString& mailbox);
+        ImapMailboxReply *examine (const QString& mailbox);
+        ImapMailboxReply *uidFetch (const QString& mailbox, const ImapSequenceSet& uids);
+
+        ImapSearchReply *searchSet (const QString& criteria, bool uid = false);
+
+    private:
+        Q_DISABLE_COPY(ImapClient)
+
+        ImapClientPrivate *d;
+};
+
+#endif /* !_IMAP_CLIENT_H_ */
@@ -0,0 +1,494 @@
+#include <QTextCodec>
+
+#include <string.h>
+
+#include "imapcodec.h"
+
+/*
+ * Built with SSSE3 enabled the vector path is always taken. Otherwise
+ * on x86 compilers able to target it per function (GCC 4.9, clang) it
+ * is built anyway, and taken when the CPU has SSSE3 (cpuid).
+ */
+#if defined(__SSSE3__)
+    #include <tmmintrin.h>
+    #define IMAP_CODEC_SSSE3
+    #define IMAP_CODEC_SSSE3_TARGET
+#elif (defined(__i386__) || defined(__x86_64__)) && \
+      (defined(__clang__) || (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+    #include <tmmintrin.h>
+    #include <cpuid.h>
+    #define IMAP_CODEC_SSSE3
+    #define IMAP_CODEC_SSSE3_RUNTIME
+    #define IMAP_CODEC_SSSE3_TARGET     __attribute__((target("ssse3")))
+#endif
+
+// ===========================================================================
+//  PRIVATE Tables
+// ===========================================================================
+#define B64_SKIP        (0x40)      // Whitespace, silently skipped
+#define B64_PAD         (0x41)      // '=', end of data
+#define B64_BAD         (0x80)      // Invalid char, skipped like Qt does
+
+static const quint8 _base64DecodeTable[256] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x40, 0x40, 0x80, 0x80, 0x40, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x40, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80,   62, 0x80, 0x80, 0x80,   63,
+      52,   53,   54,   55,   56,   57,   58,   59,
+      60,   61, 0x80, 0x80, 0x80, 0x41, 0x80, 0x80,
+    0x80,    0,    1,    2,    3,    4,    5,    6,
+       7,    8,    9,   10,   11,   12,   13,   14,
+      15,   16,   17,   18,   19,   20,   21,   22,
+      23,   24,   25, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80,   26,   27,   28,   29,   30,   31,   32,
+      33,   34,   35,   36,   37,   38,   39,   40,
+      41,   42,   43,   44,   45,   46,   47,   48,
+      49,   50,   51, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+static const char _base64EncodeTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static inline int _codecHexValue (uchar c) {
+    if (c >= '0' && c <= '9') return(c - '0');
+    if (c >= 'A' && c <= 'F') return(c - 'A' + 10);
+    if (c >= 'a' && c <= 'f') return(c - 'a' + 10);
+    return(-1);
+}
+
+// ===========================================================================
+//  PRIVATE Functions (SSSE3)
+// ===========================================================================
+#ifdef IMAP_CODEC_SSSE3
+/* Decode 16 base64 chars into 12 bytes, writes 16 bytes at dst.
+ * Returns false if the block contains anything but the 64 alphabet chars.
+ */
+static inline IMAP_CODEC_SSSE3_TARGET bool _codecDecodeBlock (const char *src, char *dst) {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                        0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                        0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                        0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                          0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2f);
+
+    __m128i in = _mm_loadu_si128((const __m128i *)src);
+    __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask2F);
+    __m128i loNibbles = _mm_and_si128(in, mask2F);
+    __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
+        return(false);
+
+    __m128i eq2F = _mm_cmpeq_epi8(in, mask2F);
+    __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+    in = _mm_add_epi8(in, roll);
+
+    // Pack 4 x 6bit into 3 bytes
+    __m128i merged = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+    __m128i out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    out = _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                              14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i *)dst, out);
+    return(true);
+}
+
+/* Encode 12 bytes (reads 16 bytes at src) into 16 base64 chars. */
+static inline IMAP_CODEC_SSSE3_TARGET void _codecEncodeBlock (const char *src, char *dst) {
+    __m128i in = _mm_loadu_si128((const __m128i *)src);
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                           4, 5, 3, 4, 1, 2, 0, 1));
+
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(t1, t3);
+
+    const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0);
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(shiftLut, result);
+    _mm_storeu_si128((__m128i *)dst, _mm_add_epi8(result, indices));
+}
+
+/* Decode whole blocks until an invalid one (line break, padding).
+ * Returns the number of chars consumed, 12 bytes written per 16.
+ */
+static IMAP_CODEC_SSSE3_TARGET int _codecDecodeBlocks (const char *src, int n, char *dst) {
+    int i = 0;
+    for (; (n - i) >= 16 && _codecDecodeBlock(src + i, dst); i += 16)
+        dst += 12;
+    return(i);
+}
+
+/* Encode blocks, reading 16 bytes but consuming 12 at a time.
+ * Returns the number of bytes consumed, 16 chars written per 12.
+ */
+static IMAP_CODEC_SSSE3_TARGET int _codecEncodeBlocks (const char *src, int n, char *dst) {
+    int i = 0;
+    for (; (n - i) >= 16; i += 12, dst += 16)
+        _codecEncodeBlock(src + i, dst);
+    return(i);
+}
+#endif /* IMAP_CODEC_SSSE3 */
+
+static bool _codecHasSsse3 (void) {
+#if defined(IMAP_CODEC_SSSE3_RUNTIME)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return(false);
+    return((ecx & (1 << 9)) != 0);
+#elif defined(IMAP_CODEC_SSSE3)
+    return(true);
+#else
+    return(false);
+#endif
+}
+
+static bool _codecSsse3 = _codecHasSsse3();
+
+// ===========================================================================
+//  PRIVATE Functions (RFC 2047)
+// ===========================================================================
+/* Locate the next "=?charset?X?text?=" starting at 'from'.
+ * On success fills charset/encoding/text spans and the word end.
+ */
+static bool _codecFindEncodedWord (const char *s, int n, int from,
+                                   int *start, int *end,
+                                   int *charsetEnd, int *textBegin)
+{
+    for (int p = from; p + 1 < n; ++p) {
+        if (s[p] != '=' || s[p + 1] != '?')
+            continue;
+
+        int q = p + 2;
+        while (q < n && s[q] != '?' && s[q] > ' ')
+            q++;
+        if (q == p + 2 || q + 2 >= n || s[q] != '?' || s[q + 2] != '?')
+            continue;
+
+        char method = s[q + 1] | 0x20;
+        if (method != 'b' && method != 'q')
+            continue;
+
+        int t = q + 3;
+        while (t + 1 < n && !(s[t] == '?' && s[t + 1] == '=') && s[t] > ' ')
+            t++;
+        if (t + 1 >= n || s[t] != '?' || s[t + 1] != '=')
+            continue;
+
+        *start = p;
+        *charsetEnd = q;
+        *textBegin = q + 3;
+        *end = t + 2;
+        return(true);
+    }
+    return(false);
+}
+
+static void _codecDecodeWords (const QByteArray& text,
+                               QByteArray *bytes, QString *unicode)
+{
+    const char *s = text.constData();
+    int n = text.size();
+
+    int start, end, charsetEnd, textBegin;
+    int lastEnd = -1;
+    int pos = 0;
+
+    while (_codecFindEncodedWord(s, n, pos, &start, &end, &charsetEnd, &textBegin)) {
+        // Keep text between words, unless it's only whitespace
+        // separating two adjacent encoded-words (RFC 2047, 6.2).
+        bool onlySpaces = (lastEnd >= 0);
+        for (int i = pos; onlySpaces && i < start; ++i)
+            onlySpaces = (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n');
+        if (!onlySpaces && start > pos) {
+            if (unicode != NULL)
+                unicode->append(QString::fromLatin1(s + pos, start - pos));
+            else
+                bytes->append(s + pos, start - pos);
+        }
+
+        QByteArray data = QByteArray::fromRawData(s + textBegin, end - 2 - textBegin);
+        QByteArray decoded;
+        if ((s[charsetEnd + 1] | 0x20) == 'b')
+            decoded = ImapCodec::decodeBase64(data);
+        else
+            decoded = ImapCodec::decodeQuotedPrintable(data, true);
+
+        if (unicode != NULL) {
+            // RFC 2231 allows "charset*language"
+            QByteArray charset(s + start + 2, charsetEnd - start - 2);
+            int langIndex = charset.indexOf('*');
+            if (langIndex >= 0) charset.truncate(langIndex);
+
+            QTextCodec *codec = QTextCodec::codecForName(charset);
+            if (codec != NULL)
+                unicode->append(codec->toUnicode(decoded));
+            else
+                unicode->append(QString::fromLatin1(decoded));
+        } else {
+            bytes->append(decoded);
+        }
+
+        lastEnd = pos = end;
+    }
+
+    if (pos < n) {
+        if (unicode != NULL)
+            unicode->append(QString::fromLatin1(s + pos, n - pos));
+        else
+            bytes->append(s + pos, n - pos);
+    }
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods (Code Path)
+// ===========================================================================
+/**
+ * Returns true if base64 runs the SSSE3 code path.
+ */
+bool ImapCodec::isAccelerated (void) {
+    return(_codecSsse3);
+}
+
+/**
+ * Select the SSSE3 (default, when the CPU has it) or the scalar code
+ * path, for tests and benchmarks. Not thread safe, call it before
+ * decoding. Returns false if SSSE3 can't be enabled.
+ */
+bool ImapCodec::setAccelerated (bool enable) {
+    _codecSsse3 = enable && _codecHasSsse3();
+    return(_codecSsse3 == enable);
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods (Base64)
+// ===========================================================================
+/**
+ * Decode base64 data. Whitespace (line breaks) and invalid chars are
+ * skipped, decoding stops at the first pad char.
+ */
+QByteArray ImapCodec::decodeBase64 (const QByteArray& data) {
+    const char *src = data.constData();
+    int n = data.size();
+
+    // 16 bytes of slack for the vector store.
+    QByteArray output;
+    output.resize((n * 3) / 4 + 16);
+    char *dst = output.data();
+
+    quint32 acc = 0;
+    int bits = 0;
+    int i = 0;
+
+    while (i < n) {
+#ifdef IMAP_CODEC_SSSE3
+        if (_codecSsse3 && bits == 0 && (n - i) >= 16) {
+            int used = _codecDecodeBlocks(src + i, n - i, dst);
+            dst += (used / 16) * 12;
+            i += used;
+            if (i >= n)
+                break;
+        }
+#endif
+        quint8 value = _base64DecodeTable[(uchar)src[i++]];
+        if (value >= B64_SKIP) {
+            if (value == B64_PAD)
+                break;
+            continue;
+        }
+
+        acc = (acc << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            *dst++ = (char)(acc >> bits);
+            acc &= (1 << bits) - 1;
+        }
+    }
+
+    output.truncate(dst - output.constData());
+    return(output);
+}
+
+/**
+ * Encode data as a single base64 line (no line breaks).
+ */
+QByteArray ImapCodec::encodeBase64 (const QByteArray& data) {
+    const uchar *src = (const uchar *)data.constData();
+    int n = data.size();
+
+    QByteArray output;
+    output.resize(((n + 2) / 3) * 4);
+    char *dst = output.data();
+    int i = 0;
+
+#ifdef IMAP_CODEC_SSSE3
+    if (_codecSsse3) {
+        i = _codecEncodeBlocks((const char *)src, n, dst);
+        dst += (i / 12) * 16;
+    }
+#endif
+
+    for (; (n - i) >= 3; i += 3) {
+        quint32 v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        *dst++ = _base64EncodeTable[(v >> 18) & 0x3f];
+        *dst++ = _base64EncodeTable[(v >> 12) & 0x3f];
+        *dst++ = _base64EncodeTable[(v >> 6) & 0x3f];
+        *dst++ = _base64EncodeTable[v & 0x3f];
+    }
+
+    if ((n - i) == 1) {
+        quint32 v = (src[i] << 16);
+        *dst++ = _base64EncodeTable[(v >> 18) & 0x3f];
+        *dst++ = _base64EncodeTable[(v >> 12) & 0x3f];
+        *dst++ = '=';
+        *dst++ = '=';
+    } else if ((n - i) == 2) {
+        quint32 v = (src[i] << 16) | (src[i + 1] << 8);
+        *dst++ = _base64EncodeTable[(v >> 18) & 0x3f];
+        *dst++ = _base64EncodeTable[(v >> 12) & 0x3f];
+        *dst++ = _base64EncodeTable[(v >> 6) & 0x3f];
+        *dst++ = '=';
+    }
+
+    return(output);
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods (Quoted-Printable)
+// ===========================================================================
+/**
+ * Decode quoted-printable data, removing soft line breaks.
+ * With underscoreAsSpace set decodes RFC 2047 "Q" encoding.
+ */
+QByteArray ImapCodec::decodeQuotedPrintable (const QByteArray& data,
+                                             bool underscoreAsSpace)
+{
+    const char *src = data.constData();
+    int n = data.size();
+
+    QByteArray output;
+    output.resize(n);
+    char *dst = output.data();
+    int i = 0;
+
+    while (i < n) {
+        // Copy plain runs in bulk
+        int run = i;
+        while (run < n && src[run] != '=' && !(underscoreAsSpace && src[run] == '_'))
+            run++;
+        if (run > i) {
+            memcpy(dst, src + i, run - i);
+            dst += run - i;
+            i = run;
+            if (i >= n) break;
+        }
+
+        if (src[i] == '_') {
+            *dst++ = ' ';
+            i++;
+            continue;
+        }
+
+        // '=XX' escape
+        if (i + 2 < n) {
+            int hi = _codecHexValue(src[i + 1]);
+            int lo = _codecHexValue(src[i + 2]);
+            if (hi >= 0 && lo >= 0) {
+                *dst++ = (char)((hi << 4) | lo);
+                i += 3;
+                continue;
+            }
+        }
+
+        // Soft line break: '=' [whitespace] CRLF/LF
+        int j = i + 1;
+        while (j < n && (src[j] == ' ' || src[j] == '\t'))
+            j++;
+        if (j < n && src[j] == '\r') j++;
+        if (j < n && src[j] == '\n') {
+            i = j + 1;
+            continue;
+        }
+        if (j >= n) {
+            i = n;
+            continue;
+        }
+
+        // Malformed escape, keep it as is.
+        *dst++ = src[i++];
+    }
+
+    output.truncate(dst - output.constData());
+    return(output);
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods (RFC 2047)
+// ===========================================================================
+/**
+ * Decode RFC 2047 encoded-words, returning the raw decoded bytes.
+ * Text outside the encoded-words is preserved.
+ */
+QByteArray ImapCodec::decodeEncodedWords (const QByteArray& text) {
+    QByteArray output;
+    output.reserve(text.size());
+    _codecDecodeWords(text, &output, NULL);
+    return(output);
+}
+
+/**
+ * Decode RFC 2047 encoded-words converting each word from its charset.
+ */
+QString ImapCodec::decodeHeader (const QByteArray& text) {
+    QString output;
+    output.reserve(text.size());
+    _codecDecodeWords(text, NULL, &output);
+    return(output);
+}
+
+/**
+ * Decode body part data using the specified transfer encoding.
+ */
+QByteArray ImapCodec::decode (const QByteArray& data,
+                              ImapMessageBodyPart::Encoding encoding)
+{
+    switch (encoding) {
+        case ImapMessageBodyPart::Base64Encoding:
+            return(decodeBase64(data));
+        case ImapMessageBodyPart::QuotedPrintableEncoding:
+            return(decodeQuotedPrintable(data));
+        default:
+            break;
+    }
+    return(data);
+}
+
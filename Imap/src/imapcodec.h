@@ -0,0 +1,37 @@
+#ifndef _IMAP_CODEC_H_
+#define _IMAP_CODEC_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include "imapmessage.h"
+
+/**
+ * Content-Transfer-Encoding and RFC 2047 header decoders.
+ *
+ * All decoders work on raw bytes. Base64 decode/encode use an SSSE3
+ * code path (16 input chars per step) when the CPU has it, chosen at
+ * runtime on x86 GCC/clang builds, and a table-driven scalar loop
+ * otherwise.
+ */
+class ImapCodec {
+    public:
+        static bool isAccelerated (void);
+        static bool setAccelerated (bool enable);
+
+
+        static QByteArray decodeBase64 (const QByteArray& data);
+        static QByteArray encodeBase64 (const QByteArray& data);
+
+        static QByteArray decodeQuotedPrintable (const QByteArray& data,
+                                                 bool underscoreAsSpace = false);
+
+        static QByteArray decodeEncodedWords (const QByteArray& text);
+        static QString decodeHeader (const QByteArray& text);
+
+        static QByteArray decode (const QByteArray& data,
+                                  ImapMessageBodyPart::Encoding encoding);
+};
+
+#endif /* !_IMAP_CODEC_H_ */
+
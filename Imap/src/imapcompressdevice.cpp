@@ -0,0 +1,266 @@
+#include <QByteArray>
+#include <QTime>
+
+#include <string.h>
+#include <zlib.h>
+
+#include "imapcompressdevice.h"
+
+#define COMPRESS_CHUNK_SIZE         (16 * 1024)
+#define COMPRESS_COMPACT_SIZE       (64 * 1024)
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapCompressDevicePrivate {
+    public:
+        QIODevice *device;
+        z_stream inflater;
+        z_stream deflater;
+        bool failed;
+
+        // Inflated data not read yet, starting at offset.
+        QByteArray buffer;
+        int offset;
+
+        qint64 compressedBytesWritten;
+        qint64 compressedBytesRead;
+        qint64 bytesWritten;
+        qint64 bytesRead;
+
+    public:
+        int available (void) const;
+};
+
+int ImapCompressDevicePrivate::available (void) const {
+    return(buffer.size() - offset);
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapCompressDevice::ImapCompressDevice (QIODevice *device, QObject *parent)
+    : QIODevice(parent), d(new ImapCompressDevicePrivate)
+{
+    d->device = device;
+    d->failed = false;
+    d->offset = 0;
+    d->compressedBytesWritten = d->compressedBytesRead = 0;
+    d->bytesWritten = d->bytesRead = 0;
+
+    // Raw deflate streams, no zlib header (RFC 4978 section 4).
+    memset(&d->inflater, 0, sizeof(z_stream));
+    memset(&d->deflater, 0, sizeof(z_stream));
+    if (inflateInit2(&d->inflater, -MAX_WBITS) != Z_OK ||
+        deflateInit2(&d->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        setErrorString("Unable to initialize zlib");
+        d->failed = true;
+    }
+
+    connect(device, SIGNAL(readyRead()), this, SLOT(deviceReadyRead()));
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+ImapCompressDevice::~ImapCompressDevice() {
+    inflateEnd(&d->inflater);
+    deflateEnd(&d->deflater);
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods (QIODevice)
+// ===========================================================================
+bool ImapCompressDevice::isSequential (void) const {
+    return(true);
+}
+
+bool ImapCompressDevice::canReadLine (void) const {
+    const_cast<ImapCompressDevice *>(this)->inflateAvailable();
+    if (d->buffer.indexOf('\n', d->offset) >= 0)
+        return(true);
+    return(QIODevice::canReadLine());
+}
+
+qint64 ImapCompressDevice::bytesAvailable (void) const {
+    const_cast<ImapCompressDevice *>(this)->inflateAvailable();
+    return(d->available() + QIODevice::bytesAvailable());
+}
+
+qint64 ImapCompressDevice::bytesToWrite (void) const {
+    return(d->device->bytesToWrite());
+}
+
+/**
+ * Wait for data to inflate. Compressed data may not produce any
+ * output yet (partial block), keep waiting up to msecs.
+ */
+bool ImapCompressDevice::waitForReadyRead (int msecs) {
+    QTime timer;
+    timer.start();
+
+    while (true) {
+        inflateAvailable();
+        if (d->available() > 0)
+            return(true);
+        if (d->failed)
+            return(false);
+
+        int remaining = -1;
+        if (msecs >= 0) {
+            remaining = msecs - timer.elapsed();
+            if (remaining <= 0)
+                return(false);
+        }
+
+        if (!d->device->waitForReadyRead(remaining))
+            return(false);
+    }
+}
+
+bool ImapCompressDevice::waitForBytesWritten (int msecs) {
+    return(d->device->waitForBytesWritten(msecs));
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+QIODevice *ImapCompressDevice::device (void) const {
+    return(d->device);
+}
+
+qint64 ImapCompressDevice::bytesRead (void) const {
+    return(d->bytesRead);
+}
+
+qint64 ImapCompressDevice::bytesWritten (void) const {
+    return(d->bytesWritten);
+}
+
+qint64 ImapCompressDevice::compressedBytesRead (void) const {
+    return(d->compressedBytesRead);
+}
+
+qint64 ImapCompressDevice::compressedBytesWritten (void) const {
+    return(d->compressedBytesWritten);
+}
+
+// ===========================================================================
+//  PROTECTED Methods
+// ===========================================================================
+qint64 ImapCompressDevice::readData (char *data, qint64 maxSize) {
+    inflateAvailable();
+
+    int size = (int)qMin(maxSize, (qint64)d->available());
+    if (size == 0)
+        return(d->failed ? -1 : 0);
+
+    memcpy(data, d->buffer.constData() + d->offset, size);
+    d->offset += size;
+    return(size);
+}
+
+qint64 ImapCompressDevice::readLineData (char *data, qint64 maxSize) {
+    inflateAvailable();
+
+    int size = (int)qMin(maxSize, (qint64)d->available());
+    if (size == 0)
+        return(d->failed ? -1 : 0);
+
+    const char *begin = d->buffer.constData() + d->offset;
+    const char *newline = (const char *)memchr(begin, '\n', size);
+    if (newline != NULL)
+        size = (newline - begin) + 1;
+
+    memcpy(data, begin, size);
+    d->offset += size;
+    return(size);
+}
+
+qint64 ImapCompressDevice::writeData (const char *data, qint64 size) {
+    if (d->failed)
+        return(-1);
+
+    QByteArray output;
+    char chunk[COMPRESS_CHUNK_SIZE];
+
+    z_stream *z = &d->deflater;
+    z->next_in = (Bytef *)data;
+    z->avail_in = (uInt)size;
+    do {
+        z->next_out = (Bytef *)chunk;
+        z->avail_out = sizeof(chunk);
+        if (deflate(z, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+            setErrorString("Deflate stream error");
+            d->failed = true;
+            return(-1);
+        }
+        output.append(chunk, sizeof(chunk) - z->avail_out);
+    } while (z->avail_out == 0);
+
+    if (d->device->write(output) != output.size())
+        return(-1);
+
+    d->bytesWritten += size;
+    d->compressedBytesWritten += output.size();
+    return(size);
+}
+
+// ===========================================================================
+//  PRIVATE Slots
+// ===========================================================================
+void ImapCompressDevice::deviceReadyRead (void) {
+    if (inflateAvailable())
+        emit readyRead();
+}
+
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+/**
+ * Inflate what the underlying device has received.
+ * Returns true if new data is available.
+ */
+bool ImapCompressDevice::inflateAvailable (void) {
+    if (d->failed || d->device->bytesAvailable() <= 0)
+        return(false);
+
+    QByteArray input = d->device->readAll();
+    d->compressedBytesRead += input.size();
+
+    // Drop what was already read.
+    if (d->offset == d->buffer.size()) {
+        d->buffer.clear();
+        d->offset = 0;
+    } else if (d->offset > COMPRESS_COMPACT_SIZE) {
+        d->buffer.remove(0, d->offset);
+        d->offset = 0;
+    }
+
+    int previous = d->buffer.size();
+    char chunk[COMPRESS_CHUNK_SIZE];
+
+    z_stream *z = &d->inflater;
+    z->next_in = (Bytef *)input.data();
+    z->avail_in = input.size();
+    do {
+        z->next_out = (Bytef *)chunk;
+        z->avail_out = sizeof(chunk);
+
+        int ret = inflate(z, Z_SYNC_FLUSH);
+        d->buffer.append(chunk, sizeof(chunk) - z->avail_out);
+
+        if (ret == Z_STREAM_END || ret == Z_BUF_ERROR)
+            break;
+        if (ret != Z_OK) {
+            setErrorString(z->msg != NULL ? z->msg : "Inflate stream error");
+            d->failed = true;
+            break;
+        }
+    } while (z->avail_in > 0 || z->avail_out == 0);
+
+    d->bytesRead += d->buffer.size() - previous;
+    return(d->buffer.size() > previous);
+}
+
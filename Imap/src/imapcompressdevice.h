@@ -0,0 +1,55 @@
+#ifndef _IMAP_COMPRESS_DEVICE_H_
+#define _IMAP_COMPRESS_DEVICE_H_
+
+#include <QIODevice>
+
+class ImapCompressDevicePrivate;
+
+/**
+ * COMPRESS=DEFLATE (RFC 4978) layer over a connection stream, either
+ * a plain or an SSL socket. Data written is deflated and sync-flushed,
+ * so each command is sent at once; data read is inflated.
+ * The underlying device is not owned.
+ */
+class ImapCompressDevice : public QIODevice {
+    Q_OBJECT
+
+    public:
+        ImapCompressDevice (QIODevice *device, QObject *parent = 0);
+        ~ImapCompressDevice();
+
+        // QIODevice
+        bool isSequential (void) const;
+        bool canReadLine (void) const;
+        qint64 bytesAvailable (void) const;
+        qint64 bytesToWrite (void) const;
+        bool waitForReadyRead (int msecs);
+        bool waitForBytesWritten (int msecs);
+
+        // Properties
+        QIODevice *device (void) const;
+
+        qint64 bytesRead (void) const;
+        qint64 bytesWritten (void) const;
+        qint64 compressedBytesRead (void) const;
+        qint64 compressedBytesWritten (void) const;
+
+    protected:
+        qint64 readData (char *data, qint64 maxSize);
+        qint64 readLineData (char *data, qint64 maxSize);
+        qint64 writeData (const char *data, qint64 size);
+
+    private slots:
+        void deviceReadyRead (void);
+
+    private:
+        bool inflateAvailable (void);
+
+    private:
+        Q_DISABLE_COPY(ImapCompressDevice)
+
+        ImapCompressDevicePrivate *d;
+};
+
+#endif /* !_IMAP_COMPRESS_DEVICE_H_ */
+
@@ -0,0 +1,302 @@
+#include <QHash>
+
+#include "imapparser.h"
+#include "imapfolder.h"
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+/* INBOX is case insensitive (RFC 3501 section 5.1),
+ * keep a single spelling for it and its children.
+ */
+static QString _folderNormalize (const QString& path, QChar delimiter) {
+    if (path.size() < 5 || path.left(5).compare("INBOX", Qt::CaseInsensitive) != 0)
+        return(path);
+
+    if (path.size() > 5 && (delimiter.isNull() || path[5] != delimiter))
+        return(path);
+
+    return("INBOX" + path.mid(5));
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapFolderPrivate {
+    public:
+        QList<ImapFolder *> children;
+        ImapFolder *parent;
+
+        QStringList attributes;
+        QChar delimiter;
+        QString path;
+        QString name;
+        bool exists;
+
+        ImapFolder::StatusItems statusItems;
+        uint uidValidity;
+        uint uidNext;
+        int messages;
+        int unseen;
+        int recent;
+
+        // Root only, every folder by path.
+        QHash<QString, ImapFolder *> index;
+};
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapFolder::ImapFolder()
+    : d(new ImapFolderPrivate)
+{
+    d->parent = NULL;
+    d->exists = false;
+    d->statusItems = 0;
+    d->uidValidity = d->uidNext = 0;
+    d->messages = d->unseen = d->recent = 0;
+}
+
+ImapFolder::~ImapFolder() {
+    qDeleteAll(d->children);
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods
+// ===========================================================================
+/**
+ * STATUS data items, "MESSAGES UNSEEN UIDNEXT".
+ */
+QString ImapFolder::statusItemsString (StatusItems items) {
+    QStringList names;
+    if (items & Messages) names.append("MESSAGES");
+    if (items & Recent) names.append("RECENT");
+    if (items & Unseen) names.append("UNSEEN");
+    if (items & UidNext) names.append("UIDNEXT");
+    if (items & UidValidity) names.append("UIDVALIDITY");
+    return(names.join(" "));
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Add the folder of an untagged LIST response
+ * ("* LIST (\HasNoChildren) "/" "INBOX/Sent"") to the tree.
+ */
+bool ImapFolder::appendListResponse (const QByteArray& response) {
+    ImapParser parser(response);
+    if (!parser.skipChar('*') || !parser.skipAtom("LIST") || !parser.skipChar('('))
+        return(false);
+
+    QStringList attributes;
+    while (!parser.atListEnd()) {
+        QByteArray attribute = parser.readAtom();
+        if (attribute.isEmpty())
+            return(false);
+        attributes.append(QString::fromLatin1(attribute));
+    }
+    if (!parser.skipChar(')'))
+        return(false);
+
+    QByteArray delimiter = parser.readString();
+    QByteArray path = parser.readString();
+    if (path.isEmpty())
+        return(false);
+
+    ImapFolder *folder = addFolder(QString::fromLatin1(path),
+                                   delimiter.isEmpty() ? QChar() : QChar(delimiter[0]));
+    folder->d->attributes = attributes;
+    folder->d->exists = true;
+    return(true);
+}
+
+/**
+ * Store the counters of an untagged STATUS response
+ * ("* STATUS "INBOX" (MESSAGES 231 UIDNEXT 44292)") in its folder.
+ * The folder must be in the tree.
+ */
+bool ImapFolder::appendStatusResponse (const QByteArray& response) {
+    ImapParser parser(response);
+    if (!parser.skipChar('*') || !parser.skipAtom("STATUS"))
+        return(false);
+
+    ImapFolder *folder = find(QString::fromLatin1(parser.readString()));
+    if (folder == NULL || !parser.skipChar('('))
+        return(false);
+
+    while (!parser.atListEnd()) {
+        QByteArray item = parser.readAtom().toUpper();
+        bool ok;
+        qint64 value = parser.readNumber(&ok);
+        if (!ok)
+            return(false);
+
+        if (item == "MESSAGES") {
+            folder->d->messages = (int)value;
+            folder->d->statusItems |= Messages;
+        } else if (item == "RECENT") {
+            folder->d->recent = (int)value;
+            folder->d->statusItems |= Recent;
+        } else if (item == "UNSEEN") {
+            folder->d->unseen = (int)value;
+            folder->d->statusItems |= Unseen;
+        } else if (item == "UIDNEXT") {
+            folder->d->uidNext = (uint)value;
+            folder->d->statusItems |= UidNext;
+        } else if (item == "UIDVALIDITY") {
+            folder->d->uidValidity = (uint)value;
+            folder->d->statusItems |= UidValidity;
+        }
+    }
+    return(parser.skipChar(')'));
+}
+
+/**
+ * Return the folder of the given path, creating it and its missing
+ * parents (as non-existent folders) if needed.
+ */
+ImapFolder *ImapFolder::addFolder (const QString& path, QChar delimiter) {
+    ImapFolder *top = root();
+    QString normalized = _folderNormalize(path, delimiter);
+
+    ImapFolder *folder = top->d->index.value(normalized, NULL);
+    if (folder != NULL) {
+        if (!delimiter.isNull())
+            folder->d->delimiter = delimiter;
+        return(folder);
+    }
+
+    ImapFolder *parent = top;
+    QString name = normalized;
+    int separator = delimiter.isNull() ? -1 : normalized.lastIndexOf(delimiter);
+    if (separator > 0) {
+        parent = addFolder(normalized.left(separator), delimiter);
+        name = normalized.mid(separator + 1);
+    }
+
+    folder = new ImapFolder;
+    folder->d->parent = parent;
+    folder->d->delimiter = delimiter;
+    folder->d->path = normalized;
+    folder->d->name = name;
+
+    parent->d->children.append(folder);
+    top->d->index.insert(normalized, folder);
+    return(folder);
+}
+
+// ===========================================================================
+//  PUBLIC Tree
+// ===========================================================================
+ImapFolder *ImapFolder::parent (void) const {
+    return(d->parent);
+}
+
+ImapFolder *ImapFolder::root (void) const {
+    const ImapFolder *folder = this;
+    while (folder->d->parent != NULL)
+        folder = folder->d->parent;
+    return(const_cast<ImapFolder *>(folder));
+}
+
+int ImapFolder::childCount (void) const {
+    return(d->children.size());
+}
+
+ImapFolder *ImapFolder::childAt (int index) const {
+    return(d->children.value(index, NULL));
+}
+
+QList<ImapFolder *> ImapFolder::children (void) const {
+    return(d->children);
+}
+
+/**
+ * All the folders below this one, parents before their children.
+ */
+QList<ImapFolder *> ImapFolder::descendants (void) const {
+    QList<ImapFolder *> folders;
+    foreach (ImapFolder *child, d->children) {
+        folders.append(child);
+        folders.append(child->descendants());
+    }
+    return(folders);
+}
+
+/**
+ * Find a folder of the tree by its path, NULL if not listed.
+ */
+ImapFolder *ImapFolder::find (const QString& path) const {
+    const QHash<QString, ImapFolder *>& index = root()->d->index;
+
+    ImapFolder *folder = index.value(path, NULL);
+    if (folder == NULL && path.left(5).compare("INBOX", Qt::CaseInsensitive) == 0)
+        folder = index.value("INBOX" + path.mid(5), NULL);
+    return(folder);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+QString ImapFolder::name (void) const {
+    return(d->name);
+}
+
+QString ImapFolder::path (void) const {
+    return(d->path);
+}
+
+QChar ImapFolder::delimiter (void) const {
+    return(d->delimiter);
+}
+
+QStringList ImapFolder::attributes (void) const {
+    return(d->attributes);
+}
+
+bool ImapFolder::hasAttribute (const QString& attribute) const {
+    return(d->attributes.contains(attribute, Qt::CaseInsensitive));
+}
+
+/**
+ * Listed by the server, not only implied by a child.
+ */
+bool ImapFolder::exists (void) const {
+    return(d->exists);
+}
+
+bool ImapFolder::isSelectable (void) const {
+    return(d->exists && !hasAttribute("\\Noselect") &&
+           !hasAttribute("\\NonExistent"));
+}
+
+ImapFolder::StatusItems ImapFolder::statusItems (void) const {
+    return(d->statusItems);
+}
+
+bool ImapFolder::hasStatus (StatusItem item) const {
+    return((d->statusItems & item) != 0);
+}
+
+int ImapFolder::messages (void) const {
+    return(d->messages);
+}
+
+int ImapFolder::recent (void) const {
+    return(d->recent);
+}
+
+int ImapFolder::unseen (void) const {
+    return(d->unseen);
+}
+
+uint ImapFolder::uidNext (void) const {
+    return(d->uidNext);
+}
+
+uint ImapFolder::uidValidity (void) const {
+    return(d->uidValidity);
+}
+
@@ -0,0 +1,82 @@
+#ifndef _IMAP_FOLDER_H_
+#define _IMAP_FOLDER_H_
+
+#include <QStringList>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+class ImapFolderPrivate;
+
+/**
+ * Folder hierarchy of an account, as returned by Imap::folderTree().
+ *
+ * The root has an empty path and holds the top level folders. Each
+ * folder keeps its LIST attributes ("\Noselect", "\HasChildren")
+ * and the STATUS counters received for it. Folders that are only
+ * implied by a listed child ("a" for "a/b") are created as
+ * non-existent, non selectable nodes.
+ *
+ * Paths are kept as sent by the server, so they can be passed to
+ * select() as they are.
+ */
+class ImapFolder {
+    public:
+        enum StatusItem {
+            Messages        = 0x01,
+            Recent          = 0x02,
+            Unseen          = 0x04,
+            UidNext         = 0x08,
+            UidValidity     = 0x10
+        };
+        typedef uint StatusItems;
+
+    public:
+        ImapFolder();
+        ~ImapFolder();
+
+        static QString statusItemsString (StatusItems items);
+
+        // Methods
+        bool appendListResponse (const QByteArray& response);
+        bool appendStatusResponse (const QByteArray& response);
+
+        ImapFolder *addFolder (const QString& path, QChar delimiter);
+
+        // Tree
+        ImapFolder *parent (void) const;
+        ImapFolder *root (void) const;
+
+        int childCount (void) const;
+        ImapFolder *childAt (int index) const;
+        QList<ImapFolder *> children (void) const;
+
+        QList<ImapFolder *> descendants (void) const;
+        ImapFolder *find (const QString& path) const;
+
+        // Properties
+        QString name (void) const;
+        QString path (void) const;
+        QChar delimiter (void) const;
+
+        QStringList attributes (void) const;
+        bool hasAttribute (const QString& attribute) const;
+        bool exists (void) const;
+        bool isSelectable (void) const;
+
+        StatusItems statusItems (void) const;
+        bool hasStatus (StatusItem item) const;
+
+        int messages (void) const;
+        int recent (void) const;
+        int unseen (void) const;
+        uint uidNext (void) const;
+        uint uidValidity (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapFolder)
+
+        ImapFolderPrivate *d;
+};
+
+#endif /* !_IMAP_FOLDER_H_ */
@@ -0,0 +1,296 @@
+#include <QTimer>
+
+#include "imapidlewatcher.h"
+#include "imapparser.h"
+#include "imap_p.h"
+#include "imap.h"
+
+// Servers may drop an IDLE after 30 minutes (RFC 2177), restart it earlier.
+#define IMAP_IDLE_INTERVAL          (25 * 60 * 1000)
+#define IMAP_POLL_INTERVAL          (60 * 1000)
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapIdleWatcherPrivate {
+    public:
+        ImapPrivate *imap;
+        QTimer timer;
+
+        // Response read so far, see ImapPrivate::readBufferedResponse().
+        QByteArray response;
+        int literalSize;
+
+        int pollInterval;
+        int idleInterval;
+        bool useIdle;
+        bool entering;
+        bool idling;
+        bool done;
+        bool active;
+};
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapIdleWatcher::ImapIdleWatcher (Imap *imap, QObject *parent)
+    : QObject(parent), d(new ImapIdleWatcherPrivate)
+{
+    qRegisterMetaType<ImapSequenceSet>("ImapSequenceSet");
+    qRegisterMetaType<ImapMessageFlags>("ImapMessageFlags");
+
+    d->imap = imap->d;
+    d->literalSize = -1;
+    d->pollInterval = IMAP_POLL_INTERVAL;
+    d->idleInterval = IMAP_IDLE_INTERVAL;
+    d->useIdle = imap->hasCapability("IDLE");
+    d->entering = false;
+    d->idling = false;
+    d->done = false;
+    d->active = false;
+
+    connect(&(d->timer), SIGNAL(timeout()), this, SLOT(timeout()));
+}
+
+ImapIdleWatcher::~ImapIdleWatcher() {
+    stop();
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapIdleWatcher::isActive (void) const {
+    return(d->active);
+}
+
+/**
+ * Returns true if the server pushes changes (IDLE, acknowledged or
+ * not yet), false if the watcher is polling.
+ */
+bool ImapIdleWatcher::isIdle (void) const {
+    return(d->entering || d->idling);
+}
+
+int ImapIdleWatcher::pollInterval (void) const {
+    return(d->pollInterval);
+}
+
+void ImapIdleWatcher::setPollInterval (int msecs) {
+    d->pollInterval = msecs;
+    if (d->active && !d->idling)
+        d->timer.start(msecs);
+}
+
+int ImapIdleWatcher::idleInterval (void) const {
+    return(d->idleInterval);
+}
+
+void ImapIdleWatcher::setIdleInterval (int msecs) {
+    d->idleInterval = msecs;
+    if (d->entering || d->idling)
+        d->timer.start(msecs);
+}
+
+// ===========================================================================
+//  PUBLIC Slots
+// ===========================================================================
+/**
+ * Start watching the selected mailbox. If the server rejects
+ * IDLE, error() is emitted and the watcher polls.
+ */
+bool ImapIdleWatcher::start (void) {
+    if (d->active)
+        return(true);
+
+    if (d->imap->device == NULL)
+        return(false);
+
+    d->active = true;
+    if (d->useIdle && enterIdle()) {
+        // The continuation, or changes, may already be buffered.
+        readyRead();
+        return(true);
+    }
+
+    d->timer.start(d->pollInterval);
+    return(true);
+}
+
+/**
+ * Stop watching, the Imap connection can be used again.
+ */
+void ImapIdleWatcher::stop (void) {
+    if (!d->active)
+        return;
+
+    d->timer.stop();
+    if (d->entering || d->idling)
+        leaveIdle();
+    d->active = false;
+}
+
+// ===========================================================================
+//  PRIVATE Slots
+// ===========================================================================
+/* Only reads what is buffered, the event loop is never blocked. */
+void ImapIdleWatcher::readyRead (void) {
+    while ((d->entering || d->idling) &&
+           d->imap->readBufferedResponse(&(d->response), &(d->literalSize)))
+    {
+        QByteArray response = d->response;
+        d->response.clear();
+
+        if (response.startsWith('+')) {
+            d->idling = d->idling || d->entering;
+            d->entering = false;
+        } else if (!d->imap->isTaggedResponse(response)) {
+            dispatch(response);
+        } else {
+            bool rejected = d->entering;
+            disconnect(d->imap->device, SIGNAL(readyRead()), this, SLOT(readyRead()));
+            d->entering = false;
+            d->idling = false;
+            d->done = false;
+
+            if (rejected) {
+                d->useIdle = false;
+                d->imap->responseErrorMsg = response;
+                emit error(d->imap->responseErrorMsg);
+                d->timer.start(d->pollInterval);
+            } else if (!enterIdle()) {
+                // IDLE over (DONE or the server), start a new one.
+                d->timer.start(d->pollInterval);
+            }
+        }
+    }
+}
+
+void ImapIdleWatcher::timeout (void) {
+    if (d->entering || d->done)
+        return;
+
+    // readyRead() starts a new IDLE once the server ends this one.
+    if (d->idling) {
+        d->done = d->imap->sendDataLine("DONE");
+        if (!d->done)
+            emit error(d->imap->socket->errorString());
+        return;
+    }
+
+    poll();
+}
+
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+bool ImapIdleWatcher::enterIdle (void) {
+    if (!d->imap->sendCommand("IDLE"))
+        return(false);
+
+    // The continuation is read by readyRead(), like the changes.
+    d->entering = true;
+    d->response.clear();
+    d->literalSize = -1;
+    connect(d->imap->device, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    d->timer.start(d->idleInterval);
+    return(true);
+}
+
+/* Waits for the end of the IDLE, once acknowledged. */
+bool ImapIdleWatcher::leaveIdle (void) {
+    disconnect(d->imap->device, SIGNAL(readyRead()), this, SLOT(readyRead()));
+
+    // Finish the response readyRead() left halfway.
+    QByteArray response = d->response;
+    bool ok = true;
+    if (d->literalSize >= 0) {
+        response += d->imap->readBytes(d->literalSize, &ok);
+        if (ok)
+            response += d->imap->readResponse(&ok);
+    }
+    d->response.clear();
+    d->literalSize = -1;
+
+    while (ok) {
+        if (d->idling && !d->done) {
+            ok = d->imap->sendDataLine("DONE");
+            d->done = true;
+        } else if (response.isEmpty()) {
+            response = d->imap->readResponse(&ok);
+        } else if (response.startsWith('+')) {
+            d->idling = d->idling || d->entering;
+            d->entering = false;
+            response.clear();
+        } else if (d->imap->isTaggedResponse(response)) {
+            break;
+        } else {
+            dispatch(response);
+            response.clear();
+        }
+    }
+
+    d->entering = false;
+    d->idling = false;
+    d->done = false;
+
+    if (!ok || !d->imap->isResponseOk(response)) {
+        d->imap->responseErrorMsg = response;
+        emit error(d->imap->responseErrorMsg);
+        return(false);
+    }
+    return(true);
+}
+
+bool ImapIdleWatcher::poll (void) {
+    if (!d->imap->sendCommand("NOOP"))
+        return(false);
+
+    QByteArray response;
+    bool ok;
+
+    while ((response = d->imap->readResponse(&ok)).startsWith('*'))
+        dispatch(response);
+
+    if (!ok || !d->imap->isResponseOk(response)) {
+        d->imap->responseErrorMsg = response;
+        emit error(d->imap->responseErrorMsg);
+        return(false);
+    }
+    return(true);
+}
+
+void ImapIdleWatcher::dispatch (const QByteArray& response) {
+    ImapParser parser(response);
+    if (!parser.skipChar('*'))
+        return;
+
+    bool isNumber;
+    int number = parser.readNumber(&isNumber);
+    if (!isNumber) {
+        if (parser.skipAtom("VANISHED")) {
+            if (parser.skipChar('(')) {     // (EARLIER)
+                while (!parser.atListEnd())
+                    parser.skipValue();
+                parser.skipChar(')');
+            }
+            emit vanished(ImapSequenceSet::fromString(parser.readAtom()));
+        }
+        return;
+    }
+
+    if (parser.skipAtom("EXISTS")) {
+        emit exists(number);
+    } else if (parser.skipAtom("RECENT")) {
+        emit recent(number);
+    } else if (parser.skipAtom("EXPUNGE")) {
+        emit expunged(number);
+    } else if (parser.skipAtom("FETCH")) {
+        ImapMessageFlags flags;
+        uint uid;
+
+        if (parser.readFlagUpdate(&uid, &flags))
+            emit flagsChanged(number, uid, flags);
+    }
+}
+
@@ -0,0 +1,67 @@
+#ifndef _IMAP_IDLE_WATCHER_H_
+#define _IMAP_IDLE_WATCHER_H_
+
+#include <QObject>
+
+#include "imapsequenceset.h"
+#include "imapmessage.h"
+
+class Imap;
+class ImapIdleWatcherPrivate;
+
+/**
+ * Watch the selected mailbox for changes pushed by the server.
+ * Uses IDLE (RFC 2177) when available, re-issued before the server
+ * drops it (29 minutes), otherwise polls with NOOP.
+ * While the watcher is active the Imap connection must not be used,
+ * call stop() first. Pushed changes are read from what the socket has
+ * buffered, the event loop never waits on the server for them.
+ * The signals can be queued across threads.
+ */
+class ImapIdleWatcher : public QObject {
+    Q_OBJECT
+
+    public:
+        ImapIdleWatcher (Imap *imap, QObject *parent = 0);
+        ~ImapIdleWatcher();
+
+        bool isActive (void) const;
+        bool isIdle (void) const;
+
+        // Properties
+        int pollInterval (void) const;
+        void setPollInterval (int msecs);
+
+        int idleInterval (void) const;
+        void setIdleInterval (int msecs);
+
+    public Q_SLOTS:
+        bool start (void);
+        void stop (void);
+
+    Q_SIGNALS:
+        void exists (int count);
+        void recent (int count);
+        void expunged (int messageNumber);
+        void vanished (const ImapSequenceSet& uids);
+        void flagsChanged (int messageNumber, uint uid, ImapMessageFlags flags);
+        void error (const QString& message);
+
+    private Q_SLOTS:
+        void readyRead (void);
+        void timeout (void);
+
+    private:
+        bool enterIdle (void);
+        bool leaveIdle (void);
+        bool poll (void);
+        void dispatch (const QByteArray& response);
+
+    private:
+        Q_DISABLE_COPY(ImapIdleWatcher)
+
+        ImapIdleWatcherPrivate *d;
+};
+
+#endif /* !_IMAP_IDLE_WATCHER_H_ */
+
@@ -0,0 +1,413 @@
+#include <QtAlgorithms>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+
+#include "imaplisting.h"
+#include "imapparser.h"
+#include "imapcodec.h"
+
+#define LISTING_STRING_SUBJECT          (0)
+#define LISTING_STRING_FROM_NAME        (1)
+#define LISTING_STRING_FROM_ADDRESS     (2)
+#define LISTING_STRING_MESSAGE_ID       (3)
+#define LISTING_STRING_COLUMNS          (4)
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+static void _listingFirstAddress (ImapParser& parser,
+                                  QByteArray *name, QByteArray *address)
+{
+    // NIL address list
+    if (!parser.skipChar('(')) {
+        parser.skipValue();
+        return;
+    }
+
+    if (parser.skipChar('(')) {
+        *name = parser.readString();
+        parser.skipValue();     // Source Route
+
+        QByteArray mailbox = parser.readString();
+        QByteArray host = parser.readString();
+        if (!mailbox.isEmpty() || !host.isEmpty()) {
+            *address = (mailbox.isEmpty() ? QByteArray("unknown") : mailbox);
+            *address += '@';
+            *address += (host.isEmpty() ? QByteArray("unknown") : host);
+        }
+
+        while (!parser.atListEnd())
+            parser.skipValue();
+        parser.skipChar(')');
+    }
+
+    // Skip other addresses
+    while (!parser.atListEnd())
+        parser.skipValue();
+    parser.skipChar(')');
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapListingPrivate {
+    public:
+        ImapListing::Fields fields;
+        int stringSlots[LISTING_STRING_COLUMNS];
+        int stringSlotCount;
+
+        QVector<int> ids;
+        QVector<uint> uids;
+        QVector<ImapMessageFlags> flags;
+        QVector<quint32> sizes;
+        QVector<uint> dates;
+
+        // (offset, length) pairs into pool, stringSlotCount per message.
+        QVector<quint32> spans;
+        QByteArray pool;
+        QHash<QByteArray, quint32> internTable;
+
+        bool idsSorted;
+        bool uidsSorted;
+
+    public:
+        void appendString (const QByteArray& value, bool intern);
+        void setString (int index, int column, const QByteArray& value, bool intern);
+        QByteArray string (int index, int column) const;
+
+    private:
+        quint32 poolString (const QByteArray& value, bool intern);
+};
+
+quint32 ImapListingPrivate::poolString (const QByteArray& value, bool intern) {
+    quint32 offset = pool.size();
+
+    if (intern && !value.isEmpty()) {
+        QHash<QByteArray, quint32>::const_iterator it = internTable.find(value);
+        if (it != internTable.end()) {
+            offset = it.value();
+        } else {
+            internTable.insert(value, offset);
+            pool.append(value);
+        }
+    } else {
+        pool.append(value);
+    }
+
+    return(offset);
+}
+
+void ImapListingPrivate::appendString (const QByteArray& value, bool intern) {
+    spans.append(poolString(value, intern));
+    spans.append(value.size());
+}
+
+/* The old bytes stay in the pool until the listing is cleared. */
+void ImapListingPrivate::setString (int index, int column,
+                                    const QByteArray& value, bool intern)
+{
+    int slot = stringSlots[column];
+    if (slot < 0)
+        return;
+
+    int spanIndex = ((index * stringSlotCount) + slot) * 2;
+    spans[spanIndex] = poolString(value, intern);
+    spans[spanIndex + 1] = value.size();
+}
+
+QByteArray ImapListingPrivate::string (int index, int column) const {
+    int slot = stringSlots[column];
+    if (slot < 0)
+        return(QByteArray());
+
+    int spanIndex = ((index * stringSlotCount) + slot) * 2;
+    return(pool.mid(spans[spanIndex], spans[spanIndex + 1]));
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapListing::ImapListing (Fields fields)
+    : d(new ImapListingPrivate)
+{
+    d->fields = fields;
+    d->idsSorted = d->uidsSorted = true;
+
+    d->stringSlotCount = 0;
+    d->stringSlots[LISTING_STRING_SUBJECT] = (fields & Subject) ? d->stringSlotCount++ : -1;
+    d->stringSlots[LISTING_STRING_FROM_NAME] = (fields & From) ? d->stringSlotCount++ : -1;
+    d->stringSlots[LISTING_STRING_FROM_ADDRESS] = (fields & From) ? d->stringSlotCount++ : -1;
+    d->stringSlots[LISTING_STRING_MESSAGE_ID] = (fields & MessageId) ? d->stringSlotCount++ : -1;
+}
+
+ImapListing::~ImapListing() {
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+void ImapListing::clear (void) {
+    d->ids.clear();
+    d->uids.clear();
+    d->flags.clear();
+    d->sizes.clear();
+    d->dates.clear();
+    d->spans.clear();
+    d->pool.clear();
+    d->internTable.clear();
+    d->idsSorted = d->uidsSorted = true;
+}
+
+void ImapListing::reserve (int size) {
+    d->ids.reserve(size);
+    if (d->fields & Uid) d->uids.reserve(size);
+    if (d->fields & Flags) d->flags.reserve(size);
+    if (d->fields & Size) d->sizes.reserve(size);
+    if (d->fields & InternalDate) d->dates.reserve(size);
+    d->spans.reserve(size * d->stringSlotCount * 2);
+}
+
+/**
+ * Release the intern table and the unused capacity.
+ * Call it once the listing is complete.
+ */
+void ImapListing::squeeze (void) {
+    d->internTable.clear();
+    d->ids.squeeze();
+    d->uids.squeeze();
+    d->flags.squeeze();
+    d->sizes.squeeze();
+    d->dates.squeeze();
+    d->spans.squeeze();
+    d->pool.squeeze();
+}
+
+/**
+ * FETCH items needed to fill the requested fields.
+ */
+QString ImapListing::fetchItems (void) const {
+    QStringList items;
+    items << "UID";
+    if (d->fields & Flags) items << "FLAGS";
+    if (d->fields & Size) items << "RFC822.SIZE";
+    if (d->fields & InternalDate) items << "INTERNALDATE";
+    if (d->fields & (Subject | From | MessageId)) items << "ENVELOPE";
+    return(QString("(%1)").arg(items.join(" ")));
+}
+
+/**
+ * Append a message from a raw "* n FETCH (...)" response.
+ *
+ * A response for a sequence number already in the listing, such as an
+ * unsolicited "* n FETCH (FLAGS (...))", updates that row with the items
+ * it carries instead. It is rejected if its UID names another message.
+ */
+bool ImapListing::appendFetchResponse (const QByteArray& response) {
+    ImapParser parser(response);
+
+    bool ok;
+    if (!parser.skipChar('*'))
+        return(false);
+    int id = parser.readNumber(&ok);
+    if (!ok || !parser.skipAtom("FETCH") || !parser.skipChar('('))
+        return(false);
+
+    Fields present = 0;
+    ImapMessageFlags flags = 0;
+    quint32 size = 0;
+    uint date = 0;
+    uint uid = 0;
+
+    QByteArray subject;
+    QByteArray fromName;
+    QByteArray fromAddress;
+    QByteArray messageId;
+
+    while (!parser.atListEnd()) {
+        QByteArray item = parser.readAtom().toUpper();
+        if (item.isEmpty())
+            return(false);
+
+        if (item == "UID") {
+            uid = parser.readNumber();
+            present |= Uid;
+        } else if (item == "FLAGS") {
+            flags = parser.readFlags();
+            present |= Flags;
+        } else if (item == "RFC822.SIZE") {
+            size = parser.readNumber();
+            present |= Size;
+        } else if (item == "INTERNALDATE") {
+            QDateTime dateTime = ImapParser::parseDateTime(parser.readString());
+            date = dateTime.isValid() ? dateTime.toTime_t() : 0;
+            present |= InternalDate;
+        } else if (item == "ENVELOPE" && parser.skipChar('(')) {
+            present |= Subject | From | MessageId;
+            parser.skipValue();                 // Date
+            subject = parser.readString();
+            _listingFirstAddress(parser, &fromName, &fromAddress);
+            for (int i = 0; i < 6; ++i)         // Sender ... In-Reply-To
+                parser.skipValue();
+            messageId = parser.readString();
+            while (!parser.atListEnd())
+                parser.skipValue();
+            parser.skipChar(')');
+        } else if (!parser.skipValue()) {
+            return(false);
+        }
+    }
+
+    if (messageId.startsWith('<') && messageId.endsWith('>'))
+        messageId = messageId.mid(1, messageId.size() - 2);
+
+    int index = indexOfId(id);
+    if (index >= 0) {
+        present &= d->fields;
+        if ((present & Uid) && d->uids[index] != uid)
+            return(false);
+
+        if (present & Flags) d->flags[index] = flags;
+        if (present & Size) d->sizes[index] = size;
+        if (present & InternalDate) d->dates[index] = date;
+
+        if (present & Subject)
+            d->setString(index, LISTING_STRING_SUBJECT, subject, false);
+        if (present & From) {
+            d->setString(index, LISTING_STRING_FROM_NAME, fromName, true);
+            d->setString(index, LISTING_STRING_FROM_ADDRESS, fromAddress, true);
+        }
+        if (present & MessageId)
+            d->setString(index, LISTING_STRING_MESSAGE_ID, messageId, false);
+        return(true);
+    }
+
+    if (!d->ids.isEmpty()) {
+        d->idsSorted = d->idsSorted && (d->ids.last() < id);
+        if (d->fields & Uid)
+            d->uidsSorted = d->uidsSorted && (d->uids.last() < uid);
+    }
+
+    d->ids.append(id);
+    if (d->fields & Uid) d->uids.append(uid);
+    if (d->fields & Flags) d->flags.append(flags);
+    if (d->fields & Size) d->sizes.append(size);
+    if (d->fields & InternalDate) d->dates.append(date);
+
+    if (d->fields & Subject)
+        d->appendString(subject, false);
+    if (d->fields & From) {
+        d->appendString(fromName, true);
+        d->appendString(fromAddress, true);
+    }
+    if (d->fields & MessageId)
+        d->appendString(messageId, false);
+
+    return(true);
+}
+
+/**
+ * Build an ImapMessage from the listing row. Caller owns the message.
+ */
+ImapMessage *ImapListing::message (int index) const {
+    ImapMessage *message = new ImapMessage;
+    message->setId(d->ids[index]);
+    if (d->fields & Uid)
+        message->setUid(QString::number(d->uids[index]));
+    if (d->fields & Flags)
+        message->setFlags(d->flags[index]);
+    if (d->fields & Size)
+        message->setSize(d->sizes[index]);
+    if (d->fields & InternalDate)
+        message->setReceived(received(index));
+    if (d->fields & Subject)
+        message->setSubject(subject(index));
+    if (d->fields & From)
+        message->setFromAddress(fromAddress(index));
+    if (d->fields & MessageId)
+        message->setMessageId(messageId(index));
+    return(message);
+}
+
+int ImapListing::indexOfId (int id) const {
+    if (d->idsSorted) {
+        QVector<int>::const_iterator it = qBinaryFind(d->ids.constBegin(), d->ids.constEnd(), id);
+        return(it != d->ids.constEnd() ? (it - d->ids.constBegin()) : -1);
+    }
+    return(d->ids.indexOf(id));
+}
+
+int ImapListing::indexOfUid (uint uid) const {
+    if (d->uidsSorted) {
+        QVector<uint>::const_iterator it = qBinaryFind(d->uids.constBegin(), d->uids.constEnd(), uid);
+        return(it != d->uids.constEnd() ? (it - d->uids.constBegin()) : -1);
+    }
+    return(d->uids.indexOf(uid));
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+ImapListing::Fields ImapListing::fields (void) const {
+    return(d->fields);
+}
+
+bool ImapListing::hasField (Field field) const {
+    return((d->fields & field) != 0);
+}
+
+int ImapListing::count (void) const {
+    return(d->ids.size());
+}
+
+bool ImapListing::isEmpty (void) const {
+    return(d->ids.isEmpty());
+}
+
+int ImapListing::id (int index) const {
+    return(d->ids[index]);
+}
+
+uint ImapListing::uid (int index) const {
+    return((d->fields & Uid) ? d->uids[index] : 0);
+}
+
+ImapMessageFlags ImapListing::flags (int index) const {
+    return((d->fields & Flags) ? d->flags[index] : 0);
+}
+
+void ImapListing::setFlags (int index, ImapMessageFlags flags) {
+    if (d->fields & Flags)
+        d->flags[index] = flags;
+}
+
+int ImapListing::size (int index) const {
+    return((d->fields & Size) ? d->sizes[index] : 0);
+}
+
+QDateTime ImapListing::received (int index) const {
+    if (!(d->fields & InternalDate))
+        return(QDateTime());
+    return(QDateTime::fromTime_t(d->dates[index]));
+}
+
+QString ImapListing::subject (int index) const {
+    return(ImapCodec::decodeHeader(d->string(index, LISTING_STRING_SUBJECT)));
+}
+
+ImapAddress ImapListing::fromAddress (int index) const {
+    if (!(d->fields & From))
+        return(ImapAddress());
+
+    ImapAddress address(QString::fromLatin1(d->string(index, LISTING_STRING_FROM_ADDRESS)));
+    QByteArray name = d->string(index, LISTING_STRING_FROM_NAME);
+    if (!name.isEmpty())
+        address.setDisplayName(ImapCodec::decodeHeader(name));
+    return(address);
+}
+
+QString ImapListing::messageId (int index) const {
+    return(QString::fromLatin1(d->string(index, LISTING_STRING_MESSAGE_ID)));
+}
+
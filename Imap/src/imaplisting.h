@@ -0,0 +1,73 @@
+#ifndef _IMAP_LISTING_H_
+#define _IMAP_LISTING_H_
+
+#include <QDateTime>
+#include <QString>
+
+#include "imapmessage.h"
+#include "imapaddress.h"
+
+/**
+ * Compact, column oriented listing of a mailbox.
+ *
+ * Only the requested fields are fetched and stored: one array per column
+ * (ids, UIDs, flag bitsets, sizes, dates) plus a shared string pool for
+ * the text columns. ImapMessage objects are built only on demand.
+ */
+class ImapListingPrivate;
+class ImapListing {
+    public:
+        enum Field {
+            Uid             = 0x01,
+            Flags           = 0x02,
+            Size            = 0x04,
+            InternalDate    = 0x08,
+            Subject         = 0x10,
+            From            = 0x20,
+            MessageId       = 0x40,
+            AllFields       = 0x7f
+        };
+        typedef uint Fields;
+
+    public:
+        ImapListing (Fields fields = Uid | Flags);
+        ~ImapListing();
+
+        // Methods
+        void clear (void);
+        void reserve (int size);
+        void squeeze (void);
+
+        QString fetchItems (void) const;
+        bool appendFetchResponse (const QByteArray& response);
+
+        ImapMessage *message (int index) const;
+
+        int indexOfId (int id) const;
+        int indexOfUid (uint uid) const;
+
+        // Properties
+        Fields fields (void) const;
+        bool hasField (Field field) const;
+
+        int count (void) const;
+        bool isEmpty (void) const;
+
+        int id (int index) const;
+        uint uid (int index) const;
+        ImapMessageFlags flags (int index) const;
+        void setFlags (int index, ImapMessageFlags flags);
+        int size (int index) const;
+        QDateTime received (int index) const;
+        QString subject (int index) const;
+        ImapAddress fromAddress (int index) const;
+        QString messageId (int index) const;
+
+    private:
+        Q_DISABLE_COPY(ImapListing)
+
+        ImapListingPrivate *d;
+};
+
+#endif /* !_IMAP_LISTING_H_ */
+
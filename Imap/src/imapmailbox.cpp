@@ -1,5 +1,7 @@
 #include <QString>
+#include <QHash>
 
+#include "imapaddress.h"
 #include "imapmailbox.h"
 
 // ===========================================================================
@@ -7,15 +9,88 @@
 // ===========================================================================
 class ImapMailboxPrivate {
     public:
+        QHash<uint, ImapMessage *> uidIndex;
+        QHash<int, ImapMessage *> idIndex;
+        QHash<QString, QString> strings;
         QList<ImapMessage *> messages;
         ImapMessageFlags flags;
+        quint64 highestModSeq;
+        quint32 uidValidity;
+        quint32 uidNext;
         bool readWrite;
         QString name;
         int unseen;
         int recent;
         int exists;
+
+        ImapAddressTable addresses;
+
+    public:
+        void index (ImapMessage *message);
+        void unindex (ImapMessage *message);
+
+        void intern (ImapMessage *message);
+        QString internString (const QString& text);
+        ImapAddress internAddress (const ImapAddress& address);
+        QList<ImapAddress> internAddresses (const QList<ImapAddress>& addresses);
 };
 
+void ImapMailboxPrivate::index (ImapMessage *message) {
+    if (message->id() > 0)
+        idIndex.insert(message->id(), message);
+
+    uint uid = message->uid().toUInt();
+    if (uid != 0)
+        uidIndex.insert(uid, message);
+}
+
+void ImapMailboxPrivate::unindex (ImapMessage *message) {
+    if (idIndex.value(message->id()) == message)
+        idIndex.remove(message->id());
+
+    uint uid = message->uid().toUInt();
+    if (uidIndex.value(uid) == message)
+        uidIndex.remove(uid);
+}
+
+/* Share the values repeated across messages. */
+void ImapMailboxPrivate::intern (ImapMessage *message) {
+    if (!message->timeZone().isEmpty())
+        message->setTimeZone(internString(message->timeZone()));
+
+    message->setFromAddress(internAddress(message->fromAddress()));
+    message->setSenderAddress(internAddress(message->senderAddress()));
+    if (!message->toAddresses().isEmpty())
+        message->setToAddresses(internAddresses(message->toAddresses()));
+    if (!message->ccAddresses().isEmpty())
+        message->setCcAddresses(internAddresses(message->ccAddresses()));
+    if (!message->bccAddresses().isEmpty())
+        message->setBccAddresses(internAddresses(message->bccAddresses()));
+    if (!message->replyAddresses().isEmpty())
+        message->setReplyAddresses(internAddresses(message->replyAddresses()));
+}
+
+QString ImapMailboxPrivate::internString (const QString& text) {
+    QHash<QString, QString>::const_iterator it = strings.find(text);
+    if (it != strings.constEnd())
+        return(it.value());
+
+    strings.insert(text, text);
+    return(text);
+}
+
+ImapAddress ImapMailboxPrivate::internAddress (const ImapAddress& address) {
+    return(addresses.intern(address));
+}
+
+QList<ImapAddress> ImapMailboxPrivate::internAddresses (const QList<ImapAddress>& list) {
+    QList<ImapAddress> interned;
+    interned.reserve(list.size());
+    foreach (const ImapAddress& address, list)
+        interned.append(internAddress(address));
+    return(interned);
+}
+
 // ===========================================================================
 //  PUBLIC Constructors/Destructor
 // ===========================================================================
@@ -23,6 +98,8 @@ ImapMailbox::ImapMailbox()
     : d(new ImapMailboxPrivate)
 {
     d->unseen = d->exists = d->recent = 0;
+    d->uidValidity = d->uidNext = 0;
+    d->highestModSeq = 0;
     d->readWrite = false;
     d->flags = 0;
 }
@@ -31,6 +108,8 @@ ImapMailbox::ImapMailbox (const QString& mailbox)
     : d(new ImapMailboxPrivate)
 {
     d->unseen = d->exists = d->recent = 0;
+    d->uidValidity = d->uidNext = 0;
+    d->highestModSeq = 0;
     d->readWrite = false;
     d->name = mailbox;
     d->flags = 0;
@@ -44,16 +123,61 @@ ImapMailbox::~ImapMailbox() {
 // ===========================================================================
 //  PUBLIC Methods 
 // ===========================================================================
+/**
+ * Reserve room for the messages about to be added (e.g. EXISTS).
+ */
+void ImapMailbox::reserve (int messages) {
+    d->messages.reserve(messages);
+    d->idIndex.reserve(messages);
+    d->uidIndex.reserve(messages);
+}
+
+/**
+ * Add a message, the mailbox takes ownership.
+ */
 void ImapMailbox::addMessage (ImapMessage *message) {
+    d->intern(message);
+    d->index(message);
     d->messages.append(message);
 }
 
-void ImapMailbox::clearMessages (void) {
-    QList<ImapMessage *>::iterator it = d->messages.begin();
-    while (it != d->messages.end()) {
-        delete *it;
-        it = d->messages.erase(it);
+/**
+ * Apply an untagged "* n EXPUNGE": delete message n, if it was added,
+ * and renumber the messages after it as the server did. Exists is
+ * decremented.
+ */
+void ImapMailbox::expunge (int messageId) {
+    ImapMessage *message = d->idIndex.value(messageId, NULL);
+    if (message != NULL) {
+        d->unindex(message);
+        d->messages.removeOne(message);
+        delete message;
+    }
+
+    // Unindex all the shifted ids before reindexing any of them.
+    QList<ImapMessage *> shifted;
+    foreach (ImapMessage *current, d->messages) {
+        if (current->id() > messageId) {
+            d->idIndex.remove(current->id());
+            shifted.append(current);
+        }
     }
+    foreach (ImapMessage *current, shifted) {
+        current->setId(current->id() - 1);
+        d->idIndex.insert(current->id(), current);
+    }
+
+    if (d->exists > 0)
+        d->exists--;
+}
+
+void ImapMailbox::clearMessages (void) {
+    qDeleteAll(d->messages);
+    d->messages.clear();
+    d->uidIndex.clear();
+    d->idIndex.clear();
+    d->addresses.clear();
+    d->strings.clear();
 }
 
 // ===========================================================================
@@ -93,6 +217,31 @@ void ImapMailbox::setUnseen (int unseen) {
     d->unseen = unseen;
 }
 
+quint32 ImapMailbox::uidValidity (void) const {
+    return(d->uidValidity);
+}
+
+void ImapMailbox::setUidValidity (quint32 uidValidity) {
+    d->uidValidity = uidValidity;
+}
+
+quint32 ImapMailbox::uidNext (void) const {
+    return(d->uidNext);
+}
+
+void ImapMailbox::setUidNext (quint32 uidNext) {
+    d->uidNext = uidNext;
+}
+
+/** Zero if the server doesn't support CONDSTORE (or reported NOMODSEQ). */
+quint64 ImapMailbox::highestModSeq (void) const {
+    return(d->highestModSeq);
+}
+
+void ImapMailbox::setHighestModSeq (quint64 modSeq) {
+    d->highestModSeq = modSeq;
+}
+
 bool ImapMailbox::isReadWrite (void) const {
     return(d->readWrite);
 }
@@ -114,8 +263,17 @@ void ImapMailbox::setFlags (ImapMessageFlags flags) {
     d->flags = flags;
 }
 
+int ImapMailbox::count (void) const {
+    return(d->messages.size());
+}
+
+/**
+ * Remove the message at index, the caller takes ownership.
+ */
 ImapMessage *ImapMailbox::takeAt (int index) {
-    return(d->messages.takeAt(index));
+    ImapMessage *message = d->messages.takeAt(index);
+    d->unindex(message);
+    return(message);
 }
 
 ImapMessage *ImapMailbox::at (int index) const {
@@ -127,10 +285,17 @@ QList<ImapMessage *> ImapMailbox::messages (void) const {
 }
 
 ImapMessage *ImapMailbox::findById (int messageId) const {
-    foreach (ImapMessage *message, d->messages) {
-        if (message->id() == messageId)
-            return(message);
-    }
-    return(NULL);
+    return(d->idIndex.value(messageId, NULL));
+}
+
+ImapMessage *ImapMailbox::findByUid (uint uid) const {
+    return(d->uidIndex.value(uid, NULL));
+}
+
+/**
+ * Addresses of the messages, to parse new envelopes against.
+ */
+ImapAddressTable *ImapMailbox::addressTable (void) const {
+    return(&(d->addresses));
 }
 
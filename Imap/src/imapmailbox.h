@@ -4,6 +4,16 @@
 #include <QList>
 #include "imapmessage.h"
 
+class ImapAddressTable;
+
+/**
+ * Selected mailbox status and its messages (owned).
+ * Messages are indexed by id and UID when added: set them first.
+ * Pass expunges on to expunge() (e.g. ImapIdleWatcher::expunged())
+ * to keep the ids in step with the server.
+ * Addresses and time zones repeated across messages are shared.
+ */
+
 class ImapMailboxPrivate;
 class ImapMailbox {
     public:
@@ -12,7 +22,9 @@ class ImapMailbox {
         ~ImapMailbox();
 
         // Methods
+        void reserve (int messages);
         void addMessage (ImapMessage *message);
+        void expunge (int messageId);
         void clearMessages (void);
         
         // Properties
@@ -28,6 +40,15 @@ class ImapMailbox {
         int unseen (void) const;
         void setUnseen (int unseen);
 
+        quint32 uidValidity (void) const;
+        void setUidValidity (quint32 uidValidity);
+
+        quint32 uidNext (void) const;
+        void setUidNext (quint32 uidNext);
+
+        quint64 highestModSeq (void) const;
+        void setHighestModSeq (quint64 modSeq);
+
         bool isReadWrite (void) const;
         void setReadWrite (bool readWrite);
                 
@@ -35,12 +56,18 @@ class ImapMailbox {
         void setFlags (const QString& flags);
         void setFlags (ImapMessageFlags flags);
         
+        int count (void) const;
         ImapMessage *takeAt (int index);
         ImapMessage *at (int index) const;
         QList<ImapMessage *> messages (void) const;
         ImapMessage *findById (int messageId) const;
+        ImapMessage *findByUid (uint uid) const;
+
+        ImapAddressTable *addressTable (void) const;
 
     private:
+        Q_DISABLE_COPY(ImapMailbox)
+
         ImapMailboxPrivate *d;
 };
 
@@ -0,0 +1,137 @@
+#include <QTimer>
+
+#include "imappagedmailbox.h"
+#include "imapmailboxmodel.h"
+#include "imapsequenceset.h"
+#include "imapaddress.h"
+#include "imapmessage.h"
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapMailboxModelPrivate {
+    public:
+        ImapPagedMailbox *mailbox;
+
+        // Rows asked for while not loaded, fetched by fetchPending()
+        // a run at a time: distant runs don't pull the rows between.
+        ImapSequenceSet pendingRows;
+        bool scheduled;
+};
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+/**
+ * The mailbox is not owned, call refresh() after opening it again.
+ */
+ImapMailboxModel::ImapMailboxModel (ImapPagedMailbox *mailbox, QObject *parent)
+    : QAbstractTableModel(parent), d(new ImapMailboxModelPrivate)
+{
+    d->mailbox = mailbox;
+    d->scheduled = false;
+}
+
+ImapMailboxModel::~ImapMailboxModel() {
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+ImapPagedMailbox *ImapMailboxModel::mailbox (void) const {
+    return(d->mailbox);
+}
+
+int ImapMailboxModel::rowCount (const QModelIndex& parent) const {
+    return(parent.isValid() ? 0 : d->mailbox->count());
+}
+
+int ImapMailboxModel::columnCount (const QModelIndex& parent) const {
+    return(parent.isValid() ? 0 : ColumnCount);
+}
+
+QVariant ImapMailboxModel::data (const QModelIndex& index, int role) const {
+    if (!index.isValid())
+        return(QVariant());
+
+    int row = index.row();
+    if (!d->mailbox->isLoaded(row)) {
+        d->pendingRows.add(row);
+
+        if (!d->scheduled) {
+            d->scheduled = true;
+            QTimer::singleShot(0, const_cast<ImapMailboxModel *>(this), SLOT(fetchPending()));
+        }
+        return(QVariant());
+    }
+
+    ImapMessage *message = d->mailbox->cachedMessage(row);
+    if (message == NULL)
+        return(QVariant());
+
+    switch (role) {
+        case Qt::DisplayRole:
+            switch (index.column()) {
+                case SubjectColumn: return(message->subject());
+                case FromColumn:    return(message->fromAddress().toString());
+                case DateColumn:    return(message->sent());
+                case SizeColumn:    return(message->size());
+            }
+            break;
+        case UidRole:
+            return(message->uid().toUInt());
+        case FlagsRole:
+            return(message->flags());
+    }
+    return(QVariant());
+}
+
+QVariant ImapMailboxModel::headerData (int section,
+                                       Qt::Orientation orientation,
+                                       int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return(QVariant());
+
+    switch (section) {
+        case SubjectColumn: return(tr("Subject"));
+        case FromColumn:    return(tr("From"));
+        case DateColumn:    return(tr("Date"));
+        case SizeColumn:    return(tr("Size"));
+    }
+    return(QVariant());
+}
+
+// ===========================================================================
+//  PUBLIC Slots
+// ===========================================================================
+/**
+ * The mailbox was opened again: rows and messages changed.
+ */
+void ImapMailboxModel::refresh (void) {
+    beginResetModel();
+    d->pendingRows.clear();
+    endResetModel();
+}
+
+// ===========================================================================
+//  PRIVATE Slots
+// ===========================================================================
+void ImapMailboxModel::fetchPending (void) {
+    ImapSequenceSet rows = d->pendingRows;
+    d->pendingRows.clear();
+    d->scheduled = false;
+
+    for (int i = 0; i < rows.rangeCount(); ++i) {
+        int first = rows.rangeFirst(i);
+        int last = rows.rangeLast(i);
+        if (last >= d->mailbox->count())
+            break;
+
+        // On failure, wait for the view to ask again rather than retry now.
+        if (!d->mailbox->fetchRows(first, last))
+            continue;
+        emit dataChanged(index(first, 0), index(last, ColumnCount - 1));
+    }
+}
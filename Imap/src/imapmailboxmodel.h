@@ -0,0 +1,60 @@
+#ifndef _IMAP_MAILBOX_MODEL_H_
+#define _IMAP_MAILBOX_MODEL_H_
+
+#include <QAbstractTableModel>
+
+class ImapPagedMailbox;
+class ImapMailboxModelPrivate;
+
+/**
+ * Item model over an ImapPagedMailbox, a row per message.
+ *
+ * Rows not loaded yet have no data: the rows a view asks for are
+ * collected and fetched once control returns to the event loop, each
+ * run of consecutive rows on its own, then dataChanged() is emitted. Only the visible rows are ever requested,
+ * so opening a large folder costs one SELECT.
+ */
+class ImapMailboxModel : public QAbstractTableModel {
+    Q_OBJECT
+
+    public:
+        enum Column {
+            SubjectColumn,
+            FromColumn,
+            DateColumn,
+            SizeColumn,
+            ColumnCount
+        };
+
+        enum Role {
+            UidRole = Qt::UserRole,
+            FlagsRole
+        };
+
+    public:
+        ImapMailboxModel (ImapPagedMailbox *mailbox, QObject *parent = 0);
+        ~ImapMailboxModel();
+
+        ImapPagedMailbox *mailbox (void) const;
+
+        int rowCount (const QModelIndex& parent = QModelIndex()) const;
+        int columnCount (const QModelIndex& parent = QModelIndex()) const;
+
+        QVariant data (const QModelIndex& index, int role = Qt::DisplayRole) const;
+        QVariant headerData (int section,
+                             Qt::Orientation orientation,
+                             int role = Qt::DisplayRole) const;
+
+    public Q_SLOTS:
+        void refresh (void);
+
+    private Q_SLOTS:
+        void fetchPending (void);
+
+    private:
+        Q_DISABLE_COPY(ImapMailboxModel)
+
+        ImapMailboxModelPrivate *d;
+};
+
+#endif /* !_IMAP_MAILBOX_MODEL_H_ */
@@ -1,58 +1,26 @@
 #include <QStringList>
 #include <QSharedData>
+#include <QMutex>
 
+#include <string.h>
+
+#include "imapbodystructure.h"
 #include "imapmessage.h"
 #include "imapaddress.h"
+#include "imapparser.h"
 #include "imap.h"
 
 // ===========================================================================
-//  PRIVATE Functions
+//  PRIVATE Keyword Table
 // ===========================================================================
-static QList<ImapAddress> _createAddressList (const QString& addresses) {
-    QList<ImapAddress> list;
-
-    QRegExp rx("(NIL|\\\".+\\\")\\s+(NIL|\\\".+\\\")\\s+(NIL|\\\".+\\\")\\s+(NIL|\\\".+\\\")\\)");
-
-    QStringList addressList = addresses.split('(', QString::SkipEmptyParts);
-    foreach (QString address, addressList) {
-        if (rx.indexIn(address) == -1)
-            continue;
-
-        QString hostName = rx.cap(4);
-        QString mailboxName = rx.cap(3);
-        if (mailboxName == "NIL" && hostName == "NIL")
-            continue;
-
-        QString email;
-        if (mailboxName == "NIL")
-            email = QString("unknown@%1").arg(hostName);
-        else if (hostName == "NIL")
-            email = QString("%1@unknown").arg(mailboxName);
-        else
-            email = QString("%1@%2").arg(mailboxName).arg(hostName);
-
-        // Create new ImapAddress
-        ImapAddress imapAddress(email.replace("\"", ""));
-
-        // Setup Personal Name (Display Name)
-        QString personalName = rx.cap(1);
-        if (personalName != "NIL") {
-            personalName.replace("\"", "");
-            imapAddress.setDisplayName(Imap::decode(personalName));
-        }
-
-        // Setup SMTP Domain
-        QString smtpDomain = rx.cap(2);
-        if (smtpDomain != "NIL") {
-            smtpDomain.replace("\"", "");
-            imapAddress.setSmtpDomain(Imap::decode(smtpDomain));
-        }
-
-        list.append(imapAddress);
-    }
+/* Interned keywords, shared by every connection: the keyword at index i
+ * is the bit (ImapMessageFirstKeyword << i). Entries are never removed,
+ * only keywords set on messages are interned. */
+typedef QList<QByteArray> ImapKeywordTable;
+Q_GLOBAL_STATIC(ImapKeywordTable, _imapKeywords)
+static QMutex _imapKeywordsMutex;
 
-    return(list);
-}
+#define IMAP_MESSAGE_MAX_KEYWORDS       (26)
 
 // ===========================================================================
 //  PRIVATE Class
@@ -70,6 +38,7 @@ class ImapMessageBodyPartPrivate {
         QString bodyPart;
 
         bool isAttachment;
+        bool isPartial;
         QByteArray data;
         quint32 lines;
         quint32 size;
@@ -82,6 +51,8 @@ class ImapMessageBodyPartPrivate {
         QString parseCharset (const QString& text) const;
         QString parseFileName (const QString& text) const;
         ImapMessageBodyPart::Encoding parseEncoding (const QString& text) const;
+
+        static ImapMessageBodyPart::Encoding encodingFromName (const QString& name);
 };
 
 QString ImapMessageBodyPartPrivate::parseNil (const QString& text) const {
@@ -106,11 +77,17 @@ QString ImapMessageBodyPartPrivate::parseFileName (const QString& text) const {
     return(QString());
 }
 
-// None, Unknown, Utf7, Utf8, Base64, QuotedPrintable
 ImapMessageBodyPart::Encoding ImapMessageBodyPartPrivate::parseEncoding (
     const QString& text) const
 {
-    QString data = parseNilAndQuote(text).toUpper();
+    return(encodingFromName(parseNilAndQuote(text)));
+}
+
+// None, Unknown, Utf7, Utf8, Base64, QuotedPrintable
+ImapMessageBodyPart::Encoding ImapMessageBodyPartPrivate::encodingFromName (
+    const QString& name)
+{
+    QString data = name.toUpper();
     if (data.isEmpty())
         return(ImapMessageBodyPart::UnknownEncoding);
 
@@ -139,6 +116,8 @@ ImapMessageBodyPart::Encoding ImapMessageBodyPartPrivate::parseEncoding (
 ImapMessageBodyPart::ImapMessageBodyPart(const QString& data)
     : d(new ImapMessageBodyPartPrivate)
 {
+    d->isPartial = false;
+
     QRegExp rxNonAttachment("^\\((\"[^\"]*\"|NIL)\\s+(\"[^\"]*\"|NIL)"
             "\\s+(\\(.*\\)|NIL)\\s+(\"[^\"]*\"|NIL)\\s+(\"[^\"]*\"|NIL)"
             "\\s+(\"[^\"]*\"|NIL)\\s+(\\d+|NIL)\\s+(\\d+|NIL)"
@@ -187,6 +166,29 @@ ImapMessageBodyPart::ImapMessageBodyPart(const QString& data)
     }
 }
 
+/**
+ * Body part of a (non-multipart) node of the parsed BODYSTRUCTURE.
+ */
+ImapMessageBodyPart::ImapMessageBodyPart(const ImapBodyStructure *structure)
+    : d(new ImapMessageBodyPartPrivate)
+{
+    d->isPartial = false;
+    d->contentType = structure->mimeType();
+    d->charset = structure->charset();
+    d->fileName = structure->fileName();
+    d->isAttachment = structure->isAttachment();
+
+    d->contentId = structure->contentId();
+    d->contentDescription = structure->contentDescription();
+    d->encoding = d->encodingFromName(structure->encoding());
+    d->size = structure->size();
+    d->lines = structure->lines();
+    d->md5 = structure->md5();
+    d->disposition = structure->disposition();
+    d->language = structure->language();
+    d->bodyPart = structure->section();
+}
+
 ImapMessageBodyPart::~ImapMessageBodyPart() {
     delete d;
 }
@@ -203,8 +205,20 @@ QByteArray ImapMessageBodyPart::data (void) const {
     return(d->data);
 }
 
-void ImapMessageBodyPart::setData (const QByteArray& data) {
+/**
+ * Set the (decoded) data, complete unless marked partial.
+ */
+void ImapMessageBodyPart::setData (const QByteArray& data, bool partial) {
     d->data = data;
+    d->isPartial = partial;
+}
+
+/**
+ * True if data() is only the beginning of the part, e.g. a preview
+ * fetched by Imap::fetchBodies() with maxBytes.
+ */
+bool ImapMessageBodyPart::isPartial (void) const {
+    return(d->isPartial);
 }
 
 ImapMessageBodyPart::Encoding ImapMessageBodyPart::encoding (void) const {
@@ -266,6 +280,7 @@ QString ImapMessageBodyPart::contentDescription (void) const {
 class ImapMessagePrivate {
     public:
         QList<ImapMessageBodyPart *> bodyParts;
+        ImapBodyStructure *bodyStructure;
 
         QList<ImapAddress> replyAddresses;
         QList<ImapAddress> bccAddresses;
@@ -297,6 +312,7 @@ ImapMessage::ImapMessage()
     d->id = -1;
     d->flags = 0;
     d->htmlPartIndex = d->textPartIndex = -1;
+    d->bodyStructure = NULL;
 }
 
 ImapMessage::~ImapMessage() {
@@ -305,6 +321,7 @@ ImapMessage::~ImapMessage() {
         delete *it;
         it = d->bodyParts.erase(it);
     }
+    delete d->bodyStructure;
     delete d;
 }
 
@@ -329,11 +346,99 @@ ImapMessageFlags ImapMessage::parseFlags (const QString& textFlags) {
             flags |= ImapMessageRecent;
         else if (flag == "\\Seen")
             flags |= ImapMessageSeen;
+        else if (!flag.startsWith('\\'))
+            flags |= keywordFlag(flag.toLatin1());
     }
 
     return(flags);
 }
 
+/**
+ * Flag list as sent to the server, "\Seen \Flagged".
+ * \Recent is left out, the server sets it.
+ */
+QString ImapMessage::flagsString (ImapMessageFlags flags) {
+    QStringList flagList;
+    if (flags & ImapMessageAnswered) flagList << "\\Answered";
+    if (flags & ImapMessageDeleted) flagList << "\\Deleted";
+    if (flags & ImapMessageDraft) flagList << "\\Draft";
+    if (flags & ImapMessageFlagged) flagList << "\\Flagged";
+    if (flags & ImapMessageSeen) flagList << "\\Seen";
+
+    for (uint bit = ImapMessageFirstKeyword; bit != 0; bit <<= 1) {
+        if (flags & bit)
+            flagList << QString::fromLatin1(keywordName(bit));
+    }
+    return(flagList.join(" "));
+}
+
+/**
+ * The bit of keyword, interned on first use. Keywords compare case
+ * insensitively. Returns 0 for an invalid keyword (see isValidKeyword())
+ * or once the table is full: storeFlags() then fails, and parsers
+ * report the keywords they had to drop.
+ */
+ImapMessageFlags ImapMessage::keywordFlag (const QByteArray& keyword) {
+    if (!isValidKeyword(keyword))
+        return(0);
+
+    QMutexLocker locker(&_imapKeywordsMutex);
+    ImapKeywordTable *table = _imapKeywords();
+    for (int i = 0; i < table->size(); ++i) {
+        if (qstricmp(table->at(i).constData(), keyword.constData()) == 0)
+            return((uint)ImapMessageFirstKeyword << i);
+    }
+
+    if (table->size() >= IMAP_MESSAGE_MAX_KEYWORDS)
+        return(0);
+
+    table->append(keyword);
+    return((uint)ImapMessageFirstKeyword << (table->size() - 1));
+}
+
+/**
+ * The bit of an already interned keyword, 0 if it isn't. For keyword
+ * lists that shouldn't take table entries, like a mailbox FLAGS.
+ */
+ImapMessageFlags ImapMessage::findKeyword (const QByteArray& keyword) {
+    QMutexLocker locker(&_imapKeywordsMutex);
+    const ImapKeywordTable *table = _imapKeywords();
+    for (int i = 0; i < table->size(); ++i) {
+        if (qstricmp(table->at(i).constData(), keyword.constData()) == 0)
+            return((uint)ImapMessageFirstKeyword << i);
+    }
+    return(0);
+}
+
+/**
+ * The keyword of a single keyword bit, empty if none.
+ */
+QByteArray ImapMessage::keywordName (ImapMessageFlags flag) {
+    QMutexLocker locker(&_imapKeywordsMutex);
+    const ImapKeywordTable *table = _imapKeywords();
+    for (int i = 0; i < table->size(); ++i) {
+        if (flag == ((uint)ImapMessageFirstKeyword << i))
+            return(table->at(i));
+    }
+    return(QByteArray());
+}
+
+/**
+ * A keyword is an atom (RFC 3501): no spaces, controls or any
+ * of ( ) { % * " ] \ characters (\ starts system flags).
+ */
+bool ImapMessage::isValidKeyword (const QByteArray& keyword) {
+    if (keyword.isEmpty())
+        return(false);
+
+    for (int i = 0; i < keyword.size(); ++i) {
+        uchar c = (uchar)keyword[i];
+        if (c <= 0x20 || c >= 0x7f || strchr("(){%*\"]\\", c) != NULL)
+            return(false);
+    }
+    return(true);
+}
+
 // ===========================================================================
 //  PUBLIC Properties
 // ===========================================================================
@@ -442,90 +547,87 @@ ImapAddress ImapMessage::fromAddress (void) const {
     return(d->fromAddress);
 }
 
+void ImapMessage::setFromAddress (const ImapAddress& address) {
+    d->fromAddress = address;
+}
+
 ImapAddress ImapMessage::senderAddress (void) const {
     return(d->senderAddress);
 }
 
+void ImapMessage::setSenderAddress (const ImapAddress& address) {
+    d->senderAddress = address;
+}
+
 QList<ImapAddress> ImapMessage::toAddresses (void) const {
     return(d->toAddresses);
 }
 
+void ImapMessage::setToAddresses (const QList<ImapAddress>& addresses) {
+    d->toAddresses = addresses;
+}
+
 QList<ImapAddress> ImapMessage::ccAddresses (void) const {
     return(d->ccAddresses);
 }
 
+void ImapMessage::setCcAddresses (const QList<ImapAddress>& addresses) {
+    d->ccAddresses = addresses;
+}
+
 QList<ImapAddress> ImapMessage::bccAddresses (void) const {
     return(d->bccAddresses);
 }
 
+void ImapMessage::setBccAddresses (const QList<ImapAddress>& addresses) {
+    d->bccAddresses = addresses;
+}
+
 QList<ImapAddress> ImapMessage::replyAddresses (void) const {
     return(d->replyAddresses);
 }
 
-void ImapMessage::setAddresses (const QString& fullAddresses) {
-    QString addresses = fullAddresses;
-    QString addressList;
-    int index;
-
-    // From Address
-    if (addresses.startsWith("NIL")) {
-        addresses = addresses.remove(0, 3).trimmed();
-    } else {
-        index = addresses.indexOf("))") + 2;
-        addressList = addresses.mid(0, index);
-        addresses = addresses.mid(addressList.size()).trimmed();
-        d->fromAddress = _createAddressList(addressList).takeFirst();
-    }
-
-    // Sender Address
-    if (addresses.startsWith("NIL")) {
-        addresses = addresses.remove(0, 3).trimmed();
-    } else {
-        index = addresses.indexOf("))") + 2;
-        addressList = addresses.mid(0, index);
-        addresses = addresses.mid(addressList.size()).trimmed();
-        d->senderAddress = _createAddressList(addressList).takeFirst();
-    }
-
-    // ReplyTo Address
-    if (addresses.startsWith("NIL")) {
-        addresses = addresses.remove(0, 3).trimmed();
-    } else {
-        index = addresses.indexOf("))") + 2;
-        addressList = addresses.mid(0, index);
-        addresses = addresses.mid(addressList.size()).trimmed();
-        d->replyAddresses = _createAddressList(addressList);
-    }
-
-    // To Address
-    if (addresses.startsWith("NIL")) {
-        addresses = addresses.remove(0, 3).trimmed();
-    } else {
-        index = addresses.indexOf("))") + 2;
-        addressList = addresses.mid(0, index);
-        addresses = addresses.mid(addressList.size()).trimmed();
-        d->toAddresses = _createAddressList(addressList);
-    }
-
-    // CC Address
-    if (addresses.startsWith("NIL")) {
-        addresses = addresses.remove(0, 3).trimmed();
-    } else {
-        index = addresses.indexOf("))") + 2;
-        addressList = addresses.mid(0, index);
-        addresses = addresses.mid(addressList.size()).trimmed();
-        d->ccAddresses = _createAddressList(addressList);
-    }
-
-    // BCC Address
-    if (addresses.startsWith("NIL")) {
-        addresses = addresses.remove(0, 3).trimmed();
-    } else {
-        index = addresses.indexOf("))") + 2;
-        addressList = addresses.mid(0, index);
-        addresses = addresses.mid(addressList.size()).trimmed();
-        d->bccAddresses = _createAddressList(addressList);
-    }
+void ImapMessage::setReplyAddresses (const QList<ImapAddress>& addresses) {
+    d->replyAddresses = addresses;
+}
+
+/**
+ * Set the addresses from the address lists of an ENVELOPE, from
+ * "From" to "Bcc", read in one pass. Repeated addresses are shared
+ * through the table, a temporary one if NULL.
+ * Returns false if the lists are malformed, keeping those read.
+ */
+bool ImapMessage::setAddresses (const QString& addresses, ImapAddressTable *table) {
+    ImapParser parser(addresses.toLatin1());
+    return(setAddresses(&parser, table));
+}
+
+/**
+ * Read the address lists in place, the parser being on the "From" list
+ * of an ENVELOPE. It is left after the "Bcc" list.
+ */
+bool ImapMessage::setAddresses (ImapParser *parser, ImapAddressTable *table) {
+    ImapAddressTable localTable;
+    if (table == NULL)
+        table = &localTable;
+
+    QList<ImapAddress> from, sender, reply, to, cc, bcc;
+    bool ok = table->readList(parser, &from) &&
+              table->readList(parser, &sender) &&
+              table->readList(parser, &reply) &&
+              table->readList(parser, &to) &&
+              table->readList(parser, &cc) &&
+              table->readList(parser, &bcc);
+
+    if (!from.isEmpty())
+        d->fromAddress = from.first();
+    if (!sender.isEmpty())
+        d->senderAddress = sender.first();
+    d->replyAddresses = reply;
+    d->toAddresses = to;
+    d->ccAddresses = cc;
+    d->bccAddresses = bcc;
+    return(ok);
 }
 
 bool ImapMessage::hasHtmlPart (void) const {
@@ -580,4 +682,15 @@ void ImapMessage::setBodyParts (const QList<ImapMessageBodyPart *> parts) {
     d->bodyParts = parts;
 }
 
+/**
+ * MIME tree of the message, if fetched. The message takes ownership.
+ */
+ImapBodyStructure *ImapMessage::bodyStructure (void) const {
+    return(d->bodyStructure);
+}
 
+void ImapMessage::setBodyStructure (ImapBodyStructure *structure) {
+    if (d->bodyStructure != structure)
+        delete d->bodyStructure;
+    d->bodyStructure = structure;
+}
@@ -4,17 +4,22 @@
 #include <QtGlobal>
 #include <QDateTime>
 
+/* System flags take the low bits, keywords ("$Forwarded") the ones
+ * from ImapMessageFirstKeyword up, see ImapMessage::keywordFlag(). */
 typedef uint ImapMessageFlags;
 typedef enum {
-    None                   = 0,
-    ImapMessageAnswered    = 1,
-    ImapMessageDeleted     = 2,
-    ImapMessageDraft       = 4,
-    ImapMessageFlagged     = 8,
-    ImapMessageRecent      = 16,
-    ImapMessageSeen        = 32
+    None                    = 0,
+    ImapMessageAnswered     = 1,
+    ImapMessageDeleted      = 2,
+    ImapMessageDraft        = 4,
+    ImapMessageFlagged      = 8,
+    ImapMessageRecent       = 16,
+    ImapMessageSeen         = 32,
+    ImapMessageSystemFlags  = 63,
+    ImapMessageFirstKeyword = 64
 } ImapMessageFlag;
 
+class ImapBodyStructure;
 class ImapMessageBodyPartPrivate;
 class ImapMessageBodyPart {
     public:
@@ -26,10 +31,12 @@ class ImapMessageBodyPart {
 
     public:
         ImapMessageBodyPart(const QString& data);
+        ImapMessageBodyPart(const ImapBodyStructure *structure);
         ~ImapMessageBodyPart();
 
         QByteArray data (void) const;
-        void setData (const QByteArray& data);
+        void setData (const QByteArray& data, bool partial = false);
+        bool isPartial (void) const;
 
         Encoding encoding (void) const;
 
@@ -56,7 +63,9 @@ class ImapMessageBodyPart {
         ImapMessageBodyPartPrivate *d;
 };
 
+class ImapAddressTable;
 class ImapAddress;
+class ImapParser;
 class ImapMessagePrivate;
 class ImapMessage {
     public:
@@ -65,6 +74,11 @@ class ImapMessage {
         
         // STATIC Methods
         static ImapMessageFlags parseFlags (const QString& textFlags);
+        static QString flagsString (ImapMessageFlags flags);
+        static ImapMessageFlags keywordFlag (const QByteArray& keyword);
+        static ImapMessageFlags findKeyword (const QByteArray& keyword);
+        static QByteArray keywordName (ImapMessageFlags flag);
+        static bool isValidKeyword (const QByteArray& keyword);
 
         // Properties
         bool isNull (void) const;
@@ -103,12 +117,27 @@ class ImapMessage {
         void setFlags (ImapMessageFlags flags);
 
         ImapAddress fromAddress (void) const;
+        void setFromAddress (const ImapAddress& address);
+
         ImapAddress senderAddress (void) const;
+        void setSenderAddress (const ImapAddress& address);
+
         QList<ImapAddress> toAddresses (void) const;
+        void setToAddresses (const QList<ImapAddress>& addresses);
+
         QList<ImapAddress> ccAddresses (void) const;
+        void setCcAddresses (const QList<ImapAddress>& addresses);
+
         QList<ImapAddress> bccAddresses (void) const;
+        void setBccAddresses (const QList<ImapAddress>& addresses);
+
         QList<ImapAddress> replyAddresses (void) const;
-        void setAddresses (const QString& addresses);
+        void setReplyAddresses (const QList<ImapAddress>& addresses);
+
+        bool setAddresses (const QString& addresses,
+                           ImapAddressTable *table = NULL);
+        bool setAddresses (ImapParser *parser,
+                           ImapAddressTable *table = NULL);
 
         bool hasHtmlPart (void) const;
         int htmlPartIndex (void) const;
@@ -125,6 +154,9 @@ class ImapMessage {
         QList<ImapMessageBodyPart *> bodyParts (void) const;
         void setBodyParts (const QList<ImapMessageBodyPart *> parts);
 
+        ImapBodyStructure *bodyStructure (void) const;
+        void setBodyStructure (ImapBodyStructure *structure);
+
     private:
         ImapMessagePrivate *d;
 };
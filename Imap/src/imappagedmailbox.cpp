@@ -0,0 +1,339 @@
+#include <QVector>
+#include <QHash>
+
+#include "imappagedmailbox.h"
+#include "imapsequenceset.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imap.h"
+
+#define IMAP_PAGE_SIZE              (100)
+#define IMAP_PAGE_MAX_PAGES         (20)
+#define IMAP_PAGE_PREFETCH          (1)
+
+// ===========================================================================
+//  PRIVATE Classes
+// ===========================================================================
+/* Messages of pageSize rows, NULL for the ones the server didn't send. */
+class ImapPagedMailboxPage {
+    public:
+        ~ImapPagedMailboxPage() { qDeleteAll(messages); }
+
+        QVector<ImapMessage *> messages;
+};
+
+class ImapPagedMailboxPrivate {
+    public:
+        Imap *imap;
+        QString mailbox;
+        QList<uint> uids;
+        bool uidOrder;
+        int count;
+
+        int pageSize;
+        int maxPages;
+        int prefetchPages;
+
+        QHash<int, ImapPagedMailboxPage *> pages;
+        QList<int> recentPages;     // Least recently used first
+        int lastFirstRow;
+
+        // Fetched messages land here, its address table and strings are
+        // shared by the messages of the loaded pages (until an eviction).
+        ImapMailbox buffer;
+
+    public:
+        void clear (void);
+        void touch (int page);
+        bool fetchPages (int first, int last);
+        void evict (int firstKept, int lastKept);
+        int pageCount (void) const;
+};
+
+void ImapPagedMailboxPrivate::clear (void) {
+    qDeleteAll(pages);
+    pages.clear();
+    recentPages.clear();
+    buffer.clearMessages();
+    lastFirstRow = 0;
+}
+
+void ImapPagedMailboxPrivate::touch (int page) {
+    recentPages.removeOne(page);
+    recentPages.append(page);
+}
+
+/**
+ * Fetch the pages from first to last in one command.
+ */
+bool ImapPagedMailboxPrivate::fetchPages (int first, int last) {
+    int firstRow = first * pageSize;
+    int lastRow = qMin(count, (last + 1) * pageSize) - 1;
+
+    QHash<uint, int> rows;
+    if (uidOrder) {
+        ImapSequenceSet set;
+        for (int row = firstRow; row <= lastRow; ++row) {
+            set.add(uids[row]);
+            rows.insert(uids[row], row);
+        }
+        if (imap->uidFetch(&buffer, set) == NULL) {
+            buffer.clearMessages();
+            return(false);
+        }
+    } else {
+        if (imap->fetch(&buffer, firstRow + 1, lastRow + 1) == NULL) {
+            buffer.clearMessages();
+            return(false);
+        }
+    }
+
+    for (int page = first; page <= last; ++page) {
+        ImapPagedMailboxPage *data = new ImapPagedMailboxPage;
+        data->messages.fill(NULL, qMin(pageSize, count - page * pageSize));
+        pages.insert(page, data);
+        touch(page);
+    }
+
+    while (buffer.count() > 0) {
+        ImapMessage *message = buffer.takeAt(0);
+        int row = uidOrder ? rows.value(message->uid().toUInt(), -1) : message->id() - 1;
+
+        ImapPagedMailboxPage *data = (row >= firstRow && row <= lastRow)
+                                   ? pages.value(row / pageSize) : NULL;
+        if (data == NULL || data->messages[row % pageSize] != NULL) {
+            delete message;
+            continue;
+        }
+        data->messages[row % pageSize] = message;
+    }
+    return(true);
+}
+
+/**
+ * Drop the least recently used pages, keeping the ones in range.
+ */
+void ImapPagedMailboxPrivate::evict (int firstKept, int lastKept) {
+    bool evicted = false;
+    int index = 0;
+    while (pages.size() > maxPages && index < recentPages.size()) {
+        int page = recentPages[index];
+        if (page >= firstKept && page <= lastKept) {
+            index++;
+            continue;
+        }
+
+        recentPages.removeAt(index);
+        delete pages.take(page);
+        evicted = true;
+    }
+
+    // Release the addresses and strings interned for the evicted
+    // messages, the loaded ones keep their own shared copies.
+    if (evicted)
+        buffer.clearMessages();
+}
+
+int ImapPagedMailboxPrivate::pageCount (void) const {
+    return((count + pageSize - 1) / pageSize);
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapPagedMailbox::ImapPagedMailbox (Imap *imap)
+    : d(new ImapPagedMailboxPrivate)
+{
+    d->imap = imap;
+    d->uidOrder = false;
+    d->count = 0;
+    d->pageSize = IMAP_PAGE_SIZE;
+    d->maxPages = IMAP_PAGE_MAX_PAGES;
+    d->prefetchPages = IMAP_PAGE_PREFETCH;
+    d->lastFirstRow = 0;
+}
+
+ImapPagedMailbox::~ImapPagedMailbox() {
+    d->clear();
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Select mailbox, rows are message numbers. No envelope is fetched.
+ */
+bool ImapPagedMailbox::open (const QString& mailbox) {
+    close();
+
+    ImapMailbox *selected = d->imap->select(mailbox);
+    if (selected == NULL)
+        return(false);
+
+    d->mailbox = mailbox;
+    d->count = selected->exists();
+    delete selected;
+    return(true);
+}
+
+/**
+ * Select mailbox, rows are uids in the given order.
+ */
+bool ImapPagedMailbox::open (const QString& mailbox, const QList<uint>& uids) {
+    if (!open(mailbox))
+        return(false);
+
+    d->uids = uids;
+    d->uidOrder = true;
+    d->count = uids.size();
+    return(true);
+}
+
+void ImapPagedMailbox::close (void) {
+    d->clear();
+    d->mailbox.clear();
+    d->uids.clear();
+    d->uidOrder = false;
+    d->count = 0;
+}
+
+/**
+ * Make rows first to last available, and prefetch prefetchPages()
+ * beyond them in the direction of the move since the last call.
+ */
+bool ImapPagedMailbox::fetchRows (int first, int last) {
+    first = qMax(0, first);
+    last = qMin(d->count - 1, last);
+    if (first > last)
+        return(true);
+
+    int firstPage = first / d->pageSize;
+    int lastPage = last / d->pageSize;
+
+    // Prefetch within the room maxPages() leaves, a page
+    // evicted as soon as fetched would be fetched for nothing.
+    int prefetch = qMin(d->prefetchPages, d->maxPages - (lastPage - firstPage + 1));
+    prefetch = qMax(0, prefetch);
+
+    int firstWanted = firstPage;
+    int lastWanted = lastPage;
+    if (first >= d->lastFirstRow)
+        lastWanted = qMin(d->pageCount() - 1, lastPage + prefetch);
+    else
+        firstWanted = qMax(0, firstPage - prefetch);
+    d->lastFirstRow = first;
+
+    bool ok = true;
+    int page = firstWanted;
+    while (page <= lastWanted) {
+        if (d->pages.contains(page)) {
+            d->touch(page);
+            page++;
+            continue;
+        }
+
+        int run = page;
+        while (run < lastWanted && !d->pages.contains(run + 1))
+            run++;
+        if (!d->fetchPages(page, run))
+            ok = false;
+        page = run + 1;
+    }
+
+    // Visible pages are the most recent ones.
+    for (page = firstPage; page <= lastPage; ++page) {
+        if (d->pages.contains(page))
+            d->touch(page);
+    }
+
+    d->evict(firstWanted, lastWanted);
+    return(ok);
+}
+
+/**
+ * The message at row, fetching its page if needed.
+ * NULL on failure. Valid until the page is evicted.
+ */
+ImapMessage *ImapPagedMailbox::message (int row) {
+    if (row < 0 || row >= d->count)
+        return(NULL);
+
+    if (!isLoaded(row))
+        fetchRows(row, row);
+    return(cachedMessage(row));
+}
+
+/**
+ * The message at row if its page is loaded, NULL otherwise.
+ */
+ImapMessage *ImapPagedMailbox::cachedMessage (int row) const {
+    if (row < 0 || row >= d->count)
+        return(NULL);
+
+    ImapPagedMailboxPage *page = d->pages.value(row / d->pageSize);
+    return(page != NULL ? page->messages[row % d->pageSize] : NULL);
+}
+
+bool ImapPagedMailbox::isLoaded (int row) const {
+    return(row >= 0 && row < d->count && d->pages.contains(row / d->pageSize));
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+Imap *ImapPagedMailbox::imap (void) const {
+    return(d->imap);
+}
+
+QString ImapPagedMailbox::mailbox (void) const {
+    return(d->mailbox);
+}
+
+int ImapPagedMailbox::count (void) const {
+    return(d->count);
+}
+
+bool ImapPagedMailbox::isUidOrder (void) const {
+    return(d->uidOrder);
+}
+
+int ImapPagedMailbox::pageSize (void) const {
+    return(d->pageSize);
+}
+
+/**
+ * Rows fetched at once. Changing it drops the loaded pages.
+ */
+void ImapPagedMailbox::setPageSize (int rows) {
+    if (rows < 1 || rows == d->pageSize)
+        return;
+
+    d->clear();
+    d->pageSize = rows;
+}
+
+int ImapPagedMailbox::maxPages (void) const {
+    return(d->maxPages);
+}
+
+/**
+ * Pages kept in memory, the visible ones are never evicted.
+ * Prefetching is limited to the pages left once the visible ones fit.
+ */
+void ImapPagedMailbox::setMaxPages (int pages) {
+    d->maxPages = qMax(1, pages);
+}
+
+int ImapPagedMailbox::prefetchPages (void) const {
+    return(d->prefetchPages);
+}
+
+void ImapPagedMailbox::setPrefetchPages (int pages) {
+    d->prefetchPages = qMax(0, pages);
+}
+
+int ImapPagedMailbox::loadedPages (void) const {
+    return(d->pages.size());
+}
+
@@ -0,0 +1,63 @@
+#ifndef _IMAP_PAGED_MAILBOX_H_
+#define _IMAP_PAGED_MAILBOX_H_
+
+#include <QString>
+#include <QList>
+
+class Imap;
+class ImapMessage;
+class ImapPagedMailboxPrivate;
+
+/**
+ * Mailbox whose envelopes are fetched by pages, on demand.
+ *
+ * open() only selects the mailbox: the row count comes from EXISTS.
+ * Rows are message numbers, or the UIDs given to open() (for instance
+ * in the order of Imap::sort()). fetchRows() is told the visible rows:
+ * it fetches the missing pages (a single FETCH per run of pages),
+ * prefetches ahead in the scroll direction as far as maxPages() allows,
+ * and evicts the least recently used pages beyond maxPages().
+ *
+ * Messages are owned by the mailbox and deleted with their page.
+ * Expunges are not tracked: open() again once they happen.
+ */
+class ImapPagedMailbox {
+    public:
+        ImapPagedMailbox (Imap *imap);
+        ~ImapPagedMailbox();
+
+        // Methods
+        bool open (const QString& mailbox);
+        bool open (const QString& mailbox, const QList<uint>& uids);
+        void close (void);
+
+        bool fetchRows (int first, int last);
+
+        ImapMessage *message (int row);
+        ImapMessage *cachedMessage (int row) const;
+        bool isLoaded (int row) const;
+
+        // Properties
+        Imap *imap (void) const;
+        QString mailbox (void) const;
+        int count (void) const;
+        bool isUidOrder (void) const;
+
+        int pageSize (void) const;
+        void setPageSize (int rows);
+
+        int maxPages (void) const;
+        void setMaxPages (int pages);
+
+        int prefetchPages (void) const;
+        void setPrefetchPages (int pages);
+
+        int loadedPages (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapPagedMailbox)
+
+        ImapPagedMailboxPrivate *d;
+};
+
+#endif /* !_IMAP_PAGED_MAILBOX_H_ */
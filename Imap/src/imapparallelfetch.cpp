@@ -0,0 +1,417 @@
+#include <QMutex>
+
+#include "imapparallelfetch.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapclient.h"
+
+#define IMAP_PARALLEL_CONNECTIONS       (4)
+#define IMAP_PARALLEL_CHUNK_SIZE        (500)
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+static bool _parallelUidLessThan (const ImapMessage *a, const ImapMessage *b) {
+    return(a->uid().toUInt() < b->uid().toUInt());
+}
+
+/* Split uids in chunks of at most chunkSize UIDs. Meant for UIDs
+ * that exist: a sparse range would give mostly empty chunks.
+ */
+static QList<ImapSequenceSet> _parallelSplit (const ImapSequenceSet& uids, int chunkSize) {
+    QList<ImapSequenceSet> chunks;
+    ImapSequenceSet chunk;
+    quint64 count = 0;
+
+    for (int i = 0; i < uids.rangeCount(); ++i) {
+        quint64 first = uids.rangeFirst(i);
+        quint64 last = uids.rangeLast(i);
+
+        while (first <= last) {
+            quint64 take = qMin(last - first + 1, (quint64)chunkSize - count);
+            chunk.add(first, first + take - 1);
+            first += take;
+            count += take;
+
+            if (count == (quint64)chunkSize) {
+                chunks.append(chunk);
+                chunk.clear();
+                count = 0;
+            }
+        }
+    }
+
+    if (!chunk.isEmpty())
+        chunks.append(chunk);
+    return(chunks);
+}
+
+// ===========================================================================
+//  PRIVATE Classes
+// ===========================================================================
+/* A pooled connection, logged in once and kept across fetches. */
+class ImapParallelConnection {
+    public:
+        ImapParallelConnection() : broken(false) {}
+
+        ImapClient client;
+
+        // Mailbox EXAMINEd last, only used in the I/O thread.
+        QString examined;
+        bool broken;
+};
+
+class ImapParallelFetchPrivate {
+    public:
+        Imap::LoginType loginType;
+        QString username;
+        QString password;
+        QString host;
+        quint16 port;
+        bool useSsl;
+
+        int maxConnections;
+        int chunkSize;
+
+        QList<ImapParallelConnection *> connections;
+
+        // Fetch state, guarded by mutex.
+        QMutex mutex;
+        QList<ImapSequenceSet> chunks;
+        QList<QList<ImapMessage *> > results;
+        QString errorString;
+        QString mailbox;
+        int nextChunk;
+        int failedChunks;
+
+    public:
+        bool openConnections (void);
+        void closeConnections (void);
+        void dropBroken (void);
+
+        int takeChunk (ImapSequenceSet *chunk);
+        void setResult (int index, ImapMailbox *mailbox);
+        void setFailed (int index, const QString& error);
+};
+
+/* EXAMINE mailbox on the connection, unless it already is. */
+static bool _parallelExamine (Imap *imap,
+                              ImapParallelConnection *connection,
+                              const QString& mailbox)
+{
+    if (connection->examined == mailbox)
+        return(true);
+
+    ImapMailbox *status = imap->examine(mailbox);
+    if (status == NULL) {
+        connection->examined.clear();
+        return(false);
+    }
+    delete status;
+    connection->examined = mailbox;
+    return(true);
+}
+
+/* The UIDs of a set that exist in the mailbox. */
+class ImapParallelSearchReply : public ImapReply {
+    public:
+        ImapParallelSearchReply (ImapParallelConnection *connection,
+                                 const QString& mailbox,
+                                 const ImapSequenceSet& uids)
+            : m_connection(connection), m_mailbox(mailbox), m_uids(uids)
+        {
+        }
+
+        ImapSequenceSet result (void) const {
+            return(m_result);
+        }
+
+    protected:
+        bool execute (Imap *imap) {
+            if (!_parallelExamine(imap, m_connection, m_mailbox))
+                return(false);
+
+            // Split, a sparse set would not fit in one command.
+            ImapSequenceSet result;
+            if (!imap->searchUids(m_uids, QString(), &result))
+                return(false);
+            m_result = result.intersected(m_uids);
+            return(true);
+        }
+
+    private:
+        ImapParallelConnection *m_connection;
+        ImapSequenceSet m_result;
+        QString m_mailbox;
+        ImapSequenceSet m_uids;
+};
+
+/* One connection, fetching chunks until none is left. */
+class ImapParallelFetchReply : public ImapReply {
+    public:
+        ImapParallelFetchReply (ImapParallelFetchPrivate *fetch,
+                                ImapParallelConnection *connection)
+            : m_fetch(fetch), m_connection(connection)
+        {
+        }
+
+    protected:
+        bool execute (Imap *imap) {
+            ImapParallelFetchPrivate *f = m_fetch;
+            if (!_parallelExamine(imap, m_connection, f->mailbox)) {
+                f->setFailed(-1, imap->errorString());
+                return(false);
+            }
+
+            ImapSequenceSet chunk;
+            int index;
+            while ((index = f->takeChunk(&chunk)) >= 0) {
+                ImapMailbox mailbox(f->mailbox);
+                if (imap->uidFetch(&mailbox, chunk) == NULL) {
+                    f->setFailed(index, imap->errorString());
+                    return(false);
+                }
+                f->setResult(index, &mailbox);
+            }
+            return(true);
+        }
+
+    private:
+        ImapParallelFetchPrivate *m_fetch;
+        ImapParallelConnection *m_connection;
+};
+
+/* Open the missing connections, up to maxConnections. Connections
+ * are opened in parallel; false if none could be opened.
+ */
+bool ImapParallelFetchPrivate::openConnections (void) {
+    QList<ImapParallelConnection *> opened;
+    QList<ImapReply *> replies;
+    while (connections.size() + opened.size() < maxConnections) {
+        ImapParallelConnection *connection = new ImapParallelConnection;
+        ImapReply *connect = connection->client.connectToHost(host, port, useSsl);
+        ImapReply *login = connection->client.login(username, password, loginType);
+        opened.append(connection);
+        replies << connect << login;
+    }
+
+    for (int i = 0; i < opened.size(); ++i) {
+        ImapReply *connect = replies[i * 2];
+        ImapReply *login = replies[i * 2 + 1];
+        connect->waitForFinished();
+        login->waitForFinished();
+
+        if (connect->isOk() && login->isOk()) {
+            connections.append(opened[i]);
+        } else {
+            errorString = connect->isOk() ? login->errorString() : connect->errorString();
+            delete opened[i];
+        }
+    }
+    qDeleteAll(replies);
+
+    return(!connections.isEmpty());
+}
+
+void ImapParallelFetchPrivate::closeConnections (void) {
+    QList<ImapReply *> replies;
+    foreach (ImapParallelConnection *connection, connections)
+        replies.append(connection->client.logout());
+    foreach (ImapReply *reply, replies)
+        reply->waitForFinished();
+    qDeleteAll(replies);
+
+    qDeleteAll(connections);
+    connections.clear();
+}
+
+/* Forget the connections whose last command failed,
+ * they are reopened by the next fetch. */
+void ImapParallelFetchPrivate::dropBroken (void) {
+    for (int i = connections.size() - 1; i >= 0; --i) {
+        if (connections[i]->broken)
+            delete connections.takeAt(i);
+    }
+}
+
+/* Returns the index of the next chunk to fetch, or -1. */
+int ImapParallelFetchPrivate::takeChunk (ImapSequenceSet *chunk) {
+    QMutexLocker locker(&mutex);
+    if (nextChunk >= chunks.size())
+        return(-1);
+
+    *chunk = chunks[nextChunk];
+    return(nextChunk++);
+}
+
+void ImapParallelFetchPrivate::setResult (int index, ImapMailbox *mailbox) {
+    QList<ImapMessage *> messages;
+    int count = mailbox->count();
+    for (int i = 0; i < count; ++i)
+        messages.append(mailbox->takeAt(0));
+    qSort(messages.begin(), messages.end(), _parallelUidLessThan);
+
+    QMutexLocker locker(&mutex);
+    results[index] = messages;
+}
+
+void ImapParallelFetchPrivate::setFailed (int index, const QString& error) {
+    QMutexLocker locker(&mutex);
+    errorString = error;
+    if (index >= 0)
+        failedChunks++;
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapParallelFetch::ImapParallelFetch()
+    : d(new ImapParallelFetchPrivate)
+{
+    d->maxConnections = IMAP_PARALLEL_CONNECTIONS;
+    d->chunkSize = IMAP_PARALLEL_CHUNK_SIZE;
+    d->loginType = Imap::LoginPlain;
+    d->useSsl = false;
+    d->port = 143;
+    d->nextChunk = 0;
+    d->failedChunks = 0;
+}
+
+ImapParallelFetch::~ImapParallelFetch() {
+    d->closeConnections();
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Fetch UID, FLAGS, INTERNALDATE, RFC822.SIZE and ENVELOPE of the
+ * specified messages. Returns NULL if a chunk couldn't be fetched.
+ *
+ * uids may be sparse or open ended ("1:*"): a UID SEARCH first finds
+ * the ones that exist, and those are split in chunks.
+ */
+ImapMailbox *ImapParallelFetch::fetch (const QString& mailbox,
+                                       const ImapSequenceSet& uids)
+{
+    d->errorString.clear();
+    d->dropBroken();
+    if (uids.isEmpty())
+        return(new ImapMailbox(mailbox));
+    if (!d->openConnections())
+        return(NULL);
+
+    ImapParallelConnection *first = d->connections.first();
+    ImapParallelSearchReply *search = new ImapParallelSearchReply(first, mailbox, uids);
+    first->client.submit(search);
+    search->waitForFinished();
+    if (!search->isOk()) {
+        d->errorString = search->errorString();
+        first->broken = true;
+        delete search;
+        return(NULL);
+    }
+    ImapSequenceSet existing = search->result();
+    delete search;
+
+    d->chunks = _parallelSplit(existing, d->chunkSize);
+    d->results.clear();
+    for (int i = 0; i < d->chunks.size(); ++i)
+        d->results.append(QList<ImapMessage *>());
+    d->mailbox = mailbox;
+    d->failedChunks = 0;
+    d->nextChunk = 0;
+
+    int connections = qMin(d->connections.size(), d->chunks.size());
+    QList<ImapReply *> replies;
+    for (int i = 0; i < connections; ++i) {
+        ImapParallelConnection *connection = d->connections[i];
+        replies.append(connection->client.submit(new ImapParallelFetchReply(d, connection)));
+    }
+    for (int i = 0; i < replies.size(); ++i) {
+        replies[i]->waitForFinished();
+        if (!replies[i]->isOk())
+            d->connections[i]->broken = true;
+    }
+    qDeleteAll(replies);
+
+    // Chunks left by every connection failing, or failed ones.
+    if (d->failedChunks > 0 || d->nextChunk < d->chunks.size()) {
+        for (int i = 0; i < d->results.size(); ++i)
+            qDeleteAll(d->results[i]);
+        d->results.clear();
+        return(NULL);
+    }
+
+    int total = 0;
+    for (int i = 0; i < d->results.size(); ++i)
+        total += d->results[i].size();
+
+    ImapMailbox *result = new ImapMailbox(mailbox);
+    result->reserve(total);
+    for (int i = 0; i < d->results.size(); ++i) {
+        foreach (ImapMessage *message, d->results[i])
+            result->addMessage(message);
+    }
+    d->results.clear();
+    d->chunks.clear();
+    return(result);
+}
+
+/**
+ * Log out the pooled connections. The next fetch opens new ones.
+ */
+void ImapParallelFetch::close (void) {
+    d->closeConnections();
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+void ImapParallelFetch::setHost (const QString& host, quint16 port, bool useSsl) {
+    d->host = host;
+    d->port = port;
+    d->useSsl = useSsl;
+}
+
+void ImapParallelFetch::setLogin (const QString& username,
+                                  const QString& password,
+                                  Imap::LoginType type)
+{
+    d->username = username;
+    d->password = password;
+    d->loginType = type;
+}
+
+int ImapParallelFetch::maxConnections (void) const {
+    return(d->maxConnections);
+}
+
+/**
+ * Servers limit the connections per user (often 10 to 20),
+ * keep the cap below, counting the other clients of the account.
+ */
+void ImapParallelFetch::setMaxConnections (int connections) {
+    d->maxConnections = qMax(1, connections);
+}
+
+int ImapParallelFetch::chunkSize (void) const {
+    return(d->chunkSize);
+}
+
+void ImapParallelFetch::setChunkSize (int uids) {
+    d->chunkSize = qMax(1, uids);
+}
+
+/**
+ * Connections currently open.
+ */
+int ImapParallelFetch::connectionCount (void) const {
+    return(d->connections.size());
+}
+
+QString ImapParallelFetch::errorString (void) const {
+    return(d->errorString);
+}
+
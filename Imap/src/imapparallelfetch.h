@@ -0,0 +1,53 @@
+#ifndef _IMAP_PARALLEL_FETCH_H_
+#define _IMAP_PARALLEL_FETCH_H_
+
+#include <QString>
+
+#include "imapsequenceset.h"
+#include "imap.h"
+
+class ImapMailbox;
+class ImapParallelFetchPrivate;
+
+/**
+ * Fetch the envelopes of a large UID set over several connections.
+ * The UIDs that exist are split in chunks, each connection (at most
+ * maxConnections) takes the next chunk until none is left. Messages
+ * are merged in UID order.
+ *
+ * Connections are opened by the first fetch and kept for the next
+ * ones, until close() or the destruction of the object.
+ */
+class ImapParallelFetch {
+    public:
+        ImapParallelFetch();
+        ~ImapParallelFetch();
+
+        // Methods
+        ImapMailbox *fetch (const QString& mailbox, const ImapSequenceSet& uids);
+        void close (void);
+
+        // Properties
+        void setHost (const QString& host, quint16 port = 143, bool useSsl = false);
+        void setLogin (const QString& username,
+                       const QString& password,
+                       Imap::LoginType type = Imap::LoginPlain);
+
+        int maxConnections (void) const;
+        void setMaxConnections (int connections);
+
+        int chunkSize (void) const;
+        void setChunkSize (int uids);
+
+        int connectionCount (void) const;
+
+        QString errorString (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapParallelFetch)
+
+        ImapParallelFetchPrivate *d;
+};
+
+#endif /* !_IMAP_PARALLEL_FETCH_H_ */
+
@@ -0,0 +1,477 @@
+#include "imapparser.h"
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+static inline bool _parserIsAtomEnd (char c) {
+    switch (c) {
+        case ' ': case '(': case ')': case '{': case '"':
+        case ']': case '\r': case '\n': case '\t':
+            return(true);
+    }
+    return(false);
+}
+
+static inline char _parserToUpper (char c) {
+    return((c >= 'a' && c <= 'z') ? (c - 32) : c);
+}
+
+static int _parserMonth (const char *s) {
+    static const char *months = "JANFEBMARAPRMAYJUNJULAUGSEPOCTNOVDEC";
+    char a = _parserToUpper(s[0]);
+    char b = _parserToUpper(s[1]);
+    char c = _parserToUpper(s[2]);
+    for (int i = 0; i < 12; ++i) {
+        if (months[i * 3] == a && months[i * 3 + 1] == b && months[i * 3 + 2] == c)
+            return(i + 1);
+    }
+    return(0);
+}
+
+static int _parserDigits (const char *s, int n, int *pos, int maxDigits) {
+    int value = 0;
+    int count = 0;
+    while (*pos < n && count < maxDigits && s[*pos] >= '0' && s[*pos] <= '9') {
+        value = (value * 10) + (s[*pos] - '0');
+        (*pos)++;
+        count++;
+    }
+    return(count > 0 ? value : -1);
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapParser::ImapParser (const QByteArray& data, int position)
+    : m_data(data)
+{
+    m_ptr = m_data.constData();
+    m_size = m_data.size();
+    m_pos = position;
+    m_dropped = 0;
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapParser::atEnd (void) {
+    skipSpaces();
+    return(m_pos >= m_size);
+}
+
+bool ImapParser::atListEnd (void) {
+    skipSpaces();
+    return(m_pos >= m_size || m_ptr[m_pos] == ')');
+}
+
+int ImapParser::position (void) const {
+    return(m_pos);
+}
+
+void ImapParser::setPosition (int position) {
+    m_pos = position;
+}
+
+const QByteArray& ImapParser::data (void) const {
+    return(m_data);
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Returns the next non-space char without consuming it, 0 at end.
+ */
+char ImapParser::peek (void) {
+    skipSpaces();
+    return(m_pos < m_size ? m_ptr[m_pos] : '\0');
+}
+
+/**
+ * Consume the next non-space char if it matches c.
+ */
+bool ImapParser::skipChar (char c) {
+    skipSpaces();
+    if (m_pos < m_size && m_ptr[m_pos] == c) {
+        m_pos++;
+        return(true);
+    }
+    return(false);
+}
+
+/**
+ * Consume the next atom if it matches (case insensitive) the given one.
+ */
+bool ImapParser::skipAtom (const char *atom) {
+    skipSpaces();
+
+    int i = 0;
+    while (atom[i] != '\0') {
+        if (m_pos + i >= m_size || _parserToUpper(m_ptr[m_pos + i]) != _parserToUpper(atom[i]))
+            return(false);
+        i++;
+    }
+
+    if (m_pos + i < m_size && !_parserIsAtomEnd(m_ptr[m_pos + i]) && m_ptr[m_pos + i] != '[')
+        return(false);
+
+    m_pos += i;
+    return(true);
+}
+
+/**
+ * Skip the next value: parenthesized list, string, literal or atom.
+ */
+bool ImapParser::skipValue (void) {
+    int offset, length;
+
+    switch (peek()) {
+        case '\0':
+            return(false);
+        case '(': {
+            int depth = 0;
+            do {
+                char c = peek();
+                if (c == '(') {
+                    depth++;
+                    m_pos++;
+                } else if (c == ')') {
+                    depth--;
+                    m_pos++;
+                } else if (c == '"' || c == '{') {
+                    if (!readStringSpan(&offset, &length))
+                        return(false);
+                } else if (c == '\0') {
+                    return(false);
+                } else {
+                    int end = atomEnd(m_pos);
+                    m_pos = (end > m_pos) ? end : (m_pos + 1);
+                }
+            } while (depth > 0);
+            return(true);
+        }
+        case '"':
+        case '{':
+            return(readStringSpan(&offset, &length));
+        case ')':
+            return(false);
+    }
+
+    int end = atomEnd(m_pos);
+    m_pos = (end > m_pos) ? end : (m_pos + 1);
+    return(true);
+}
+
+/**
+ * Read an atom. Bracketed sections are part of the atom,
+ * so "BODY[HEADER.FIELDS (SUBJECT)]<0>" is read as a single item.
+ */
+QByteArray ImapParser::readAtom (void) {
+    skipSpaces();
+    int begin = m_pos;
+    m_pos = atomEnd(m_pos);
+    return(m_data.mid(begin, m_pos - begin));
+}
+
+qint64 ImapParser::readNumber (bool *ok) {
+    skipSpaces();
+
+    qint64 value = 0;
+    int begin = m_pos;
+    while (m_pos < m_size && m_ptr[m_pos] >= '0' && m_ptr[m_pos] <= '9')
+        value = (value * 10) + (m_ptr[m_pos++] - '0');
+
+    if (ok != NULL) *ok = (m_pos > begin);
+    return(value);
+}
+
+/**
+ * Read a quoted string, literal, atom or NIL (returns a null array).
+ */
+QByteArray ImapParser::readString (bool *isNil) {
+    skipSpaces();
+    if (m_pos < m_size && m_ptr[m_pos] == '"') {
+        int offset, length;
+        bool escaped;
+        if (isNil != NULL) *isNil = false;
+        if (!readQuotedSpan(&offset, &length, &escaped))
+            return(QByteArray());
+        if (!escaped)
+            return(m_data.mid(offset, length));
+
+        QByteArray value;
+        value.reserve(length);
+        for (int i = offset; i < offset + length; ++i) {
+            if (m_ptr[i] == '\\' && (i + 1) < offset + length)
+                i++;
+            value.append(m_ptr[i]);
+        }
+        return(value);
+    }
+
+    int offset, length;
+    bool nil;
+    if (!readStringSpan(&offset, &length, &nil) || nil) {
+        if (isNil != NULL) *isNil = true;
+        return(QByteArray());
+    }
+
+    if (isNil != NULL) *isNil = false;
+    return(m_data.mid(offset, length));
+}
+
+/**
+ * Locate the next string value without copying it.
+ * Quoted strings are returned raw, with escapes still in place.
+ */
+bool ImapParser::readStringSpan (int *offset, int *length, bool *isNil) {
+    skipSpaces();
+    if (isNil != NULL) *isNil = false;
+    if (m_pos >= m_size)
+        return(false);
+
+    if (m_ptr[m_pos] == '"') {
+        bool escaped;
+        return(readQuotedSpan(offset, length, &escaped));
+    }
+
+    if (m_ptr[m_pos] == '{')
+        return(readLiteralSpan(offset, length));
+
+    int end = atomEnd(m_pos);
+    if (end == m_pos)
+        return(false);
+
+    *offset = m_pos;
+    *length = end - m_pos;
+    m_pos = end;
+
+    if (*length == 3 && _parserToUpper(m_ptr[*offset]) == 'N' &&
+        _parserToUpper(m_ptr[*offset + 1]) == 'I' &&
+        _parserToUpper(m_ptr[*offset + 2]) == 'L')
+    {
+        if (isNil != NULL) *isNil = true;
+        *length = 0;
+    }
+    return(true);
+}
+
+/**
+ * Read a parenthesized flag list "(\Seen \Flagged)".
+ * Keywords are interned (see ImapMessage::keywordFlag()), or only
+ * looked up if intern is false. Those without a bit are counted by
+ * droppedKeywords(). Unknown system flags are ignored.
+ */
+ImapMessageFlags ImapParser::readFlags (bool intern) {
+    ImapMessageFlags flags = 0;
+
+    if (!skipChar('(')) {
+        skipValue();
+        return(flags);
+    }
+
+    while (!atListEnd()) {
+        int begin = m_pos;
+        m_pos = atomEnd(m_pos);
+        if (m_pos == begin) {
+            skipValue();
+            continue;
+        }
+
+        if (m_ptr[begin] != '\\') {
+            QByteArray keyword(m_ptr + begin, m_pos - begin);
+            ImapMessageFlags flag = intern ? ImapMessage::keywordFlag(keyword)
+                                           : ImapMessage::findKeyword(keyword);
+            if (flag == 0)
+                m_dropped++;
+            flags |= flag;
+            continue;
+        }
+        if ((m_pos - begin) < 3)
+            continue;
+
+        switch (m_ptr[begin + 1] | 0x20) {
+            case 'a': flags |= ImapMessageAnswered; break;
+            case 'd':
+                if ((m_ptr[begin + 2] | 0x20) == 'r')
+                    flags |= ImapMessageDraft;
+                else
+                    flags |= ImapMessageDeleted;
+                break;
+            case 'f': flags |= ImapMessageFlagged; break;
+            case 'r': flags |= ImapMessageRecent; break;
+            case 's': flags |= ImapMessageSeen; break;
+        }
+    }
+
+    skipChar(')');
+    return(flags);
+}
+
+/**
+ * Keywords read by readFlags() that couldn't be given a bit.
+ */
+int ImapParser::droppedKeywords (void) const {
+    return(m_dropped);
+}
+
+/**
+ * Read the attributes of a flag update "(UID n FLAGS (...) MODSEQ (n))",
+ * as sent for STORE, CHANGEDSINCE or unsolicited FETCH responses.
+ * Returns true if a FLAGS item was found.
+ */
+bool ImapParser::readFlagUpdate (uint *uid, ImapMessageFlags *flags) {
+    bool hasFlags = false;
+    *flags = 0;
+    *uid = 0;
+
+    if (!skipChar('('))
+        return(false);
+
+    while (!atListEnd()) {
+        QByteArray item = readAtom().toUpper();
+        if (item == "UID") {
+            *uid = readNumber();
+        } else if (item == "FLAGS") {
+            *flags = readFlags();
+            hasFlags = true;
+        } else if (item.isEmpty() || !skipValue()) {
+            break;
+        }
+    }
+
+    skipChar(')');
+    return(hasFlags);
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods
+// ===========================================================================
+/**
+ * Parse both INTERNALDATE ("17-Jul-1996 02:44:25 -0700") and
+ * RFC 2822 ("Wed, 17 Jul 1996 02:44:25 -0700 (PDT)") dates, to UTC.
+ */
+QDateTime ImapParser::parseDateTime (const QByteArray& text) {
+    const char *s = text.constData();
+    int n = text.size();
+    int pos = 0;
+
+    while (pos < n && (s[pos] == ' ' || s[pos] == '"'))
+        pos++;
+
+    // Optional day of week
+    if (pos + 3 < n && s[pos + 3] == ',') {
+        pos += 4;
+        while (pos < n && s[pos] == ' ') pos++;
+    }
+
+    int day = _parserDigits(s, n, &pos, 2);
+    if (day < 0 || pos + 4 >= n) return(QDateTime());
+    pos++;
+
+    int month = _parserMonth(s + pos);
+    if (month == 0) return(QDateTime());
+    pos += 4;
+
+    int year = _parserDigits(s, n, &pos, 4);
+    if (year < 0) return(QDateTime());
+    if (year < 50) year += 2000; else if (year < 100) year += 1900;
+    while (pos < n && s[pos] == ' ') pos++;
+
+    int hour = _parserDigits(s, n, &pos, 2);
+    int minute = 0, second = 0;
+    if (pos < n && s[pos] == ':') { pos++; minute = _parserDigits(s, n, &pos, 2); }
+    if (pos < n && s[pos] == ':') { pos++; second = _parserDigits(s, n, &pos, 2); }
+    if (hour < 0 || minute < 0 || second < 0) return(QDateTime());
+    while (pos < n && s[pos] == ' ') pos++;
+
+    int offset = 0;
+    if (pos < n && (s[pos] == '+' || s[pos] == '-')) {
+        int sign = (s[pos] == '-') ? -1 : 1;
+        pos++;
+        int zone = _parserDigits(s, n, &pos, 4);
+        if (zone > 0) offset = sign * (((zone / 100) * 3600) + ((zone % 100) * 60));
+    }
+
+    QDateTime dateTime(QDate(year, month, day), QTime(hour, minute, second), Qt::UTC);
+    return(dateTime.addSecs(-offset));
+}
+
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+void ImapParser::skipSpaces (void) {
+    while (m_pos < m_size) {
+        char c = m_ptr[m_pos];
+        if (c != ' ' && c != '\r' && c != '\n' && c != '\t')
+            break;
+        m_pos++;
+    }
+}
+
+int ImapParser::atomEnd (int from) const {
+    int depth = 0;
+    while (from < m_size) {
+        char c = m_ptr[from];
+        if (c == '[') {
+            depth++;
+        } else if (depth > 0) {
+            if (c == ']') depth--;
+            else if (c == '\r' || c == '\n') break;
+        } else if (_parserIsAtomEnd(c)) {
+            break;
+        }
+        from++;
+    }
+
+    // Partial fetch suffix, "BODY[]<0>"
+    if (from < m_size && m_ptr[from] == '<') {
+        while (from < m_size && m_ptr[from] != '>' && !_parserIsAtomEnd(m_ptr[from]))
+            from++;
+        if (from < m_size && m_ptr[from] == '>') from++;
+    }
+    return(from);
+}
+
+bool ImapParser::readQuotedSpan (int *offset, int *length, bool *escaped) {
+    int i = m_pos + 1;
+    *escaped = false;
+    while (i < m_size && m_ptr[i] != '"') {
+        if (m_ptr[i] == '\\') {
+            *escaped = true;
+            i++;
+        }
+        i++;
+    }
+
+    if (i >= m_size)
+        return(false);
+
+    *offset = m_pos + 1;
+    *length = i - m_pos - 1;
+    m_pos = i + 1;
+    return(true);
+}
+
+bool ImapParser::readLiteralSpan (int *offset, int *length) {
+    int i = m_pos + 1;
+    int size = 0;
+    while (i < m_size && m_ptr[i] >= '0' && m_ptr[i] <= '9')
+        size = (size * 10) + (m_ptr[i++] - '0');
+
+    if (i < m_size && m_ptr[i] == '+') i++;
+    if (i >= m_size || m_ptr[i] != '}')
+        return(false);
+    i++;
+
+    if (i < m_size && m_ptr[i] == '\r') i++;
+    if (i < m_size && m_ptr[i] == '\n') i++;
+    if (i + size > m_size)
+        return(false);
+
+    *offset = i;
+    *length = size;
+    m_pos = i + size;
+    return(true);
+}
+
@@ -0,0 +1,56 @@
+#ifndef _IMAP_PARSER_H_
+#define _IMAP_PARSER_H_
+
+#include <QByteArray>
+#include <QDateTime>
+
+#include "imapmessage.h"
+
+/**
+ * Cursor over a raw IMAP response (literals included inline, as returned
+ * by ImapPrivate::readResponse()). Walks the data once, values are copied
+ * out only when read.
+ */
+class ImapParser {
+    public:
+        ImapParser (const QByteArray& data, int position = 0);
+
+        bool atEnd (void);
+        bool atListEnd (void);
+
+        int position (void) const;
+        void setPosition (int position);
+        const QByteArray& data (void) const;
+
+        char peek (void);
+        bool skipChar (char c);
+        bool skipAtom (const char *atom);
+        bool skipValue (void);
+
+        QByteArray readAtom (void);
+        qint64 readNumber (bool *ok = NULL);
+        QByteArray readString (bool *isNil = NULL);
+        ImapMessageFlags readFlags (bool intern = true);
+        bool readFlagUpdate (uint *uid, ImapMessageFlags *flags);
+        bool readStringSpan (int *offset, int *length, bool *isNil = NULL);
+
+        int droppedKeywords (void) const;
+
+        static QDateTime parseDateTime (const QByteArray& text);
+
+    private:
+        void skipSpaces (void);
+        int atomEnd (int from) const;
+        bool readQuotedSpan (int *offset, int *length, bool *escaped);
+        bool readLiteralSpan (int *offset, int *length);
+
+    private:
+        QByteArray m_data;
+        const char *m_ptr;
+        int m_size;
+        int m_pos;
+        int m_dropped;
+};
+
+#endif /* !_IMAP_PARSER_H_ */
+
@@ -0,0 +1,477 @@
+#include <QSharedData>
+#include <QStringList>
+
+#include "imapsearchquery.h"
+#include "imapaddress.h"
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+static QString _searchQuote (const QString& text) {
+    QString quoted = text;
+    quoted.replace("\\", "\\\\").replace("\"", "\\\"");
+    return(QString("\"%1\"").arg(quoted));
+}
+
+/* RFC 3501 date, with english month names whatever the locale. */
+static QString _searchDate (const QDate& date) {
+    static const char *months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+    };
+
+    return(QString("%1-%2-%3").arg(date.day())
+                              .arg(months[date.month() - 1])
+                              .arg(date.year()));
+}
+
+static bool _searchAddressMatch (const ImapAddress& address, const QString& text) {
+    return(address.address().contains(text, Qt::CaseInsensitive) ||
+           address.displayName().contains(text, Qt::CaseInsensitive));
+}
+
+static bool _searchAddressMatch (const QList<ImapAddress>& addresses,
+                                 const QString& text)
+{
+    foreach (const ImapAddress& address, addresses) {
+        if (_searchAddressMatch(address, text))
+            return(true);
+    }
+    return(false);
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapSearchQueryData : public QSharedData {
+    public:
+        QList<ImapSearchQuery> operands;
+        ImapSearchQuery::Key key;
+        ImapMessageFlags flag;
+        ImapSequenceSet set;
+        qint64 number;
+        QString field;
+        QString text;
+        QDate date;
+
+    public:
+        ImapSearchQueryData (ImapSearchQuery::Key key = ImapSearchQuery::All)
+            : key(key), flag(0), number(0)
+        {
+        }
+};
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+/**
+ * Create a query matching every message (ALL).
+ */
+ImapSearchQuery::ImapSearchQuery()
+    : d(new ImapSearchQueryData)
+{
+}
+
+ImapSearchQuery::ImapSearchQuery (const ImapSearchQuery& other)
+    : d(other.d)
+{
+}
+
+ImapSearchQuery::ImapSearchQuery (ImapSearchQueryData *data)
+    : d(data)
+{
+}
+
+ImapSearchQuery::~ImapSearchQuery() {
+}
+
+ImapSearchQuery& ImapSearchQuery::operator= (const ImapSearchQuery& other) {
+    d = other.d;
+    return(*this);
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods (Keys)
+// ===========================================================================
+ImapSearchQuery ImapSearchQuery::all (void) {
+    return(ImapSearchQuery());
+}
+
+/**
+ * Messages with (or without, if isSet is false) the specified flag:
+ * a system flag or a keyword bit from ImapMessage::keywordFlag().
+ */
+ImapSearchQuery ImapSearchQuery::flag (ImapMessageFlags flag, bool isSet) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(isSet ? Flag : NoFlag);
+    data->flag = flag;
+    return(ImapSearchQuery(data));
+}
+
+ImapSearchQuery ImapSearchQuery::keyword (const QString& keyword, bool isSet) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(isSet ? Keyword : NoKeyword);
+    data->text = keyword;
+    return(ImapSearchQuery(data));
+}
+
+#define IMAP_SEARCH_TEXT_KEY(name, keyValue)                    \
+    ImapSearchQuery ImapSearchQuery::name (const QString& text) {  \
+        ImapSearchQueryData *data = new ImapSearchQueryData(keyValue); \
+        data->text = text;                                      \
+        return(ImapSearchQuery(data));                          \
+    }
+
+IMAP_SEARCH_TEXT_KEY(from, From)
+IMAP_SEARCH_TEXT_KEY(to, To)
+IMAP_SEARCH_TEXT_KEY(cc, Cc)
+IMAP_SEARCH_TEXT_KEY(bcc, Bcc)
+IMAP_SEARCH_TEXT_KEY(subject, Subject)
+IMAP_SEARCH_TEXT_KEY(body, Body)
+IMAP_SEARCH_TEXT_KEY(text, Text)
+
+ImapSearchQuery ImapSearchQuery::header (const QString& field, const QString& text) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(Header);
+    data->field = field;
+    data->text = text;
+    return(ImapSearchQuery(data));
+}
+
+#define IMAP_SEARCH_DATE_KEY(name, keyValue)                    \
+    ImapSearchQuery ImapSearchQuery::name (const QDate& date) { \
+        ImapSearchQueryData *data = new ImapSearchQueryData(keyValue); \
+        data->date = date;                                      \
+        return(ImapSearchQuery(data));                          \
+    }
+
+IMAP_SEARCH_DATE_KEY(before, Before)
+IMAP_SEARCH_DATE_KEY(on, On)
+IMAP_SEARCH_DATE_KEY(since, Since)
+IMAP_SEARCH_DATE_KEY(sentBefore, SentBefore)
+IMAP_SEARCH_DATE_KEY(sentOn, SentOn)
+IMAP_SEARCH_DATE_KEY(sentSince, SentSince)
+
+/**
+ * Messages received from 'first' to 'last', both included.
+ */
+ImapSearchQuery ImapSearchQuery::between (const QDate& first, const QDate& last) {
+    return(since(first) && before(last.addDays(1)));
+}
+
+ImapSearchQuery ImapSearchQuery::larger (int size) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(Larger);
+    data->number = size;
+    return(ImapSearchQuery(data));
+}
+
+ImapSearchQuery ImapSearchQuery::smaller (int size) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(Smaller);
+    data->number = size;
+    return(ImapSearchQuery(data));
+}
+
+ImapSearchQuery ImapSearchQuery::uids (const ImapSequenceSet& uids) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(Uid);
+    data->set = uids;
+    return(ImapSearchQuery(data));
+}
+
+ImapSearchQuery ImapSearchQuery::messages (const ImapSequenceSet& messages) {
+    ImapSearchQueryData *data = new ImapSearchQueryData(Messages);
+    data->set = messages;
+    return(ImapSearchQuery(data));
+}
+
+// ===========================================================================
+//  PUBLIC Operators
+// ===========================================================================
+ImapSearchQuery ImapSearchQuery::operator&& (const ImapSearchQuery& other) const {
+    if (d->key == All) return(other);
+    if (other.d->key == All) return(*this);
+
+    ImapSearchQueryData *data = new ImapSearchQueryData(And);
+    if (d->key == And) data->operands += d->operands; else data->operands.append(*this);
+    if (other.d->key == And) data->operands += other.d->operands; else data->operands.append(other);
+    return(ImapSearchQuery(data));
+}
+
+ImapSearchQuery ImapSearchQuery::operator|| (const ImapSearchQuery& other) const {
+    if (d->key == All) return(*this);
+    if (other.d->key == All) return(other);
+
+    ImapSearchQueryData *data = new ImapSearchQueryData(Or);
+    if (d->key == Or) data->operands += d->operands; else data->operands.append(*this);
+    if (other.d->key == Or) data->operands += other.d->operands; else data->operands.append(other);
+    return(ImapSearchQuery(data));
+}
+
+ImapSearchQuery ImapSearchQuery::operator! (void) const {
+    if (d->key == Not)
+        return(d->operands.first());
+
+    ImapSearchQueryData *data = new ImapSearchQueryData(Not);
+    data->operands.append(*this);
+    return(ImapSearchQuery(data));
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Returns the SEARCH criteria, e.g. "FROM \"bob\" SINCE 1-Jul-2009 UNSEEN".
+ */
+QString ImapSearchQuery::toString (void) const {
+    if (d->key != And)
+        return(toKey());
+
+    QStringList keys;
+    foreach (const ImapSearchQuery& operand, d->operands)
+        keys.append(operand.toKey());
+    return(keys.join(" "));
+}
+
+/**
+ * Returns false if the query has keys that can't be sent: a flag that
+ * is neither a system flag nor a known keyword bit, or a keyword that
+ * isn't an atom. Imap::search() fails on such queries.
+ */
+bool ImapSearchQuery::isValid (void) const {
+    switch (d->key) {
+        case Flag:
+        case NoFlag:
+            return(!toKey().isEmpty());
+        case Keyword:
+        case NoKeyword:
+            return(ImapMessage::isValidKeyword(d->text.toLatin1()));
+        case And:
+        case Or:
+        case Not:
+            foreach (const ImapSearchQuery& operand, d->operands) {
+                if (!operand.isValid())
+                    return(false);
+            }
+            return(true);
+        default:
+            break;
+    }
+    return(true);
+}
+
+/**
+ * Returns true if matches() can evaluate the query: every key
+ * works on flags, envelope, dates, size or UID. BODY, TEXT, keywords,
+ * message numbers and headers other than Message-ID need the server.
+ */
+bool ImapSearchQuery::isLocal (void) const {
+    switch (d->key) {
+        case Body:
+        case Text:
+        case Keyword:
+        case NoKeyword:
+        case Messages:
+            return(false);
+        case Header:
+            return(d->field.compare("Message-ID", Qt::CaseInsensitive) == 0);
+        case And:
+        case Or:
+        case Not:
+            foreach (const ImapSearchQuery& operand, d->operands) {
+                if (!operand.isLocal())
+                    return(false);
+            }
+            return(true);
+        default:
+            break;
+    }
+    return(true);
+}
+
+/**
+ * Returns false if matches() only reads the flags and UID
+ * of the message, so its envelope can be left empty.
+ */
+bool ImapSearchQuery::needsEnvelope (void) const {
+    switch (d->key) {
+        case All:
+        case Flag:
+        case NoFlag:
+        case Uid:
+            return(false);
+        case And:
+        case Or:
+        case Not:
+            foreach (const ImapSearchQuery& operand, d->operands) {
+                if (operand.needsEnvelope())
+                    return(true);
+            }
+            return(false);
+        default:
+            break;
+    }
+    return(true);
+}
+
+/**
+ * Evaluate the query on a message (e.g. from ImapCache).
+ * Only meaningful if isLocal() is true.
+ */
+bool ImapSearchQuery::matches (const ImapMessage *message) const {
+    switch (d->key) {
+        case All:
+            return(true);
+        case Flag:
+            return((message->flags() & d->flag) != 0);
+        case NoFlag:
+            return((message->flags() & d->flag) == 0);
+        case From:
+            return(_searchAddressMatch(message->fromAddress(), d->text));
+        case To:
+            return(_searchAddressMatch(message->toAddresses(), d->text));
+        case Cc:
+            return(_searchAddressMatch(message->ccAddresses(), d->text));
+        case Bcc:
+            return(_searchAddressMatch(message->bccAddresses(), d->text));
+        case Subject:
+            return(message->subject().contains(d->text, Qt::CaseInsensitive));
+        case Header:
+            if (d->field.compare("Message-ID", Qt::CaseInsensitive) != 0)
+                return(false);
+            return(message->messageId().contains(d->text, Qt::CaseInsensitive));
+        case Before:
+            return(message->received().date() < d->date);
+        case On:
+            return(message->received().date() == d->date);
+        case Since:
+            return(message->received().date() >= d->date);
+        case SentBefore:
+            return(message->sent().date() < d->date);
+        case SentOn:
+            return(message->sent().date() == d->date);
+        case SentSince:
+            return(message->sent().date() >= d->date);
+        case Larger:
+            return(message->size() > d->number);
+        case Smaller:
+            return(message->size() < d->number);
+        case Uid:
+            return(d->set.contains(message->uid().toUInt()));
+        case And:
+            foreach (const ImapSearchQuery& operand, d->operands) {
+                if (!operand.matches(message))
+                    return(false);
+            }
+            return(true);
+        case Or:
+            foreach (const ImapSearchQuery& operand, d->operands) {
+                if (operand.matches(message))
+                    return(true);
+            }
+            return(false);
+        case Not:
+            return(!d->operands.first().matches(message));
+        default:
+            break;
+    }
+    return(false);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+ImapSearchQuery::Key ImapSearchQuery::key (void) const {
+    return(d->key);
+}
+
+/**
+ * Operands of And, Or and Not queries.
+ */
+QList<ImapSearchQuery> ImapSearchQuery::operands (void) const {
+    return(d->operands);
+}
+
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+/* A single search key, And groups are parenthesized. */
+QString ImapSearchQuery::toKey (void) const {
+    switch (d->key) {
+        case All:
+            return("ALL");
+        case Flag:
+        case NoFlag: {
+            bool isSet = (d->key == Flag);
+            switch (d->flag) {
+                case ImapMessageAnswered: return(isSet ? "ANSWERED" : "UNANSWERED");
+                case ImapMessageDeleted: return(isSet ? "DELETED" : "UNDELETED");
+                case ImapMessageDraft: return(isSet ? "DRAFT" : "UNDRAFT");
+                case ImapMessageFlagged: return(isSet ? "FLAGGED" : "UNFLAGGED");
+                case ImapMessageRecent: return(isSet ? "RECENT" : "OLD");
+                case ImapMessageSeen: return(isSet ? "SEEN" : "UNSEEN");
+            }
+
+            // A keyword bit, or no valid key (see isValid()).
+            QByteArray keyword = ImapMessage::keywordName(d->flag);
+            if (keyword.isEmpty())
+                return(QString());
+            return(QString("%1 %2").arg(isSet ? "KEYWORD" : "UNKEYWORD")
+                                   .arg(QString::fromLatin1(keyword)));
+        }
+        case Keyword:
+            return(QString("KEYWORD %1").arg(d->text));
+        case NoKeyword:
+            return(QString("UNKEYWORD %1").arg(d->text));
+        case From:
+            return(QString("FROM %1").arg(_searchQuote(d->text)));
+        case To:
+            return(QString("TO %1").arg(_searchQuote(d->text)));
+        case Cc:
+            return(QString("CC %1").arg(_searchQuote(d->text)));
+        case Bcc:
+            return(QString("BCC %1").arg(_searchQuote(d->text)));
+        case Subject:
+            return(QString("SUBJECT %1").arg(_searchQuote(d->text)));
+        case Body:
+            return(QString("BODY %1").arg(_searchQuote(d->text)));
+        case Text:
+            return(QString("TEXT %1").arg(_searchQuote(d->text)));
+        case Header:
+            return(QString("HEADER %1 %2").arg(_searchQuote(d->field))
+                                          .arg(_searchQuote(d->text)));
+        case Before:
+            return(QString("BEFORE %1").arg(_searchDate(d->date)));
+        case On:
+            return(QString("ON %1").arg(_searchDate(d->date)));
+        case Since:
+            return(QString("SINCE %1").arg(_searchDate(d->date)));
+        case SentBefore:
+            return(QString("SENTBEFORE %1").arg(_searchDate(d->date)));
+        case SentOn:
+            return(QString("SENTON %1").arg(_searchDate(d->date)));
+        case SentSince:
+            return(QString("SENTSINCE %1").arg(_searchDate(d->date)));
+        case Larger:
+            return(QString("LARGER %1").arg(d->number));
+        case Smaller:
+            return(QString("SMALLER %1").arg(d->number));
+        case Uid:
+        case Messages:
+            // An empty set matches no message.
+            if (d->set.isEmpty())
+                return("NOT ALL");
+            if (d->key == Uid)
+                return(QString("UID %1").arg(d->set.toString()));
+            return(d->set.toString());
+        case And:
+            return(QString("(%1)").arg(toString()));
+        case Or: {
+            // OR takes two keys: OR a OR b c
+            QString key;
+            int count = d->operands.size();
+            for (int i = 0; i < count - 1; ++i)
+                key += QString("OR %1 ").arg(d->operands[i].toKey());
+            return(key + d->operands[count - 1].toKey());
+        }
+        case Not:
+            return(QString("NOT %1").arg(d->operands.first().toKey()));
+    }
+    return("ALL");
+}
+
@@ -0,0 +1,96 @@
+#ifndef _IMAP_SEARCH_QUERY_H_
+#define _IMAP_SEARCH_QUERY_H_
+
+#include <QSharedDataPointer>
+#include <QDateTime>
+#include <QString>
+
+#include "imapsequenceset.h"
+#include "imapmessage.h"
+
+/**
+ * Search criteria, composed with && || ! and compiled into the
+ * search keys of a single SEARCH command:
+ *
+ *   ImapSearchQuery query = ImapSearchQuery::from("bob") &&
+ *                           ImapSearchQuery::since(QDate(2009, 7, 1)) &&
+ *                           !ImapSearchQuery::flag(ImapMessageSeen);
+ *   imap.search(query, &result);
+ *
+ * Keys on flags, envelope fields, dates, size and UIDs can also be
+ * evaluated on a message (matches()), e.g. one loaded from the cache.
+ */
+class ImapSearchQueryData;
+class ImapSearchQuery {
+    public:
+        enum Key {
+            All, Flag, NoFlag, Keyword, NoKeyword,
+            From, To, Cc, Bcc, Subject, Body, Text, Header,
+            Before, On, Since, SentBefore, SentOn, SentSince,
+            Larger, Smaller, Uid, Messages,
+            And, Or, Not
+        };
+
+    public:
+        ImapSearchQuery();
+        ImapSearchQuery (const ImapSearchQuery& other);
+        ~ImapSearchQuery();
+
+        ImapSearchQuery& operator= (const ImapSearchQuery& other);
+
+        // Keys
+        static ImapSearchQuery all (void);
+        static ImapSearchQuery flag (ImapMessageFlags flag, bool isSet = true);
+        static ImapSearchQuery keyword (const QString& keyword, bool isSet = true);
+
+        static ImapSearchQuery from (const QString& text);
+        static ImapSearchQuery to (const QString& text);
+        static ImapSearchQuery cc (const QString& text);
+        static ImapSearchQuery bcc (const QString& text);
+        static ImapSearchQuery subject (const QString& text);
+        static ImapSearchQuery body (const QString& text);
+        static ImapSearchQuery text (const QString& text);
+        static ImapSearchQuery header (const QString& field, const QString& text);
+
+        static ImapSearchQuery before (const QDate& date);
+        static ImapSearchQuery on (const QDate& date);
+        static ImapSearchQuery since (const QDate& date);
+        static ImapSearchQuery between (const QDate& first, const QDate& last);
+        static ImapSearchQuery sentBefore (const QDate& date);
+        static ImapSearchQuery sentOn (const QDate& date);
+        static ImapSearchQuery sentSince (const QDate& date);
+
+        static ImapSearchQuery larger (int size);
+        static ImapSearchQuery smaller (int size);
+
+        static ImapSearchQuery uids (const ImapSequenceSet& uids);
+        static ImapSearchQuery messages (const ImapSequenceSet& messages);
+
+        // Operators
+        ImapSearchQuery operator&& (const ImapSearchQuery& other) const;
+        ImapSearchQuery operator|| (const ImapSearchQuery& other) const;
+        ImapSearchQuery operator! (void) const;
+
+        // Methods
+        QString toString (void) const;
+
+        bool isValid (void) const;
+        bool isLocal (void) const;
+        bool needsEnvelope (void) const;
+        bool matches (const ImapMessage *message) const;
+
+        // Properties
+        Key key (void) const;
+        QList<ImapSearchQuery> operands (void) const;
+
+    private:
+        ImapSearchQuery (ImapSearchQueryData *data);
+
+        QString toKey (void) const;
+
+    private:
+        QSharedDataPointer<ImapSearchQueryData> d;
+};
+
+#endif /* !_IMAP_SEARCH_QUERY_H_ */
+
@@ -0,0 +1,73 @@
+#include "imapsearchresult.h"
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapSearchResult::ImapSearchResult() {
+    clear();
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+void ImapSearchResult::clear (void) {
+    m_all.clear();
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+    m_uid = false;
+}
+
+/**
+ * Fill every item from the full result (plain SEARCH).
+ */
+void ImapSearchResult::setFromSet (const ImapSequenceSet& all) {
+    m_all = all;
+    m_min = all.first();
+    m_max = all.last();
+    m_count = all.count();
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapSearchResult::isUid (void) const {
+    return(m_uid);
+}
+
+void ImapSearchResult::setUid (bool uid) {
+    m_uid = uid;
+}
+
+uint ImapSearchResult::min (void) const {
+    return(m_min);
+}
+
+void ImapSearchResult::setMin (uint min) {
+    m_min = min;
+}
+
+uint ImapSearchResult::max (void) const {
+    return(m_max);
+}
+
+void ImapSearchResult::setMax (uint max) {
+    m_max = max;
+}
+
+quint64 ImapSearchResult::count (void) const {
+    return(m_count);
+}
+
+void ImapSearchResult::setCount (quint64 count) {
+    m_count = count;
+}
+
+ImapSequenceSet ImapSearchResult::all (void) const {
+    return(m_all);
+}
+
+void ImapSearchResult::setAll (const ImapSequenceSet& all) {
+    m_all = all;
+}
+
@@ -0,0 +1,52 @@
+#ifndef _IMAP_SEARCH_RESULT_H_
+#define _IMAP_SEARCH_RESULT_H_
+
+#include "imapsequenceset.h"
+
+/**
+ * Result of a SEARCH: the matching message numbers (or UIDs)
+ * as a sequence set, plus MIN, MAX and COUNT.
+ * With ESEARCH (RFC 4731) only the requested items are returned
+ * by the server, the others are 0 or empty.
+ */
+class ImapSearchResult {
+    public:
+        enum ReturnOption {
+            ReturnMin   = 1,
+            ReturnMax   = 2,
+            ReturnCount = 4,
+            ReturnAll   = 8
+        };
+        typedef uint ReturnOptions;
+
+    public:
+        ImapSearchResult();
+
+        void clear (void);
+        void setFromSet (const ImapSequenceSet& all);
+
+        bool isUid (void) const;
+        void setUid (bool uid);
+
+        uint min (void) const;
+        void setMin (uint min);
+
+        uint max (void) const;
+        void setMax (uint max);
+
+        quint64 count (void) const;
+        void setCount (quint64 count);
+
+        ImapSequenceSet all (void) const;
+        void setAll (const ImapSequenceSet& all);
+
+    private:
+        ImapSequenceSet m_all;
+        quint64 m_count;
+        uint m_min;
+        uint m_max;
+        bool m_uid;
+};
+
+#endif /* !_IMAP_SEARCH_RESULT_H_ */
+
@@ -0,0 +1,369 @@
+#include "imapsequenceset.h"
+
+#define IMAP_SEQUENCE_LIST_MAX      (1 << 24)
+
+/* Length of value in decimal. */
+static int _sequenceDigits (uint value) {
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return(digits);
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+ImapSequenceSet::ImapSequenceSet() {
+}
+
+ImapSequenceSet::ImapSequenceSet (uint value) {
+    m_ranges.append(value);
+    m_ranges.append(value);
+}
+
+ImapSequenceSet::ImapSequenceSet (uint first, uint last) {
+    m_ranges.append(qMin(first, last));
+    m_ranges.append(qMax(first, last));
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods
+// ===========================================================================
+/**
+ * Parse a sequence set "1:5,7,9:12". '*' is read as the largest UID.
+ */
+ImapSequenceSet ImapSequenceSet::fromString (const QByteArray& text) {
+    ImapSequenceSet set;
+    const char *s = text.constData();
+    int n = text.size();
+    int i = 0;
+
+    while (i < n) {
+        uint values[2] = { 0, 0 };
+        int count = 0;
+
+        while (count < 2 && i < n) {
+            if (s[i] == '*') {
+                values[count++] = 0xffffffff;
+                i++;
+            } else if (s[i] >= '0' && s[i] <= '9') {
+                uint value = 0;
+                while (i < n && s[i] >= '0' && s[i] <= '9')
+                    value = (value * 10) + (s[i++] - '0');
+                values[count++] = value;
+            } else {
+                break;
+            }
+
+            if (i < n && s[i] == ':') i++; else break;
+        }
+
+        if (count == 1)
+            set.add(values[0]);
+        else if (count == 2)
+            set.add(qMin(values[0], values[1]), qMax(values[0], values[1]));
+
+        // Skip separator, stop at anything else.
+        if (i < n && s[i] == ',') i++; else break;
+    }
+
+    return(set);
+}
+
+ImapSequenceSet ImapSequenceSet::fromList (const QList<int>& values) {
+    ImapSequenceSet set;
+    foreach (int value, values)
+        set.add(value);
+    return(set);
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+void ImapSequenceSet::add (uint value) {
+    add(value, value);
+}
+
+void ImapSequenceSet::add (uint first, uint last) {
+    if (first > last)
+        qSwap(first, last);
+
+    // Fast path, ascending appends.
+    int size = m_ranges.size();
+    if (size == 0 || (quint64)first > (quint64)m_ranges[size - 1] + 1) {
+        m_ranges.append(first);
+        m_ranges.append(last);
+        return;
+    }
+
+    if (first >= m_ranges[size - 2]) {
+        m_ranges[size - 1] = qMax(m_ranges[size - 1], last);
+        return;
+    }
+
+    // First range touching [first, last]
+    int ranges = size / 2;
+    int lo = 0, hi = ranges;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if ((quint64)m_ranges[mid * 2 + 1] + 1 < first)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int i = lo;
+
+    // One past the last range touching [first, last]
+    int j = i;
+    while (j < ranges && (quint64)m_ranges[j * 2] <= (quint64)last + 1)
+        j++;
+
+    if (i == j) {
+        m_ranges.insert(i * 2, 2, 0);
+        m_ranges[i * 2] = first;
+        m_ranges[i * 2 + 1] = last;
+        return;
+    }
+
+    uint newFirst = qMin(first, m_ranges[i * 2]);
+    uint newLast = qMax(last, m_ranges[(j - 1) * 2 + 1]);
+    m_ranges.remove((i + 1) * 2, (j - i - 1) * 2);
+    m_ranges[i * 2] = newFirst;
+    m_ranges[i * 2 + 1] = newLast;
+}
+
+void ImapSequenceSet::add (const ImapSequenceSet& other) {
+    for (int i = 0; i < other.m_ranges.size(); i += 2)
+        add(other.m_ranges[i], other.m_ranges[i + 1]);
+}
+
+void ImapSequenceSet::remove (uint value) {
+    int index = findRange(value);
+    if (index < 0)
+        return;
+
+    uint first = m_ranges[index * 2];
+    uint last = m_ranges[index * 2 + 1];
+    if (first == last) {
+        m_ranges.remove(index * 2, 2);
+    } else if (value == first) {
+        m_ranges[index * 2] = first + 1;
+    } else if (value == last) {
+        m_ranges[index * 2 + 1] = last - 1;
+    } else {
+        m_ranges.insert(index * 2 + 1, 2, 0);
+        m_ranges[index * 2 + 1] = value - 1;
+        m_ranges[index * 2 + 2] = value + 1;
+    }
+}
+
+void ImapSequenceSet::remove (const ImapSequenceSet& other) {
+    *this = subtracted(other);
+}
+
+ImapSequenceSet ImapSequenceSet::subtracted (const ImapSequenceSet& other) const {
+    ImapSequenceSet result;
+    int j = 0;
+
+    for (int i = 0; i < m_ranges.size(); i += 2) {
+        quint64 first = m_ranges[i];
+        quint64 last = m_ranges[i + 1];
+
+        while (j < other.m_ranges.size() && other.m_ranges[j + 1] < first)
+            j += 2;
+
+        int k = j;
+        while (first <= last && k < other.m_ranges.size() && other.m_ranges[k] <= last) {
+            if (other.m_ranges[k] > first)
+                result.m_ranges << (uint)first << (uint)(other.m_ranges[k] - 1);
+            first = (quint64)other.m_ranges[k + 1] + 1;
+            k += 2;
+        }
+
+        if (first <= last)
+            result.m_ranges << (uint)first << (uint)last;
+    }
+
+    return(result);
+}
+
+ImapSequenceSet ImapSequenceSet::intersected (const ImapSequenceSet& other) const {
+    ImapSequenceSet result;
+    int i = 0, j = 0;
+
+    while (i < m_ranges.size() && j < other.m_ranges.size()) {
+        uint first = qMax(m_ranges[i], other.m_ranges[j]);
+        uint last = qMin(m_ranges[i + 1], other.m_ranges[j + 1]);
+        if (first <= last)
+            result.m_ranges << first << last;
+
+        if (m_ranges[i + 1] < other.m_ranges[j + 1])
+            i += 2;
+        else
+            j += 2;
+    }
+
+    return(result);
+}
+
+bool ImapSequenceSet::contains (uint value) const {
+    return(findRange(value) >= 0);
+}
+
+void ImapSequenceSet::clear (void) {
+    m_ranges.clear();
+}
+
+void ImapSequenceSet::squeeze (void) {
+    m_ranges.squeeze();
+}
+
+QString ImapSequenceSet::toString (void) const {
+    QString text;
+    text.reserve(m_ranges.size() * 6);
+
+    for (int i = 0; i < m_ranges.size(); i += 2) {
+        if (i > 0) text += ',';
+        text += QString::number(m_ranges[i]);
+        if (m_ranges[i + 1] != m_ranges[i]) {
+            text += ':';
+            text += QString::number(m_ranges[i + 1]);
+        }
+    }
+
+    return(text);
+}
+
+/**
+ * The values of the set, for sets of known size. Returns an empty
+ * list above 16M values, as for ranges ending at '*' (4294967295).
+ */
+QList<int> ImapSequenceSet::toList (void) const {
+    QList<int> list;
+    if (count() > IMAP_SEQUENCE_LIST_MAX)
+        return(list);
+
+    list.reserve((int)count());
+    for (int i = 0; i < m_ranges.size(); i += 2) {
+        for (quint64 value = m_ranges[i]; value <= m_ranges[i + 1]; ++value)
+            list.append((int)value);
+    }
+    return(list);
+}
+
+/**
+ * Split in sets whose toString() fits in maxLength characters, for
+ * servers limiting the command line length. Ranges are never cut:
+ * a single range longer than maxLength makes a set of its own.
+ */
+QList<ImapSequenceSet> ImapSequenceSet::split (int maxLength) const {
+    QList<ImapSequenceSet> parts;
+    ImapSequenceSet part;
+    int length = 0;
+
+    for (int i = 0; i < m_ranges.size(); i += 2) {
+        int rangeLength = _sequenceDigits(m_ranges[i]);
+        if (m_ranges[i + 1] != m_ranges[i])
+            rangeLength += 1 + _sequenceDigits(m_ranges[i + 1]);
+
+        if (!part.isEmpty() && length + 1 + rangeLength > maxLength) {
+            parts.append(part);
+            part.clear();
+        }
+
+        length = part.isEmpty() ? rangeLength : (length + 1 + rangeLength);
+        part.m_ranges.append(m_ranges[i]);
+        part.m_ranges.append(m_ranges[i + 1]);
+    }
+
+    if (!part.isEmpty())
+        parts.append(part);
+    return(parts);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapSequenceSet::isEmpty (void) const {
+    return(m_ranges.isEmpty());
+}
+
+quint64 ImapSequenceSet::count (void) const {
+    quint64 total = 0;
+    for (int i = 0; i < m_ranges.size(); i += 2)
+        total += (quint64)(m_ranges[i + 1] - m_ranges[i]) + 1;
+    return(total);
+}
+
+uint ImapSequenceSet::first (void) const {
+    return(m_ranges.isEmpty() ? 0 : m_ranges.first());
+}
+
+uint ImapSequenceSet::last (void) const {
+    return(m_ranges.isEmpty() ? 0 : m_ranges.last());
+}
+
+int ImapSequenceSet::rangeCount (void) const {
+    return(m_ranges.size() / 2);
+}
+
+uint ImapSequenceSet::rangeFirst (int index) const {
+    return(m_ranges[index * 2]);
+}
+
+uint ImapSequenceSet::rangeLast (int index) const {
+    return(m_ranges[index * 2 + 1]);
+}
+
+bool ImapSequenceSet::operator== (const ImapSequenceSet& other) const {
+    return(m_ranges == other.m_ranges);
+}
+
+bool ImapSequenceSet::operator!= (const ImapSequenceSet& other) const {
+    return(m_ranges != other.m_ranges);
+}
+
+// ===========================================================================
+//  PRIVATE Methods
+// ===========================================================================
+int ImapSequenceSet::findRange (uint value) const {
+    int lo = 0;
+    int hi = m_ranges.size() / 2;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_ranges[mid * 2 + 1] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < m_ranges.size() / 2 && m_ranges[lo * 2] <= value)
+        return(lo);
+    return(-1);
+}
+
+// ===========================================================================
+//  DataStream Operators
+// ===========================================================================
+QDataStream& operator<< (QDataStream& stream, const ImapSequenceSet& set) {
+    stream << (quint32)set.rangeCount();
+    for (int i = 0; i < set.rangeCount(); ++i)
+        stream << (quint32)set.rangeFirst(i) << (quint32)set.rangeLast(i);
+    return(stream);
+}
+
+QDataStream& operator>> (QDataStream& stream, ImapSequenceSet& set) {
+    quint32 count;
+    stream >> count;
+
+    set.clear();
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint32 first, last;
+        stream >> first >> last;
+        set.add(first, last);
+    }
+    return(stream);
+}
+
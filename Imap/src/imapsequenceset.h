@@ -0,0 +1,72 @@
+#ifndef _IMAP_SEQUENCE_SET_H_
+#define _IMAP_SEQUENCE_SET_H_
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QMetaType>
+#include <QVector>
+#include <QString>
+#include <QList>
+
+/**
+ * Set of message numbers or UIDs, stored as sorted non-overlapping runs
+ * (first, last). "1:5,7,9:12" takes three runs regardless of its size.
+ */
+class ImapSequenceSet {
+    public:
+        ImapSequenceSet();
+        ImapSequenceSet (uint value);
+        ImapSequenceSet (uint first, uint last);
+
+        static ImapSequenceSet fromString (const QByteArray& text);
+        static ImapSequenceSet fromList (const QList<int>& values);
+
+        // Methods
+        void add (uint value);
+        void add (uint first, uint last);
+        void add (const ImapSequenceSet& other);
+
+        void remove (uint value);
+        void remove (const ImapSequenceSet& other);
+
+        ImapSequenceSet subtracted (const ImapSequenceSet& other) const;
+        ImapSequenceSet intersected (const ImapSequenceSet& other) const;
+
+        bool contains (uint value) const;
+
+        void clear (void);
+        void squeeze (void);
+
+        QString toString (void) const;
+        QList<int> toList (void) const;
+        QList<ImapSequenceSet> split (int maxLength) const;
+
+        // Properties
+        bool isEmpty (void) const;
+        quint64 count (void) const;
+
+        uint first (void) const;
+        uint last (void) const;
+
+        int rangeCount (void) const;
+        uint rangeFirst (int index) const;
+        uint rangeLast (int index) const;
+
+        bool operator== (const ImapSequenceSet& other) const;
+        bool operator!= (const ImapSequenceSet& other) const;
+
+    private:
+        int findRange (uint value) const;
+
+    private:
+        // first0, last0, first1, last1, ...
+        QVector<uint> m_ranges;
+};
+
+QDataStream& operator<< (QDataStream& stream, const ImapSequenceSet& set);
+QDataStream& operator>> (QDataStream& stream, ImapSequenceSet& set);
+
+Q_DECLARE_METATYPE(ImapSequenceSet)
+
+#endif /* !_IMAP_SEQUENCE_SET_H_ */
+
@@ -0,0 +1,307 @@
+#include <QtAlgorithms>
+#include <QStringList>
+#include <QVector>
+
+#include "imapaddress.h"
+#include "imapthread.h"
+#include "imapsort.h"
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapSorterPrivate {
+    public:
+        const ImapListing *listing;
+        ImapSortCriteria criteria;
+        bool valid;
+
+        // Listing rows, sorted.
+        QVector<int> order;
+
+        // Sort keys by row, one column per criterion:
+        // numbers for dates and sizes, texts for subjects and senders.
+        QVector<QVector<uint> > numbers;
+        QVector<QVector<QString> > texts;
+
+    public:
+        void extract (int from, int to);
+        int compare (int a, int b) const;
+};
+
+void ImapSorterPrivate::extract (int from, int to) {
+    for (int i = 0; i < criteria.count(); ++i) {
+        switch (criteria.key(i)) {
+            case ImapSortCriteria::Arrival:
+            case ImapSortCriteria::Date:
+                numbers[i].resize(to);
+                for (int row = from; row < to; ++row)
+                    numbers[i][row] = listing->received(row).toTime_t();
+                break;
+            case ImapSortCriteria::Size:
+                numbers[i].resize(to);
+                for (int row = from; row < to; ++row)
+                    numbers[i][row] = listing->size(row);
+                break;
+            case ImapSortCriteria::Subject:
+                texts[i].resize(to);
+                for (int row = from; row < to; ++row)
+                    texts[i][row] = ImapThreader::baseSubject(listing->subject(row));
+                break;
+            case ImapSortCriteria::From:
+                // RFC 5256: the mailbox of the first From address.
+                texts[i].resize(to);
+                for (int row = from; row < to; ++row)
+                    texts[i][row] = listing->fromAddress(row).address().section('@', 0, 0).toLower();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int ImapSorterPrivate::compare (int a, int b) const {
+    for (int i = 0; i < criteria.count(); ++i) {
+        ImapSortCriteria::Key key = criteria.key(i);
+        int result;
+        if (key == ImapSortCriteria::Subject || key == ImapSortCriteria::From) {
+            result = texts[i][a].compare(texts[i][b]);
+        } else {
+            uint x = numbers[i][a];
+            uint y = numbers[i][b];
+            result = (x < y) ? -1 : (x > y ? 1 : 0);
+        }
+
+        if (result != 0)
+            return(criteria.isReverse(i) ? -result : result);
+    }
+    return(a - b);
+}
+
+class ImapSorterLessThan {
+    public:
+        ImapSorterLessThan (const ImapSorterPrivate *sorter)
+            : m_sorter(sorter)
+        {
+        }
+
+        bool operator() (int a, int b) const {
+            return(m_sorter->compare(a, b) < 0);
+        }
+
+    private:
+        const ImapSorterPrivate *m_sorter;
+};
+
+// ===========================================================================
+//  ImapSortCriteria
+// ===========================================================================
+ImapSortCriteria::ImapSortCriteria() {
+}
+
+ImapSortCriteria::ImapSortCriteria (Key key, bool reverse) {
+    append(key, reverse);
+}
+
+QString ImapSortCriteria::keyName (Key key) {
+    switch (key) {
+        case Arrival:   return("ARRIVAL");
+        case Cc:        return("CC");
+        case Date:      return("DATE");
+        case From:      return("FROM");
+        case Size:      return("SIZE");
+        case Subject:   return("SUBJECT");
+        case To:        return("TO");
+    }
+    return(QString());
+}
+
+/**
+ * Add a less significant key.
+ */
+void ImapSortCriteria::append (Key key, bool reverse) {
+    m_keys.append(key);
+    m_reverse.append(reverse);
+}
+
+void ImapSortCriteria::clear (void) {
+    m_keys.clear();
+    m_reverse.clear();
+}
+
+/**
+ * The criteria in SORT syntax: "(REVERSE DATE SUBJECT)".
+ */
+QString ImapSortCriteria::toString (void) const {
+    QStringList items;
+    for (int i = 0; i < m_keys.size(); ++i) {
+        if (m_reverse[i])
+            items.append("REVERSE");
+        items.append(keyName(m_keys[i]));
+    }
+    return(QString("(%1)").arg(items.join(" ")));
+}
+
+bool ImapSortCriteria::isEmpty (void) const {
+    return(m_keys.isEmpty());
+}
+
+int ImapSortCriteria::count (void) const {
+    return(m_keys.size());
+}
+
+ImapSortCriteria::Key ImapSortCriteria::key (int index) const {
+    return(m_keys.at(index));
+}
+
+bool ImapSortCriteria::isReverse (int index) const {
+    return(m_reverse.at(index));
+}
+
+// ===========================================================================
+//  ImapSorter
+// ===========================================================================
+/**
+ * Sort the rows of listing, which must have the listingFields()
+ * of criteria. The listing is not owned.
+ */
+ImapSorter::ImapSorter (const ImapListing *listing, const ImapSortCriteria& criteria)
+    : d(new ImapSorterPrivate)
+{
+    d->listing = listing;
+    d->criteria = criteria;
+    d->numbers.resize(criteria.count());
+    d->texts.resize(criteria.count());
+
+    ImapListing::Fields fields = listingFields(criteria);
+    d->valid = isSupported(criteria) && (listing->fields() & fields) == fields;
+}
+
+ImapSorter::~ImapSorter() {
+    delete d;
+}
+
+bool ImapSorter::isSupported (const ImapSortCriteria& criteria) {
+    if (criteria.isEmpty())
+        return(false);
+
+    for (int i = 0; i < criteria.count(); ++i) {
+        ImapSortCriteria::Key key = criteria.key(i);
+        if (key == ImapSortCriteria::Cc || key == ImapSortCriteria::To)
+            return(false);
+    }
+    return(true);
+}
+
+/**
+ * Listing fields holding the keys of criteria, and the UIDs.
+ */
+ImapListing::Fields ImapSorter::listingFields (const ImapSortCriteria& criteria) {
+    ImapListing::Fields fields = ImapListing::Uid;
+    for (int i = 0; i < criteria.count(); ++i) {
+        switch (criteria.key(i)) {
+            case ImapSortCriteria::Arrival:
+            case ImapSortCriteria::Date:
+                fields |= ImapListing::InternalDate;
+                break;
+            case ImapSortCriteria::From:
+                fields |= ImapListing::From;
+                break;
+            case ImapSortCriteria::Size:
+                fields |= ImapListing::Size;
+                break;
+            case ImapSortCriteria::Subject:
+                fields |= ImapListing::Subject;
+                break;
+            default:
+                break;
+        }
+    }
+    return(fields);
+}
+
+/**
+ * Sort the rows appended to the listing since the last update,
+ * and merge them with the rows already sorted.
+ */
+void ImapSorter::update (void) {
+    if (!d->valid)
+        return;
+
+    int rows = d->listing->count();
+    if (rows < d->order.size())
+        reset();
+
+    int sorted = d->order.size();
+    if (rows == sorted)
+        return;
+
+    d->extract(sorted, rows);
+
+    QVector<int> added(rows - sorted);
+    for (int i = 0; i < added.size(); ++i)
+        added[i] = sorted + i;
+
+    ImapSorterLessThan lessThan(d);
+    qSort(added.begin(), added.end(), lessThan);
+
+    if (sorted == 0) {
+        d->order = added;
+        return;
+    }
+
+    QVector<int> merged;
+    merged.reserve(rows);
+
+    int i = 0, j = 0;
+    while (i < sorted && j < added.size()) {
+        if (lessThan(added[j], d->order[i]))
+            merged.append(added[j++]);
+        else
+            merged.append(d->order[i++]);
+    }
+    while (i < sorted)
+        merged.append(d->order[i++]);
+    while (j < added.size())
+        merged.append(added[j++]);
+
+    d->order = merged;
+}
+
+/**
+ * Forget the sorted rows, for a listing cleared or refetched.
+ */
+void ImapSorter::reset (void) {
+    d->order.clear();
+    for (int i = 0; i < d->criteria.count(); ++i) {
+        d->numbers[i].clear();
+        d->texts[i].clear();
+    }
+}
+
+bool ImapSorter::isValid (void) const {
+    return(d->valid);
+}
+
+int ImapSorter::count (void) const {
+    return(d->order.size());
+}
+
+/**
+ * Listing row at position in the sort order.
+ */
+int ImapSorter::indexAt (int position) const {
+    return(d->order.at(position));
+}
+
+uint ImapSorter::uidAt (int position) const {
+    return(d->listing->uid(d->order.at(position)));
+}
+
+QList<uint> ImapSorter::uids (void) const {
+    QList<uint> uids;
+    uids.reserve(d->order.size());
+    foreach (int row, d->order)
+        uids.append(d->listing->uid(row));
+    return(uids);
+}
+
@@ -0,0 +1,90 @@
+#ifndef _IMAP_SORT_H_
+#define _IMAP_SORT_H_
+
+#include <QString>
+#include <QList>
+
+#include "imaplisting.h"
+
+class ImapSorterPrivate;
+
+/**
+ * Sort criteria of a SORT command (RFC 5256), most significant first:
+ *
+ *   ImapSortCriteria criteria(ImapSortCriteria::Date, true);
+ *   criteria.append(ImapSortCriteria::Subject);    // (REVERSE DATE SUBJECT)
+ */
+class ImapSortCriteria {
+    public:
+        enum Key {
+            Arrival,
+            Cc,
+            Date,
+            From,
+            Size,
+            Subject,
+            To
+        };
+
+    public:
+        ImapSortCriteria();
+        ImapSortCriteria (Key key, bool reverse = false);
+
+        static QString keyName (Key key);
+
+        // Methods
+        void append (Key key, bool reverse = false);
+        void clear (void);
+
+        QString toString (void) const;
+
+        // Properties
+        bool isEmpty (void) const;
+        int count (void) const;
+
+        Key key (int index) const;
+        bool isReverse (int index) const;
+
+    private:
+        QList<Key> m_keys;
+        QList<bool> m_reverse;
+};
+
+/**
+ * Client side SORT over an ImapListing, when the server has none.
+ *
+ * The sort keys of each row are extracted once. update() sorts only
+ * the rows appended to the listing since the previous call and merges
+ * them in, so a listing that grows is never sorted again from
+ * scratch. Ties keep the listing (sequence number) order.
+ *
+ * Cc and To are not in a listing: criteria using them are invalid.
+ * Date falls back on the internal date, the only one listed.
+ */
+class ImapSorter {
+    public:
+        ImapSorter (const ImapListing *listing, const ImapSortCriteria& criteria);
+        ~ImapSorter();
+
+        static bool isSupported (const ImapSortCriteria& criteria);
+        static ImapListing::Fields listingFields (const ImapSortCriteria& criteria);
+
+        // Methods
+        void update (void);
+        void reset (void);
+
+        // Properties
+        bool isValid (void) const;
+        int count (void) const;
+
+        int indexAt (int position) const;
+        uint uidAt (int position) const;
+        QList<uint> uids (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapSorter)
+
+        ImapSorterPrivate *d;
+};
+
+#endif /* !_IMAP_SORT_H_ */
@@ -0,0 +1,204 @@
+#include "imapstats.h"
+
+#define IMAP_STATS_HISTORY_SIZE         (256)
+
+// ===========================================================================
+//  ImapCommandStats
+// ===========================================================================
+ImapCommandStats::ImapCommandStats()
+    : m_bytesOut(0), m_bytesIn(0), m_firstByteTime(0), m_completeTime(0),
+      m_sendTime(0), m_waitTime(0), m_lines(0), m_count(0), m_failed(0)
+{
+}
+
+ImapCommandStats::ImapCommandStats (const QString& command)
+    : m_command(command), m_bytesOut(0), m_bytesIn(0), m_firstByteTime(0),
+      m_completeTime(0), m_sendTime(0), m_waitTime(0), m_lines(0),
+      m_count(1), m_failed(0)
+{
+}
+
+void ImapCommandStats::add (const ImapCommandStats& other) {
+    m_firstByteTime += other.m_firstByteTime;
+    m_completeTime += other.m_completeTime;
+    m_sendTime += other.m_sendTime;
+    m_waitTime += other.m_waitTime;
+    m_bytesOut += other.m_bytesOut;
+    m_bytesIn += other.m_bytesIn;
+    m_failed += other.m_failed;
+    m_lines += other.m_lines;
+    m_count += other.m_count;
+}
+
+QString ImapCommandStats::command (void) const {
+    return(m_command);
+}
+
+void ImapCommandStats::setCommand (const QString& command) {
+    m_command = command;
+}
+
+int ImapCommandStats::count (void) const {
+    return(m_count);
+}
+
+/**
+ * Tagged OK, for totals: none of the commands failed.
+ */
+bool ImapCommandStats::isOk (void) const {
+    return(m_failed == 0);
+}
+
+void ImapCommandStats::setOk (bool ok) {
+    m_failed = ok ? 0 : 1;
+}
+
+int ImapCommandStats::sendTime (void) const {
+    return(m_sendTime);
+}
+
+void ImapCommandStats::setSendTime (int msecs) {
+    m_sendTime = msecs;
+}
+
+int ImapCommandStats::firstByteTime (void) const {
+    return(m_firstByteTime);
+}
+
+void ImapCommandStats::setFirstByteTime (int msecs) {
+    m_firstByteTime = msecs;
+}
+
+int ImapCommandStats::completeTime (void) const {
+    return(m_completeTime);
+}
+
+void ImapCommandStats::setCompleteTime (int msecs) {
+    m_completeTime = msecs;
+}
+
+int ImapCommandStats::waitTime (void) const {
+    return(m_waitTime);
+}
+
+void ImapCommandStats::addWaitTime (int msecs) {
+    m_waitTime += msecs;
+}
+
+int ImapCommandStats::processTime (void) const {
+    return(qMax(0, m_completeTime - m_sendTime - m_waitTime));
+}
+
+qint64 ImapCommandStats::bytesIn (void) const {
+    return(m_bytesIn);
+}
+
+void ImapCommandStats::addBytesIn (qint64 bytes) {
+    m_bytesIn += bytes;
+}
+
+qint64 ImapCommandStats::bytesOut (void) const {
+    return(m_bytesOut);
+}
+
+void ImapCommandStats::addBytesOut (qint64 bytes) {
+    m_bytesOut += bytes;
+}
+
+int ImapCommandStats::lines (void) const {
+    return(m_lines);
+}
+
+void ImapCommandStats::addLines (int lines) {
+    m_lines += lines;
+}
+
+// ===========================================================================
+//  ImapStats
+// ===========================================================================
+ImapStats::ImapStats()
+    : m_historySize(IMAP_STATS_HISTORY_SIZE)
+{
+}
+
+ImapStats::~ImapStats() {
+}
+
+void ImapStats::clear (void) {
+    m_total = ImapCommandStats();
+    m_commands.clear();
+    m_history.clear();
+}
+
+/**
+ * Add a finished command to the totals and the history.
+ */
+void ImapStats::record (const ImapCommandStats& stats) {
+    m_total.add(stats);
+
+    int i = 0;
+    while (i < m_commands.size() && m_commands[i].command() != stats.command())
+        i++;
+    if (i == m_commands.size())
+        m_commands.append(ImapCommandStats());
+    m_commands[i].add(stats);
+    m_commands[i].setCommand(stats.command());
+
+    if (m_historySize > 0) {
+        if (m_history.size() >= m_historySize)
+            m_history.removeFirst();
+        m_history.append(stats);
+    }
+
+    commandFinished(stats);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+ImapCommandStats ImapStats::total (void) const {
+    return(m_total);
+}
+
+ImapCommandStats ImapStats::total (const QString& command) const {
+    foreach (const ImapCommandStats& stats, m_commands) {
+        if (stats.command() == command)
+            return(stats);
+    }
+    return(ImapCommandStats());
+}
+
+QStringList ImapStats::commands (void) const {
+    QStringList names;
+    foreach (const ImapCommandStats& stats, m_commands)
+        names.append(stats.command());
+    return(names);
+}
+
+QList<ImapCommandStats> ImapStats::history (void) const {
+    return(m_history);
+}
+
+int ImapStats::historySize (void) const {
+    return(m_historySize);
+}
+
+/**
+ * Number of recent commands kept, 0 to keep only totals.
+ */
+void ImapStats::setHistorySize (int commands) {
+    m_historySize = commands;
+    while (m_history.size() > qMax(commands, 0))
+        m_history.removeFirst();
+}
+
+// ===========================================================================
+//  PROTECTED Methods
+// ===========================================================================
+/**
+ * Called after each command, once recorded. Does nothing by default.
+ */
+void ImapStats::commandFinished (const ImapCommandStats& stats) {
+    Q_UNUSED(stats)
+}
+
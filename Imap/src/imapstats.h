@@ -0,0 +1,106 @@
+#ifndef _IMAP_STATS_H_
+#define _IMAP_STATS_H_
+
+#include <QStringList>
+#include <QString>
+#include <QList>
+
+/**
+ * Timings and sizes of a command, from sending it to its tagged
+ * response (times in ms, from the start of the command):
+ *
+ *   sendTime       writing the command (and literals)
+ *   firstByteTime  first response line received
+ *   completeTime   tagged response received
+ *   waitTime       blocked waiting for the server (waitForReadyRead)
+ *   processTime    the rest: reading and parsing the responses
+ *
+ * Totals (ImapStats::total()) sum the values of count() commands.
+ */
+class ImapCommandStats {
+    public:
+        ImapCommandStats();
+        ImapCommandStats (const QString& command);
+
+        void add (const ImapCommandStats& other);
+
+        QString command (void) const;
+        void setCommand (const QString& command);
+
+        int count (void) const;
+        bool isOk (void) const;
+        void setOk (bool ok);
+
+        int sendTime (void) const;
+        void setSendTime (int msecs);
+
+        int firstByteTime (void) const;
+        void setFirstByteTime (int msecs);
+
+        int completeTime (void) const;
+        void setCompleteTime (int msecs);
+
+        int waitTime (void) const;
+        void addWaitTime (int msecs);
+
+        int processTime (void) const;
+
+        qint64 bytesIn (void) const;
+        void addBytesIn (qint64 bytes);
+
+        qint64 bytesOut (void) const;
+        void addBytesOut (qint64 bytes);
+
+        int lines (void) const;
+        void addLines (int lines);
+
+    private:
+        QString m_command;
+        qint64 m_bytesOut;
+        qint64 m_bytesIn;
+        int m_firstByteTime;
+        int m_completeTime;
+        int m_sendTime;
+        int m_waitTime;
+        int m_lines;
+        int m_count;
+        int m_failed;
+};
+
+/**
+ * Instrumentation of an Imap connection (Imap::setStats()), per
+ * command name ("SELECT", "UID FETCH"): totals and the most recent
+ * commands. Arguments are never recorded.
+ *
+ * Reimplement commandFinished() to be notified of each command.
+ * Without stats the client only pays a NULL check.
+ */
+class ImapStats {
+    public:
+        ImapStats();
+        virtual ~ImapStats();
+
+        void clear (void);
+        void record (const ImapCommandStats& stats);
+
+        // Properties
+        ImapCommandStats total (void) const;
+        ImapCommandStats total (const QString& command) const;
+        QStringList commands (void) const;
+
+        QList<ImapCommandStats> history (void) const;
+        int historySize (void) const;
+        void setHistorySize (int commands);
+
+    protected:
+        virtual void commandFinished (const ImapCommandStats& stats);
+
+    private:
+        QList<ImapCommandStats> m_commands;
+        QList<ImapCommandStats> m_history;
+        ImapCommandStats m_total;
+        int m_historySize;
+};
+
+#endif /* !_IMAP_STATS_H_ */
+
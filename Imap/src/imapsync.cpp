@@ -0,0 +1,251 @@
+#include "imapmailbox.h"
+#include "imapsync.h"
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor (State)
+// ===========================================================================
+ImapSyncState::ImapSyncState() {
+    clear();
+}
+
+ImapSyncState::ImapSyncState (const QString& mailbox) {
+    clear();
+    m_mailbox = mailbox;
+}
+
+// ===========================================================================
+//  PUBLIC Methods (State)
+// ===========================================================================
+/**
+ * Forget everything but the mailbox name.
+ */
+void ImapSyncState::clear (void) {
+    m_highestModSeq = 0;
+    m_uidValidity = 0;
+    m_uidNext = 0;
+    m_flags.clear();
+    m_uids.clear();
+}
+
+// ===========================================================================
+//  PUBLIC Properties (State)
+// ===========================================================================
+QString ImapSyncState::mailbox (void) const {
+    return(m_mailbox);
+}
+
+void ImapSyncState::setMailbox (const QString& mailbox) {
+    m_mailbox = mailbox;
+}
+
+quint32 ImapSyncState::uidValidity (void) const {
+    return(m_uidValidity);
+}
+
+void ImapSyncState::setUidValidity (quint32 uidValidity) {
+    m_uidValidity = uidValidity;
+}
+
+quint32 ImapSyncState::uidNext (void) const {
+    return(m_uidNext);
+}
+
+void ImapSyncState::setUidNext (quint32 uidNext) {
+    m_uidNext = uidNext;
+}
+
+quint64 ImapSyncState::highestModSeq (void) const {
+    return(m_highestModSeq);
+}
+
+void ImapSyncState::setHighestModSeq (quint64 modSeq) {
+    m_highestModSeq = modSeq;
+}
+
+ImapSequenceSet ImapSyncState::uids (void) const {
+    return(m_uids);
+}
+
+void ImapSyncState::setUids (const ImapSequenceSet& uids) {
+    m_uids = uids;
+}
+
+bool ImapSyncState::hasFlags (uint uid) const {
+    return(m_flags.contains(uid));
+}
+
+ImapMessageFlags ImapSyncState::flags (uint uid) const {
+    return(m_flags.value(uid, 0));
+}
+
+void ImapSyncState::setFlags (uint uid, ImapMessageFlags flags) {
+    m_flags.insert(uid, flags);
+}
+
+void ImapSyncState::removeFlags (const ImapSequenceSet& uids) {
+    QHash<uint, ImapMessageFlags>::iterator it = m_flags.begin();
+    while (it != m_flags.end()) {
+        if (uids.contains(it.key())) it = m_flags.erase(it); else ++it;
+    }
+}
+
+// ===========================================================================
+//  DataStream Operators (State)
+// ===========================================================================
+/* Flags follow the UIDs: system flags, then the keyword names, since
+ * keyword bits are only valid in the process that interned them.
+ * States written before have no flags, their first synchronization
+ * reports every flag once. */
+QDataStream& operator<< (QDataStream& stream, const ImapSyncState& state) {
+    stream << state.mailbox();
+    stream << state.uidValidity() << state.uidNext() << state.highestModSeq();
+    stream << state.uids();
+
+    ImapSequenceSet uids = state.uids();
+    QList<QByteArray> keywords;
+    quint32 count = 0;
+    for (int i = 0; i < uids.rangeCount(); ++i) {
+        for (quint64 uid = uids.rangeFirst(i); uid <= uids.rangeLast(i); ++uid) {
+            if (state.hasFlags((uint)uid))
+                count++;
+        }
+    }
+
+    stream << count;
+    for (int i = 0; i < uids.rangeCount(); ++i) {
+        for (quint64 uid = uids.rangeFirst(i); uid <= uids.rangeLast(i); ++uid) {
+            if (!state.hasFlags((uint)uid))
+                continue;
+
+            ImapMessageFlags flags = state.flags((uint)uid);
+            keywords.clear();
+            for (uint bit = ImapMessageFirstKeyword; bit != 0; bit <<= 1) {
+                if (flags & bit)
+                    keywords.append(ImapMessage::keywordName(bit));
+            }
+            stream << (quint32)uid << (quint32)(flags & ImapMessageSystemFlags) << keywords;
+        }
+    }
+    return(stream);
+}
+
+QDataStream& operator>> (QDataStream& stream, ImapSyncState& state) {
+    quint32 uidValidity, uidNext;
+    ImapSequenceSet uids;
+    quint64 modSeq;
+    QString mailbox;
+
+    stream >> mailbox >> uidValidity >> uidNext >> modSeq >> uids;
+    state.clear();
+    state.setMailbox(mailbox);
+    state.setUidValidity(uidValidity);
+    state.setUidNext(uidNext);
+    state.setHighestModSeq(modSeq);
+    state.setUids(uids);
+
+    if (stream.atEnd())
+        return(stream);
+
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QList<QByteArray> keywords;
+        quint32 uid, system;
+        stream >> uid >> system >> keywords;
+
+        ImapMessageFlags flags = system & ImapMessageSystemFlags;
+        foreach (const QByteArray& keyword, keywords)
+            flags |= ImapMessage::keywordFlag(keyword);
+        state.setFlags(uid, flags);
+    }
+    return(stream);
+}
+
+// ===========================================================================
+//  PRIVATE Class (Delta)
+// ===========================================================================
+class ImapSyncDeltaPrivate {
+    public:
+        QHash<uint, ImapMessageFlags> changed;
+        ImapSequenceSet removed;
+        ImapMailbox added;
+        quint32 uidValidity;
+        bool reset;
+};
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor (Delta)
+// ===========================================================================
+ImapSyncDelta::ImapSyncDelta()
+    : d(new ImapSyncDeltaPrivate)
+{
+    d->uidValidity = 0;
+    d->reset = false;
+}
+
+ImapSyncDelta::~ImapSyncDelta() {
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC Methods (Delta)
+// ===========================================================================
+void ImapSyncDelta::clear (void) {
+    d->added.clearMessages();
+    d->changed.clear();
+    d->removed.clear();
+    d->uidValidity = 0;
+    d->reset = false;
+}
+
+bool ImapSyncDelta::isEmpty (void) const {
+    return(!d->reset && d->added.messages().isEmpty() &&
+           d->removed.isEmpty() && d->changed.isEmpty());
+}
+
+// ===========================================================================
+//  PUBLIC Properties (Delta)
+// ===========================================================================
+bool ImapSyncDelta::isReset (void) const {
+    return(d->reset);
+}
+
+void ImapSyncDelta::setReset (bool reset) {
+    d->reset = reset;
+}
+
+/**
+ * UIDVALIDITY of the mailbox, the new one on a reset.
+ */
+quint32 ImapSyncDelta::uidValidity (void) const {
+    return(d->uidValidity);
+}
+
+void ImapSyncDelta::setUidValidity (quint32 uidValidity) {
+    d->uidValidity = uidValidity;
+}
+
+/**
+ * New messages, owned by the delta.
+ * Use ImapMailbox::takeAt() to keep them.
+ */
+ImapMailbox *ImapSyncDelta::added (void) const {
+    return(&d->added);
+}
+
+ImapSequenceSet ImapSyncDelta::removed (void) const {
+    return(d->removed);
+}
+
+void ImapSyncDelta::addRemoved (const ImapSequenceSet& uids) {
+    d->removed.add(uids);
+}
+
+QHash<uint, ImapMessageFlags> ImapSyncDelta::changed (void) const {
+    return(d->changed);
+}
+
+void ImapSyncDelta::addChanged (uint uid, ImapMessageFlags flags) {
+    d->changed.insert(uid, flags);
+}
+
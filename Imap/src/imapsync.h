@@ -0,0 +1,91 @@
+#ifndef _IMAP_SYNC_H_
+#define _IMAP_SYNC_H_
+
+#include <QString>
+#include <QHash>
+
+#include "imapsequenceset.h"
+#include "imapmessage.h"
+
+/**
+ * What the client knows about a mailbox between two synchronizations:
+ * its UIDs and their last known flags, compared with the server's when
+ * it doesn't support CONDSTORE. Serialize it with QDataStream to
+ * resume across runs.
+ */
+class ImapSyncState {
+    public:
+        ImapSyncState();
+        ImapSyncState (const QString& mailbox);
+
+        void clear (void);
+
+        QString mailbox (void) const;
+        void setMailbox (const QString& mailbox);
+
+        quint32 uidValidity (void) const;
+        void setUidValidity (quint32 uidValidity);
+
+        quint32 uidNext (void) const;
+        void setUidNext (quint32 uidNext);
+
+        quint64 highestModSeq (void) const;
+        void setHighestModSeq (quint64 modSeq);
+
+        ImapSequenceSet uids (void) const;
+        void setUids (const ImapSequenceSet& uids);
+
+        bool hasFlags (uint uid) const;
+        ImapMessageFlags flags (uint uid) const;
+        void setFlags (uint uid, ImapMessageFlags flags);
+        void removeFlags (const ImapSequenceSet& uids);
+
+    private:
+        QHash<uint, ImapMessageFlags> m_flags;
+        ImapSequenceSet m_uids;
+        quint64 m_highestModSeq;
+        quint32 m_uidValidity;
+        quint32 m_uidNext;
+        QString m_mailbox;
+};
+
+QDataStream& operator<< (QDataStream& stream, const ImapSyncState& state);
+QDataStream& operator>> (QDataStream& stream, ImapSyncState& state);
+
+/**
+ * Changes found by Imap::synchronize(): new messages (with envelope),
+ * UIDs removed from the server and UIDs whose flags changed.
+ */
+class ImapMailbox;
+class ImapSyncDeltaPrivate;
+class ImapSyncDelta {
+    public:
+        ImapSyncDelta();
+        ~ImapSyncDelta();
+
+        void clear (void);
+        bool isEmpty (void) const;
+
+        // UIDVALIDITY changed, every known message was removed.
+        bool isReset (void) const;
+        void setReset (bool reset);
+
+        quint32 uidValidity (void) const;
+        void setUidValidity (quint32 uidValidity);
+
+        ImapMailbox *added (void) const;
+
+        ImapSequenceSet removed (void) const;
+        void addRemoved (const ImapSequenceSet& uids);
+
+        QHash<uint, ImapMessageFlags> changed (void) const;
+        void addChanged (uint uid, ImapMessageFlags flags);
+
+    private:
+        Q_DISABLE_COPY(ImapSyncDelta)
+
+        ImapSyncDeltaPrivate *d;
+};
+
+#endif /* !_IMAP_SYNC_H_ */
+
@@ -0,0 +1,919 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QThreadPool>
+#include <QTextCodec>
+#include <QRunnable>
+#include <QVector>
+#include <QMutex>
+#include <QFileInfo>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QDir>
+
+#include <string.h>
+
+#include "imaptextindex.h"
+#include "imapbodystructure.h"
+#include "imapaddress.h"
+#include "imapmessage.h"
+#include "imapcache.h"
+
+#define IMAP_INDEX_SEGMENT_MAGIC        (0x31535449)        // "ITS1"
+#define IMAP_INDEX_MANIFEST_MAGIC       (0x314d5449)        // "ITM1"
+#define IMAP_INDEX_VERSION              (2)
+
+#define IMAP_INDEX_MIN_WORD             (2)
+#define IMAP_INDEX_MAX_WORD             (32)
+
+// Prefix of the terms of the envelope, never part of a word.
+#define IMAP_INDEX_HEADER_PREFIX        '#'
+
+// Flush the buffer as a new segment past this many postings.
+#define IMAP_INDEX_BUFFER_POSTINGS      (256 * 1024)
+#define IMAP_INDEX_MERGE_THRESHOLD      (8)
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+static void _indexWriteVarint (QByteArray *data, quint32 value) {
+    while (value >= 0x80) {
+        data->append((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data->append((char)value);
+}
+
+static quint32 _indexReadVarint (const uchar **p, const uchar *end) {
+    quint32 value = 0;
+    int shift = 0;
+
+    while (*p < end && shift < 35) {
+        uchar c = *(*p)++;
+        value |= (quint32)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            break;
+        shift += 7;
+    }
+    return(value);
+}
+
+/* Sorted UIDs, delta encoded. */
+static QByteArray _indexEncodePostings (const QVector<uint>& uids) {
+    QByteArray data;
+    data.reserve(uids.size() * 2);
+
+    uint last = 0;
+    foreach (uint uid, uids) {
+        _indexWriteVarint(&data, uid - last);
+        last = uid;
+    }
+    return(data);
+}
+
+static void _indexDecodePostings (const uchar *p, const uchar *end,
+                                  quint32 count, QVector<uint> *uids)
+{
+    uids->reserve(uids->size() + count);
+
+    uint last = 0;
+    for (quint32 i = 0; i < count && p < end; ++i) {
+        last += _indexReadVarint(&p, end);
+        uids->append(last);
+    }
+}
+
+static QByteArray _indexEncodeSet (const ImapSequenceSet& set) {
+    QByteArray data;
+    _indexWriteVarint(&data, set.rangeCount());
+
+    uint last = 0;
+    for (int i = 0; i < set.rangeCount(); ++i) {
+        _indexWriteVarint(&data, set.rangeFirst(i) - last);
+        _indexWriteVarint(&data, set.rangeLast(i) - set.rangeFirst(i));
+        last = set.rangeLast(i);
+    }
+    return(data);
+}
+
+static ImapSequenceSet _indexDecodeSet (const uchar **p, const uchar *end) {
+    ImapSequenceSet set;
+    quint32 count = _indexReadVarint(p, end);
+
+    uint last = 0;
+    for (quint32 i = 0; i < count && *p < end; ++i) {
+        uint first = last + _indexReadVarint(p, end);
+        last = first + _indexReadVarint(p, end);
+        set.add(first, last);
+    }
+    return(set);
+}
+
+static QVector<uint> _indexUnite (const QVector<uint>& a, const QVector<uint>& b) {
+    QVector<uint> result;
+    result.reserve(a.size() + b.size());
+
+    int i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            result.append(a[i++]);
+        } else if (b[j] < a[i]) {
+            result.append(b[j++]);
+        } else {
+            result.append(a[i++]);
+            j++;
+        }
+    }
+    while (i < a.size()) result.append(a[i++]);
+    while (j < b.size()) result.append(b[j++]);
+    return(result);
+}
+
+/* Term matches a query word: the word is part of it (as a server TEXT search). */
+static bool _indexTermMatches (const QByteArray& term, const QByteArray& word, bool bodyOnly) {
+    if (bodyOnly && term.startsWith(IMAP_INDEX_HEADER_PREFIX))
+        return(false);
+    return(term.contains(word));
+}
+
+/*
+ * Text of a part in its declared charset. Undeclared or unknown
+ * charsets are read as UTF-8 when valid, as Latin-1 otherwise.
+ */
+static QString _indexDecodeText (const QByteArray& data, const QString& charset) {
+    QTextCodec *codec = NULL;
+    if (!charset.isEmpty())
+        codec = QTextCodec::codecForName(charset.toLatin1());
+    if (codec != NULL)
+        return(codec->toUnicode(data));
+
+    QTextCodec::ConverterState state;
+    QString text = QTextCodec::codecForName("UTF-8")->toUnicode(data.constData(),
+                                                                 data.size(), &state);
+    if (state.invalidChars == 0)
+        return(text);
+    return(QString::fromLatin1(data));
+}
+
+/*
+ * Put the written file in place of fileName. The old one is kept as
+ * ".old" until then, and restored if the rename fails.
+ */
+static bool _indexReplaceFile (QFile *file, const QString& fileName) {
+    QString oldName = fileName + ".old";
+    QFile::remove(oldName);
+    if (QFile::exists(fileName) && !QFile::rename(fileName, oldName)) {
+        file->remove();
+        return(false);
+    }
+
+    if (!file->rename(fileName)) {
+        QFile::rename(oldName, fileName);
+        file->remove();
+        return(false);
+    }
+
+    QFile::remove(oldName);
+    return(true);
+}
+
+// ===========================================================================
+//  PRIVATE Class (Segment)
+// ===========================================================================
+/*
+ * Segment file:
+ *   magic, version, term count (quint32, host order)
+ *   indexed UIDs (varint ranges)
+ *   terms, sorted: length, utf8 term, postings count, postings length,
+ *                  postings (varint deltas)
+ * Envelope terms are prefixed by '#'. Every length is checked against
+ * the file size, a truncated or corrupt segment is not opened.
+ */
+class ImapTextSegment {
+    public:
+        ImapSequenceSet docs;
+
+    public:
+        ImapTextSegment (const QString& fileName);
+        ~ImapTextSegment();
+
+        bool open (void);
+        QString fileName (void) const;
+
+        QList<QByteArray> terms (void) const;
+        QVector<uint> postings (const QByteArray& term) const;
+        QVector<uint> matching (const QByteArray& word, bool bodyOnly) const;
+
+        static bool write (const QString& fileName,
+                           const ImapSequenceSet& docs,
+                           const QList<QByteArray>& terms,
+                           const QList<QVector<uint> >& postings);
+
+    private:
+        QVector<uint> postingsAt (quint32 offset) const;
+
+    private:
+        // term -> offset of its postings count
+        QHash<QByteArray, quint32> m_terms;
+        const uchar *m_map;
+        qint64 m_size;
+        QFile m_file;
+};
+
+ImapTextSegment::ImapTextSegment (const QString& fileName)
+    : m_map(NULL), m_size(0), m_file(fileName)
+{
+}
+
+ImapTextSegment::~ImapTextSegment() {
+    if (m_map != NULL)
+        m_file.unmap((uchar *)m_map);
+    m_file.close();
+}
+
+bool ImapTextSegment::open (void) {
+    if (!m_file.open(QIODevice::ReadOnly))
+        return(false);
+
+    m_size = m_file.size();
+    if (m_size < 12 || (m_map = m_file.map(0, m_size)) == NULL)
+        return(false);
+
+    quint32 header[3];
+    memcpy(header, m_map, sizeof(header));
+    if (header[0] != IMAP_INDEX_SEGMENT_MAGIC || header[1] != IMAP_INDEX_VERSION)
+        return(false);
+
+    const uchar *end = m_map + m_size;
+    const uchar *p = m_map + sizeof(header);
+    docs = _indexDecodeSet(&p, end);
+
+    // Each term takes at least 4 bytes, don't trust the header count.
+    m_terms.reserve(qMin((qint64)header[2], m_size / 4));
+    for (quint32 i = 0; i < header[2]; ++i) {
+        if (p >= end)
+            return(false);
+
+        quint32 length = _indexReadVarint(&p, end);
+        if (length == 0 || length > (quint64)(end - p))
+            return(false);
+        QByteArray term((const char *)p, length);
+        p += length;
+
+        quint32 offset = p - m_map;
+        quint32 count = _indexReadVarint(&p, end);
+        quint32 size = _indexReadVarint(&p, end);
+        if (size > (quint64)(end - p) || count > size)
+            return(false);
+        p += size;
+
+        m_terms.insert(term, offset);
+    }
+
+    return(true);
+}
+
+QString ImapTextSegment::fileName (void) const {
+    return(m_file.fileName());
+}
+
+QList<QByteArray> ImapTextSegment::terms (void) const {
+    return(m_terms.keys());
+}
+
+QVector<uint> ImapTextSegment::postings (const QByteArray& term) const {
+    QVector<uint> uids;
+
+    QHash<QByteArray, quint32>::const_iterator it = m_terms.find(term);
+    if (it != m_terms.constEnd())
+        uids = postingsAt(it.value());
+    return(uids);
+}
+
+/**
+ * Postings of every term containing word.
+ */
+QVector<uint> ImapTextSegment::matching (const QByteArray& word, bool bodyOnly) const {
+    QVector<uint> uids;
+
+    QHash<QByteArray, quint32>::const_iterator it;
+    for (it = m_terms.constBegin(); it != m_terms.constEnd(); ++it) {
+        if (_indexTermMatches(it.key(), word, bodyOnly))
+            uids = _indexUnite(uids, postingsAt(it.value()));
+    }
+    return(uids);
+}
+
+/* Offsets and lengths were checked by open(). */
+QVector<uint> ImapTextSegment::postingsAt (quint32 offset) const {
+    QVector<uint> uids;
+
+    const uchar *end = m_map + m_size;
+    const uchar *p = m_map + offset;
+    quint32 count = _indexReadVarint(&p, end);
+    quint32 length = _indexReadVarint(&p, end);
+    _indexDecodePostings(p, p + length, count, &uids);
+    return(uids);
+}
+
+bool ImapTextSegment::write (const QString& fileName,
+                             const ImapSequenceSet& docs,
+                             const QList<QByteArray>& terms,
+                             const QList<QVector<uint> >& postings)
+{
+    QFile file(fileName + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return(false);
+
+    QByteArray data;
+    quint32 header[3] = { IMAP_INDEX_SEGMENT_MAGIC, IMAP_INDEX_VERSION, 0 };
+    header[2] = terms.size();
+    data.append((const char *)header, sizeof(header));
+    data.append(_indexEncodeSet(docs));
+
+    for (int i = 0; i < terms.size(); ++i) {
+        QByteArray encoded = _indexEncodePostings(postings[i]);
+        _indexWriteVarint(&data, terms[i].size());
+        data.append(terms[i]);
+        _indexWriteVarint(&data, postings[i].size());
+        _indexWriteVarint(&data, encoded.size());
+        data.append(encoded);
+
+        // Write out in blocks, segments may be large.
+        if (data.size() > (1 << 20)) {
+            if (file.write(data) != data.size())
+                return(false);
+            data.clear();
+        }
+    }
+
+    if (file.write(data) != data.size())
+        return(false);
+    file.close();
+    return(_indexReplaceFile(&file, fileName));
+}
+
+// ===========================================================================
+//  PRIVATE Class
+// ===========================================================================
+class ImapTextIndexPrivate {
+    public:
+        // Guards segments, deleted and merging (merge thread).
+        mutable QMutex mutex;
+        QList<ImapTextSegment *> segments;
+        ImapSequenceSet deleted;
+        bool merging;
+
+        QHash<QByteArray, QVector<uint> > buffer;
+        ImapSequenceSet bufferDocs;
+        int bufferPostings;
+
+        QThreadPool mergePool;
+        QString errorString;
+        QString baseName;
+        QString path;
+        quint32 uidValidity;
+        int mergeThreshold;
+        int nextSegment;
+        bool isOpen;
+
+    public:
+        QVector<uint> bufferMatching (const QByteArray& word, bool bodyOnly) const;
+        ImapSequenceSet segmentDocs (void) const;
+        QString segmentName (void);
+        bool saveManifest (void);
+        bool loadManifest (void);
+        void startMerge (void);
+        void mergeSegments (const QList<ImapTextSegment *>& inputs);
+};
+
+/* Buffered postings of the terms containing word, removed messages excluded. */
+QVector<uint> ImapTextIndexPrivate::bufferMatching (const QByteArray& word, bool bodyOnly) const {
+    QVector<uint> uids;
+
+    QHash<QByteArray, QVector<uint> >::const_iterator it;
+    for (it = buffer.constBegin(); it != buffer.constEnd(); ++it) {
+        if (!_indexTermMatches(it.key(), word, bodyOnly))
+            continue;
+
+        QVector<uint> live;
+        foreach (uint uid, it.value()) {
+            if (bufferDocs.contains(uid))
+                live.append(uid);
+        }
+        qSort(live);
+        uids = _indexUnite(uids, live);
+    }
+    return(uids);
+}
+
+/* UIDs written in the segments, under the mutex. */
+ImapSequenceSet ImapTextIndexPrivate::segmentDocs (void) const {
+    ImapSequenceSet docs;
+    foreach (ImapTextSegment *segment, segments)
+        docs.add(segment->docs);
+    return(docs);
+}
+
+/* New segment file name, under the mutex. */
+QString ImapTextIndexPrivate::segmentName (void) {
+    return(QString("%1.%2.seg").arg(baseName).arg(nextSegment++));
+}
+
+/* Manifest: segment list and removed UIDs still in a segment, under the mutex. */
+bool ImapTextIndexPrivate::saveManifest (void) {
+    QStringList names;
+    foreach (ImapTextSegment *segment, segments)
+        names.append(QFileInfo(segment->fileName()).fileName());
+
+    QFile file(baseName + ".manifest.tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return(false);
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << (quint32)IMAP_INDEX_MANIFEST_MAGIC << (quint32)IMAP_INDEX_VERSION;
+    stream << uidValidity << (qint32)nextSegment << names << deleted;
+    file.close();
+
+    return(_indexReplaceFile(&file, baseName + ".manifest"));
+}
+
+bool ImapTextIndexPrivate::loadManifest (void) {
+    // Replaced while the new one was being put in place.
+    QString fileName = baseName + ".manifest";
+    if (!QFile::exists(fileName) && QFile::exists(fileName + ".old"))
+        QFile::rename(fileName + ".old", fileName);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return(false);
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic, version, storedUidValidity;
+    QStringList names;
+    qint32 next;
+
+    stream >> magic >> version >> storedUidValidity >> next >> names >> deleted;
+    if (stream.status() != QDataStream::Ok || magic != IMAP_INDEX_MANIFEST_MAGIC ||
+        version != IMAP_INDEX_VERSION || storedUidValidity != uidValidity)
+    {
+        deleted.clear();
+        return(false);
+    }
+
+    QDir directory(path);
+    nextSegment = next;
+    foreach (QString name, names) {
+        ImapTextSegment *segment = new ImapTextSegment(directory.filePath(name));
+        if (segment->open()) {
+            segments.append(segment);
+        } else {
+            delete segment;
+        }
+    }
+    return(true);
+}
+
+class ImapTextIndexMerger : public QRunnable {
+    public:
+        ImapTextIndexMerger (ImapTextIndexPrivate *index,
+                             const QList<ImapTextSegment *>& inputs)
+            : m_inputs(inputs), m_index(index)
+        {
+        }
+
+        void run (void) {
+            m_index->mergeSegments(m_inputs);
+        }
+
+    private:
+        QList<ImapTextSegment *> m_inputs;
+        ImapTextIndexPrivate *m_index;
+};
+
+/* Merge every segment in the background, under the mutex. */
+void ImapTextIndexPrivate::startMerge (void) {
+    if (merging || segments.size() < mergeThreshold)
+        return;
+
+    merging = true;
+    mergePool.start(new ImapTextIndexMerger(this, segments));
+}
+
+/*
+ * Runs in the merge thread. Input segments are immutable,
+ * the mutex is only taken to snapshot deletions and to swap segments.
+ */
+void ImapTextIndexPrivate::mergeSegments (const QList<ImapTextSegment *>& inputs) {
+    mutex.lock();
+    ImapSequenceSet removed = deleted;
+    QString fileName = segmentName();
+    mutex.unlock();
+
+    ImapSequenceSet docs;
+    QMap<QByteArray, bool> sortedTerms;
+    foreach (ImapTextSegment *segment, inputs) {
+        docs.add(segment->docs);
+        foreach (const QByteArray& term, segment->terms())
+            sortedTerms.insert(term, true);
+    }
+    docs.remove(removed);
+
+    QList<QVector<uint> > postings;
+    QList<QByteArray> terms;
+    QMap<QByteArray, bool>::const_iterator it;
+    for (it = sortedTerms.constBegin(); it != sortedTerms.constEnd(); ++it) {
+        QVector<uint> uids;
+        foreach (ImapTextSegment *segment, inputs)
+            uids = _indexUnite(uids, segment->postings(it.key()));
+
+        if (!removed.isEmpty()) {
+            QVector<uint> live;
+            live.reserve(uids.size());
+            foreach (uint uid, uids) {
+                if (!removed.contains(uid))
+                    live.append(uid);
+            }
+            uids = live;
+        }
+
+        if (!uids.isEmpty()) {
+            terms.append(it.key());
+            postings.append(uids);
+        }
+    }
+
+    bool written = ImapTextSegment::write(fileName, docs, terms, postings);
+
+    QMutexLocker locker(&mutex);
+    merging = false;
+
+    ImapTextSegment *merged = new ImapTextSegment(fileName);
+    if (!written || !merged->open()) {
+        delete merged;
+        QFile::remove(fileName);
+        return;
+    }
+
+    // Segments written meanwhile are newer, keep them after the merged one.
+    foreach (ImapTextSegment *segment, inputs) {
+        segments.removeAll(segment);
+        QString inputName = segment->fileName();
+        delete segment;
+        QFile::remove(inputName);
+    }
+    segments.prepend(merged);
+
+    // UIDs are never reused: only the removed ones still written in a
+    // segment (newer ones, or removed during the merge) need masking.
+    deleted = deleted.intersected(segmentDocs());
+    saveManifest();
+}
+
+// ===========================================================================
+//  PUBLIC Constructors/Destructor
+// ===========================================================================
+/**
+ * Create an index stored in the 'path' directory.
+ */
+ImapTextIndex::ImapTextIndex (const QString& path)
+    : d(new ImapTextIndexPrivate)
+{
+    d->mergeThreshold = IMAP_INDEX_MERGE_THRESHOLD;
+    d->mergePool.setMaxThreadCount(1);
+    d->bufferPostings = 0;
+    d->uidValidity = 0;
+    d->nextSegment = 0;
+    d->merging = false;
+    d->isOpen = false;
+    d->path = path;
+}
+
+ImapTextIndex::~ImapTextIndex() {
+    close();
+    delete d;
+}
+
+// ===========================================================================
+//  PUBLIC STATIC Methods
+// ===========================================================================
+/**
+ * Split text in lowercase words. Words shorter than 2 chars are dropped,
+ * longer than 32 are truncated.
+ */
+QStringList ImapTextIndex::tokenize (const QString& text) {
+    QStringList words;
+    const QChar *p = text.unicode();
+    int size = text.size();
+
+    int i = 0;
+    while (i < size) {
+        while (i < size && !p[i].isLetterOrNumber())
+            i++;
+
+        int begin = i;
+        while (i < size && p[i].isLetterOrNumber())
+            i++;
+
+        int length = i - begin;
+        if (length >= IMAP_INDEX_MIN_WORD)
+            words.append(text.mid(begin, qMin(length, IMAP_INDEX_MAX_WORD)).toLower());
+    }
+
+    return(words);
+}
+
+// ===========================================================================
+//  PUBLIC Methods
+// ===========================================================================
+/**
+ * Open the index of the specified mailbox.
+ * If it was built with a different UIDVALIDITY it starts empty.
+ */
+bool ImapTextIndex::open (const QString& server,
+                          const QString& mailbox,
+                          quint32 uidValidity)
+{
+    close();
+
+    QDir directory(d->path);
+    if (!directory.exists() && !directory.mkpath(".")) {
+        d->errorString = QString("Unable to create %1").arg(d->path);
+        return(false);
+    }
+
+    QByteArray key = QString("%1\n%2").arg(server).arg(mailbox).toUtf8();
+    QString hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    d->baseName = directory.filePath(hash);
+    d->uidValidity = uidValidity;
+
+    QMutexLocker locker(&(d->mutex));
+    if (!d->loadManifest()) {
+        // Stale or missing, drop the old segments.
+        QStringList filters(QString("%1.*.seg").arg(hash));
+        foreach (QString name, directory.entryList(filters, QDir::Files))
+            directory.remove(name);
+        d->nextSegment = 0;
+
+        if (!d->saveManifest()) {
+            d->errorString = QString("Unable to write the index manifest");
+            return(false);
+        }
+    }
+
+    d->isOpen = true;
+    return(true);
+}
+
+/**
+ * Flush the buffered words, wait for the merge and release the segments.
+ */
+void ImapTextIndex::close (void) {
+    if (!d->isOpen)
+        return;
+
+    flush();
+    d->mergePool.waitForDone();
+
+    QMutexLocker locker(&(d->mutex));
+    qDeleteAll(d->segments);
+    d->segments.clear();
+    d->deleted.clear();
+    d->isOpen = false;
+}
+
+/**
+ * Index the words of text for the message uid.
+ * Header words are only matched by TEXT searches, body ones by BODY too.
+ */
+void ImapTextIndex::addText (uint uid, const QString& text, Field field) {
+    foreach (QString word, tokenize(text)) {
+        QByteArray term = word.toUtf8();
+        if (field == Header)
+            term.prepend(IMAP_INDEX_HEADER_PREFIX);
+
+        QVector<uint>& uids = d->buffer[term];
+        if (uids.isEmpty() || uids.last() != uid) {
+            uids.append(uid);
+            d->bufferPostings++;
+        }
+    }
+
+    d->bufferDocs.add(uid);
+    if (d->bufferPostings >= IMAP_INDEX_BUFFER_POSTINGS)
+        flush();
+}
+
+/**
+ * Index subject, addresses and the text parts already fetched.
+ */
+void ImapTextIndex::addMessage (const ImapMessage *message) {
+    uint uid = message->uid().toUInt();
+    if (uid == 0)
+        return;
+
+    QStringList fields;
+    fields.append(message->subject());
+    fields.append(message->fromAddress().toString());
+    foreach (const ImapAddress& address, message->toAddresses())
+        fields.append(address.toString());
+    foreach (const ImapAddress& address, message->ccAddresses())
+        fields.append(address.toString());
+    addText(uid, fields.join(" "), Header);
+
+    foreach (ImapMessageBodyPart *part, message->bodyParts()) {
+        if (part->isAttachment() || part->data().isEmpty())
+            continue;
+        if (!part->contentType().startsWith("TEXT/", Qt::CaseInsensitive))
+            continue;
+        addText(uid, _indexDecodeText(part->data(), part->charset()), Body);
+    }
+}
+
+/**
+ * Index the cached messages not indexed yet (envelope and cached
+ * textual body parts). Returns the number of messages indexed.
+ */
+int ImapTextIndex::update (const ImapCache *cache) {
+    ImapSequenceSet uids = cache->uids().subtracted(indexed());
+    int count = 0;
+
+    for (int i = 0; i < uids.rangeCount(); ++i) {
+        quint64 last = uids.rangeLast(i);
+        for (quint64 uid = uids.rangeFirst(i); uid <= last; ++uid) {
+            ImapMessage *message = cache->message(uid);
+            if (message == NULL)
+                continue;
+
+            addMessage(message);
+            delete message;
+
+            ImapBodyStructure *structure = NULL;
+            if (cache->hasBodyStructure(uid))
+                structure = ImapBodyStructure::parse(cache->bodyStructure(uid));
+
+            foreach (QString section, cache->bodyPartSections(uid)) {
+                QByteArray data = cache->bodyPart(uid, section);
+
+                // Skip binary parts.
+                if (memchr(data.constData(), 0, qMin(data.size(), 1024)) != NULL)
+                    continue;
+
+                ImapBodyStructure *part = NULL;
+                if (structure != NULL)
+                    part = structure->findSection(section);
+                addText(uid, _indexDecodeText(data, part != NULL ? part->charset() : QString()), Body);
+            }
+
+            delete structure;
+            count++;
+        }
+    }
+
+    return(count);
+}
+
+/**
+ * Forget removed messages. Their postings are dropped on the next merge
+ * (or flush, for buffered ones).
+ */
+void ImapTextIndex::remove (const ImapSequenceSet& uids) {
+    QMutexLocker locker(&(d->mutex));
+    d->deleted.add(uids.intersected(d->segmentDocs()));
+    d->bufferDocs.remove(uids);
+    d->saveManifest();
+}
+
+/**
+ * Write the buffered words as a new segment.
+ */
+bool ImapTextIndex::flush (void) {
+    if (d->bufferDocs.isEmpty()) {
+        d->buffer.clear();
+        return(true);
+    }
+
+    QList<QByteArray> terms = d->buffer.keys();
+    qSort(terms);
+
+    // Drop the postings of the messages removed since they were buffered.
+    QList<QVector<uint> > postings;
+    QList<QByteArray> liveTerms;
+    foreach (const QByteArray& term, terms) {
+        QVector<uint> uids;
+        foreach (uint uid, d->buffer.value(term)) {
+            if (d->bufferDocs.contains(uid))
+                uids.append(uid);
+        }
+        if (uids.isEmpty())
+            continue;
+
+        qSort(uids);
+        liveTerms.append(term);
+        postings.append(uids);
+    }
+    terms = liveTerms;
+
+    QMutexLocker locker(&(d->mutex));
+    QString fileName = d->segmentName();
+    if (!ImapTextSegment::write(fileName, d->bufferDocs, terms, postings)) {
+        d->errorString = QString("Unable to write %1").arg(fileName);
+        return(false);
+    }
+
+    ImapTextSegment *segment = new ImapTextSegment(fileName);
+    if (!segment->open()) {
+        d->errorString = QString("Unable to read %1").arg(fileName);
+        delete segment;
+        return(false);
+    }
+
+    d->segments.append(segment);
+    d->buffer.clear();
+    d->bufferDocs.clear();
+    d->bufferPostings = 0;
+
+    d->saveManifest();
+    d->startMerge();
+    return(true);
+}
+
+void ImapTextIndex::waitForMerge (void) {
+    d->mergePool.waitForDone();
+}
+
+/**
+ * Returns the UIDs of the indexed messages containing every word of text,
+ * as part of a longer word too: "port" matches "support", as a server
+ * search does. With bodyOnly the envelope words are not matched (BODY).
+ */
+ImapSequenceSet ImapTextIndex::search (const QString& text, bool bodyOnly) const {
+    QStringList words = tokenize(text);
+    ImapSequenceSet result;
+    bool first = true;
+
+    QMutexLocker locker(&(d->mutex));
+    foreach (QString word, words) {
+        QByteArray term = word.toUtf8();
+
+        ImapSequenceSet matches;
+        foreach (uint uid, d->bufferMatching(term, bodyOnly))
+            matches.add(uid);
+        foreach (ImapTextSegment *segment, d->segments) {
+            foreach (uint uid, segment->matching(term, bodyOnly))
+                matches.add(uid);
+        }
+
+        result = first ? matches : result.intersected(matches);
+        first = false;
+        if (result.isEmpty())
+            break;
+    }
+
+    result.remove(d->deleted);
+    return(result);
+}
+
+// ===========================================================================
+//  PUBLIC Properties
+// ===========================================================================
+bool ImapTextIndex::isOpen (void) const {
+    return(d->isOpen);
+}
+
+/**
+ * UIDs of the indexed messages, buffered ones included.
+ */
+ImapSequenceSet ImapTextIndex::indexed (void) const {
+    QMutexLocker locker(&(d->mutex));
+
+    ImapSequenceSet uids = d->bufferDocs;
+    foreach (ImapTextSegment *segment, d->segments)
+        uids.add(segment->docs);
+    uids.remove(d->deleted);
+    return(uids);
+}
+
+int ImapTextIndex::segmentCount (void) const {
+    QMutexLocker locker(&(d->mutex));
+    return(d->segments.size());
+}
+
+int ImapTextIndex::mergeThreshold (void) const {
+    return(d->mergeThreshold);
+}
+
+/**
+ * Merge the segments in background once there are this many.
+ */
+void ImapTextIndex::setMergeThreshold (int segments) {
+    d->mergeThreshold = qMax(2, segments);
+}
+
+QString ImapTextIndex::errorString (void) const {
+    return(d->errorString);
+}
+
@@ -0,0 +1,73 @@
+#ifndef _IMAP_TEXT_INDEX_H_
+#define _IMAP_TEXT_INDEX_H_
+
+#include <QStringList>
+#include <QString>
+
+#include "imapsequenceset.h"
+
+class ImapMessage;
+class ImapCache;
+class ImapTextIndexPrivate;
+
+/**
+ * Local inverted index of the words of a mailbox messages (envelope and
+ * text parts), for offline TEXT searches.
+ *
+ * Words are buffered in memory and written as immutable segments:
+ * a sorted term dictionary with delta+varint compressed UID postings.
+ * When too many segments pile up they are merged in a background
+ * thread, dropping removed messages.
+ *
+ * Searches match words as substrings, all the words of the query must
+ * appear: the result holds every message a server TEXT search of the
+ * indexed fields would find. Envelope words are kept apart, for BODY.
+ */
+class ImapTextIndex {
+    public:
+        enum Field {
+            Header,
+            Body
+        };
+
+    public:
+        ImapTextIndex (const QString& path);
+        ~ImapTextIndex();
+
+        static QStringList tokenize (const QString& text);
+
+        // Methods
+        bool open (const QString& server,
+                   const QString& mailbox,
+                   quint32 uidValidity);
+        void close (void);
+
+        void addText (uint uid, const QString& text, Field field = Body);
+        void addMessage (const ImapMessage *message);
+        int update (const ImapCache *cache);
+        void remove (const ImapSequenceSet& uids);
+
+        bool flush (void);
+        void waitForMerge (void);
+
+        ImapSequenceSet search (const QString& text, bool bodyOnly = false) const;
+
+        // Properties
+        bool isOpen (void) const;
+
+        ImapSequenceSet indexed (void) const;
+        int segmentCount (void) const;
+
+        int mergeThreshold (void) const;
+        void setMergeThreshold (int segments);
+
+        QString errorString (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapTextIndex)
+
+        ImapTextIndexPrivate *d;
+};
+
+#endif /* !_IMAP_TEXT_INDEX_H_ */
+
@@ -0,0 +1,736 @@
+#include <QPair>
+#include <QVector>
+#include <QHash>
+
+#include "imapmessage.h"
+#include "imapparser.h"
+#include "imapthread.h"
+
+// ===========================================================================
+//  PRIVATE Functions
+// ===========================================================================
+/* "(3 6 (4 23)(44 7 96))": each member is a child of the previous one,
+ * nested lists are branches of the last member. A list starting with
+ * a list ("((3)(5))") has a missing message as its root.
+ */
+static bool _threadParseList (ImapParser *parser, ImapThread *parent) {
+    if (!parser->skipChar('('))
+        return(false);
+
+    ImapThread *current = parent;
+    while (!parser->atListEnd()) {
+        if (parser->peek() == '(') {
+            if (current == parent)
+                current = parent->addChild(0);
+            if (!_threadParseList(parser, current))
+                return(false);
+        } else {
+            bool ok;
+            qint64 uid = parser->readNumber(&ok);
+            if (!ok || uid <= 0)
+                return(false);
+            current = current->addChild((uint)uid);
+        }
+    }
+    return(parser->skipChar(')'));
+}
+
+static void _threadWrite (const ImapThread *thread, QString *text) {
+    // A chain of single replies is written flat: "3 6 7".
+    while (!thread->isDummy()) {
+        text->append(QString::number(thread->uid()));
+        if (thread->childCount() != 1)
+            break;
+        text->append(' ');
+        thread = thread->childAt(0);
+    }
+
+    if (!thread->isDummy() && thread->childCount() > 0)
+        text->append(' ');
+
+    foreach (ImapThread *child, thread->children()) {
+        text->append('(');
+        _threadWrite(child, text);
+        text->append(')');
+    }
+}
+
+/* subj-blob: "[" *BLOBCHAR "]" *WSP, returns the index after it or -1. */
+static int _threadBlobEnd (const QString& subject, int index) {
+    if (index >= subject.size() || subject[index] != '[')
+        return(-1);
+
+    int close = subject.indexOf(']', index + 1);
+    if (close < 0)
+        return(-1);
+
+    int open = subject.indexOf('[', index + 1);
+    if (open >= 0 && open < close)
+        return(-1);
+
+    index = close + 1;
+    while (index < subject.size() && subject[index] == ' ')
+        index++;
+    return(index);
+}
+
+/* subj-refwd: ("re" / ("fw" ["d"])) *WSP [subj-blob] ":" */
+static int _threadReplyEnd (const QString& subject, int index) {
+    if (subject.midRef(index, 3) == QLatin1String("fwd"))
+        index += 3;
+    else if (subject.midRef(index, 2) == QLatin1String("fw") ||
+             subject.midRef(index, 2) == QLatin1String("re"))
+        index += 2;
+    else
+        return(-1);
+
+    while (index < subject.size() && subject[index] == ' ')
+        index++;
+
+    int blobEnd = _threadBlobEnd(subject, index);
+    if (blobEnd >= 0)
+        index = blobEnd;
+
+    if (index < subject.size() && subject[index] == ':')
+        return(index + 1);
+    return(-1);
+}
+
+// ===========================================================================
+//  PRIVATE Classes
+// ===========================================================================
+class ImapThreadPrivate {
+    public:
+        QList<ImapThread *> children;
+        ImapThread *parent;
+        uint uid;
+};
+
+class ImapThreaderMessage {
+    public:
+        QStringList references;
+        QString messageId;
+        QString subject;
+        uint sent;
+        uint uid;
+};
+
+class ImapThreaderPrivate {
+    public:
+        QVector<ImapThreaderMessage> messages;
+        ImapThreader::Algorithm algorithm;
+};
+
+/* A node of the tree being built: a message, or a dummy (message -1).
+ * While linking, childLinks counts the containers whose parent it is. */
+class ImapThreaderContainer {
+    public:
+        ImapThreaderContainer() : message(-1), parent(-1), childLinks(0) {}
+
+        QList<int> children;
+        int message;
+        int parent;
+        int childLinks;
+};
+
+/* State of one ImapThreader::thread() run, containers are indexes. */
+class ImapThreaderBuild {
+    public:
+        ImapThreaderBuild (const QVector<ImapThreaderMessage>& messages);
+
+        void linkReferences (void);
+        void linkSubjects (void);
+        void prune (void);
+        void sort (QList<int> *containers);
+        void groupBySubject (void);
+        ImapThread *tree (void) const;
+
+        bool isDummy (int container) const;
+        const ImapThreaderMessage& firstMessage (int container) const;
+
+    private:
+        int add (void);
+        int find (const QString& messageId);
+        void setParent (int container, int parent);
+        bool isAncestor (int ancestor, int container) const;
+        QList<int> postOrder (const QList<int>& containers) const;
+
+    public:
+        const QVector<ImapThreaderMessage>& messages;
+        QVector<ImapThreaderContainer> containers;
+        QHash<QString, int> ids;
+        QList<int> roots;
+};
+
+/* Sent date, then UID, of the first message of a container. */
+class ImapThreaderLessThan {
+    public:
+        ImapThreaderLessThan (const ImapThreaderBuild *build)
+            : m_build(build)
+        {
+        }
+
+        bool operator() (int a, int b) const {
+            const ImapThreaderMessage& x = m_build->firstMessage(a);
+            const ImapThreaderMessage& y = m_build->firstMessage(b);
+            if (x.sent != y.sent)
+                return(x.sent < y.sent);
+            return(x.uid < y.uid);
+        }
+
+    private:
+        const ImapThreaderBuild *m_build;
+};
+
+/* Base subject, then sent date and UID, of a message. */
+class ImapThreaderSubjectLessThan {
+    public:
+        ImapThreaderSubjectLessThan (const QVector<ImapThreaderMessage>& messages,
+                                     const QVector<QString>& subjects)
+            : m_messages(messages), m_subjects(subjects)
+        {
+        }
+
+        bool operator() (int a, int b) const {
+            int compare = m_subjects[a].compare(m_subjects[b]);
+            if (compare != 0)
+                return(compare < 0);
+            if (m_messages[a].sent != m_messages[b].sent)
+                return(m_messages[a].sent < m_messages[b].sent);
+            return(m_messages[a].uid < m_messages[b].uid);
+        }
+
+    private:
+        const QVector<ImapThreaderMessage>& m_messages;
+        const QVector<QString>& m_subjects;
+};
+
+ImapThreaderBuild::ImapThreaderBuild (const QVector<ImapThreaderMessage>& messages)
+    : messages(messages)
+{
+    containers.reserve(messages.size() + messages.size() / 4);
+    ids.reserve(messages.size());
+}
+
+/**
+ * RFC 5256 REFERENCES, step 1 and 2: a container per Message-ID,
+ * each reference the parent of the next one, the last one the parent
+ * of the message. Links that would make a loop are dropped.
+ */
+void ImapThreaderBuild::linkReferences (void) {
+    for (int i = 0; i < messages.size(); ++i) {
+        const ImapThreaderMessage& message = messages[i];
+
+        // Duplicate Message-IDs get their own container.
+        int container = -1;
+        if (!message.messageId.isEmpty()) {
+            container = find(message.messageId);
+            if (containers[container].message >= 0)
+                container = -1;
+        }
+        if (container < 0)
+            container = add();
+        containers[container].message = i;
+
+        int previous = -1;
+        foreach (const QString& reference, message.references) {
+            int current = find(reference);
+            if (previous >= 0 && current != previous &&
+                containers[current].parent < 0 && !isAncestor(current, previous))
+            {
+                setParent(current, previous);
+            }
+            previous = current;
+        }
+
+        setParent(container, -1);
+        if (previous >= 0 && previous != container && !isAncestor(container, previous))
+            setParent(container, previous);
+    }
+
+    for (int i = 0; i < containers.size(); ++i) {
+        int parent = containers[i].parent;
+        if (parent < 0)
+            roots.append(i);
+        else
+            containers[parent].children.append(i);
+    }
+}
+
+/**
+ * ORDEREDSUBJECT: messages sorted by base subject and date, the first
+ * one of each subject is the parent of the others.
+ */
+void ImapThreaderBuild::linkSubjects (void) {
+    QVector<QString> subjects(messages.size());
+    QList<int> order;
+    for (int i = 0; i < messages.size(); ++i) {
+        subjects[i] = ImapThreader::baseSubject(messages[i].subject);
+        order.append(i);
+        containers[add()].message = i;
+    }
+    qSort(order.begin(), order.end(), ImapThreaderSubjectLessThan(messages, subjects));
+
+    int parent = -1;
+    foreach (int message, order) {
+        if (parent >= 0 && subjects[parent] == subjects[message]) {
+            containers[parent].children.append(message);
+        } else {
+            roots.append(message);
+            parent = message;
+        }
+    }
+}
+
+/**
+ * Step 4: drop dummies without children, and replace the others by
+ * their children, but at the root level if they have more than one.
+ * Children are pruned before their parent, without recursion: the
+ * replies of a long conversation nest as deep as it is long.
+ */
+void ImapThreaderBuild::prune (void) {
+    QList<int> order = postOrder(roots);
+    foreach (int container, order) {
+        QList<int> children;
+        foreach (int child, containers[container].children) {
+            if (!isDummy(child))
+                children.append(child);
+            else
+                children += containers[child].children;
+        }
+        containers[container].children = children;
+    }
+
+    QList<int> pruned;
+    foreach (int root, roots) {
+        const QList<int>& children = containers[root].children;
+        if (!isDummy(root) || children.size() > 1)
+            pruned.append(root);
+        else
+            pruned += children;
+    }
+    roots = pruned;
+}
+
+/**
+ * Order the containers, and their children first, by sent date.
+ * A dummy sorts by its first child, so children go before parents.
+ */
+void ImapThreaderBuild::sort (QList<int> *list) {
+    QList<int> order = postOrder(*list);
+    foreach (int container, order) {
+        QList<int> *children = &(containers[container].children);
+        if (children->size() > 1)
+            qSort(children->begin(), children->end(), ImapThreaderLessThan(this));
+    }
+    qSort(list->begin(), list->end(), ImapThreaderLessThan(this));
+}
+
+/**
+ * Step 5: merge the threads with the same base subject. The thread
+ * kept is a dummy, or else one whose subject is not a reply; a reply
+ * becomes a child of it, other pairs get a new dummy parent.
+ */
+void ImapThreaderBuild::groupBySubject (void) {
+    QVector<QString> subjects(roots.size());
+    QVector<bool> replies(roots.size());
+    QHash<QString, int> table;
+
+    for (int i = 0; i < roots.size(); ++i) {
+        bool isReply;
+        subjects[i] = ImapThreader::baseSubject(firstMessage(roots[i]).subject, &isReply);
+        replies[i] = isReply;
+        if (subjects[i].isEmpty())
+            continue;
+
+        QHash<QString, int>::iterator it = table.find(subjects[i]);
+        if (it == table.end()) {
+            table.insert(subjects[i], i);
+        } else if ((isDummy(roots[i]) && !isDummy(roots[it.value()])) ||
+                   (replies[it.value()] && !isReply && !isDummy(roots[it.value()])))
+        {
+            it.value() = i;
+        }
+    }
+
+    bool merged = false;
+    for (int i = 0; i < roots.size(); ++i) {
+        if (subjects[i].isEmpty())
+            continue;
+
+        int index = table.value(subjects[i]);
+        if (index == i)
+            continue;
+
+        int kept = roots[index];
+        int current = roots[i];
+        if (isDummy(kept) && isDummy(current)) {
+            containers[kept].children += containers[current].children;
+        } else if (isDummy(kept)) {
+            containers[kept].children.append(current);
+        } else if (isDummy(current)) {
+            containers[current].children.append(kept);
+            roots[index] = current;
+        } else if (replies[i] && !replies[index]) {
+            containers[kept].children.append(current);
+        } else {
+            int dummy = add();
+            containers[dummy].children.append(kept);
+            containers[dummy].children.append(current);
+            roots[index] = dummy;
+        }
+        roots[i] = -1;
+        merged = true;
+    }
+
+    if (!merged)
+        return;
+
+    roots.removeAll(-1);
+    for (int i = 0; i < roots.size(); ++i) {
+        QList<int> *children = &(containers[roots[i]].children);
+        qSort(children->begin(), children->end(), ImapThreaderLessThan(this));
+    }
+}
+
+ImapThread *ImapThreaderBuild::tree (void) const {
+    ImapThread *root = new ImapThread;
+
+    QList<QPair<int, ImapThread *> > stack;
+    for (int i = roots.size() - 1; i >= 0; --i)
+        stack.append(qMakePair(roots[i], root));
+
+    while (!stack.isEmpty()) {
+        QPair<int, ImapThread *> node = stack.takeLast();
+        int message = containers[node.first].message;
+        ImapThread *thread = node.second->addChild(message < 0 ? 0 : messages[message].uid);
+
+        const QList<int>& children = containers[node.first].children;
+        for (int i = children.size() - 1; i >= 0; --i)
+            stack.append(qMakePair(children[i], thread));
+    }
+    return(root);
+}
+
+bool ImapThreaderBuild::isDummy (int container) const {
+    return(containers[container].message < 0);
+}
+
+/* The message of a container, or of its first child for a dummy. */
+const ImapThreaderMessage& ImapThreaderBuild::firstMessage (int container) const {
+    while (containers[container].message < 0)
+        container = containers[container].children.first();
+    return(messages[containers[container].message]);
+}
+
+int ImapThreaderBuild::add (void) {
+    containers.append(ImapThreaderContainer());
+    return(containers.size() - 1);
+}
+
+int ImapThreaderBuild::find (const QString& messageId) {
+    QHash<QString, int>::const_iterator it = ids.constFind(messageId);
+    if (it != ids.constEnd())
+        return(it.value());
+
+    int container = add();
+    ids.insert(messageId, container);
+    return(container);
+}
+
+void ImapThreaderBuild::setParent (int container, int parent) {
+    int old = containers[container].parent;
+    if (old >= 0)
+        containers[old].childLinks--;
+    if (parent >= 0)
+        containers[parent].childLinks++;
+    containers[container].parent = parent;
+}
+
+/* Walks up from container, but not for the usual new message
+ * that nothing links to yet. */
+bool ImapThreaderBuild::isAncestor (int ancestor, int container) const {
+    if (containers[ancestor].childLinks == 0)
+        return(container == ancestor);
+
+    while (container >= 0) {
+        if (container == ancestor)
+            return(true);
+        container = containers[container].parent;
+    }
+    return(false);
+}
+
+/* The subtrees of the containers, each container after its children. */
+QList<int> ImapThreaderBuild::postOrder (const QList<int>& list) const {
+    QList<int> order;
+    QList<int> stack = list;
+    while (!stack.isEmpty()) {
+        int container = stack.takeLast();
+        order.append(container);
+        stack += containers[container].children;
+    }
+
+    // Pre-order reversed: descendants come before their ancestors.
+    QList<int> reversed;
+    reversed.reserve(order.size());
+    for (int i = order.size() - 1; i >= 0; --i)
+        reversed.append(order[i]);
+    return(reversed);
+}
+
+// ===========================================================================
+//  ImapThread
+// ===========================================================================
+ImapThread::ImapThread (uint uid)
+    : d(new ImapThreadPrivate)
+{
+    d->parent = NULL;
+    d->uid = uid;
+}
+
+ImapThread::~ImapThread() {
+    // Detach the subtree first, deep threads would overflow the stack.
+    QList<ImapThread *> stack = d->children;
+    while (!stack.isEmpty()) {
+        ImapThread *thread = stack.takeLast();
+        stack += thread->d->children;
+        thread->d->children.clear();
+        delete thread;
+    }
+    delete d;
+}
+
+/**
+ * Add the threads of an untagged THREAD response
+ * ("* THREAD (2)(3 6 (4 23)(44 7 96))") to this node.
+ */
+bool ImapThread::appendThreadResponse (const QByteArray& response) {
+    ImapParser parser(response);
+    if (!parser.skipChar('*') || !parser.skipAtom("THREAD"))
+        return(false);
+
+    while (!parser.atEnd()) {
+        if (!_threadParseList(&parser, this))
+            return(false);
+    }
+    return(true);
+}
+
+/**
+ * Append a message (or a dummy, uid 0) to the children.
+ */
+ImapThread *ImapThread::addChild (uint uid) {
+    ImapThread *child = new ImapThread(uid);
+    child->d->parent = this;
+    d->children.append(child);
+    return(child);
+}
+
+/**
+ * The children, in the THREAD response syntax.
+ */
+QString ImapThread::toString (void) const {
+    QString text;
+    if (isDummy()) {
+        _threadWrite(this, &text);
+    } else {
+        text.append('(');
+        _threadWrite(this, &text);
+        text.append(')');
+    }
+    return(text);
+}
+
+ImapThread *ImapThread::parent (void) const {
+    return(d->parent);
+}
+
+int ImapThread::childCount (void) const {
+    return(d->children.size());
+}
+
+ImapThread *ImapThread::childAt (int index) const {
+    return(d->children.at(index));
+}
+
+QList<ImapThread *> ImapThread::children (void) const {
+    return(d->children);
+}
+
+uint ImapThread::uid (void) const {
+    return(d->uid);
+}
+
+bool ImapThread::isDummy (void) const {
+    return(d->uid == 0);
+}
+
+/**
+ * Messages of the subtree, this one included, dummies excluded.
+ */
+int ImapThread::messageCount (void) const {
+    return(uids().size());
+}
+
+/**
+ * UIDs of the subtree in thread order (depth first).
+ */
+QList<uint> ImapThread::uids (void) const {
+    QList<uint> uids;
+    QList<const ImapThread *> stack;
+    stack.append(this);
+
+    while (!stack.isEmpty()) {
+        const ImapThread *thread = stack.takeLast();
+        if (!thread->isDummy())
+            uids.append(thread->uid());
+        for (int i = thread->d->children.size() - 1; i >= 0; --i)
+            stack.append(thread->d->children.at(i));
+    }
+    return(uids);
+}
+
+// ===========================================================================
+//  ImapThreader
+// ===========================================================================
+ImapThreader::ImapThreader (Algorithm algorithm)
+    : d(new ImapThreaderPrivate)
+{
+    d->algorithm = algorithm;
+}
+
+ImapThreader::~ImapThreader() {
+    delete d;
+}
+
+/**
+ * Name of the algorithm in THREAD commands and capabilities.
+ */
+QString ImapThreader::algorithmName (Algorithm algorithm) {
+    return(algorithm == OrderedSubject ? "ORDEREDSUBJECT" : "REFERENCES");
+}
+
+/**
+ * Subject without "Re:", "Fwd:", "[list]" prefixes, "(fwd)" trailers
+ * and "[Fwd: ...]" wrappers, whitespace collapsed and lower case
+ * (RFC 5256 section 2.1, for ASCII subjects). isReply tells whether
+ * a reply or forward marker was removed.
+ */
+QString ImapThreader::baseSubject (const QString& subject, bool *isReply) {
+    QString base = subject.simplified().toLower();
+    bool reply = false;
+
+    while (true) {
+        while (base.endsWith("(fwd)")) {
+            base.chop(5);
+            base = base.trimmed();
+            reply = true;
+        }
+
+        while (true) {
+            int index = 0;
+            int blobEnd;
+            while ((blobEnd = _threadBlobEnd(base, index)) >= 0)
+                index = blobEnd;
+
+            int replyEnd = _threadReplyEnd(base, index);
+            if (replyEnd >= 0) {
+                base = base.mid(replyEnd).trimmed();
+                reply = true;
+                continue;
+            }
+
+            blobEnd = _threadBlobEnd(base, 0);
+            if (blobEnd >= 0 && blobEnd < base.size()) {
+                base = base.mid(blobEnd);
+                continue;
+            }
+            break;
+        }
+
+        if (base.startsWith("[fwd:") && base.endsWith(']')) {
+            base = base.mid(5, base.size() - 6).trimmed();
+            reply = true;
+            continue;
+        }
+        break;
+    }
+
+    if (isReply != NULL) *isReply = reply;
+    return(base);
+}
+
+void ImapThreader::clear (void) {
+    d->messages.clear();
+}
+
+void ImapThreader::reserve (int messages) {
+    d->messages.reserve(messages);
+}
+
+/**
+ * Add a message. Ids may be given with or without angle brackets,
+ * references are ordered from the thread root to the direct parent.
+ */
+void ImapThreader::addMessage (uint uid,
+                               const QString& messageId,
+                               const QStringList& references,
+                               const QString& subject,
+                               const QDateTime& sent)
+{
+    ImapThreaderMessage message;
+    message.uid = uid;
+    message.messageId = messageId;
+    message.subject = subject;
+    message.sent = sent.isValid() ? sent.toTime_t() : 0;
+
+    if (message.messageId.startsWith('<') && message.messageId.endsWith('>'))
+        message.messageId = message.messageId.mid(1, message.messageId.size() - 2);
+
+    foreach (const QString& reference, references) {
+        if (reference.startsWith('<') && reference.endsWith('>'))
+            message.references.append(reference.mid(1, reference.size() - 2));
+        else if (!reference.isEmpty())
+            message.references.append(reference);
+    }
+
+    d->messages.append(message);
+}
+
+void ImapThreader::addMessage (const ImapMessage *message) {
+    QStringList references;
+    if (!message->reference().isEmpty())
+        references.append(message->reference());
+
+    addMessage(message->uid().toUInt(), message->messageId(), references,
+               message->subject(), message->sent());
+}
+
+/**
+ * Thread the messages added, the caller owns the returned root.
+ */
+ImapThread *ImapThreader::thread (void) const {
+    ImapThreaderBuild build(d->messages);
+
+    if (d->algorithm == OrderedSubject) {
+        build.linkSubjects();
+        build.sort(&(build.roots));
+    } else {
+        build.linkReferences();
+        build.prune();
+        build.sort(&(build.roots));
+        build.groupBySubject();
+    }
+
+    return(build.tree());
+}
+
+ImapThreader::Algorithm ImapThreader::algorithm (void) const {
+    return(d->algorithm);
+}
+
+int ImapThreader::count (void) const {
+    return(d->messages.size());
+}
+
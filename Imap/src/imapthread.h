@@ -0,0 +1,102 @@
+#ifndef _IMAP_THREAD_H_
+#define _IMAP_THREAD_H_
+
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QList>
+
+class ImapMessage;
+class ImapThreadPrivate;
+class ImapThreaderPrivate;
+
+/**
+ * Conversation tree of a mailbox, as returned by Imap::thread().
+ *
+ * The root holds the threads. Each node is a message UID, or a dummy
+ * (uid 0) standing for a missing parent: a message only known from
+ * the references of its replies, or a subject shared by several
+ * threads. Siblings are ordered by sent date.
+ */
+class ImapThread {
+    public:
+        ImapThread (uint uid = 0);
+        ~ImapThread();
+
+        // Methods
+        bool appendThreadResponse (const QByteArray& response);
+
+        ImapThread *addChild (uint uid);
+
+        QString toString (void) const;
+
+        // Tree
+        ImapThread *parent (void) const;
+
+        int childCount (void) const;
+        ImapThread *childAt (int index) const;
+        QList<ImapThread *> children (void) const;
+
+        // Properties
+        uint uid (void) const;
+        bool isDummy (void) const;
+
+        int messageCount (void) const;
+        QList<uint> uids (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapThread)
+
+        ImapThreadPrivate *d;
+};
+
+/**
+ * Local threading (RFC 5256), used when the server has no THREAD.
+ *
+ * REFERENCES links each message to its parent by Message-ID, through a
+ * hash of the ids, then prunes the missing parents and groups the
+ * threads by base subject. ORDEREDSUBJECT only groups by base subject.
+ * Both run in O(n log n).
+ *
+ * The envelope only carries In-Reply-To: addMessage(ImapMessage *)
+ * uses it as the single reference.
+ */
+class ImapThreader {
+    public:
+        enum Algorithm {
+            OrderedSubject,
+            References
+        };
+
+    public:
+        ImapThreader (Algorithm algorithm = References);
+        ~ImapThreader();
+
+        static QString algorithmName (Algorithm algorithm);
+        static QString baseSubject (const QString& subject, bool *isReply = NULL);
+
+        // Methods
+        void clear (void);
+        void reserve (int messages);
+
+        void addMessage (uint uid,
+                         const QString& messageId,
+                         const QStringList& references,
+                         const QString& subject,
+                         const QDateTime& sent);
+        void addMessage (const ImapMessage *message);
+
+        ImapThread *thread (void) const;
+
+        // Properties
+        Algorithm algorithm (void) const;
+        int count (void) const;
+
+    private:
+        Q_DISABLE_COPY(ImapThreader)
+
+        ImapThreaderPrivate *d;
+};
+
+#endif /* !_IMAP_THREAD_H_ */
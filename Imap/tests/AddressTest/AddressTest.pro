@@ -0,0 +1,16 @@
+######################################################################
+# Imap ENVELOPE Address List Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_ADDRESS
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += addresstest.h
+SOURCES += addresstest.cpp
@@ -0,0 +1,160 @@
+#ifdef TEST_IMAP_ADDRESS
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapaddress.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapparser.h"
+#include "imap.h"
+
+#include "addresstest.h"
+
+AddressTest::AddressTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+AddressTest::~AddressTest() {
+}
+
+void AddressTest::testList (void) {
+    ImapAddressTable table;
+    ImapParser parser("((\"=?ISO-8859-1?Q?Andr=E9?= \\\"Dre\\\"\" NIL \"andre\" \"example.org\")"
+                      "(NIL \"@relay.example\" NIL \"example.net\")) NIL");
+
+    QList<ImapAddress> addresses;
+    QVERIFY(table.readList(&parser, &addresses));
+    QCOMPARE(addresses.size(), 2);
+
+    QCOMPARE(addresses[0].address(), QString("andre@example.org"));
+    QCOMPARE(addresses[0].displayName(), QString::fromLatin1("Andr\xe9 \"Dre\""));
+
+    QCOMPARE(addresses[1].address(), QString("unknown@example.net"));
+    QVERIFY(!addresses[1].hasDisplayName());
+    QCOMPARE(addresses[1].smtpDomain(), QString("@relay.example"));
+
+    // The cursor is left after the list.
+    QVERIFY(parser.skipAtom("NIL"));
+}
+
+void AddressTest::testNil (void) {
+    ImapAddressTable table;
+    ImapParser parser("NIL nil");
+
+    QList<ImapAddress> addresses;
+    QVERIFY(table.readList(&parser, &addresses));
+    QVERIFY(table.readList(&parser, &addresses));
+    QVERIFY(addresses.isEmpty());
+}
+
+/* Group start (NIL host) and end markers aren't addresses. */
+void AddressTest::testGroup (void) {
+    ImapAddressTable table;
+    ImapParser parser("((NIL NIL \"team\" NIL)(NIL NIL \"ann\" \"example.org\")(NIL NIL NIL NIL)"
+                      "(NIL NIL \"bob\" \"example.net\"))");
+
+    QList<ImapAddress> addresses;
+    QVERIFY(table.readList(&parser, &addresses));
+    QCOMPARE(addresses.size(), 2);
+    QCOMPARE(addresses[0].address(), QString("ann@example.org"));
+    QCOMPARE(addresses[1].address(), QString("bob@example.net"));
+}
+
+void AddressTest::testShared (void) {
+    ImapAddressTable table;
+    QByteArray list("((\"Ann\" NIL \"ann\" \"example.org\"))");
+
+    QList<ImapAddress> addresses;
+    for (int i = 0; i < 3; ++i) {
+        ImapParser parser(list);
+        QVERIFY(table.readList(&parser, &addresses));
+    }
+    QCOMPARE(addresses.size(), 3);
+    QCOMPARE(table.count(), 1);
+
+    // The same address built elsewhere is shared as well.
+    ImapAddress copy("ann@example.org", "Ann");
+    table.intern(copy);
+    QCOMPARE(table.count(), 1);
+
+    table.clear();
+    QCOMPARE(table.count(), 0);
+}
+
+void AddressTest::testMalformed (void) {
+    ImapAddressTable table;
+    QList<ImapAddress> addresses;
+
+    ImapParser truncated("((\"Ann\" NIL \"ann\"");
+    QVERIFY(!table.readList(&truncated, &addresses));
+
+    ImapParser unclosed("((\"Ann\" NIL \"ann\" \"example.org\")");
+    QVERIFY(!table.readList(&unclosed, &addresses));
+
+    ImapParser atom("ann@example.org");
+    QVERIFY(!table.readList(&atom, &addresses));
+}
+
+/* FETCH ENVELOPE responses, as read by Imap::fetch() and uidFetch(). */
+void AddressTest::testEnvelope (void) {
+    ImapTestServer server(5);
+    Imap imap;
+    QVERIFY(imap.connectToHost("127.0.0.1", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    delete imap.select("INBOX");
+
+    ImapMailbox *mailbox = imap.fetch(1, 5);
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 5);
+
+    ImapMessage *message = mailbox->at(2);
+    QCOMPARE(message->id(), 3);
+    QCOMPARE(message->uid(), QString("3"));
+    QCOMPARE(message->subject(), QString::fromLatin1(ImapTestServer::subject(3)));
+    QCOMPARE(message->fromAddress().address(), QString("bob@example.org"));
+    QCOMPARE(message->fromAddress().displayName(), QString("Bob Example"));
+    QCOMPARE(message->toAddresses().size(), 1);
+    QCOMPARE(message->toAddresses().first().address(), QString("team@example.com"));
+    QVERIFY(message->ccAddresses().isEmpty());
+    QCOMPARE(message->messageId(), QString("message-3@example.com"));
+    QCOMPARE(message->reference(), QString("thread-0@example.com"));
+    QCOMPARE(message->sent(), QDateTime(QDate(2009, 7, 17), QTime(9, 44, 25), Qt::UTC));
+    QCOMPARE(message->timeZone(), QString("-0700"));
+    QCOMPARE(message->received(), message->sent());
+    QCOMPARE(message->size(), server.bodySize() + 400);
+    QCOMPARE(message->flags(), (ImapMessageFlags)ImapMessageSeen);
+    delete mailbox;
+
+    ImapMailbox uidMailbox;
+    QVERIFY(imap.uidFetch(&uidMailbox, ImapSequenceSet(4, 5)) != NULL);
+    QCOMPARE(uidMailbox.count(), 2);
+    QCOMPARE(uidMailbox.at(1)->uid(), QString("5"));
+    QCOMPARE(uidMailbox.at(1)->fromAddress().address(), QString("alice@example.com"));
+
+    imap.logout();
+    imap.disconnectFromHost();
+    server.waitForSession();
+}
+
+void AddressTest::benchmarkRepeatedSenders (void) {
+    QList<QByteArray> lists;
+    for (int i = 0; i < 1000; ++i) {
+        lists.append("((\"=?UTF-8?Q?Sender_" + QByteArray::number(i % 20) + "?=\" NIL \"sender" +
+                     QByteArray::number(i % 20) + "\" \"example.org\"))");
+    }
+
+    QBENCHMARK {
+        ImapAddressTable table;
+        QList<ImapAddress> addresses;
+        foreach (const QByteArray& list, lists) {
+            ImapParser parser(list);
+            table.readList(&parser, &addresses);
+        }
+    }
+}
+
+QTEST_MAIN(AddressTest)
+
+#endif /* TEST_IMAP_ADDRESS */
@@ -0,0 +1,26 @@
+#ifdef TEST_IMAP_ADDRESS
+#ifndef _ADDRESS_TEST_H_
+#define _ADDRESS_TEST_H_
+
+#include <QObject>
+
+class AddressTest : public QObject {
+    Q_OBJECT
+
+    public:
+        AddressTest (QObject *parent = 0);
+        ~AddressTest();
+
+    private slots:
+        void testList (void);
+        void testNil (void);
+        void testGroup (void);
+        void testShared (void);
+        void testMalformed (void);
+        void testEnvelope (void);
+
+        void benchmarkRepeatedSenders (void);
+};
+
+#endif /* !_ADDRESS_TEST_H_ */
+#endif /* TEST_IMAP_ADDRESS */
@@ -0,0 +1,22 @@
+######################################################################
+# Imap BODYSTRUCTURE Parser Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += . ../../src/
+INCLUDEPATH += . ../../src/
+
+DEFINES += TEST_IMAP_BODY_STRUCTURE
+
+QT += testlib
+
+# Input
+HEADERS += bodystructuretest.h \
+           ../../src/imapbodystructure.h \
+           ../../src/imapparser.h \
+           ../../src/imapcodec.h
+SOURCES += bodystructuretest.cpp \
+           ../../src/imapbodystructure.cpp \
+           ../../src/imapparser.cpp \
+           ../../src/imapcodec.cpp
@@ -0,0 +1,128 @@
+#ifdef TEST_IMAP_BODY_STRUCTURE
+
+#include <QtTest>
+
+#include "imapbodystructure.h"
+
+#include "bodystructuretest.h"
+
+BodyStructureTest::BodyStructureTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+BodyStructureTest::~BodyStructureTest() {
+}
+
+void BodyStructureTest::testSinglePart (void) {
+    ImapBodyStructure *body = ImapBodyStructure::parse(
+        "(\"TEXT\" \"PLAIN\" (\"CHARSET\" \"US-ASCII\") NIL NIL \"7BIT\" 3028 92)");
+    QVERIFY(body != NULL);
+
+    QVERIFY(!body->isMultipart());
+    QCOMPARE(body->section(), QString("1"));
+    QCOMPARE(body->mimeType(), QString("TEXT/PLAIN"));
+    QCOMPARE(body->charset(), QString("US-ASCII"));
+    QCOMPARE(body->encoding(), QString("7BIT"));
+    QCOMPARE(body->size(), quint32(3028));
+    QCOMPARE(body->lines(), quint32(92));
+    QCOMPARE(body->leaves().size(), 1);
+    delete body;
+}
+
+void BodyStructureTest::testMultipart (void) {
+    ImapBodyStructure *body = ImapBodyStructure::parse(
+        "((\"TEXT\" \"PLAIN\" (\"CHARSET\" \"UTF-8\") NIL NIL \"QUOTED-PRINTABLE\" 120 4 NIL NIL NIL)"
+        "((\"TEXT\" \"HTML\" (\"CHARSET\" \"UTF-8\") NIL NIL \"BASE64\" 800 11 NIL NIL NIL)"
+        "(\"IMAGE\" \"PNG\" (\"NAME\" \"logo.png\") \"<logo>\" NIL \"BASE64\" 4000 NIL NIL NIL)"
+        " \"RELATED\" (\"BOUNDARY\" \"b2\") NIL NIL)"
+        " \"ALTERNATIVE\" (\"BOUNDARY\" \"b1\") NIL (\"EN\" \"DE\") NIL)");
+    QVERIFY(body != NULL);
+
+    QVERIFY(body->isMultipart());
+    QCOMPARE(body->subtype(), QString("ALTERNATIVE"));
+    QCOMPARE(body->parameter("boundary"), QString("b1"));
+    QCOMPARE(body->language(), QString("EN, DE"));
+    QCOMPARE(body->childCount(), 2);
+
+    QList<ImapBodyStructure *> leaves = body->leaves();
+    QCOMPARE(leaves.size(), 3);
+    QCOMPARE(leaves[0]->section(), QString("1"));
+    QCOMPARE(leaves[1]->section(), QString("2.1"));
+    QCOMPARE(leaves[2]->section(), QString("2.2"));
+    QCOMPARE(leaves[2]->contentId(), QString("<logo>"));
+    QCOMPARE(leaves[2]->fileName(), QString("logo.png"));
+    QCOMPARE(leaves[2]->parent(), body->childAt(1));
+    QCOMPARE(body->findSection("2.2"), leaves[2]);
+    delete body;
+}
+
+void BodyStructureTest::testAttachment (void) {
+    ImapBodyStructure *body = ImapBodyStructure::parse(
+        "((\"TEXT\" \"PLAIN\" NIL NIL NIL \"7BIT\" 10 1 NIL NIL NIL)"
+        "(\"APPLICATION\" \"PDF\" NIL NIL {6}\r\nCV (1) \"BASE64\" 2048"
+        " NIL (\"ATTACHMENT\" (\"FILENAME\" \"=?UTF-8?Q?r=C3=A9sum=C3=A9.pdf?=\")) NIL NIL)"
+        " \"MIXED\")");
+    QVERIFY(body != NULL);
+
+    QList<ImapBodyStructure *> leaves = body->leaves();
+    QCOMPARE(leaves.size(), 2);
+    QVERIFY(!leaves[0]->isAttachment());
+    QVERIFY(leaves[1]->isAttachment());
+    QCOMPARE(leaves[1]->disposition(), QString("ATTACHMENT"));
+    QCOMPARE(leaves[1]->contentDescription(), QString("CV (1)"));
+    QCOMPARE(leaves[1]->size(), quint32(2048));
+    QCOMPARE(leaves[1]->fileName(), QString::fromUtf8("r\xc3\xa9sum\xc3\xa9.pdf"));
+    delete body;
+}
+
+void BodyStructureTest::testEmbeddedMessage (void) {
+    ImapBodyStructure *body = ImapBodyStructure::parse(
+        "((\"TEXT\" \"PLAIN\" NIL NIL NIL \"7BIT\" 10 1)"
+        "(\"MESSAGE\" \"RFC822\" NIL NIL NIL \"7BIT\" 500"
+        " (NIL \"Fwd (1)\" ((NIL NIL \"a\" \"b.org\")) NIL NIL NIL NIL NIL NIL NIL)"
+        " ((\"TEXT\" \"PLAIN\" NIL NIL NIL \"7BIT\" 20 2)"
+        "(\"TEXT\" \"HTML\" NIL NIL NIL \"7BIT\" 40 3) \"ALTERNATIVE\") 12)"
+        " \"MIXED\")");
+    QVERIFY(body != NULL);
+
+    QList<ImapBodyStructure *> leaves = body->leaves();
+    QCOMPARE(leaves.size(), 2);
+
+    ImapBodyStructure *message = leaves[1];
+    QVERIFY(message->isMessage());
+    QCOMPARE(message->section(), QString("2"));
+    QCOMPARE(message->lines(), quint32(12));
+
+    ImapBodyStructure *embedded = message->childAt(0);
+    QVERIFY(embedded->isMultipart());
+    QCOMPARE(embedded->childAt(0)->section(), QString("2.1"));
+    QCOMPARE(embedded->childAt(1)->section(), QString("2.2"));
+    delete body;
+}
+
+void BodyStructureTest::testMalformed (void) {
+    QVERIFY(ImapBodyStructure::parse("") == NULL);
+    QVERIFY(ImapBodyStructure::parse("(\"TEXT\" \"PLAIN\" NIL") == NULL);
+    QVERIFY(ImapBodyStructure::parse("((\"TEXT\" \"PLAIN\" (\"CHARSET") == NULL);
+
+    QByteArray deep;
+    for (int i = 0; i < 1000; ++i) deep += '(';
+    QVERIFY(ImapBodyStructure::parse(deep) == NULL);
+}
+
+void BodyStructureTest::benchmarkNested (void) {
+    QByteArray data("(\"TEXT\" \"PLAIN\" (\"CHARSET\" \"UTF-8\") NIL NIL \"7BIT\" 10 1)");
+    for (int i = 0; i < 32; ++i) {
+        data = '(' + data + "(\"IMAGE\" \"PNG\" (\"NAME\" \"a.png\") NIL NIL \"BASE64\" 100 NIL)"
+               " \"MIXED\" (\"BOUNDARY\" \"b\") NIL NIL)";
+    }
+
+    QBENCHMARK {
+        delete ImapBodyStructure::parse(data);
+    }
+}
+
+QTEST_MAIN(BodyStructureTest)
+
+#endif /* TEST_IMAP_BODY_STRUCTURE */
@@ -0,0 +1,25 @@
+#ifdef TEST_IMAP_BODY_STRUCTURE
+#ifndef _BODY_STRUCTURE_TEST_H_
+#define _BODY_STRUCTURE_TEST_H_
+
+#include <QObject>
+
+class BodyStructureTest : public QObject {
+    Q_OBJECT
+
+    public:
+        BodyStructureTest (QObject *parent = 0);
+        ~BodyStructureTest();
+
+    private slots:
+        void testSinglePart (void);
+        void testMultipart (void);
+        void testAttachment (void);
+        void testEmbeddedMessage (void);
+        void testMalformed (void);
+
+        void benchmarkNested (void);
+};
+
+#endif /* !_BODY_STRUCTURE_TEST_H_ */
+#endif /* TEST_IMAP_BODY_STRUCTURE */
@@ -0,0 +1,17 @@
+######################################################################
+# Imap Cache Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_CACHE
+
+include(../../src/imap.pri)
+QT += testlib
+
+# Input
+HEADERS += cachetest.h
+SOURCES += cachetest.cpp
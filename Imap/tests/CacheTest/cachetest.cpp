@@ -0,0 +1,318 @@
+#ifdef TEST_IMAP_CACHE
+
+#include <QCryptographicHash>
+#include <QtTest>
+#include <QFile>
+#include <QDir>
+
+#include "imapsearchquery.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapcache.h"
+#include "imapsync.h"
+
+#include "cachetest.h"
+
+#define CACHE_TEST_SERVER       ("imap.example.com")
+#define CACHE_TEST_MAILBOX      ("INBOX")
+
+static QString _cacheSubject (uint uid) {
+    return(QString("Cached message #%1").arg(uid));
+}
+
+static ImapMessage *_cacheMessage (uint uid, ImapMessageFlags flags) {
+    ImapMessage *message = new ImapMessage;
+    message->setUid(QString::number(uid));
+    message->setSubject(_cacheSubject(uid));
+    message->setMessageId(QString("<message-%1@example.com>").arg(uid));
+    message->setSent(QDateTime(QDate(2009, 7, 17), QTime(9, 0)).addDays(uid));
+    message->setSize(1000 + uid);
+    message->setFlags(flags);
+    return(message);
+}
+
+CacheTest::CacheTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+CacheTest::~CacheTest() {
+}
+
+void CacheTest::cleanup (void) {
+    QDir directory(cachePath());
+    foreach (const QString& name, directory.entryList(QDir::Files))
+        directory.remove(name);
+}
+
+void CacheTest::testRecord (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1, ImapMessageSeen));
+    QVERIFY(insert(&cache, 2));
+    QVERIFY(cache.insertBodyStructure(1, "(\"TEXT\" \"PLAIN\" NIL NIL NIL \"7BIT\" 5 1)"));
+    QVERIFY(cache.insertBodyPart(1, "1", "Hello"));
+    QVERIFY(cache.insertBodyPart(1, "2.1", QByteArray()));
+
+    QVERIFY(cache.contains(1));
+    QVERIFY(!cache.contains(3));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1, 2));
+
+    ImapMessage *message = cache.message(1);
+    QVERIFY(message != NULL);
+    QCOMPARE(message->subject(), _cacheSubject(1));
+    QCOMPARE(message->size(), 1001);
+    QCOMPARE(message->flags(), (ImapMessageFlags)ImapMessageSeen);
+    delete message;
+
+    QCOMPARE(cache.bodyPart(1, "1"), QByteArray("Hello"));
+    QVERIFY(cache.hasBodyPart(1, "2.1"));
+    QVERIFY(cache.bodyPart(1, "2.1").isEmpty());
+    QVERIFY(cache.hasBodyStructure(1));
+    QVERIFY(!cache.hasBodyStructure(2));
+
+    // The latest record wins.
+    QVERIFY(cache.setFlags(1, ImapMessageFlagged));
+    QCOMPARE(cache.flags(1), (ImapMessageFlags)ImapMessageFlagged);
+}
+
+void CacheTest::testReload (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 5, ImapMessageSeen));
+    QVERIFY(cache.insertBodyPart(5, "1", "Body of five"));
+    QVERIFY(cache.setFlags(5, ImapMessageSeen | ImapMessageAnswered));
+    QVERIFY(cache.remove(ImapSequenceSet(6)));
+    QVERIFY(insert(&cache, 7));
+    QVERIFY(cache.remove(ImapSequenceSet(7)));
+    cache.close();
+    QVERIFY(!cache.isOpen());
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet(5));
+    QCOMPARE(cache.flags(5), (ImapMessageFlags)(ImapMessageSeen | ImapMessageAnswered));
+    QCOMPARE(cache.bodyPart(5, "1"), QByteArray("Body of five"));
+    QCOMPARE(cache.bodyPartSections(5), QStringList() << "1");
+
+    QString messageId, reference, subject;
+    QDateTime sent;
+    QVERIFY(cache.threadFields(5, &messageId, &reference, &subject, &sent));
+    QCOMPARE(subject, _cacheSubject(5));
+    QCOMPARE(messageId, QString("<message-5@example.com>"));
+}
+
+/* Records appended past the mapping are read back through the file. */
+void CacheTest::testManyRecords (void) {
+    const uint count = 3000;
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    for (uint uid = 1; uid <= count; ++uid) {
+        QVERIFY(insert(&cache, uid));
+        QVERIFY(cache.insertBodyPart(uid, "1", "Part " + QByteArray::number(uid)));
+        if ((uid % 3) == 0)
+            QVERIFY(cache.setFlags(uid, ImapMessageSeen));
+    }
+
+    for (uint uid = 1; uid <= count; uid += 97) {
+        QCOMPARE(cache.bodyPart(uid, "1"), "Part " + QByteArray::number(uid));
+        QCOMPARE(cache.flags(uid), (ImapMessageFlags)((uid % 3) == 0 ? ImapMessageSeen : 0));
+    }
+    cache.close();
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1, count));
+    ImapMessage *message = cache.message(count);
+    QVERIFY(message != NULL);
+    QCOMPARE(message->subject(), _cacheSubject(count));
+    delete message;
+}
+
+/* A new UIDVALIDITY discards the content. */
+void CacheTest::testUidValidity (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1));
+    cache.close();
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 2));
+    QCOMPARE(cache.uidValidity(), 2U);
+    QVERIFY(cache.uids().isEmpty());
+}
+
+void CacheTest::testCompact (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    for (uint uid = 1; uid <= 20; ++uid)
+        QVERIFY(insert(&cache, uid));
+    for (int i = 0; i < 50; ++i)
+        QVERIFY(cache.setFlags(3, (i % 2) ? ImapMessageSeen : ImapMessageFlagged));
+    QVERIFY(cache.insertBodyPart(3, "1", QByteArray(4096, 'x')));
+    QVERIFY(cache.insertBodyPart(4, "1", QByteArray(4096, 'y')));
+    QVERIFY(cache.remove(ImapSequenceSet(4, 10)));
+
+    ImapSyncState state(CACHE_TEST_MAILBOX);
+    state.setUidValidity(1);
+    state.setUids(cache.uids());
+    QVERIFY(cache.setSyncState(state));
+
+    qint64 size = cache.size();
+    QVERIFY(cache.compact());
+    QVERIFY(cache.size() < size);
+
+    QCOMPARE(cache.uids(), ImapSequenceSet::fromString("1:3,11:20"));
+    QCOMPARE(cache.flags(3), (ImapMessageFlags)ImapMessageSeen);
+    QCOMPARE(cache.bodyPart(3, "1"), QByteArray(4096, 'x'));
+    QVERIFY(!cache.hasBodyPart(4, "1"));
+    QCOMPARE(cache.syncState().uids(), state.uids());
+    QVERIFY(!QFile::exists(fileName(".data.old")));
+    QVERIFY(!QFile::exists(fileName(".index.old")));
+    QVERIFY(!QFile::exists(fileName(".data.tmp")));
+
+    // Still the same once reloaded.
+    cache.close();
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet::fromString("1:3,11:20"));
+    QCOMPARE(cache.flags(3), (ImapMessageFlags)ImapMessageSeen);
+}
+
+/* A crash after compact() moved the live files aside: they're restored. */
+void CacheTest::testInterruptedCompact (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1, ImapMessageSeen));
+    QVERIFY(insert(&cache, 2));
+    cache.close();
+
+    QVERIFY(QFile::rename(fileName(".data"), fileName(".data.old")));
+    QVERIFY(QFile::rename(fileName(".index"), fileName(".index.old")));
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1, 2));
+    QCOMPARE(cache.flags(1), (ImapMessageFlags)ImapMessageSeen);
+}
+
+/* A crash in the middle of a write: the partial record is dropped. */
+void CacheTest::testCorruptTail (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1));
+    QVERIFY(insert(&cache, 2));
+    cache.close();
+
+    QFile data(fileName(".data"));
+    qint64 size = data.size();
+    QVERIFY(data.open(QIODevice::Append));
+    data.write("IMCR\x02\x00\x00", 7);
+    data.close();
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1, 2));
+    QCOMPARE(QFileInfo(fileName(".data")).size(), size);
+
+    QVERIFY(insert(&cache, 3));
+    cache.close();
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1, 3));
+}
+
+/* Index entries lost: recovered from the data file. */
+void CacheTest::testLostIndex (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1, ImapMessageSeen));
+    QVERIFY(insert(&cache, 2, ImapMessageDraft));
+    cache.close();
+
+    QFile index(fileName(".index"));
+    QVERIFY(index.open(QIODevice::ReadWrite));
+    QVERIFY(index.resize(16 + 1));
+    index.close();
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1, 2));
+    QCOMPARE(cache.flags(2), (ImapMessageFlags)ImapMessageDraft);
+}
+
+void CacheTest::testApply (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1));
+    QVERIFY(insert(&cache, 2));
+
+    ImapSyncDelta delta;
+    delta.setUidValidity(1);
+    delta.addRemoved(ImapSequenceSet(1));
+    delta.addChanged(2, ImapMessageSeen);
+    delta.added()->addMessage(_cacheMessage(3, ImapMessageFlagged));
+    QVERIFY(cache.apply(delta));
+
+    QCOMPARE(cache.uids(), ImapSequenceSet(2, 3));
+    QCOMPARE(cache.flags(2), (ImapMessageFlags)ImapMessageSeen);
+    QCOMPARE(cache.flags(3), (ImapMessageFlags)ImapMessageFlagged);
+}
+
+/* The new messages survive the next open with the new UIDVALIDITY. */
+void CacheTest::testApplyReset (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    QVERIFY(insert(&cache, 1));
+    QVERIFY(insert(&cache, 2));
+
+    ImapSyncDelta delta;
+    delta.setReset(true);
+    delta.setUidValidity(9);
+    delta.addRemoved(ImapSequenceSet(1, 2));
+    delta.added()->addMessage(_cacheMessage(1, ImapMessageSeen));
+    QVERIFY(cache.apply(delta));
+    QCOMPARE(cache.uidValidity(), 9U);
+    QCOMPARE(cache.uids(), ImapSequenceSet(1));
+    cache.close();
+
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 9));
+    QCOMPARE(cache.uids(), ImapSequenceSet(1));
+    QCOMPARE(cache.flags(1), (ImapMessageFlags)ImapMessageSeen);
+}
+
+void CacheTest::testSearch (void) {
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(CACHE_TEST_SERVER, CACHE_TEST_MAILBOX, 1));
+    for (uint uid = 1; uid <= 30; ++uid)
+        QVERIFY(insert(&cache, uid, (uid % 2) ? ImapMessageSeen : 0));
+
+    ImapSearchQuery unseen = ImapSearchQuery::flag(ImapMessageSeen, false);
+    QVERIFY(!unseen.needsEnvelope());
+    ImapSequenceSet expected;
+    for (uint uid = 2; uid <= 30; uid += 2)
+        expected.add(uid);
+    QCOMPARE(cache.search(unseen), expected);
+
+    ImapSearchQuery subject = ImapSearchQuery::subject("#2") && unseen;
+    QVERIFY(subject.needsEnvelope());
+    QCOMPARE(cache.search(subject), ImapSequenceSet::fromString("2,20,22,24,26,28"));
+
+    QCOMPARE(cache.search(ImapSearchQuery::uids(ImapSequenceSet(5, 7)) && !unseen),
+             ImapSequenceSet::fromString("5,7"));
+}
+
+QString CacheTest::cachePath (void) const {
+    return(QDir::temp().filePath("ImapCacheTest"));
+}
+
+/* The cache files are named after the SHA-1 of server and mailbox. */
+QString CacheTest::fileName (const QString& extension) const {
+    QByteArray key = QString("%1\n%2").arg(CACHE_TEST_SERVER).arg(CACHE_TEST_MAILBOX).toUtf8();
+    QString baseName = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return(QDir(cachePath()).filePath(baseName + extension));
+}
+
+bool CacheTest::insert (ImapCache *cache, uint uid, ImapMessageFlags flags) {
+    ImapMessage *message = _cacheMessage(uid, flags);
+    bool ok = cache->insertMessage(message);
+    delete message;
+    return(ok);
+}
+
+QTEST_MAIN(CacheTest)
+
+#endif /* TEST_IMAP_CACHE */
@@ -0,0 +1,40 @@
+#ifdef TEST_IMAP_CACHE
+#ifndef _CACHE_TEST_H_
+#define _CACHE_TEST_H_
+
+#include <QObject>
+
+#include "imapmessage.h"
+
+class ImapCache;
+
+class CacheTest : public QObject {
+    Q_OBJECT
+
+    public:
+        CacheTest (QObject *parent = 0);
+        ~CacheTest();
+
+    private slots:
+        void cleanup (void);
+
+        void testRecord (void);
+        void testReload (void);
+        void testManyRecords (void);
+        void testUidValidity (void);
+        void testCompact (void);
+        void testInterruptedCompact (void);
+        void testCorruptTail (void);
+        void testLostIndex (void);
+        void testApply (void);
+        void testApplyReset (void);
+        void testSearch (void);
+
+    private:
+        QString cachePath (void) const;
+        QString fileName (const QString& extension) const;
+        bool insert (ImapCache *cache, uint uid, ImapMessageFlags flags = 0);
+};
+
+#endif /* !_CACHE_TEST_H_ */
+#endif /* TEST_IMAP_CACHE */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Thread-safe Client Tests, against the local test server
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_CLIENT
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += clienttest.h
+SOURCES += clienttest.cpp
@@ -0,0 +1,163 @@
+#ifdef TEST_IMAP_CLIENT
+
+#include <QThreadPool>
+#include <QEventLoop>
+#include <QRunnable>
+#include <QTimer>
+#include <QMutex>
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapclient.h"
+#include "imapmailbox.h"
+
+#include "clienttest.h"
+
+#define CLIENT_TEST_MESSAGES        (100)
+#define CLIENT_TEST_PRODUCERS       (4)
+#define CLIENT_TEST_SEARCHES        (50)
+
+/* Submits searches from a pool thread. */
+class ClientTestProducer : public QRunnable {
+    public:
+        ClientTestProducer (ImapClient *client, QMutex *mutex,
+                            QList<ImapSearchReply *> *replies)
+            : m_client(client), m_mutex(mutex), m_replies(replies)
+        {
+        }
+
+        void run (void) {
+            for (int i = 0; i < CLIENT_TEST_SEARCHES; ++i) {
+                ImapSearchReply *reply = m_client->searchSet("ALL", true);
+                QMutexLocker locker(m_mutex);
+                m_replies->append(reply);
+            }
+        }
+
+    private:
+        ImapClient *m_client;
+        QMutex *m_mutex;
+        QList<ImapSearchReply *> *m_replies;
+};
+
+ClientTest::ClientTest (QObject *parent)
+    : QObject(parent), m_server(NULL)
+{
+}
+
+ClientTest::~ClientTest() {
+}
+
+void ClientTest::initTestCase (void) {
+    m_server = new ImapTestServer(CLIENT_TEST_MESSAGES);
+}
+
+void ClientTest::cleanupTestCase (void) {
+    delete m_server;
+}
+
+void ClientTest::testSession (void) {
+    ImapClient client;
+
+    ImapReply *connected = client.connectToHost("127.0.0.1", m_server->listen());
+    ImapReply *login = client.login("user", "secret");
+    ImapMailboxReply *select = client.select("INBOX");
+    ImapMailboxReply *fetch = client.uidFetch("INBOX", ImapSequenceSet::fromString("1:10"));
+
+    // Delivered to this thread, queued.
+    QEventLoop loop;
+    connect(fetch, SIGNAL(finished()), &loop, SLOT(quit()));
+    QTimer::singleShot(30000, &loop, SLOT(quit()));
+    if (!fetch->isFinished())
+        loop.exec();
+
+    QVERIFY(fetch->isFinished());
+    QVERIFY(connected->waitForFinished() && connected->isOk());
+    QVERIFY(login->waitForFinished() && login->isOk());
+    QVERIFY(select->waitForFinished() && select->isOk());
+    QCOMPARE(select->mailbox()->exists(), CLIENT_TEST_MESSAGES);
+
+    QVERIFY(fetch->isOk());
+    ImapMailbox *mailbox = fetch->takeMailbox();
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 10);
+    delete mailbox;
+
+    ImapReply *logout = client.logout();
+    QVERIFY(logout->waitForFinished(30000));
+    QVERIFY(m_server->waitForSession());
+
+    delete connected;
+    delete login;
+    delete select;
+    delete fetch;
+    delete logout;
+}
+
+void ClientTest::testConcurrentSubmit (void) {
+    ImapClient client;
+    ImapReply *connected = client.connectToHost("127.0.0.1", m_server->listen());
+    ImapReply *login = client.login("user", "secret");
+    ImapMailboxReply *select = client.select("INBOX");
+
+    QMutex mutex;
+    QList<ImapSearchReply *> replies;
+
+    QThreadPool pool;
+    for (int i = 0; i < CLIENT_TEST_PRODUCERS; ++i)
+        pool.start(new ClientTestProducer(&client, &mutex, &replies));
+    pool.waitForDone();
+
+    QCOMPARE(replies.size(), CLIENT_TEST_PRODUCERS * CLIENT_TEST_SEARCHES);
+    foreach (ImapSearchReply *reply, replies) {
+        QVERIFY(reply->waitForFinished(30000));
+        QVERIFY(reply->isOk());
+        QCOMPARE(reply->result().count(), quint64(CLIENT_TEST_MESSAGES));
+    }
+    QVERIFY(select->isOk());
+
+    qDeleteAll(replies);
+    delete connected;
+    delete login;
+    delete select;
+}
+
+/* A stalled server costs the deadline, not the socket timeout. */
+void ClientTest::testDeadline (void) {
+    ImapClient client;
+    ImapReply *connected = client.connectToHost("127.0.0.1", m_server->listen());
+    ImapReply *login = client.login("user", "secret");
+    QVERIFY(login->waitForFinished(30000) && login->isOk());
+
+    m_server->setLatency(3000);
+
+    QTime timer;
+    timer.start();
+    ImapSearchReply *stalled = new ImapSearchReply("ALL", true);
+    stalled->setDeadline(300);
+    client.submit(stalled);
+
+    ImapSearchReply *cancelled = client.searchSet("ALL", true);
+    cancelled->cancel();
+
+    QVERIFY(stalled->waitForFinished(30000));
+    QVERIFY(timer.elapsed() < 2000);
+    QVERIFY(!stalled->isOk());
+    QCOMPARE(stalled->errorString(), QString("Operation deadline expired"));
+
+    QVERIFY(cancelled->waitForFinished(30000));
+    QVERIFY(!cancelled->isOk());
+    QCOMPARE(cancelled->errorString(), QString("Operation cancelled"));
+
+    QVERIFY(m_server->waitForSession());
+    m_server->setLatency(0);
+
+    delete connected;
+    delete login;
+    delete stalled;
+    delete cancelled;
+}
+
+QTEST_MAIN(ClientTest)
+
+#endif /* TEST_IMAP_CLIENT */
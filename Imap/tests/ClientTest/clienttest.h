@@ -0,0 +1,29 @@
+#ifdef TEST_IMAP_CLIENT
+#ifndef _CLIENT_TEST_H_
+#define _CLIENT_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+
+class ClientTest : public QObject {
+    Q_OBJECT
+
+    public:
+        ClientTest (QObject *parent = 0);
+        ~ClientTest();
+
+    private slots:
+        void initTestCase (void);
+        void cleanupTestCase (void);
+
+        void testSession (void);
+        void testConcurrentSubmit (void);
+        void testDeadline (void);
+
+    private:
+        ImapTestServer *m_server;
+};
+
+#endif /* !_CLIENT_TEST_H_ */
+#endif /* TEST_IMAP_CLIENT */
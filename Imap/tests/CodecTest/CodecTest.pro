@@ -0,0 +1,18 @@
+######################################################################
+# Imap Codec Tests and Throughput Benchmarks
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += . ../../src/
+INCLUDEPATH += . ../../src/
+
+DEFINES += TEST_IMAP_CODEC
+
+QT += testlib
+
+# Input
+HEADERS += codectest.h \
+           ../../src/imapcodec.h
+SOURCES += codectest.cpp \
+           ../../src/imapcodec.cpp
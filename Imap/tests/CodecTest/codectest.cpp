@@ -0,0 +1,114 @@
+#ifdef TEST_IMAP_CODEC
+
+#include <QtTest>
+
+#include "imapcodec.h"
+
+#include "codectest.h"
+
+#define CODEC_TEST_DATA_SIZE        (4 * 1024 * 1024)
+
+CodecTest::CodecTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+CodecTest::~CodecTest() {
+}
+
+void CodecTest::initTestCase (void) {
+    qsrand(1);
+
+    m_binary.resize(CODEC_TEST_DATA_SIZE);
+    for (int i = 0; i < m_binary.size(); ++i)
+        m_binary[i] = (char)(qrand() & 0xff);
+
+    // Base64 body as sent by a mail server: 76 chars per line, CRLF.
+    QByteArray base64 = m_binary.toBase64();
+    m_base64.reserve(base64.size() + (base64.size() / 76) * 2 + 2);
+    for (int i = 0; i < base64.size(); i += 76) {
+        m_base64 += base64.mid(i, 76);
+        m_base64 += "\r\n";
+    }
+
+    // Mostly ASCII text with some escapes and soft line breaks.
+    QByteArray line("Caf=C3=A9 latte, cr=C3=A8me br=C3=BBl=C3=A9e and some plain text=\r\n");
+    while (m_quotedPrintable.size() < CODEC_TEST_DATA_SIZE)
+        m_quotedPrintable += line;
+}
+
+/* Back to the default code path. */
+void CodecTest::cleanup (void) {
+    ImapCodec::setAccelerated(true);
+}
+
+void CodecTest::testBase64_data (void) {
+    QTest::addColumn<bool>("accelerated");
+
+    QTest::newRow("scalar") << false;
+    QTest::newRow("ssse3") << true;
+}
+
+/* Every size around the 16 chars (12 bytes) blocks, and line breaks. */
+void CodecTest::testBase64 (void) {
+    QFETCH(bool, accelerated);
+    if (!ImapCodec::setAccelerated(accelerated))
+        QSKIP("SSSE3 not available", SkipSingle);
+    QCOMPARE(ImapCodec::isAccelerated(), accelerated);
+
+    QCOMPARE(ImapCodec::decodeBase64(m_base64), m_binary);
+    QCOMPARE(ImapCodec::encodeBase64(m_binary), m_binary.toBase64());
+
+    for (int size = 0; size < 64; ++size) {
+        QByteArray data = m_binary.left(size);
+        QCOMPARE(ImapCodec::encodeBase64(data), data.toBase64());
+        QCOMPARE(ImapCodec::decodeBase64(data.toBase64()), data);
+    }
+
+    QByteArray wrapped;
+    QByteArray base64 = m_binary.left(1000).toBase64();
+    for (int i = 0; i < base64.size(); i += 76)
+        wrapped += base64.mid(i, 76) + "\r\n";
+    QCOMPARE(ImapCodec::decodeBase64(wrapped), m_binary.left(1000));
+}
+
+void CodecTest::testQuotedPrintable (void) {
+    QCOMPARE(ImapCodec::decodeQuotedPrintable("a=3Db=\r\nc=\nd"), QByteArray("a=bcd"));
+    QCOMPARE(ImapCodec::decodeQuotedPrintable("caf=C3=A9"), QByteArray("caf\xc3\xa9"));
+    QCOMPARE(ImapCodec::decodeQuotedPrintable("a_b", true), QByteArray("a b"));
+    QCOMPARE(ImapCodec::decodeQuotedPrintable("100=%"), QByteArray("100=%"));
+}
+
+void CodecTest::testEncodedWords (void) {
+    QCOMPARE(ImapCodec::decodeEncodedWords("plain subject"), QByteArray("plain subject"));
+    QCOMPARE(ImapCodec::decodeEncodedWords("Re: =?UTF-8?Q?caf=C3=A9?= tail"),
+             QByteArray("Re: caf\xc3\xa9 tail"));
+    QCOMPARE(ImapCodec::decodeEncodedWords("=?UTF-8?B?SGVs?= =?UTF-8?B?bG8=?="),
+             QByteArray("Hello"));
+    QCOMPARE(ImapCodec::decodeHeader("=?ISO-8859-1?Q?caf=E9?="),
+             QString::fromUtf8("caf\xc3\xa9"));
+}
+
+void CodecTest::benchmarkBase64Decode (void) {
+    QBENCHMARK { ImapCodec::decodeBase64(m_base64); }
+}
+
+void CodecTest::benchmarkBase64DecodeQt (void) {
+    QBENCHMARK { QByteArray::fromBase64(m_base64); }
+}
+
+void CodecTest::benchmarkBase64Encode (void) {
+    QBENCHMARK { ImapCodec::encodeBase64(m_binary); }
+}
+
+void CodecTest::benchmarkBase64EncodeQt (void) {
+    QBENCHMARK { m_binary.toBase64(); }
+}
+
+void CodecTest::benchmarkQuotedPrintableDecode (void) {
+    QBENCHMARK { ImapCodec::decodeQuotedPrintable(m_quotedPrintable); }
+}
+
+QTEST_MAIN(CodecTest)
+
+#endif /* TEST_IMAP_CODEC */
@@ -0,0 +1,37 @@
+#ifdef TEST_IMAP_CODEC
+#ifndef _CODEC_TEST_H_
+#define _CODEC_TEST_H_
+
+#include <QByteArray>
+#include <QObject>
+
+class CodecTest : public QObject {
+    Q_OBJECT
+
+    public:
+        CodecTest (QObject *parent = 0);
+        ~CodecTest();
+
+    private slots:
+        void initTestCase (void);
+        void cleanup (void);
+
+        void testBase64_data (void);
+        void testBase64 (void);
+        void testQuotedPrintable (void);
+        void testEncodedWords (void);
+
+        void benchmarkBase64Decode (void);
+        void benchmarkBase64DecodeQt (void);
+        void benchmarkBase64Encode (void);
+        void benchmarkBase64EncodeQt (void);
+        void benchmarkQuotedPrintableDecode (void);
+
+    private:
+        QByteArray m_binary;
+        QByteArray m_base64;
+        QByteArray m_quotedPrintable;
+};
+
+#endif /* !_CODEC_TEST_H_ */
+#endif /* TEST_IMAP_CODEC */
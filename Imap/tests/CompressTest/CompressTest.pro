@@ -0,0 +1,16 @@
+######################################################################
+# Imap COMPRESS=DEFLATE Tests, against the local test server
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_COMPRESS
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += compresstest.h
+SOURCES += compresstest.cpp
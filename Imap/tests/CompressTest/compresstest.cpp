@@ -0,0 +1,164 @@
+#ifdef TEST_IMAP_COMPRESS
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+#ifndef QT_NO_OPENSSL
+    #include <QSslSocket>
+#endif
+
+#include "imapcompressdevice.h"
+#include "imapsequenceset.h"
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imap.h"
+
+#include "compresstest.h"
+
+#define COMPRESS_TEST_MESSAGES      (2000)
+
+CompressTest::CompressTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+CompressTest::~CompressTest() {
+}
+
+void CompressTest::initTestCase (void) {
+    m_server = new ImapTestServer(COMPRESS_TEST_MESSAGES);
+}
+
+void CompressTest::cleanupTestCase (void) {
+    delete m_server;
+}
+
+/* Both ends of a loopback connection, deflated. */
+void CompressTest::testDeviceRoundTrip (void) {
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+    QVERIFY(server.waitForNewConnection(5000));
+    QTcpSocket *peer = server.nextPendingConnection();
+
+    ImapCompressDevice clientDevice(&client);
+    ImapCompressDevice peerDevice(peer);
+
+    QByteArray lines;
+    for (int i = 0; i < 500; ++i)
+        lines += "* " + QByteArray::number(i) + " FETCH (FLAGS (\\Seen))\r\n";
+
+    peerDevice.write(lines);
+    QVERIFY(peerDevice.waitForBytesWritten(5000));
+
+    QByteArray received;
+    while (received.size() < lines.size()) {
+        while (!clientDevice.canReadLine())
+            QVERIFY(clientDevice.waitForReadyRead(5000));
+        received += clientDevice.readLine();
+    }
+    QCOMPARE(received, lines);
+    QVERIFY(peerDevice.compressedBytesWritten() < lines.size() / 4);
+    QCOMPARE(clientDevice.bytesRead(), (qint64)lines.size());
+
+    clientDevice.write("A1 NOOP\r\n");
+    QVERIFY(clientDevice.waitForBytesWritten(5000));
+    while (!peerDevice.canReadLine())
+        QVERIFY(peerDevice.waitForReadyRead(5000));
+    QCOMPARE(peerDevice.readLine(), QByteArray("A1 NOOP\r\n"));
+
+    delete peer;
+}
+
+void CompressTest::testFetchCompressed (void) {
+    bool compressed;
+
+    QCOMPARE(fetchEnvelopes(false, &compressed), COMPRESS_TEST_MESSAGES);
+    QVERIFY(!compressed);
+    qint64 plainBytes = m_server->bytesSent();
+    QCOMPARE(plainBytes, m_server->payloadSent());
+
+    QCOMPARE(fetchEnvelopes(true, &compressed), COMPRESS_TEST_MESSAGES);
+    QVERIFY(compressed);
+    QVERIFY(m_server->isCompressed());
+    qint64 compressedBytes = m_server->bytesSent();
+
+    qDebug("Envelopes: %lld bytes, %lld compressed (%.1f%% saved)",
+           plainBytes, compressedBytes,
+           100.0 - (compressedBytes * 100.0 / plainBytes));
+    QVERIFY(compressedBytes < plainBytes / 3);
+}
+
+void CompressTest::testNotSupported (void) {
+    ImapTestServer server(10);
+    server.setCapabilities(QStringList() << "IMAP4rev1");
+
+    Imap imap;
+    imap.setCompression(true);
+    QVERIFY(imap.connectToHost("127.0.0.1", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    QVERIFY(!imap.isCompressed());
+    QVERIFY(imap.logout());
+    imap.disconnectFromHost();
+}
+
+/* DEFLATE layered over TLS: compressed before encryption. */
+void CompressTest::testFetchCompressedSsl (void) {
+#ifndef QT_NO_OPENSSL
+    ImapTestServer server(200);
+    server.setSsl(true);
+    QSslSocket::addDefaultCaCertificate(ImapTestServer::certificate());
+
+    Imap imap;
+    imap.setCompression(true);
+    QVERIFY(imap.connectToSslHost("localhost", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    QVERIFY(imap.isCompressed());
+
+    ImapMailbox *mailbox = imap.select("INBOX");
+    QVERIFY(mailbox != NULL);
+    QVERIFY(imap.uidFetch(mailbox, ImapSequenceSet(1, 200)) != NULL);
+    QCOMPARE(mailbox->count(), 200);
+    delete mailbox;
+
+    QVERIFY(imap.logout());
+    imap.disconnectFromHost();
+    QVERIFY(server.waitForSession());
+    QVERIFY(server.isSsl());
+    QVERIFY(server.isCompressed());
+    QVERIFY(server.bytesSent() < server.payloadSent() / 3);
+#else
+    QSKIP("Built without OpenSSL", SkipAll);
+#endif
+}
+
+int CompressTest::fetchEnvelopes (bool compression, bool *compressed) {
+    Imap imap;
+    imap.setCompression(compression);
+    if (!imap.connectToHost("127.0.0.1", m_server->listen()))
+        return(-1);
+    if (!imap.login("user", "secret"))
+        return(-1);
+    *compressed = imap.isCompressed();
+
+    ImapMailbox *mailbox = imap.select("INBOX");
+    if (mailbox == NULL)
+        return(-1);
+
+    int count = -1;
+    if (imap.uidFetch(mailbox, ImapSequenceSet(1, COMPRESS_TEST_MESSAGES)) != NULL)
+        count = mailbox->count();
+    delete mailbox;
+
+    imap.logout();
+    imap.disconnectFromHost();
+    m_server->waitForSession();
+    return(count);
+}
+
+QTEST_MAIN(CompressTest)
+
+#endif /* TEST_IMAP_COMPRESS */
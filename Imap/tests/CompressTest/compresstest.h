@@ -0,0 +1,33 @@
+#ifdef TEST_IMAP_COMPRESS
+#ifndef _COMPRESS_TEST_H_
+#define _COMPRESS_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+
+class CompressTest : public QObject {
+    Q_OBJECT
+
+    public:
+        CompressTest (QObject *parent = 0);
+        ~CompressTest();
+
+    private slots:
+        void initTestCase (void);
+        void cleanupTestCase (void);
+
+        void testDeviceRoundTrip (void);
+        void testFetchCompressed (void);
+        void testNotSupported (void);
+        void testFetchCompressedSsl (void);
+
+    private:
+        int fetchEnvelopes (bool compression, bool *compressed);
+
+    private:
+        ImapTestServer *m_server;
+};
+
+#endif /* !_COMPRESS_TEST_H_ */
+#endif /* TEST_IMAP_COMPRESS */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Batched Body Fetch Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_FETCH_BODIES
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += fetchbodiestest.h
+SOURCES += fetchbodiestest.cpp
@@ -0,0 +1,194 @@
+#ifdef TEST_IMAP_FETCH_BODIES
+
+#include <QtTest>
+#include <QDir>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapcache.h"
+#include "imap.h"
+
+#include "fetchbodiestest.h"
+
+#define FETCH_TEST_MESSAGES     (5)
+#define FETCH_TEST_SERVER       ("127.0.0.1")
+
+/* Text with the newlines of either convention, to compare. */
+static QByteArray _fetchText (const QByteArray& data) {
+    QByteArray text = data;
+    text.replace("\r\n", "\n");
+    return(text);
+}
+
+FetchBodiesTest::FetchBodiesTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+FetchBodiesTest::~FetchBodiesTest() {
+}
+
+void FetchBodiesTest::cleanup (void) {
+    QDir directory(cachePath());
+    foreach (const QString& name, directory.entryList(QDir::Files))
+        directory.remove(name);
+}
+
+/*
+ * Messages without structure, out of UID order: every response goes to
+ * its message, the body literal coming before the BODYSTRUCTURE.
+ */
+void FetchBodiesTest::testDemultiplex (void) {
+    ImapTestServer server(FETCH_TEST_MESSAGES);
+    server.setBodySize(300);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QList<ImapMessage *> list = messages(QList<uint>() << 3 << 1 << 5);
+    QVERIFY(imap.fetchBodies(list, false, QStringList() << "1"));
+
+    foreach (ImapMessage *message, list) {
+        uint uid = message->uid().toUInt();
+        QVERIFY(message->bodyStructure() != NULL);
+        QCOMPARE(message->bodyPartCount(), 1);
+
+        ImapMessageBodyPart *part = message->bodyPartAt(0);
+        QCOMPARE(_fetchText(part->data()), _fetchText(ImapTestServer::body(uid, 300)));
+        QVERIFY(!part->isPartial());
+    }
+
+    close(&imap, &server);
+    qDeleteAll(list);
+
+    // The structure is asked only because the messages had none.
+    bool structure = false;
+    foreach (const QByteArray& command, server.commandLog())
+        structure |= command.startsWith("UID FETCH 1,3,5 (UID BODY.PEEK[1] BODYSTRUCTURE)");
+    QVERIFY(structure);
+}
+
+void FetchBodiesTest::testStructureOnly (void) {
+    ImapTestServer server(FETCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QList<ImapMessage *> list = messages(QList<uint>() << 2 << 4);
+    QVERIFY(imap.fetchBodies(list, true));
+
+    foreach (ImapMessage *message, list) {
+        QVERIFY(message->bodyStructure() != NULL);
+        QCOMPARE(message->bodyPartCount(), 1);
+        QVERIFY(message->bodyPartAt(0)->data().isEmpty());
+    }
+
+    close(&imap, &server);
+    qDeleteAll(list);
+}
+
+/* A preview is marked partial and kept out of the cache. */
+void FetchBodiesTest::testPartial (void) {
+    ImapTestServer server(FETCH_TEST_MESSAGES);
+    server.setBodySize(4096);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(FETCH_TEST_SERVER, "INBOX", 1));
+    imap.setCache(&cache);
+
+    QList<ImapMessage *> list = messages(QList<uint>() << 1 << 2);
+    QVERIFY(imap.fetchBodies(list, true, QStringList() << "1", 100));
+
+    foreach (ImapMessage *message, list) {
+        uint uid = message->uid().toUInt();
+        ImapMessageBodyPart *part = message->bodyPartAt(0);
+        QVERIFY(part->isPartial());
+        QCOMPARE(_fetchText(part->data()), _fetchText(ImapTestServer::body(uid, 4096).left(100)));
+        QVERIFY(!cache.hasBodyPart(uid, "1"));
+        QVERIFY(cache.hasBodyStructure(uid));
+    }
+
+    imap.setCache(NULL);
+    close(&imap, &server);
+    qDeleteAll(list);
+}
+
+/* Cut within a base64 quad: decoded up to the last whole one. */
+void FetchBodiesTest::testPartialBase64 (void) {
+    ImapTestServer server(FETCH_TEST_MESSAGES);
+    server.setBodyEncoding("BASE64");
+    server.setBodySize(1000);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QList<ImapMessage *> list = messages(QList<uint>() << 4);
+    QVERIFY(imap.fetchBodies(list, true, QStringList() << "1", 30));
+
+    ImapMessageBodyPart *part = list.first()->bodyPartAt(0);
+    QVERIFY(part->isPartial());
+    QCOMPARE(part->data(), ImapTestServer::body(4, 1000).left(21));
+
+    close(&imap, &server);
+    qDeleteAll(list);
+}
+
+/* Parts shorter than maxBytes come whole, they are complete. */
+void FetchBodiesTest::testShortPartComplete (void) {
+    ImapTestServer server(FETCH_TEST_MESSAGES);
+    server.setBodySize(50);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(FETCH_TEST_SERVER, "INBOX", 1));
+    imap.setCache(&cache);
+
+    QList<ImapMessage *> list = messages(QList<uint>() << 1);
+    QVERIFY(imap.fetchBodies(list, true, QStringList() << "1", 100));
+
+    ImapMessageBodyPart *part = list.first()->bodyPartAt(0);
+    QVERIFY(!part->isPartial());
+    QCOMPARE(_fetchText(part->data()), _fetchText(ImapTestServer::body(1, 50)));
+    QVERIFY(cache.hasBodyPart(1, "1"));
+
+    imap.setCache(NULL);
+    close(&imap, &server);
+    qDeleteAll(list);
+}
+
+QString FetchBodiesTest::cachePath (void) const {
+    return(QDir::temp().filePath("ImapFetchBodiesTest"));
+}
+
+/* Messages known by UID only, as loaded from a listing. */
+QList<ImapMessage *> FetchBodiesTest::messages (const QList<uint>& uids) const {
+    QList<ImapMessage *> list;
+    foreach (uint uid, uids) {
+        ImapMessage *message = new ImapMessage;
+        message->setUid(QString::number(uid));
+        list.append(message);
+    }
+    return(list);
+}
+
+bool FetchBodiesTest::open (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost(FETCH_TEST_SERVER, server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select("INBOX");
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+void FetchBodiesTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+}
+
+QTEST_MAIN(FetchBodiesTest)
+
+#endif /* TEST_IMAP_FETCH_BODIES */
@@ -0,0 +1,36 @@
+#ifdef TEST_IMAP_FETCH_BODIES
+#ifndef _FETCH_BODIES_TEST_H_
+#define _FETCH_BODIES_TEST_H_
+
+#include <QObject>
+#include <QList>
+
+class ImapTestServer;
+class ImapMessage;
+class Imap;
+
+class FetchBodiesTest : public QObject {
+    Q_OBJECT
+
+    public:
+        FetchBodiesTest (QObject *parent = 0);
+        ~FetchBodiesTest();
+
+    private slots:
+        void cleanup (void);
+
+        void testDemultiplex (void);
+        void testStructureOnly (void);
+        void testPartial (void);
+        void testPartialBase64 (void);
+        void testShortPartComplete (void);
+
+    private:
+        QString cachePath (void) const;
+        QList<ImapMessage *> messages (const QList<uint>& uids) const;
+        bool open (Imap *imap, ImapTestServer *server);
+        void close (Imap *imap, ImapTestServer *server);
+};
+
+#endif /* !_FETCH_BODIES_TEST_H_ */
+#endif /* TEST_IMAP_FETCH_BODIES */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Flags, Keywords and Flag Cache Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_FLAGS
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += flagstest.h
+SOURCES += flagstest.cpp
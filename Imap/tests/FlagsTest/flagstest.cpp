@@ -0,0 +1,227 @@
+#ifdef TEST_IMAP_FLAGS
+
+#include <QCryptographicHash>
+#include <QtTest>
+#include <QFile>
+#include <QDir>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapparser.h"
+#include "imapcache.h"
+#include "imap.h"
+
+#include "flagstest.h"
+
+#define FLAGS_TEST_MESSAGES     (10)
+#define FLAGS_TEST_SERVER       ("127.0.0.1")
+
+/* Append a quint32, in host byte order as the cache files are. */
+static void _flagsAppend (QByteArray *data, quint32 value) {
+    data->append((const char *)&value, sizeof(quint32));
+}
+
+FlagsTest::FlagsTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+FlagsTest::~FlagsTest() {
+}
+
+void FlagsTest::cleanup (void) {
+    QDir directory(cachePath());
+    foreach (const QString& name, directory.entryList(QDir::Files))
+        directory.remove(name);
+}
+
+void FlagsTest::testKeywordFlag (void) {
+    ImapMessageFlags forwarded = ImapMessage::keywordFlag("$Forwarded");
+    QVERIFY(forwarded >= (ImapMessageFlags)ImapMessageFirstKeyword);
+    QCOMPARE(ImapMessage::keywordFlag("$forwarded"), forwarded);
+    QCOMPARE(ImapMessage::findKeyword("$FORWARDED"), forwarded);
+    QCOMPARE(ImapMessage::keywordName(forwarded), QByteArray("$Forwarded"));
+
+    ImapMessageFlags junk = ImapMessage::keywordFlag("$Junk");
+    QVERIFY(junk != forwarded);
+    QCOMPARE(ImapMessage::flagsString(ImapMessageSeen | forwarded | junk),
+             QString("\\Seen $Forwarded $Junk"));
+    QCOMPARE(ImapMessage::parseFlags("\\Seen $Junk"), ImapMessageSeen | junk);
+}
+
+/* Not atoms: they would break the STORE command line. */
+void FlagsTest::testInvalidKeyword (void) {
+    QCOMPARE(ImapMessage::keywordFlag(""), (ImapMessageFlags)0);
+    QCOMPARE(ImapMessage::keywordFlag("two words"), (ImapMessageFlags)0);
+    QCOMPARE(ImapMessage::keywordFlag("$Label)"), (ImapMessageFlags)0);
+    QCOMPARE(ImapMessage::keywordFlag("(Label"), (ImapMessageFlags)0);
+    QCOMPARE(ImapMessage::keywordFlag("Label\r\nA001 LOGOUT"), (ImapMessageFlags)0);
+    QCOMPARE(ImapMessage::keywordFlag("\\Seen"), (ImapMessageFlags)0);
+    QCOMPARE(ImapMessage::keywordFlag("\"quoted\""), (ImapMessageFlags)0);
+    QVERIFY(ImapMessage::isValidKeyword("$MDNSent"));
+    QVERIFY(!ImapMessage::isValidKeyword("caf\xc3\xa9"));
+}
+
+void FlagsTest::testMailboxFlagsNotInterned (void) {
+    ImapParser parser("(\\Seen \\Flagged $NeverSetAnywhere)");
+    QCOMPARE(parser.readFlags(false), (ImapMessageFlags)(ImapMessageSeen | ImapMessageFlagged));
+    QCOMPARE(parser.droppedKeywords(), 1);
+    QCOMPARE(ImapMessage::findKeyword("$NeverSetAnywhere"), (ImapMessageFlags)0);
+}
+
+/* Keywords are stored by name, system flags as bits. */
+void FlagsTest::testCacheFlagRecord (void) {
+    ImapMessageFlags label = ImapMessage::keywordFlag("$Label1");
+    ImapMessageFlags flags = ImapMessageSeen | ImapMessageAnswered | label;
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(FLAGS_TEST_SERVER, "INBOX", 1));
+    QVERIFY(cache.setFlags(7, flags));
+    QVERIFY(cache.setFlags(8, ImapMessageDraft));
+    cache.close();
+
+    QVERIFY(cache.open(FLAGS_TEST_SERVER, "INBOX", 1));
+    QCOMPARE(cache.flags(7), flags);
+    QCOMPARE(cache.flags(8), (ImapMessageFlags)ImapMessageDraft);
+
+    QVERIFY(cache.compact());
+    QCOMPARE(cache.flags(7), flags);
+}
+
+/* Records written before keywords: the 4 bytes of flags only. */
+void FlagsTest::testCacheOldFlagRecord (void) {
+    QDir directory(cachePath());
+    QVERIFY(directory.mkpath("."));
+
+    QByteArray key = QString("%1\n%2").arg(FLAGS_TEST_SERVER).arg("INBOX").toUtf8();
+    QString baseName = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+
+    QByteArray data;
+    _flagsAppend(&data, 0x31434d49);                        // "IMC1"
+    _flagsAppend(&data, 1);                                 // Version
+    _flagsAppend(&data, 1);                                 // UIDVALIDITY
+    _flagsAppend(&data, 0);
+    _flagsAppend(&data, 0x52434d49);                        // "IMCR"
+    data.append((char)2);                                   // Flags record
+    data.append((char)0);
+    data.append((char)0).append((char)0);                   // No section
+    _flagsAppend(&data, 42);                                // UID
+    _flagsAppend(&data, sizeof(quint32));
+    _flagsAppend(&data, ImapMessageSeen | ImapMessageFlagged);
+
+    // No index entry: recovered from the data file on open.
+    QFile file(directory.filePath(baseName + ".data"));
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(data), (qint64)data.size());
+    file.close();
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(FLAGS_TEST_SERVER, "INBOX", 1));
+    QCOMPARE(cache.flags(42), (ImapMessageFlags)(ImapMessageSeen | ImapMessageFlagged));
+}
+
+/* The FETCH FLAGS replies to STORE update the cache. */
+void FlagsTest::testStoreUpdatesCache (void) {
+    ImapMessageFlags label = ImapMessage::keywordFlag("$Label2");
+    ImapTestServer server(FLAGS_TEST_MESSAGES);
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(FLAGS_TEST_SERVER, "INBOX", 1));
+
+    Imap imap;
+    imap.setCache(&cache);
+    QVERIFY(open(&imap, &server));
+
+    // Message 3 is \Seen, message 4 has no flags.
+    QVERIFY(imap.storeFlags(ImapSequenceSet(3, 4), ImapMessageFlagged | label));
+    QCOMPARE(cache.flags(3), ImapMessageSeen | ImapMessageFlagged | label);
+    QCOMPARE(cache.flags(4), ImapMessageFlagged | label);
+
+    QVERIFY(imap.storeFlags(ImapSequenceSet(3), 0, ImapMessageSeen | label));
+    QCOMPARE(cache.flags(3), (ImapMessageFlags)ImapMessageFlagged);
+    close(&imap, &server);
+}
+
+void FlagsTest::testStoreNothing (void) {
+    ImapTestServer server(FLAGS_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+    QVERIFY(!imap.storeFlags(ImapSequenceSet(1), 0, 0));
+    QVERIFY(!imap.errorString().isEmpty());
+    close(&imap, &server);
+}
+
+void FlagsTest::testFullTable (void) {
+    ImapMessageFlags used = 0;
+    int interned = 0;
+    for (int i = 0; i < 64; ++i) {
+        ImapMessageFlags flag = ImapMessage::keywordFlag("$Fill" + QByteArray::number(i));
+        if (flag == 0)
+            break;
+        QVERIFY(!(used & flag));
+        used |= flag;
+        interned++;
+    }
+    QVERIFY(interned < 64);
+
+    // Full: known keywords still work, new ones are errors.
+    QVERIFY(ImapMessage::keywordFlag("$Forwarded") != 0);
+    QCOMPARE(ImapMessage::keywordFlag("$OneTooMany"), (ImapMessageFlags)0);
+
+    ImapParser parser("(\\Seen $Forwarded $OneTooMany)");
+    QCOMPARE(parser.readFlags(), ImapMessageSeen | ImapMessage::findKeyword("$Forwarded"));
+    QCOMPARE(parser.droppedKeywords(), 1);
+}
+
+/* A keyword without a bit isn't cached, the STORE still succeeds. */
+void FlagsTest::testStoreFullTable (void) {
+    ImapTestServer server(FLAGS_TEST_MESSAGES);
+    server.setFlags(5, "\\Seen $ServerOnly");
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(FLAGS_TEST_SERVER, "INBOX", 1));
+    QVERIFY(cache.setFlags(5, ImapMessageSeen));
+
+    Imap imap;
+    imap.setCache(&cache);
+    QVERIFY(open(&imap, &server));
+    QVERIFY(imap.storeFlags(ImapSequenceSet(5), ImapMessageFlagged));
+    QCOMPARE(cache.flags(5), (ImapMessageFlags)ImapMessageSeen);
+    close(&imap, &server);
+}
+
+/* Without a cache the dropped keyword doesn't matter. */
+void FlagsTest::testStoreFullTableNoCache (void) {
+    ImapTestServer server(FLAGS_TEST_MESSAGES);
+    server.setFlags(5, "$ServerOnly");
+
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+    QVERIFY(imap.storeFlags(ImapSequenceSet(5), ImapMessageSeen));
+    close(&imap, &server);
+}
+
+QString FlagsTest::cachePath (void) const {
+    return(QDir::temp().filePath("ImapFlagsTest"));
+}
+
+bool FlagsTest::open (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost(FLAGS_TEST_SERVER, server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select("INBOX");
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+void FlagsTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+}
+
+QTEST_MAIN(FlagsTest)
+
+#endif /* TEST_IMAP_FLAGS */
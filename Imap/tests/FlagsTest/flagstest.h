@@ -0,0 +1,40 @@
+#ifdef TEST_IMAP_FLAGS
+#ifndef _FLAGS_TEST_H_
+#define _FLAGS_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class Imap;
+
+class FlagsTest : public QObject {
+    Q_OBJECT
+
+    public:
+        FlagsTest (QObject *parent = 0);
+        ~FlagsTest();
+
+    private slots:
+        void cleanup (void);
+
+        void testKeywordFlag (void);
+        void testInvalidKeyword (void);
+        void testMailboxFlagsNotInterned (void);
+        void testCacheFlagRecord (void);
+        void testCacheOldFlagRecord (void);
+        void testStoreUpdatesCache (void);
+        void testStoreNothing (void);
+
+        // Fill the process wide keyword table, keep last.
+        void testFullTable (void);
+        void testStoreFullTable (void);
+        void testStoreFullTableNoCache (void);
+
+    private:
+        QString cachePath (void) const;
+        bool open (Imap *imap, ImapTestServer *server);
+        void close (Imap *imap, ImapTestServer *server);
+};
+
+#endif /* !_FLAGS_TEST_H_ */
+#endif /* TEST_IMAP_FLAGS */
@@ -0,0 +1,20 @@
+######################################################################
+# Imap Folder Tree Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += . ../../src/
+INCLUDEPATH += . ../../src/
+
+DEFINES += TEST_IMAP_FOLDER
+
+QT += testlib
+
+# Input
+HEADERS += foldertest.h \
+           ../../src/imapfolder.h \
+           ../../src/imapparser.h
+SOURCES += foldertest.cpp \
+           ../../src/imapfolder.cpp \
+           ../../src/imapparser.cpp
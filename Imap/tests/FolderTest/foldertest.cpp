@@ -0,0 +1,92 @@
+#ifdef TEST_IMAP_FOLDER
+
+#include <QtTest>
+
+#include "imapfolder.h"
+
+#include "foldertest.h"
+
+FolderTest::FolderTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+FolderTest::~FolderTest() {
+}
+
+void FolderTest::testList (void) {
+    ImapFolder root;
+    QVERIFY(root.appendListResponse("* LIST (\\HasChildren) \"/\" INBOX\r\n"));
+    QVERIFY(root.appendListResponse("* LIST (\\HasNoChildren) \"/\" \"inbox/Sent Items\"\r\n"));
+    QVERIFY(root.appendListResponse("* LIST (\\Noselect \\HasChildren) \"/\" \"Archive\"\r\n"));
+    QVERIFY(root.appendListResponse("* LIST () \"/\" {4}\r\n2024\r\n"));
+
+    QCOMPARE(root.childCount(), 3);
+    QCOMPARE(root.descendants().size(), 4);
+
+    ImapFolder *inbox = root.childAt(0);
+    QCOMPARE(inbox->path(), QString("INBOX"));
+    QCOMPARE(inbox->delimiter(), QChar('/'));
+    QVERIFY(inbox->hasAttribute("\\haschildren"));
+    QVERIFY(inbox->isSelectable());
+
+    ImapFolder *sent = root.find("INBOX/Sent Items");
+    QVERIFY(sent != NULL);
+    QCOMPARE(sent->parent(), inbox);
+    QCOMPARE(sent->name(), QString("Sent Items"));
+
+    ImapFolder *archive = root.find("Archive");
+    QVERIFY(archive != NULL);
+    QVERIFY(archive->exists());
+    QVERIFY(!archive->isSelectable());
+    QVERIFY(root.find("2024") != NULL);
+}
+
+void FolderTest::testImpliedParents (void) {
+    ImapFolder root;
+    QVERIFY(root.appendListResponse("* LIST () \".\" \"a.b.c\"\r\n"));
+
+    ImapFolder *b = root.find("a.b");
+    QVERIFY(b != NULL);
+    QVERIFY(!b->exists());
+    QVERIFY(!b->isSelectable());
+    QCOMPARE(b->parent(), root.find("a"));
+    QCOMPARE(b->childAt(0)->name(), QString("c"));
+
+    // Listed later: the same node.
+    QVERIFY(root.appendListResponse("* LIST () \".\" \"a.b\"\r\n"));
+    QCOMPARE(root.find("a.b"), b);
+    QVERIFY(b->isSelectable());
+    QCOMPARE(root.descendants().size(), 3);
+}
+
+void FolderTest::testStatus (void) {
+    ImapFolder root;
+    QVERIFY(root.appendListResponse("* LIST () \"/\" \"INBOX\"\r\n"));
+    QVERIFY(root.appendStatusResponse("* STATUS \"Inbox\" (MESSAGES 231 UIDNEXT 44292 UNSEEN 3)\r\n"));
+
+    ImapFolder *inbox = root.find("INBOX");
+    QVERIFY(inbox->hasStatus(ImapFolder::Messages));
+    QVERIFY(!inbox->hasStatus(ImapFolder::UidValidity));
+    QCOMPARE(inbox->messages(), 231);
+    QCOMPARE(inbox->unseen(), 3);
+    QCOMPARE(inbox->uidNext(), uint(44292));
+
+    QCOMPARE(ImapFolder::statusItemsString(ImapFolder::Messages | ImapFolder::UidNext),
+             QString("MESSAGES UIDNEXT"));
+}
+
+void FolderTest::testMalformed (void) {
+    ImapFolder root;
+    QVERIFY(!root.appendListResponse("* LIST \"/\" \"INBOX\"\r\n"));
+    QVERIFY(!root.appendListResponse("* LIST () \"/\"\r\n"));
+    QVERIFY(!root.appendStatusResponse("* STATUS \"Unknown\" (MESSAGES 1)\r\n"));
+
+    QVERIFY(root.appendListResponse("* LIST () \"/\" \"INBOX\"\r\n"));
+    QVERIFY(!root.appendStatusResponse("* STATUS \"INBOX\" (MESSAGES)\r\n"));
+    QCOMPARE(root.childCount(), 1);
+}
+
+QTEST_MAIN(FolderTest)
+
+#endif /* TEST_IMAP_FOLDER */
@@ -0,0 +1,22 @@
+#ifdef TEST_IMAP_FOLDER
+#ifndef _FOLDER_TEST_H_
+#define _FOLDER_TEST_H_
+
+#include <QObject>
+
+class FolderTest : public QObject {
+    Q_OBJECT
+
+    public:
+        FolderTest (QObject *parent = 0);
+        ~FolderTest();
+
+    private slots:
+        void testList (void);
+        void testImpliedParents (void);
+        void testStatus (void);
+        void testMalformed (void);
+};
+
+#endif /* !_FOLDER_TEST_H_ */
+#endif /* TEST_IMAP_FOLDER */
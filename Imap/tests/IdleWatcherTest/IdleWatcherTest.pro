@@ -0,0 +1,16 @@
+######################################################################
+# Imap Idle Watcher Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_IDLE_WATCHER
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += idlewatchertest.h
+SOURCES += idlewatchertest.cpp
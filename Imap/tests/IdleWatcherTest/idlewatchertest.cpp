@@ -0,0 +1,208 @@
+#ifdef TEST_IMAP_IDLE_WATCHER
+
+#include <QtTest>
+
+#include "imapidlewatcher.h"
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imap.h"
+
+#include "idlewatchertest.h"
+
+#define IDLE_TEST_MESSAGES      (10)
+#define IDLE_TEST_SERVER        ("127.0.0.1")
+#define IDLE_TEST_MAILBOX       ("INBOX")
+#define IDLE_TEST_TIMEOUT       (5000)
+
+IdleWatcherTest::IdleWatcherTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+IdleWatcherTest::~IdleWatcherTest() {
+}
+
+void IdleWatcherTest::testPushed (void) {
+    ImapTestServer server(IDLE_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapIdleWatcher watcher(&imap);
+    QSignalSpy exists(&watcher, SIGNAL(exists(int)));
+    QSignalSpy expunged(&watcher, SIGNAL(expunged(int)));
+    QSignalSpy flagsChanged(&watcher, SIGNAL(flagsChanged(int, uint, ImapMessageFlags)));
+    QSignalSpy error(&watcher, SIGNAL(error(QString)));
+
+    QVERIFY(watcher.start());
+    QVERIFY(watcher.isIdle());
+
+    server.push("* 11 EXISTS\r\n"
+                "* 2 FETCH (UID 2 FLAGS (\\Flagged))\r\n"
+                "* 3 EXPUNGE\r\n");
+    QVERIFY(waitFor(&expunged, 1));
+    QCOMPARE(exists.count(), 1);
+    QCOMPARE(exists.first().at(0).toInt(), 11);
+    QCOMPARE(flagsChanged.count(), 1);
+    QCOMPARE(flagsChanged.first().at(0).toInt(), 2);
+    QCOMPARE(flagsChanged.first().at(1).toUInt(), (uint)2);
+    QCOMPARE(flagsChanged.first().at(2).toUInt(), (uint)ImapMessageFlagged);
+    QCOMPARE(expunged.first().at(0).toInt(), 3);
+
+    watcher.stop();
+    QVERIFY(!watcher.isActive());
+    QCOMPARE(error.count(), 0);
+
+    // The connection is usable again.
+    ImapMailbox *mailbox = imap.select(IDLE_TEST_MAILBOX);
+    QVERIFY(mailbox != NULL);
+    delete mailbox;
+    close(&imap, &server);
+}
+
+/* A response coming in pieces is read as it comes, the event
+ * loop doesn't wait for the rest (or for the timeout). */
+void IdleWatcherTest::testSplitResponse (void) {
+    ImapTestServer server(IDLE_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+    imap.setTimeout(IDLE_TEST_TIMEOUT);
+
+    ImapIdleWatcher watcher(&imap);
+    QSignalSpy exists(&watcher, SIGNAL(exists(int)));
+    QSignalSpy flagsChanged(&watcher, SIGNAL(flagsChanged(int, uint, ImapMessageFlags)));
+    QSignalSpy error(&watcher, SIGNAL(error(QString)));
+    QVERIFY(watcher.start());
+
+    QTime timer;
+    timer.start();
+    server.push("* 12 EXI");
+    QTest::qWait(300);
+    server.push("STS\r\n* 4 FETCH (UID 4 BODY[1] {5}\r\nab");
+    QTest::qWait(300);
+    QVERIFY(timer.elapsed() < IDLE_TEST_TIMEOUT / 2);
+    QCOMPARE(exists.count(), 1);
+    QCOMPARE(exists.first().at(0).toInt(), 12);
+    QCOMPARE(flagsChanged.count(), 0);
+
+    server.push("cde FLAGS (\\Seen))\r\n");
+    QVERIFY(waitFor(&flagsChanged, 1));
+    QCOMPARE(flagsChanged.first().at(1).toUInt(), (uint)4);
+    QCOMPARE(flagsChanged.first().at(2).toUInt(), (uint)ImapMessageSeen);
+
+    watcher.stop();
+    QCOMPARE(error.count(), 0);
+    close(&imap, &server);
+}
+
+/* IDLE is ended with DONE and issued again at each idleInterval. */
+void IdleWatcherTest::testRestart (void) {
+    ImapTestServer server(IDLE_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapIdleWatcher watcher(&imap);
+    watcher.setIdleInterval(200);
+    QSignalSpy exists(&watcher, SIGNAL(exists(int)));
+    QSignalSpy error(&watcher, SIGNAL(error(QString)));
+    QVERIFY(watcher.start());
+
+    QTest::qWait(700);
+    QVERIFY(watcher.isIdle());
+    server.push("* 11 EXISTS\r\n");
+    QVERIFY(waitFor(&exists, 1));
+
+    watcher.stop();
+    QCOMPARE(error.count(), 0);
+    close(&imap, &server);
+
+    int idles = 0;
+    foreach (const QByteArray& line, server.commandLog())
+        idles += (line == "IDLE") ? 1 : 0;
+    QVERIFY(idles >= 2);
+}
+
+/* Without IDLE the watcher polls with NOOP. */
+void IdleWatcherTest::testPolling (void) {
+    ImapTestServer server(IDLE_TEST_MESSAGES);
+    QStringList capabilities = server.capabilities();
+    capabilities.removeAll("IDLE");
+    server.setCapabilities(capabilities);
+
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapIdleWatcher watcher(&imap);
+    watcher.setPollInterval(100);
+    QVERIFY(watcher.start());
+    QVERIFY(!watcher.isIdle());
+    QTest::qWait(350);
+    watcher.stop();
+    close(&imap, &server);
+
+    int noops = 0;
+    foreach (const QByteArray& line, server.commandLog())
+        noops += (line == "NOOP") ? 1 : 0;
+    QVERIFY(noops >= 2);
+}
+
+/* The signal argument types are registered for queued connections. */
+void IdleWatcherTest::testQueuedSignals (void) {
+    ImapTestServer server(IDLE_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapIdleWatcher watcher(&imap);
+    QVERIFY(QMetaType::type("ImapSequenceSet") != 0);
+    QVERIFY(QMetaType::type("ImapMessageFlags") != 0);
+
+    // Relayed by a second (inactive) watcher, across the event loop.
+    ImapIdleWatcher relay(&imap);
+    connect(&watcher, SIGNAL(vanished(ImapSequenceSet)),
+            &relay, SIGNAL(vanished(ImapSequenceSet)), Qt::QueuedConnection);
+    connect(&watcher, SIGNAL(flagsChanged(int, uint, ImapMessageFlags)),
+            &relay, SIGNAL(flagsChanged(int, uint, ImapMessageFlags)), Qt::QueuedConnection);
+    QSignalSpy vanished(&relay, SIGNAL(vanished(ImapSequenceSet)));
+    QSignalSpy flagsChanged(&relay, SIGNAL(flagsChanged(int, uint, ImapMessageFlags)));
+
+    QVERIFY(watcher.start());
+    server.push("* VANISHED 3:4\r\n* 5 FETCH (UID 5 FLAGS (\\Seen \\Flagged))\r\n");
+    QVERIFY(waitFor(&flagsChanged, 1));
+    QVERIFY(waitFor(&vanished, 1));
+
+    ImapSequenceSet uids = qvariant_cast<ImapSequenceSet>(vanished.first().at(0));
+    QCOMPARE(uids.toString(), QString("3:4"));
+    QCOMPARE(flagsChanged.first().at(2).toUInt(), (uint)(ImapMessageSeen | ImapMessageFlagged));
+
+    watcher.stop();
+    close(&imap, &server);
+}
+
+/* Run the event loop until spy has count signals. */
+bool IdleWatcherTest::waitFor (QSignalSpy *spy, int count) {
+    QTime timer;
+    timer.start();
+    while (spy->count() < count && timer.elapsed() < IDLE_TEST_TIMEOUT)
+        QTest::qWait(20);
+    return(spy->count() >= count);
+}
+
+bool IdleWatcherTest::open (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost(IDLE_TEST_SERVER, server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select(IDLE_TEST_MAILBOX);
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+void IdleWatcherTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+}
+
+QTEST_MAIN(IdleWatcherTest)
+
+#endif /* TEST_IMAP_IDLE_WATCHER */
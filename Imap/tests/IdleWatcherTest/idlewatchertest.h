@@ -0,0 +1,32 @@
+#ifdef TEST_IMAP_IDLE_WATCHER
+#ifndef _IDLE_WATCHER_TEST_H_
+#define _IDLE_WATCHER_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class QSignalSpy;
+class Imap;
+
+class IdleWatcherTest : public QObject {
+    Q_OBJECT
+
+    public:
+        IdleWatcherTest (QObject *parent = 0);
+        ~IdleWatcherTest();
+
+    private slots:
+        void testPushed (void);
+        void testSplitResponse (void);
+        void testRestart (void);
+        void testPolling (void);
+        void testQueuedSignals (void);
+
+    private:
+        bool waitFor (QSignalSpy *spy, int count);
+        bool open (Imap *imap, ImapTestServer *server);
+        void close (Imap *imap, ImapTestServer *server);
+};
+
+#endif /* !_IDLE_WATCHER_TEST_H_ */
+#endif /* TEST_IMAP_IDLE_WATCHER */
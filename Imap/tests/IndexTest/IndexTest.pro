@@ -0,0 +1,16 @@
+######################################################################
+# Imap Text Index Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_TEXT_INDEX
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += indextest.h
+SOURCES += indextest.cpp
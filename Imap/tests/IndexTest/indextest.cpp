@@ -0,0 +1,366 @@
+#ifdef TEST_IMAP_TEXT_INDEX
+
+#include <QtTest>
+#include <QFile>
+#include <QDir>
+
+#include "imaptestserver.h"
+#include "imaptextindex.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapcache.h"
+#include "imap.h"
+
+#include "indextest.h"
+
+#define INDEX_TEST_MESSAGES     (10)
+#define INDEX_TEST_INDEXED      (5)
+#define INDEX_TEST_SERVER       ("127.0.0.1")
+#define INDEX_TEST_MAILBOX      ("INBOX")
+
+static ImapSequenceSet _indexRange (uint first, uint last) {
+    ImapSequenceSet set;
+    set.add(first, last);
+    return(set);
+}
+
+IndexTest::IndexTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+IndexTest::~IndexTest() {
+}
+
+void IndexTest::cleanup (void) {
+    QDir directory(indexPath());
+    foreach (const QString& name, directory.entryList(QDir::Files))
+        directory.remove(name);
+}
+
+void IndexTest::testTokenize (void) {
+    QStringList words = ImapTextIndex::tokenize("Re: Weekly status-report, a #42!");
+    QCOMPARE(words, QStringList() << "re" << "weekly" << "status" << "report" << "42");
+}
+
+/* Words match as part of longer ones, buffered or written. */
+void IndexTest::testSubstring (void) {
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+
+    index.addText(1, "Support ticket opened");
+    index.addText(2, "Port scan report");
+    QCOMPARE(index.search("port").toString(), QString("1:2"));
+    QCOMPARE(index.search("ticket port").toString(), QString("1"));
+
+    QVERIFY(index.flush());
+    QCOMPARE(index.search("port").toString(), QString("1:2"));
+    QCOMPARE(index.search("PORT SCAN").toString(), QString("2"));
+    QVERIFY(index.search("missing").isEmpty());
+}
+
+void IndexTest::testBodyOnly (void) {
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+
+    index.addText(1, "Invoice for July", ImapTextIndex::Header);
+    index.addText(1, "Please find the payment details", ImapTextIndex::Body);
+    QVERIFY(index.flush());
+
+    QCOMPARE(index.search("invoice").toString(), QString("1"));
+    QVERIFY(index.search("invoice", true).isEmpty());
+    QCOMPARE(index.search("payment", true).toString(), QString("1"));
+}
+
+/* Buffered and written messages alike. */
+void IndexTest::testRemove (void) {
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+
+    index.addText(1, "written alpha");
+    QVERIFY(index.flush());
+    index.addText(2, "buffered alpha");
+
+    index.remove(_indexRange(1, 2));
+    QVERIFY(index.search("alpha").isEmpty());
+    QVERIFY(index.indexed().isEmpty());
+
+    // The removed buffered postings are not written.
+    QVERIFY(index.flush());
+    index.close();
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    QVERIFY(index.search("alpha").isEmpty());
+}
+
+/*
+ * Once merged away, a removed UID no longer masks anything:
+ * indexing it again (as after a reset) finds it.
+ */
+void IndexTest::testMergePurgesRemoved (void) {
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    index.setMergeThreshold(2);
+
+    index.addText(1, "alpha");
+    QVERIFY(index.flush());
+    index.addText(2, "beta");
+    QVERIFY(index.flush());
+    index.waitForMerge();
+
+    index.remove(_indexRange(1, 1));
+    index.addText(3, "gamma");
+    QVERIFY(index.flush());
+    index.addText(4, "delta");
+    QVERIFY(index.flush());
+    index.waitForMerge();
+
+    QVERIFY(index.search("alpha").isEmpty());
+    QCOMPARE(index.search("beta").toString(), QString("2"));
+    QCOMPARE(index.indexed().toString(), QString("2:4"));
+
+    index.addText(1, "alpha");
+    QCOMPARE(index.search("alpha").toString(), QString("1"));
+    QVERIFY(index.flush());
+    QCOMPARE(index.search("alpha").toString(), QString("1"));
+}
+
+void IndexTest::testCorruptSegment (void) {
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    index.addText(1, "truncated segment terms");
+    index.close();
+
+    QDir directory(indexPath());
+    QStringList segments = directory.entryList(QStringList("*.seg"), QDir::Files);
+    QCOMPARE(segments.size(), 1);
+
+    QFile file(directory.filePath(segments.first()));
+    QVERIFY(file.resize(file.size() - 2));
+
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    QVERIFY(index.indexed().isEmpty());
+    QVERIFY(index.search("segment").isEmpty());
+}
+
+/* Cached parts are read in the charset of their BODYSTRUCTURE. */
+void IndexTest::testCharset (void) {
+    ImapCache cache(indexPath());
+    QVERIFY(cache.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+
+    ImapMessage message;
+    message.setUid("1");
+    message.setSubject("Menu");
+    QVERIFY(cache.insertMessage(&message));
+    QVERIFY(cache.insertBodyStructure(1, "(\"TEXT\" \"PLAIN\" (\"CHARSET\" \"ISO-8859-1\")"
+                                         " NIL NIL \"8BIT\" 12 1 NIL NIL NIL)"));
+    QVERIFY(cache.insertBodyPart(1, "1", "caf\xe9 cr\xe8me"));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    QCOMPARE(index.update(&cache), 1);
+
+    QCOMPARE(index.search(QString::fromUtf8("caf\xc3\xa9")).toString(), QString("1"));
+    QCOMPARE(index.search(QString::fromUtf8("cr\xc3\xa8me")).toString(), QString("1"));
+}
+
+/* Same result with and without the index, whatever it covers. */
+void IndexTest::testUidSearchText (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSequenceSet all = imap.uidSearchText("uick");
+    QCOMPARE(all.toString(), QString("1:10"));
+    ImapSequenceSet report = imap.uidSearchText("report #3");
+    QCOMPARE(report.toString(), QString("3"));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    indexMessages(&index, INDEX_TEST_INDEXED);
+    imap.setTextIndex(&index);
+
+    QCOMPARE(imap.uidSearchText("uick"), all);
+    QCOMPARE(imap.uidSearchText("report #3"), report);
+    QVERIFY(imap.uidSearchText("missing").isEmpty());
+
+    imap.setTextIndex(NULL);
+    close(&imap, &server);
+
+    // No indexed message holds "missing", the server skips them all.
+    bool narrowed = false;
+    foreach (const QByteArray& line, server.commandLog())
+        narrowed |= line.startsWith("UID SEARCH UID 6:4294967295 TEXT");
+    QVERIFY(narrowed);
+}
+
+void IndexTest::testSearchText (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    indexMessages(&index, INDEX_TEST_INDEXED);
+    imap.setTextIndex(&index);
+
+    QList<int> expected;
+    for (int i = 1; i <= INDEX_TEST_MESSAGES; ++i)
+        expected.append(i);
+    QCOMPARE(imap.searchText("\"lazy dog\""), expected);
+    QCOMPARE(imap.searchText("weekly"), expected);
+    QVERIFY(imap.searchText("\"missing\"").isEmpty());
+
+    imap.setTextIndex(NULL);
+    close(&imap, &server);
+}
+
+/* BODY doesn't look at the envelope, on either side. */
+void IndexTest::testSearchBody (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    indexMessages(&index, INDEX_TEST_INDEXED);
+    imap.setTextIndex(&index);
+
+    QVERIFY(imap.searchBody("\"weekly\"").isEmpty());
+    QCOMPARE(imap.searchBody("\"fox\"").size(), INDEX_TEST_MESSAGES);
+
+    imap.setTextIndex(NULL);
+    close(&imap, &server);
+}
+
+/* One word: the indexed messages aren't searched by the server. */
+void IndexTest::testAnsweredByIndex (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    indexMessages(&index, INDEX_TEST_INDEXED);
+    imap.setTextIndex(&index);
+
+    QCOMPARE(imap.uidSearchText("uick").toString(), QString("1:10"));
+    QCOMPARE(imap.searchText("weekly").size(), INDEX_TEST_MESSAGES);
+
+    imap.setTextIndex(NULL);
+    close(&imap, &server);
+
+    // The message numbers of the index matches come in the same batch.
+    QCOMPARE(searches(&server), QList<QByteArray>()
+             << "UID SEARCH UID 6:4294967295 TEXT \"uick\""
+             << "SEARCH UID 6:4294967295 TEXT \"weekly\""
+             << "SEARCH UID 1:5");
+}
+
+/* Several words, or verifyTextIndex: the server checks the candidates. */
+void IndexTest::testVerifyIndex (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    indexMessages(&index, INDEX_TEST_INDEXED);
+    imap.setTextIndex(&index);
+
+    QVERIFY(!imap.verifyTextIndex());
+    QCOMPARE(imap.uidSearchText("report #3").toString(), QString("3"));
+
+    imap.setVerifyTextIndex(true);
+    QCOMPARE(imap.uidSearchText("uick").toString(), QString("1:10"));
+
+    imap.setTextIndex(NULL);
+    close(&imap, &server);
+
+    QCOMPARE(searches(&server), QList<QByteArray>()
+             << "UID SEARCH UID 1:4294967295 TEXT \"report #3\""
+             << "UID SEARCH UID 1:4294967295 TEXT \"uick\"");
+}
+
+void IndexTest::testOffline (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+    close(&imap, &server);
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    indexMessages(&index, INDEX_TEST_INDEXED);
+    imap.setTextIndex(&index);
+
+    QCOMPARE(imap.uidSearchText("uick").toString(), QString("1:5"));
+    QVERIFY(imap.uidSearchText("missing").isEmpty());
+    imap.setTextIndex(NULL);
+}
+
+/* Every other UID indexed: the rest is split below the line limit. */
+void IndexTest::testFragmentedIndex (void) {
+    ImapTestServer server(INDEX_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapTextIndex index(indexPath());
+    QVERIFY(index.open(INDEX_TEST_SERVER, INDEX_TEST_MAILBOX, 1));
+    for (uint uid = 1; uid < 6000; uid += 2)
+        index.addText(uid, "marker", ImapTextIndex::Body);
+    index.flush();
+    imap.setTextIndex(&index);
+
+    QCOMPARE(imap.uidSearchText("uick").toString(), QString("2,4,6,8,10"));
+
+    imap.setTextIndex(NULL);
+    close(&imap, &server);
+
+    QList<QByteArray> lines = searches(&server);
+    QVERIFY(lines.size() > 1);
+    foreach (const QByteArray& line, lines)
+        QVERIFY(line.size() < 8000);
+}
+
+QString IndexTest::indexPath (void) const {
+    return(QDir::temp().filePath("ImapIndexTest"));
+}
+
+/* Index the first messages of the test server, as fetched. */
+void IndexTest::indexMessages (ImapTextIndex *index, int count) {
+    for (int i = 1; i <= count; ++i) {
+        index->addText(i, ImapTestServer::subject(i), ImapTextIndex::Header);
+        index->addText(i, ImapTestServer::body(i, 256), ImapTextIndex::Body);
+    }
+    index->flush();
+}
+
+bool IndexTest::open (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost(INDEX_TEST_SERVER, server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select(INDEX_TEST_MAILBOX);
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+void IndexTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+}
+
+/* The SEARCH commands of the last session. */
+QList<QByteArray> IndexTest::searches (ImapTestServer *server) const {
+    QList<QByteArray> lines;
+    foreach (const QByteArray& line, server->commandLog()) {
+        if (line.contains("SEARCH"))
+            lines.append(line);
+    }
+    return(lines);
+}
+
+QTEST_MAIN(IndexTest)
+
+#endif /* TEST_IMAP_TEXT_INDEX */
@@ -0,0 +1,45 @@
+#ifdef TEST_IMAP_TEXT_INDEX
+#ifndef _INDEX_TEST_H_
+#define _INDEX_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class ImapTextIndex;
+class Imap;
+
+class IndexTest : public QObject {
+    Q_OBJECT
+
+    public:
+        IndexTest (QObject *parent = 0);
+        ~IndexTest();
+
+    private slots:
+        void cleanup (void);
+
+        void testTokenize (void);
+        void testSubstring (void);
+        void testBodyOnly (void);
+        void testRemove (void);
+        void testMergePurgesRemoved (void);
+        void testCorruptSegment (void);
+        void testCharset (void);
+        void testUidSearchText (void);
+        void testSearchText (void);
+        void testSearchBody (void);
+        void testAnsweredByIndex (void);
+        void testVerifyIndex (void);
+        void testOffline (void);
+        void testFragmentedIndex (void);
+
+    private:
+        QString indexPath (void) const;
+        void indexMessages (ImapTextIndex *index, int count);
+        bool open (Imap *imap, ImapTestServer *server);
+        void close (Imap *imap, ImapTestServer *server);
+        QList<QByteArray> searches (ImapTestServer *server) const;
+};
+
+#endif /* !_INDEX_TEST_H_ */
+#endif /* TEST_IMAP_TEXT_INDEX */
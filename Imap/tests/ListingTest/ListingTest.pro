@@ -0,0 +1,16 @@
+######################################################################
+# Imap Listing Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_LISTING
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += listingtest.h
+SOURCES += listingtest.cpp
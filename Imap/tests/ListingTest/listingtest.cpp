@@ -0,0 +1,102 @@
+#ifdef TEST_IMAP_LISTING
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imaplisting.h"
+#include "imap.h"
+
+#include "listingtest.h"
+
+ListingTest::ListingTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+ListingTest::~ListingTest() {
+}
+
+void ListingTest::testAppend (void) {
+    ImapListing listing(ImapListing::Uid | ImapListing::Flags | ImapListing::Size);
+    QVERIFY(listing.appendFetchResponse("* 1 FETCH (UID 10 FLAGS (\\Seen) RFC822.SIZE 300)"));
+    QVERIFY(listing.appendFetchResponse("* 2 FETCH (UID 12 FLAGS () RFC822.SIZE 200)"));
+    QVERIFY(!listing.appendFetchResponse("* OK still here"));
+
+    QCOMPARE(listing.count(), 2);
+    QCOMPARE(listing.uid(1), 12U);
+    QCOMPARE(listing.flags(0), ImapMessageFlags(ImapMessageSeen));
+    QCOMPARE(listing.size(1), 200);
+    QCOMPARE(listing.indexOfUid(12), 1);
+}
+
+void ListingTest::testMergeFlags (void) {
+    ImapListing listing(ImapListing::Uid | ImapListing::Flags | ImapListing::Size);
+    QVERIFY(listing.appendFetchResponse("* 1 FETCH (UID 10 FLAGS (\\Seen) RFC822.SIZE 300)"));
+    QVERIFY(listing.appendFetchResponse("* 2 FETCH (UID 12 FLAGS () RFC822.SIZE 200)"));
+
+    // Unsolicited update: no UID, only the flags change.
+    QVERIFY(listing.appendFetchResponse("* 2 FETCH (FLAGS (\\Seen \\Flagged))"));
+    QCOMPARE(listing.count(), 2);
+    QCOMPARE(listing.uid(1), 12U);
+    QCOMPARE(listing.size(1), 200);
+    QCOMPARE(listing.flags(1), ImapMessageFlags(ImapMessageSeen | ImapMessageFlagged));
+    QCOMPARE(listing.flags(0), ImapMessageFlags(ImapMessageSeen));
+
+    // With the UID, as after a STORE.
+    QVERIFY(listing.appendFetchResponse("* 1 FETCH (FLAGS () UID 10)"));
+    QCOMPARE(listing.count(), 2);
+    QCOMPARE(listing.flags(0), ImapMessageFlags(0));
+    QCOMPARE(listing.indexOfId(1), 0);
+}
+
+void ListingTest::testMergeEnvelope (void) {
+    ImapListing listing(ImapListing::Uid | ImapListing::Subject | ImapListing::MessageId);
+    QVERIFY(listing.appendFetchResponse("* 1 FETCH (UID 4 ENVELOPE (NIL \"First\" NIL NIL NIL"
+                                        " NIL NIL NIL NIL \"<one@example.com>\"))"));
+    QVERIFY(listing.appendFetchResponse("* 2 FETCH (UID 5 ENVELOPE (NIL \"Second\" NIL NIL NIL"
+                                        " NIL NIL NIL NIL \"<two@example.com>\"))"));
+
+    QVERIFY(listing.appendFetchResponse("* 1 FETCH (ENVELOPE (NIL \"Changed\" NIL NIL NIL"
+                                        " NIL NIL NIL NIL \"<three@example.com>\"))"));
+    QCOMPARE(listing.count(), 2);
+    QCOMPARE(listing.subject(0), QString("Changed"));
+    QCOMPARE(listing.messageId(0), QString("three@example.com"));
+    QCOMPARE(listing.subject(1), QString("Second"));
+    QCOMPARE(listing.messageId(1), QString("two@example.com"));
+}
+
+void ListingTest::testMergeOtherUid (void) {
+    ImapListing listing(ImapListing::Uid | ImapListing::Flags);
+    QVERIFY(listing.appendFetchResponse("* 1 FETCH (UID 10 FLAGS (\\Seen))"));
+
+    // Same sequence number, another message: the row is left alone.
+    QVERIFY(!listing.appendFetchResponse("* 1 FETCH (UID 11 FLAGS ())"));
+    QCOMPARE(listing.count(), 1);
+    QCOMPARE(listing.uid(0), 10U);
+    QCOMPARE(listing.flags(0), ImapMessageFlags(ImapMessageSeen));
+}
+
+void ListingTest::testServerListing (void) {
+    ImapTestServer server(10);
+    Imap imap;
+    QVERIFY(imap.connectToHost("127.0.0.1", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    delete imap.select("INBOX");
+
+    ImapListing listing(ImapListing::Uid | ImapListing::Flags);
+    QVERIFY(imap.fetchListing(&listing));
+    QCOMPARE(listing.count(), 10);
+    QCOMPARE(listing.flags(2), ImapMessageFlags(ImapMessageSeen));
+
+    QVERIFY(listing.appendFetchResponse("* 3 FETCH (FLAGS (\\Flagged))"));
+    QCOMPARE(listing.count(), 10);
+    QCOMPARE(listing.uid(2), 3U);
+    QCOMPARE(listing.flags(2), ImapMessageFlags(ImapMessageFlagged));
+
+    imap.logout();
+    imap.disconnectFromHost();
+}
+
+QTEST_MAIN(ListingTest)
+
+#endif /* TEST_IMAP_LISTING */
@@ -0,0 +1,23 @@
+#ifdef TEST_IMAP_LISTING
+#ifndef _LISTING_TEST_H_
+#define _LISTING_TEST_H_
+
+#include <QObject>
+
+class ListingTest : public QObject {
+    Q_OBJECT
+
+    public:
+        ListingTest (QObject *parent = 0);
+        ~ListingTest();
+
+    private slots:
+        void testAppend (void);
+        void testMergeFlags (void);
+        void testMergeEnvelope (void);
+        void testMergeOtherUid (void);
+        void testServerListing (void);
+};
+
+#endif /* !_LISTING_TEST_H_ */
+#endif /* TEST_IMAP_LISTING */
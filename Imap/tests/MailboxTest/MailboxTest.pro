@@ -0,0 +1,16 @@
+######################################################################
+# Imap Mailbox Index Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_MAILBOX
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += mailboxtest.h
+SOURCES += mailboxtest.cpp
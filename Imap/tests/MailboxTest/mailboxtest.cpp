@@ -0,0 +1,117 @@
+#ifdef TEST_IMAP_MAILBOX
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imap.h"
+
+#include "mailboxtest.h"
+
+MailboxTest::MailboxTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+MailboxTest::~MailboxTest() {
+}
+
+void MailboxTest::testIndex (void) {
+    ImapMailbox mailbox;
+    addMessages(&mailbox, 1, 5);
+
+    QCOMPARE(mailbox.count(), 5);
+    QCOMPARE(mailbox.findById(3)->uid(), QString("30"));
+    QCOMPARE(mailbox.findByUid(40)->id(), 4);
+    QVERIFY(mailbox.findById(6) == NULL);
+
+    ImapMessage *message = mailbox.takeAt(0);
+    QVERIFY(mailbox.findById(1) == NULL);
+    QVERIFY(mailbox.findByUid(10) == NULL);
+    delete message;
+}
+
+void MailboxTest::testExpunge (void) {
+    ImapMailbox mailbox;
+    mailbox.setExists(5);
+    addMessages(&mailbox, 1, 5);
+
+    // "* 2 EXPUNGE" then "* 2 EXPUNGE" again: UIDs 20 and 30 are gone.
+    mailbox.expunge(2);
+    QCOMPARE(mailbox.count(), 4);
+    QCOMPARE(mailbox.exists(), 4);
+    QVERIFY(mailbox.findByUid(20) == NULL);
+    QCOMPARE(mailbox.findById(2)->uid(), QString("30"));
+    QCOMPARE(mailbox.findById(4)->uid(), QString("50"));
+    QVERIFY(mailbox.findById(5) == NULL);
+
+    mailbox.expunge(2);
+    QCOMPARE(mailbox.count(), 3);
+    QCOMPARE(mailbox.findById(1)->uid(), QString("10"));
+    QCOMPARE(mailbox.findById(2)->uid(), QString("40"));
+    QCOMPARE(mailbox.findById(3)->uid(), QString("50"));
+    QCOMPARE(mailbox.findByUid(50)->id(), 3);
+    QVERIFY(mailbox.findById(4) == NULL);
+
+    mailbox.expunge(3);
+    QCOMPARE(mailbox.count(), 2);
+    QCOMPARE(mailbox.exists(), 2);
+    QVERIFY(mailbox.findByUid(50) == NULL);
+    QVERIFY(mailbox.findById(3) == NULL);
+}
+
+void MailboxTest::testExpungeNotLoaded (void) {
+    ImapMailbox mailbox;
+    mailbox.setExists(10);
+    addMessages(&mailbox, 6, 8);
+
+    // Below the messages loaded: they all move down.
+    mailbox.expunge(2);
+    QCOMPARE(mailbox.count(), 3);
+    QCOMPARE(mailbox.exists(), 9);
+    QCOMPARE(mailbox.findById(5)->uid(), QString("60"));
+    QCOMPARE(mailbox.findById(7)->uid(), QString("80"));
+    QVERIFY(mailbox.findById(8) == NULL);
+
+    // Above them: nothing moves.
+    mailbox.expunge(9);
+    QCOMPARE(mailbox.count(), 3);
+    QCOMPARE(mailbox.exists(), 8);
+    QCOMPARE(mailbox.findById(7)->uid(), QString("80"));
+}
+
+void MailboxTest::testServerExpunge (void) {
+    ImapTestServer server(10);
+    Imap imap;
+    QVERIFY(imap.connectToHost("127.0.0.1", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    delete imap.select("INBOX");
+
+    ImapMailbox *mailbox = imap.fetch(1, 10);
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 10);
+
+    mailbox->expunge(4);
+    QCOMPARE(mailbox->count(), 9);
+    QVERIFY(mailbox->findByUid(4) == NULL);
+    QCOMPARE(mailbox->findById(4)->uid(), QString("5"));
+    QCOMPARE(mailbox->findById(9)->uid(), QString("10"));
+    QCOMPARE(mailbox->findById(4)->subject(), QString("Weekly status report #5"));
+    delete mailbox;
+
+    imap.logout();
+    imap.disconnectFromHost();
+}
+
+void MailboxTest::addMessages (ImapMailbox *mailbox, int first, int last) {
+    for (int i = first; i <= last; ++i) {
+        ImapMessage *message = new ImapMessage;
+        message->setId(i);
+        message->setUid(QString::number(i * 10));
+        mailbox->addMessage(message);
+    }
+}
+
+QTEST_MAIN(MailboxTest)
+
+#endif /* TEST_IMAP_MAILBOX */
@@ -0,0 +1,27 @@
+#ifdef TEST_IMAP_MAILBOX
+#ifndef _MAILBOX_TEST_H_
+#define _MAILBOX_TEST_H_
+
+#include <QObject>
+
+class ImapMailbox;
+
+class MailboxTest : public QObject {
+    Q_OBJECT
+
+    public:
+        MailboxTest (QObject *parent = 0);
+        ~MailboxTest();
+
+    private slots:
+        void testIndex (void);
+        void testExpunge (void);
+        void testExpungeNotLoaded (void);
+        void testServerExpunge (void);
+
+    private:
+        void addMessages (ImapMailbox *mailbox, int first, int last);
+};
+
+#endif /* !_MAILBOX_TEST_H_ */
+#endif /* TEST_IMAP_MAILBOX */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Paged Mailbox and Mailbox Model Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_PAGED_MAILBOX
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += pagedmailboxtest.h
+SOURCES += pagedmailboxtest.cpp
@@ -0,0 +1,212 @@
+#ifdef TEST_IMAP_PAGED_MAILBOX
+
+#include <QCoreApplication>
+#include <QtTest>
+
+#include "imappagedmailbox.h"
+#include "imapmailboxmodel.h"
+#include "imaptestserver.h"
+#include "imapmessage.h"
+#include "imap.h"
+
+#include "pagedmailboxtest.h"
+
+#define PAGED_TEST_MESSAGES     (95)
+#define PAGED_TEST_PAGE_SIZE    (10)
+
+static QList<QByteArray> _pagedFetches (const QList<QByteArray>& commands) {
+    QList<QByteArray> fetches;
+    foreach (const QByteArray& command, commands) {
+        if (command.startsWith("FETCH") || command.startsWith("UID FETCH"))
+            fetches.append(command);
+    }
+    return(fetches);
+}
+
+PagedMailboxTest::PagedMailboxTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+PagedMailboxTest::~PagedMailboxTest() {
+}
+
+void PagedMailboxTest::testPaging (void) {
+    ImapTestServer server(PAGED_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(login(&imap, &server));
+
+    ImapPagedMailbox mailbox(&imap);
+    mailbox.setPageSize(PAGED_TEST_PAGE_SIZE);
+    mailbox.setPrefetchPages(1);
+    QVERIFY(mailbox.open("INBOX"));
+    QCOMPARE(mailbox.count(), PAGED_TEST_MESSAGES);
+    QCOMPARE(mailbox.loadedPages(), 0);
+
+    // The visible page and the next one, in one FETCH.
+    QVERIFY(mailbox.fetchRows(0, 9));
+    QCOMPARE(mailbox.loadedPages(), 2);
+    QVERIFY(mailbox.isLoaded(19));
+    QVERIFY(!mailbox.isLoaded(20));
+    QCOMPARE(mailbox.message(5)->uid(), QString("6"));
+
+    // Last, partial page.
+    QVERIFY(mailbox.cachedMessage(94) == NULL);
+    ImapMessage *last = mailbox.message(94);
+    QVERIFY(last != NULL);
+    QCOMPARE(last->subject(), QString(ImapTestServer::subject(95)));
+    QVERIFY(mailbox.message(95) == NULL);
+
+    QList<QByteArray> commands = close(&imap, &server);
+    QCOMPARE(_pagedFetches(commands).size(), 2);
+    QVERIFY(commands.contains("FETCH 1:20 ALL"));
+    QVERIFY(commands.contains("FETCH 91:95 ALL"));
+}
+
+void PagedMailboxTest::testUidOrder (void) {
+    ImapTestServer server(PAGED_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(login(&imap, &server));
+
+    QList<uint> uids;
+    uids << 50 << 7 << 30;
+
+    ImapPagedMailbox mailbox(&imap);
+    QVERIFY(mailbox.open("INBOX", uids));
+    QVERIFY(mailbox.isUidOrder());
+    QCOMPARE(mailbox.count(), 3);
+
+    QCOMPARE(mailbox.message(0)->uid(), QString("50"));
+    QCOMPARE(mailbox.message(1)->uid(), QString("7"));
+    QCOMPARE(mailbox.message(2)->uid(), QString("30"));
+
+    close(&imap, &server);
+}
+
+/* Scrolling down a page at a time keeps maxPages() pages. */
+void PagedMailboxTest::testEviction (void) {
+    ImapTestServer server(PAGED_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(login(&imap, &server));
+
+    ImapPagedMailbox mailbox(&imap);
+    mailbox.setPageSize(PAGED_TEST_PAGE_SIZE);
+    mailbox.setPrefetchPages(0);
+    mailbox.setMaxPages(3);
+    QVERIFY(mailbox.open("INBOX"));
+
+    for (int row = 0; row < PAGED_TEST_MESSAGES; row += PAGED_TEST_PAGE_SIZE) {
+        QVERIFY(mailbox.fetchRows(row, row + PAGED_TEST_PAGE_SIZE - 1));
+        QVERIFY(mailbox.loadedPages() <= 3);
+        QVERIFY(mailbox.isLoaded(row));
+    }
+    QVERIFY(!mailbox.isLoaded(0));
+    QVERIFY(mailbox.isLoaded(70));
+    QVERIFY(mailbox.isLoaded(94));
+
+    // Evicted rows are fetched again.
+    QCOMPARE(mailbox.message(0)->uid(), QString("1"));
+    QCOMPARE(mailbox.loadedPages(), 3);
+
+    QList<QByteArray> commands = close(&imap, &server);
+    QCOMPARE(_pagedFetches(commands).size(), 11);
+}
+
+void PagedMailboxTest::testPrefetchDirection (void) {
+    ImapTestServer server(PAGED_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(login(&imap, &server));
+
+    ImapPagedMailbox mailbox(&imap);
+    mailbox.setPageSize(PAGED_TEST_PAGE_SIZE);
+    mailbox.setPrefetchPages(1);
+    QVERIFY(mailbox.open("INBOX"));
+
+    QVERIFY(mailbox.fetchRows(50, 59));
+    QVERIFY(mailbox.isLoaded(60));
+    QVERIFY(!mailbox.isLoaded(40));
+
+    // Moving up prefetches the page above.
+    QVERIFY(mailbox.fetchRows(30, 39));
+    QVERIFY(mailbox.isLoaded(20));
+    QVERIFY(!mailbox.isLoaded(40));
+
+    close(&imap, &server);
+}
+
+/* Prefetching stops at maxPages(), rather than fetch pages evicted at once. */
+void PagedMailboxTest::testPrefetchWithinMaxPages (void) {
+    ImapTestServer server(PAGED_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(login(&imap, &server));
+
+    ImapPagedMailbox mailbox(&imap);
+    mailbox.setPageSize(PAGED_TEST_PAGE_SIZE);
+    mailbox.setPrefetchPages(2);
+    mailbox.setMaxPages(2);
+    QVERIFY(mailbox.open("INBOX"));
+
+    QVERIFY(mailbox.fetchRows(0, 9));
+    QCOMPARE(mailbox.loadedPages(), 2);
+    QVERIFY(mailbox.isLoaded(10));
+
+    QVERIFY(mailbox.fetchRows(40, 59));
+    QCOMPARE(mailbox.loadedPages(), 2);
+    QVERIFY(mailbox.isLoaded(40));
+    QVERIFY(mailbox.isLoaded(59));
+
+    QList<QByteArray> commands = close(&imap, &server);
+    QCOMPARE(_pagedFetches(commands),
+             QList<QByteArray>() << "FETCH 1:20 ALL" << "FETCH 41:60 ALL");
+}
+
+/* Rows far apart are fetched on their own, not with the rows between. */
+void PagedMailboxTest::testModelDisjointRows (void) {
+    ImapTestServer server(PAGED_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(login(&imap, &server));
+
+    ImapPagedMailbox mailbox(&imap);
+    mailbox.setPageSize(PAGED_TEST_PAGE_SIZE);
+    mailbox.setPrefetchPages(0);
+    mailbox.setMaxPages(2);
+    QVERIFY(mailbox.open("INBOX"));
+
+    ImapMailboxModel model(&mailbox);
+    QCOMPARE(model.rowCount(), PAGED_TEST_MESSAGES);
+    QVERIFY(!model.data(model.index(5, ImapMailboxModel::SubjectColumn)).isValid());
+    QVERIFY(!model.data(model.index(85, ImapMailboxModel::SubjectColumn)).isValid());
+
+    QSignalSpy changed(&model, SIGNAL(dataChanged(QModelIndex, QModelIndex)));
+    QCoreApplication::processEvents();
+    QCOMPARE(changed.count(), 2);
+
+    QVERIFY(mailbox.isLoaded(5));
+    QVERIFY(mailbox.isLoaded(85));
+    QVERIFY(!mailbox.isLoaded(45));
+    QCOMPARE(model.data(model.index(5, ImapMailboxModel::SubjectColumn)).toString(),
+             QString(ImapTestServer::subject(6)));
+    QCOMPARE(model.data(model.index(85, 0), ImapMailboxModel::UidRole).toUInt(), 86U);
+
+    QList<QByteArray> commands = close(&imap, &server);
+    QCOMPARE(_pagedFetches(commands),
+             QList<QByteArray>() << "FETCH 1:10 ALL" << "FETCH 81:90 ALL");
+}
+
+bool PagedMailboxTest::login (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost("127.0.0.1", server->listen()))
+        return(false);
+    return(imap->login("user", "secret"));
+}
+
+/* Commands of the session, once closed. */
+QList<QByteArray> PagedMailboxTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+    return(server->commandLog());
+}
+
+QTEST_MAIN(PagedMailboxTest)
+
+#endif /* TEST_IMAP_PAGED_MAILBOX */
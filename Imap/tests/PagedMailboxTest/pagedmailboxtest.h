@@ -0,0 +1,31 @@
+#ifdef TEST_IMAP_PAGED_MAILBOX
+#ifndef _PAGED_MAILBOX_TEST_H_
+#define _PAGED_MAILBOX_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class Imap;
+
+class PagedMailboxTest : public QObject {
+    Q_OBJECT
+
+    public:
+        PagedMailboxTest (QObject *parent = 0);
+        ~PagedMailboxTest();
+
+    private slots:
+        void testPaging (void);
+        void testUidOrder (void);
+        void testEviction (void);
+        void testPrefetchDirection (void);
+        void testPrefetchWithinMaxPages (void);
+        void testModelDisjointRows (void);
+
+    private:
+        bool login (Imap *imap, ImapTestServer *server);
+        QList<QByteArray> close (Imap *imap, ImapTestServer *server);
+};
+
+#endif /* !_PAGED_MAILBOX_TEST_H_ */
+#endif /* TEST_IMAP_PAGED_MAILBOX */
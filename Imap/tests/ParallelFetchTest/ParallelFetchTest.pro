@@ -0,0 +1,16 @@
+######################################################################
+# Imap Parallel Fetch Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_PARALLEL_FETCH
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += parallelfetchtest.h
+SOURCES += parallelfetchtest.cpp
@@ -0,0 +1,164 @@
+#ifdef TEST_IMAP_PARALLEL_FETCH
+
+#include <QtTest>
+
+#include "imapparallelfetch.h"
+#include "imapsequenceset.h"
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+
+#include "parallelfetchtest.h"
+
+#define PARALLEL_TEST_MESSAGES      (200)
+
+/* Commands of the log starting with prefix. */
+static int _parallelCount (const QList<QByteArray>& log, const char *prefix) {
+    int count = 0;
+    foreach (const QByteArray& command, log) {
+        if (command.startsWith(prefix))
+            count++;
+    }
+    return(count);
+}
+
+/* The UIDs of the mailbox, in its order. */
+static QList<uint> _parallelUids (const ImapMailbox *mailbox) {
+    QList<uint> uids;
+    for (int i = 0; i < mailbox->count(); ++i)
+        uids.append(mailbox->at(i)->uid().toUInt());
+    return(uids);
+}
+
+ParallelFetchTest::ParallelFetchTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+ParallelFetchTest::~ParallelFetchTest() {
+}
+
+/* Only the UIDs that exist are split: a huge hole costs nothing. */
+void ParallelFetchTest::testSparse (void) {
+    ImapTestServer server(PARALLEL_TEST_MESSAGES);
+    ImapParallelFetch fetch;
+    setup(&fetch, &server);
+    fetch.setChunkSize(20);
+
+    ImapSequenceSet uids = ImapSequenceSet::fromString("1:5,150:100000000");
+    ImapMailbox *mailbox = fetch.fetch("INBOX", uids);
+    QVERIFY(mailbox != NULL);
+
+    QList<uint> expected;
+    for (uint uid = 1; uid <= 5; ++uid) expected.append(uid);
+    for (uint uid = 150; uid <= PARALLEL_TEST_MESSAGES; ++uid) expected.append(uid);
+    QCOMPARE(_parallelUids(mailbox), expected);
+    delete mailbox;
+
+    QList<QByteArray> log = close(&fetch, &server);
+    QCOMPARE(_parallelCount(log, "UID SEARCH "), 1);
+    QCOMPARE(_parallelCount(log, "UID FETCH "), 3);
+}
+
+/* Every other UID: the SEARCH and the chunk FETCHes are split. */
+void ParallelFetchTest::testFragmented (void) {
+    ImapTestServer server(6000);
+    ImapParallelFetch fetch;
+    setup(&fetch, &server);
+    fetch.setChunkSize(2000);
+
+    ImapSequenceSet uids;
+    for (uint uid = 1; uid < 6000; uid += 2)
+        uids.add(uid);
+
+    ImapMailbox *mailbox = fetch.fetch("INBOX", uids);
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 3000);
+    QCOMPARE(mailbox->at(2999)->uid().toUInt(), 5999U);
+    delete mailbox;
+
+    QList<QByteArray> log = close(&fetch, &server);
+    QVERIFY(_parallelCount(log, "UID SEARCH ") > 1);
+    QVERIFY(_parallelCount(log, "UID FETCH ") > 2);
+    foreach (const QByteArray& command, log)
+        QVERIFY(command.size() < 8000);
+}
+
+void ParallelFetchTest::testOpenEnded (void) {
+    ImapTestServer server(PARALLEL_TEST_MESSAGES);
+    ImapParallelFetch fetch;
+    setup(&fetch, &server);
+    fetch.setChunkSize(50);
+
+    ImapMailbox *mailbox = fetch.fetch("INBOX", ImapSequenceSet::fromString("1:*"));
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), PARALLEL_TEST_MESSAGES);
+    QCOMPARE(mailbox->at(0)->uid().toUInt(), 1U);
+    QCOMPARE(mailbox->at(PARALLEL_TEST_MESSAGES - 1)->uid().toUInt(),
+             (uint)PARALLEL_TEST_MESSAGES);
+    QCOMPARE(mailbox->at(0)->subject(), QString(ImapTestServer::subject(1)));
+    delete mailbox;
+
+    QList<QByteArray> log = close(&fetch, &server);
+    QCOMPARE(_parallelCount(log, "UID FETCH "), 4);
+}
+
+void ParallelFetchTest::testNoMessages (void) {
+    ImapTestServer server(PARALLEL_TEST_MESSAGES);
+    ImapParallelFetch fetch;
+    setup(&fetch, &server);
+
+    ImapMailbox *mailbox = fetch.fetch("INBOX", ImapSequenceSet(500, 600));
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 0);
+    delete mailbox;
+
+    QList<QByteArray> log = close(&fetch, &server);
+    QCOMPARE(_parallelCount(log, "UID FETCH "), 0);
+}
+
+/* The second fetch doesn't log in or EXAMINE again. */
+void ParallelFetchTest::testReuseConnections (void) {
+    ImapTestServer server(PARALLEL_TEST_MESSAGES);
+    ImapParallelFetch fetch;
+    setup(&fetch, &server);
+    fetch.setChunkSize(100);
+
+    ImapMailbox *mailbox = fetch.fetch("INBOX", ImapSequenceSet(1, 10));
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 10);
+    delete mailbox;
+    QCOMPARE(fetch.connectionCount(), 1);
+
+    mailbox = fetch.fetch("INBOX", ImapSequenceSet(11, 30));
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->count(), 20);
+    QCOMPARE(mailbox->at(0)->uid().toUInt(), 11U);
+    delete mailbox;
+
+    QList<QByteArray> log = close(&fetch, &server);
+    QCOMPARE(fetch.connectionCount(), 0);
+    QCOMPARE(_parallelCount(log, "LOGIN ") + _parallelCount(log, "AUTHENTICATE "), 1);
+    QCOMPARE(_parallelCount(log, "EXAMINE "), 1);
+    QCOMPARE(_parallelCount(log, "UID FETCH "), 2);
+}
+
+/* The test server serves one connection at a time. */
+void ParallelFetchTest::setup (ImapParallelFetch *fetch, ImapTestServer *server) {
+    fetch->setHost("127.0.0.1", server->listen());
+    fetch->setLogin("user", "secret");
+    fetch->setMaxConnections(1);
+}
+
+/* Log out the connections, returns the command log of the session. */
+QList<QByteArray> ParallelFetchTest::close (ImapParallelFetch *fetch,
+                                            ImapTestServer *server)
+{
+    fetch->close();
+    server->waitForSession();
+    return(server->commandLog());
+}
+
+QTEST_MAIN(ParallelFetchTest)
+
+#endif /* TEST_IMAP_PARALLEL_FETCH */
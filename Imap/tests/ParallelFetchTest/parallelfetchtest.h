@@ -0,0 +1,30 @@
+#ifdef TEST_IMAP_PARALLEL_FETCH
+#ifndef _PARALLEL_FETCH_TEST_H_
+#define _PARALLEL_FETCH_TEST_H_
+
+#include <QObject>
+
+class ImapParallelFetch;
+class ImapTestServer;
+
+class ParallelFetchTest : public QObject {
+    Q_OBJECT
+
+    public:
+        ParallelFetchTest (QObject *parent = 0);
+        ~ParallelFetchTest();
+
+    private slots:
+        void testSparse (void);
+        void testFragmented (void);
+        void testOpenEnded (void);
+        void testNoMessages (void);
+        void testReuseConnections (void);
+
+    private:
+        void setup (ImapParallelFetch *fetch, ImapTestServer *server);
+        QList<QByteArray> close (ImapParallelFetch *fetch, ImapTestServer *server);
+};
+
+#endif /* !_PARALLEL_FETCH_TEST_H_ */
+#endif /* TEST_IMAP_PARALLEL_FETCH */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Protocol Benchmarks, against the local test server
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_PROTOCOL_BENCHMARK
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += protocolbenchmark.h
+SOURCES += protocolbenchmark.cpp
@@ -0,0 +1,256 @@
+#ifdef TEST_IMAP_PROTOCOL_BENCHMARK
+
+#include <QtTest>
+
+#include "imappagedmailbox.h"
+#include "imapsequenceset.h"
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapstats.h"
+#include "imap.h"
+
+#include "protocolbenchmark.h"
+
+static int _benchmarkSetting (const char *name, int defaultValue) {
+    bool ok;
+    int value = qgetenv(name).toInt(&ok);
+    return(ok ? value : defaultValue);
+}
+
+ProtocolBenchmark::ProtocolBenchmark (QObject *parent)
+    : QObject(parent), m_server(NULL), m_message(NULL), m_stats(NULL),
+      m_imap(NULL)
+{
+}
+
+ProtocolBenchmark::~ProtocolBenchmark() {
+}
+
+void ProtocolBenchmark::initTestCase (void) {
+    m_messages = _benchmarkSetting("IMAP_BENCHMARK_MESSAGES", 2000);
+    m_bodySize = _benchmarkSetting("IMAP_BENCHMARK_BODY_SIZE", 16 * 1024);
+    m_latency = _benchmarkSetting("IMAP_BENCHMARK_LATENCY", 0);
+    qDebug("%d messages, %d bytes bodies, %d ms latency",
+           m_messages, m_bodySize, m_latency);
+
+    m_server = new ImapTestServer(m_messages);
+    m_server->setBodySize(m_bodySize);
+    m_server->setLatency(m_latency);
+
+    m_stats = new ImapStats;
+    m_stats->setHistorySize(0);
+
+    m_imap = new Imap;
+    m_imap->setStats(m_stats);
+    QVERIFY(m_imap->connectToHost("127.0.0.1", m_server->listen()));
+    QVERIFY(m_imap->login("user", "secret"));
+
+    ImapMailbox *mailbox = m_imap->select("INBOX");
+    QVERIFY(mailbox != NULL);
+    QCOMPARE(mailbox->exists(), m_messages);
+    delete mailbox;
+
+    ImapMailbox first("INBOX");
+    QVERIFY(m_imap->uidFetch(&first, ImapSequenceSet(1)) != NULL);
+    QCOMPARE(first.count(), 1);
+    m_message = first.takeAt(0);
+    QVERIFY(m_imap->fetchBodyStructure(m_message));
+}
+
+void ProtocolBenchmark::cleanupTestCase (void) {
+    if (m_imap != NULL) {
+        m_imap->logout();
+        m_imap->disconnectFromHost();
+    }
+
+    if (m_stats != NULL) {
+        qDebug("%-12s %8s %10s %10s %8s %8s %8s",
+               "command", "count", "in", "out", "first", "wait", "process");
+        foreach (const QString& command, m_stats->commands()) {
+            ImapCommandStats stats = m_stats->total(command);
+            qDebug("%-12s %8d %10lld %10lld %8d %8d %8d",
+                   qPrintable(command), stats.count(),
+                   stats.bytesIn(), stats.bytesOut(),
+                   stats.firstByteTime() / stats.count(),
+                   stats.waitTime(), stats.processTime());
+        }
+    }
+
+    delete m_message;
+    delete m_stats;
+    delete m_imap;
+    delete m_server;
+}
+
+void ProtocolBenchmark::benchmarkLogin_data (void) {
+    QTest::addColumn<int>("type");
+    QTest::addColumn<bool>("saslIr");
+
+    QTest::newRow("LOGIN") << (int)Imap::LoginPlain << true;
+    QTest::newRow("AUTHENTICATE PLAIN") << (int)Imap::LoginAuthenticatePlain << true;
+    QTest::newRow("AUTHENTICATE PLAIN, no SASL-IR") << (int)Imap::LoginAuthenticatePlain << false;
+    QTest::newRow("auto") << (int)Imap::LoginAuto << true;
+}
+
+/* Time to the first command: connect, login and SELECT, on a server of
+ * its own, the main one is busy. Capabilities come with the greeting
+ * and the login response, no CAPABILITY command is expected.
+ */
+void ProtocolBenchmark::benchmarkLogin (void) {
+    QFETCH(int, type);
+    QFETCH(bool, saslIr);
+
+    ImapTestServer server(10);
+    server.setLatency(m_latency);
+    if (!saslIr) {
+        QStringList capabilities = server.capabilities();
+        capabilities.removeAll("SASL-IR");
+        server.setCapabilities(capabilities);
+    }
+    quint16 port = server.listen();
+
+    QBENCHMARK {
+        Imap imap;
+        QVERIFY(imap.connectToHost("127.0.0.1", port));
+        QVERIFY(imap.login("user", "secret", (Imap::LoginType)type));
+
+        ImapMailbox *mailbox = imap.select("INBOX");
+        QVERIFY(mailbox != NULL);
+        delete mailbox;
+
+        QVERIFY(imap.logout());
+        imap.disconnectFromHost();
+        QVERIFY(server.waitForSession());
+        QCOMPARE(server.commandCount(), 3);
+    }
+}
+
+void ProtocolBenchmark::benchmarkSelect (void) {
+    QBENCHMARK {
+        ImapMailbox *mailbox = m_imap->select("INBOX");
+        QVERIFY(mailbox != NULL);
+        delete mailbox;
+    }
+}
+
+void ProtocolBenchmark::benchmarkFetchEnvelopes_data (void) {
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("100") << qMin(100, m_messages);
+    QTest::newRow("1000") << qMin(1000, m_messages);
+    QTest::newRow("all") << m_messages;
+}
+
+void ProtocolBenchmark::benchmarkFetchEnvelopes (void) {
+    QFETCH(int, count);
+
+    QBENCHMARK {
+        ImapMailbox mailbox("INBOX");
+        QVERIFY(m_imap->uidFetch(&mailbox, ImapSequenceSet(1, count)) != NULL);
+        QCOMPARE(mailbox.count(), count);
+    }
+}
+
+/* Open and scroll through the whole mailbox, a screen of 40 rows
+ * at a time: one FETCH per page, never more than maxPages() loaded.
+ */
+void ProtocolBenchmark::benchmarkPagedScroll (void) {
+    QBENCHMARK {
+        ImapPagedMailbox mailbox(m_imap);
+        mailbox.setMaxPages(4);
+        QVERIFY(mailbox.open("INBOX"));
+        QCOMPARE(mailbox.count(), m_messages);
+
+        for (int row = 0; row < mailbox.count(); row += 40) {
+            QVERIFY(mailbox.fetchRows(row, row + 39));
+            QVERIFY(mailbox.cachedMessage(row) != NULL);
+            QVERIFY(mailbox.loadedPages() <= 4);
+        }
+    }
+}
+
+void ProtocolBenchmark::benchmarkSearch_data (void) {
+    QTest::addColumn<QString>("criteria");
+    QTest::addColumn<int>("matches");
+
+    QTest::newRow("unseen") << QString("UNSEEN") << (m_messages / 4);
+    QTest::newRow("flagged") << QString("FLAGGED") << (m_messages / 10);
+    QTest::newRow("subject") << QString("SUBJECT \"report #1\"") << -1;
+}
+
+void ProtocolBenchmark::benchmarkSearch (void) {
+    QFETCH(QString, criteria);
+    QFETCH(int, matches);
+
+    ImapSequenceSet result;
+    QBENCHMARK {
+        result = m_imap->searchSet(criteria, true);
+    }
+
+    if (matches >= 0)
+        QCOMPARE((int)result.count(), matches);
+    else
+        QVERIFY(!result.isEmpty());
+}
+
+/* Flag every third message and unflag the others: a scattered set,
+ * split in as many UID STORE commands as the line length requires.
+ */
+void ProtocolBenchmark::benchmarkStoreFlags (void) {
+    ImapSequenceSet uids;
+    for (int uid = 1; uid <= m_messages; uid += 3)
+        uids.add(uid);
+
+    ImapMessageFlags keyword = ImapMessage::keywordFlag("$Benchmark");
+    QVERIFY(keyword != 0);
+
+    QBENCHMARK {
+        QVERIFY(m_imap->storeFlags(uids, ImapMessageFlagged | keyword));
+        QVERIFY(m_imap->storeFlags(uids, 0, ImapMessageFlagged | keyword));
+    }
+}
+
+void ProtocolBenchmark::benchmarkBodyDownload (void) {
+    QVERIFY(m_message->bodyPartCount() > 0);
+
+    QBENCHMARK {
+        QVERIFY(m_imap->fetchBodyPart(m_message, 0));
+    }
+    QVERIFY(m_message->bodyPartAt(0)->data().size() > 0);
+}
+
+/* Previews of a page of 50 messages: structures, then the first
+ * 2048 bytes of the first part, two commands instead of 100.
+ */
+void ProtocolBenchmark::benchmarkBodyPreviews (void) {
+    int count = qMin(50, m_messages);
+
+    QBENCHMARK {
+        ImapMailbox page("INBOX");
+        QVERIFY(m_imap->uidFetch(&page, ImapSequenceSet(1, count)) != NULL);
+        QCOMPARE(page.count(), count);
+
+        QVERIFY(m_imap->fetchBodies(page.messages(), true));
+        QVERIFY(m_imap->fetchBodies(page.messages(), false, QStringList() << "1", 2048));
+        foreach (ImapMessage *message, page.messages()) {
+            QVERIFY(message->bodyPartCount() > 0);
+            QVERIFY(message->bodyPartAt(0)->data().size() > 0);
+        }
+    }
+}
+
+void ProtocolBenchmark::benchmarkAppend (void) {
+    QByteArray message = "From: bob@example.org\r\nSubject: Benchmark\r\n\r\n" +
+                         ImapTestServer::body(0, m_bodySize);
+
+    QBENCHMARK {
+        uint uid = 0;
+        QVERIFY(m_imap->append("INBOX", message, ImapMessageSeen, QDateTime(), &uid));
+        QVERIFY(uid > 0);
+    }
+}
+
+QTEST_MAIN(ProtocolBenchmark)
+
+#endif /* TEST_IMAP_PROTOCOL_BENCHMARK */
@@ -0,0 +1,55 @@
+#ifdef TEST_IMAP_PROTOCOL_BENCHMARK
+#ifndef _PROTOCOL_BENCHMARK_H_
+#define _PROTOCOL_BENCHMARK_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class ImapMessage;
+class ImapStats;
+class Imap;
+
+/**
+ * Client round trips against the local test server. The mailbox size,
+ * body size and simulated latency are read from the environment:
+ * IMAP_BENCHMARK_MESSAGES, IMAP_BENCHMARK_BODY_SIZE (bytes) and
+ * IMAP_BENCHMARK_LATENCY (ms per command).
+ * The per-command ImapStats of the main connection are printed at the end.
+ */
+class ProtocolBenchmark : public QObject {
+    Q_OBJECT
+
+    public:
+        ProtocolBenchmark (QObject *parent = 0);
+        ~ProtocolBenchmark();
+
+    private slots:
+        void initTestCase (void);
+        void cleanupTestCase (void);
+
+        void benchmarkLogin_data (void);
+        void benchmarkLogin (void);
+        void benchmarkSelect (void);
+        void benchmarkFetchEnvelopes_data (void);
+        void benchmarkFetchEnvelopes (void);
+        void benchmarkPagedScroll (void);
+        void benchmarkSearch_data (void);
+        void benchmarkSearch (void);
+        void benchmarkStoreFlags (void);
+        void benchmarkBodyDownload (void);
+        void benchmarkBodyPreviews (void);
+        void benchmarkAppend (void);
+
+    private:
+        ImapTestServer *m_server;
+        ImapMessage *m_message;
+        ImapStats *m_stats;
+        Imap *m_imap;
+
+        int m_messages;
+        int m_bodySize;
+        int m_latency;
+};
+
+#endif /* !_PROTOCOL_BENCHMARK_H_ */
+#endif /* TEST_IMAP_PROTOCOL_BENCHMARK */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Search Query Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_SEARCH_QUERY
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += searchquerytest.h
+SOURCES += searchquerytest.cpp
@@ -0,0 +1,266 @@
+#ifdef TEST_IMAP_SEARCH_QUERY
+
+#include <QtTest>
+#include <QDir>
+
+#include "imapsearchquery.h"
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapcache.h"
+#include "imap.h"
+
+#include "searchquerytest.h"
+
+#define SEARCH_TEST_MESSAGES    (10)
+#define SEARCH_TEST_SERVER      ("127.0.0.1")
+#define SEARCH_TEST_MAILBOX     ("INBOX")
+
+SearchQueryTest::SearchQueryTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+SearchQueryTest::~SearchQueryTest() {
+}
+
+void SearchQueryTest::cleanup (void) {
+    QDir directory(cachePath());
+    foreach (const QString& name, directory.entryList(QDir::Files))
+        directory.remove(name);
+}
+
+void SearchQueryTest::testToString (void) {
+    ImapSearchQuery query = ImapSearchQuery::from("bob") &&
+                            ImapSearchQuery::since(QDate(2009, 7, 1)) &&
+                            !ImapSearchQuery::flag(ImapMessageSeen);
+    QCOMPARE(query.toString(), QString("FROM \"bob\" SINCE 1-Jul-2009 NOT SEEN"));
+
+    query = ImapSearchQuery::flag(ImapMessageSeen, false) ||
+            ImapSearchQuery::subject("say \"hi\"") ||
+            ImapSearchQuery::larger(1000);
+    QCOMPARE(query.toString(), QString("OR UNSEEN OR SUBJECT \"say \\\"hi\\\"\" LARGER 1000"));
+    QVERIFY(query.isValid());
+}
+
+/* Keyword bits compile to KEYWORD, and match the message flags. */
+void SearchQueryTest::testKeywordFlag (void) {
+    ImapMessageFlags junk = ImapMessage::keywordFlag("$Junk");
+    QVERIFY(junk != 0);
+
+    QCOMPARE(ImapSearchQuery::flag(junk).toString(), QString("KEYWORD $Junk"));
+    QCOMPARE(ImapSearchQuery::flag(junk, false).toString(), QString("UNKEYWORD $Junk"));
+    QCOMPARE((!ImapSearchQuery::flag(junk)).toString(), QString("NOT KEYWORD $Junk"));
+    QVERIFY(ImapSearchQuery::flag(junk).isValid());
+    QVERIFY(ImapSearchQuery::flag(junk).isLocal());
+
+    ImapMessage message;
+    message.setFlags(ImapMessageSeen | junk);
+    QVERIFY(ImapSearchQuery::flag(junk).matches(&message));
+    message.setFlags(ImapMessageSeen);
+    QVERIFY(!ImapSearchQuery::flag(junk).matches(&message));
+    QVERIFY(ImapSearchQuery::flag(junk, false).matches(&message));
+}
+
+/* Flags without a name and keywords that aren't atoms. */
+void SearchQueryTest::testInvalid (void) {
+    QVERIFY(!ImapSearchQuery::flag(0).isValid());
+    QVERIFY(!ImapSearchQuery::flag(ImapMessageSeen | ImapMessageFlagged).isValid());
+    QVERIFY(!ImapSearchQuery::flag((uint)1 << 31).isValid());
+    QVERIFY(!ImapSearchQuery::keyword("two words").isValid());
+    QVERIFY(!ImapSearchQuery::keyword("").isValid());
+    QVERIFY(ImapSearchQuery::keyword("$Forwarded").isValid());
+
+    ImapSearchQuery query = ImapSearchQuery::subject("status") &&
+                            !(ImapSearchQuery::flag(ImapMessageSeen) ||
+                              ImapSearchQuery::flag(0));
+    QVERIFY(!query.isValid());
+}
+
+/* An empty set matches nothing, it isn't left out. */
+void SearchQueryTest::testEmptySet (void) {
+    ImapSearchQuery uids = ImapSearchQuery::uids(ImapSequenceSet());
+    QCOMPARE(uids.toString(), QString("NOT ALL"));
+    QCOMPARE(ImapSearchQuery::messages(ImapSequenceSet()).toString(), QString("NOT ALL"));
+    QCOMPARE((ImapSearchQuery::flag(ImapMessageSeen) && uids).toString(),
+             QString("SEEN NOT ALL"));
+
+    ImapMessage message;
+    message.setUid("1");
+    QVERIFY(!uids.matches(&message));
+    QVERIFY((!uids).matches(&message));
+
+    ImapSearchQuery some = ImapSearchQuery::uids(ImapSequenceSet(2, 4));
+    QCOMPARE(some.toString(), QString("UID 2:4"));
+}
+
+/* An invalid query fails before reaching the server. */
+void SearchQueryTest::testInvalidQuery (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSearchResult result;
+    QVERIFY(!imap.search(ImapSearchQuery::flag(0), &result, ImapSearchResult::ReturnAll, true));
+    QVERIFY(result.all().isEmpty());
+    QVERIFY(!imap.errorString().isEmpty());
+
+    QVERIFY(imap.search(ImapSearchQuery::uids(ImapSequenceSet()), &result,
+                        ImapSearchResult::ReturnAll, true));
+    QVERIFY(result.all().isEmpty());
+    close(&imap, &server);
+
+    int searches = 0;
+    foreach (const QByteArray& line, server.commandLog())
+        searches += line.startsWith("UID SEARCH") ? 1 : 0;
+    QCOMPARE(searches, 1);
+}
+
+/* Keys the server rejects are evaluated on the cache. */
+void SearchQueryTest::testFallback (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    server.setRejectedSearchKeys(QStringList() << "SUBJECT" << "SEEN");
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSearchResult result;
+    ImapSearchQuery query = ImapSearchQuery::subject("report #3") &&
+                            ImapSearchQuery::text("fox");
+    QVERIFY(!imap.search(query, &result, ImapSearchResult::ReturnAll, true));
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(SEARCH_TEST_SERVER, SEARCH_TEST_MAILBOX, 1));
+    QVERIFY(fillCache(&cache));
+    imap.setCache(&cache);
+
+    QVERIFY(imap.search(query, &result, ImapSearchResult::ReturnAll, true));
+    QCOMPARE(result.all().toString(), QString("3"));
+    QVERIFY(result.isUid());
+
+    // Answered by the cache alone, every message but 4 and 8 is seen.
+    QVERIFY(imap.search(ImapSearchQuery::flag(ImapMessageSeen), &result,
+                        ImapSearchResult::ReturnAll, true));
+    QCOMPARE(result.all().toString(), QString("1:3,5:7,9:10"));
+
+    imap.setCache(NULL);
+    close(&imap, &server);
+
+    QVERIFY(server.commandLog().contains("UID SEARCH TEXT \"fox\""));
+}
+
+/* Non-ASCII strings go as UTF-8 literals, with their CHARSET. */
+void SearchQueryTest::testUtf8 (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSearchResult result;
+    ImapSearchQuery query = ImapSearchQuery::subject(QString::fromUtf8("r\xc3\xa9port")) &&
+                            ImapSearchQuery::text("fox");
+    QVERIFY(imap.search(query, &result, ImapSearchResult::ReturnAll, true));
+    QVERIFY(result.all().isEmpty());
+
+    QVERIFY(imap.search(ImapSearchQuery::subject("report #3"), &result,
+                        ImapSearchResult::ReturnAll, true));
+    QCOMPARE(result.all().toString(), QString("3"));
+    close(&imap, &server);
+
+    QList<QByteArray> log = server.commandLog();
+    QVERIFY(log.contains("UID SEARCH CHARSET UTF-8 SUBJECT {7+}\r\nr\xc3\xa9port TEXT \"fox\""));
+    QVERIFY(log.contains("UID SEARCH SUBJECT \"report #3\""));
+}
+
+/* Without LITERAL+ each literal waits for "+", searches aren't pipelined. */
+void SearchQueryTest::testUtf8Synchronizing (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    QStringList capabilities = server.capabilities();
+    capabilities.removeAll("LITERAL+");
+    server.setCapabilities(capabilities);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSearchResult result;
+    QString text = QString::fromUtf8("Wee\xc3\x9fkly");
+    QVERIFY(imap.search(ImapSearchQuery::subject(text), &result,
+                        ImapSearchResult::ReturnAll, true));
+    QVERIFY(result.all().isEmpty());
+
+    ImapSequenceSet uids;
+    for (uint uid = 1; uid < 6000; uid += 2)
+        uids.add(uid);
+    ImapSequenceSet found;
+    QVERIFY(imap.searchUids(uids, "SUBJECT \"" + text + '"', &found));
+    QVERIFY(found.isEmpty());
+    close(&imap, &server);
+
+    int searches = 0;
+    foreach (const QByteArray& line, server.commandLog()) {
+        if (line.startsWith("UID SEARCH")) {
+            QVERIFY(line.contains("CHARSET UTF-8 "));
+            QVERIFY(line.contains("{8}\r\nWee\xc3\x9fkly"));
+            searches++;
+        }
+    }
+    QVERIFY(searches > 2);
+}
+
+/* A search that timed out isn't the server saying no. */
+void SearchQueryTest::testNoFallbackOnTimeout (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    server.setLatency(300);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapCache cache(cachePath());
+    QVERIFY(cache.open(SEARCH_TEST_SERVER, SEARCH_TEST_MAILBOX, 1));
+    QVERIFY(fillCache(&cache));
+    imap.setCache(&cache);
+
+    imap.setTimeout(50);
+    ImapSearchResult result;
+    QVERIFY(!imap.search(ImapSearchQuery::flag(ImapMessageSeen), &result,
+                         ImapSearchResult::ReturnAll, true));
+    QVERIFY(result.all().isEmpty());
+
+    imap.setCache(NULL);
+    imap.disconnectFromHost();
+    server.waitForSession();
+}
+
+QString SearchQueryTest::cachePath (void) const {
+    return(QDir::temp().filePath("ImapSearchQueryTest"));
+}
+
+/* Envelopes and flags of the test server messages. */
+bool SearchQueryTest::fillCache (ImapCache *cache) {
+    for (int i = 1; i <= SEARCH_TEST_MESSAGES; ++i) {
+        ImapMessage message;
+        message.setUid(QString::number(i));
+        message.setSubject(QString::fromLatin1(ImapTestServer::subject(i)));
+        message.setFlags((i % 4) != 0 ? ImapMessageSeen : 0);
+        if (!cache->insertMessage(&message))
+            return(false);
+    }
+    return(true);
+}
+
+bool SearchQueryTest::open (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost(SEARCH_TEST_SERVER, server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select(SEARCH_TEST_MAILBOX);
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+void SearchQueryTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+}
+
+QTEST_MAIN(SearchQueryTest)
+
+#endif /* TEST_IMAP_SEARCH_QUERY */
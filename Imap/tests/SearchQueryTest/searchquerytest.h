@@ -0,0 +1,39 @@
+#ifdef TEST_IMAP_SEARCH_QUERY
+#ifndef _SEARCH_QUERY_TEST_H_
+#define _SEARCH_QUERY_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class ImapCache;
+class Imap;
+
+class SearchQueryTest : public QObject {
+    Q_OBJECT
+
+    public:
+        SearchQueryTest (QObject *parent = 0);
+        ~SearchQueryTest();
+
+    private slots:
+        void cleanup (void);
+
+        void testToString (void);
+        void testKeywordFlag (void);
+        void testInvalid (void);
+        void testEmptySet (void);
+        void testInvalidQuery (void);
+        void testFallback (void);
+        void testUtf8 (void);
+        void testUtf8Synchronizing (void);
+        void testNoFallbackOnTimeout (void);
+
+    private:
+        QString cachePath (void) const;
+        bool fillCache (ImapCache *cache);
+        bool open (Imap *imap, ImapTestServer *server);
+        void close (Imap *imap, ImapTestServer *server);
+};
+
+#endif /* !_SEARCH_QUERY_TEST_H_ */
+#endif /* TEST_IMAP_SEARCH_QUERY */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Search Result (SEARCH and ESEARCH) Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_SEARCH_RESULT
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += searchresulttest.h
+SOURCES += searchresulttest.cpp
@@ -0,0 +1,160 @@
+#ifdef TEST_IMAP_SEARCH_RESULT
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imap.h"
+
+#include "searchresulttest.h"
+
+#define SEARCH_TEST_MESSAGES        (25)
+
+SearchResultTest::SearchResultTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+SearchResultTest::~SearchResultTest() {
+}
+
+void SearchResultTest::testFromSet (void) {
+    ImapSearchResult result;
+    result.setFromSet(ImapSequenceSet::fromString("9,3:5"));
+    QCOMPARE(result.min(), 3U);
+    QCOMPARE(result.max(), 9U);
+    QCOMPARE(result.count(), (quint64)4);
+    QCOMPARE(result.all().toString(), QString("3:5,9"));
+
+    result.setFromSet(ImapSequenceSet());
+    QCOMPARE(result.min(), 0U);
+    QCOMPARE(result.max(), 0U);
+    QCOMPARE(result.count(), (quint64)0);
+    QVERIFY(result.all().isEmpty());
+}
+
+void SearchResultTest::testESearch (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server, true));
+
+    // \Flagged: every tenth message.
+    ImapSearchResult result;
+    QVERIFY(imap.search("FLAGGED", &result,
+                        ImapSearchResult::ReturnMin | ImapSearchResult::ReturnMax |
+                        ImapSearchResult::ReturnCount | ImapSearchResult::ReturnAll));
+    QVERIFY(!result.isUid());
+    QCOMPARE(result.min(), 10U);
+    QCOMPARE(result.max(), 20U);
+    QCOMPARE(result.count(), (quint64)2);
+    QCOMPARE(result.all().toString(), QString("10,20"));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("SEARCH RETURN (MIN MAX COUNT ALL) FLAGGED"));
+}
+
+void SearchResultTest::testESearchCount (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server, true));
+
+    // Only the count is sent back: 4, 8 ... 24 are unseen.
+    ImapSearchResult result;
+    QVERIFY(imap.search("UNSEEN", &result, ImapSearchResult::ReturnCount));
+    QCOMPARE(result.count(), (quint64)6);
+    QCOMPARE(result.min(), 0U);
+    QCOMPARE(result.max(), 0U);
+    QVERIFY(result.all().isEmpty());
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("SEARCH RETURN (COUNT) UNSEEN"));
+}
+
+void SearchResultTest::testESearchUid (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server, true));
+
+    ImapSearchResult result;
+    QVERIFY(imap.search("UNSEEN", &result,
+                        ImapSearchResult::ReturnMin | ImapSearchResult::ReturnMax, true));
+    QVERIFY(result.isUid());
+    QCOMPARE(result.min(), 4U);
+    QCOMPARE(result.max(), 24U);
+    QCOMPARE(result.count(), (quint64)0);
+
+    QCOMPARE(imap.searchSet("FLAGGED", true).toString(), QString("10,20"));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("UID SEARCH RETURN (MIN MAX) UNSEEN"));
+    QVERIFY(log.contains("UID SEARCH RETURN (ALL) FLAGGED"));
+}
+
+void SearchResultTest::testESearchEmpty (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server, true));
+
+    // Nothing matches: only COUNT comes back.
+    ImapSearchResult result;
+    QVERIFY(imap.search("SUBJECT \"no such report\"", &result,
+                        ImapSearchResult::ReturnMin | ImapSearchResult::ReturnMax |
+                        ImapSearchResult::ReturnCount | ImapSearchResult::ReturnAll));
+    QCOMPARE(result.count(), (quint64)0);
+    QCOMPARE(result.min(), 0U);
+    QCOMPARE(result.max(), 0U);
+    QVERIFY(result.all().isEmpty());
+    QVERIFY(imap.search("SUBJECT \"no such report\"").isEmpty());
+
+    close(&imap, &server);
+}
+
+void SearchResultTest::testPlainSearch (void) {
+    ImapTestServer server(SEARCH_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server, false));
+
+    // Without ESEARCH every item is filled, whatever was asked.
+    ImapSearchResult result;
+    QVERIFY(imap.search("FLAGGED", &result, ImapSearchResult::ReturnCount));
+    QCOMPARE(result.count(), (quint64)2);
+    QCOMPARE(result.min(), 10U);
+    QCOMPARE(result.max(), 20U);
+    QCOMPARE(result.all().toString(), QString("10,20"));
+
+    QVERIFY(imap.search("UNSEEN", &result, ImapSearchResult::ReturnMin, true));
+    QVERIFY(result.isUid());
+    QCOMPARE(result.min(), 4U);
+    QCOMPARE(result.count(), (quint64)6);
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("SEARCH FLAGGED"));
+    QVERIFY(log.contains("UID SEARCH UNSEEN"));
+    foreach (const QByteArray& line, log)
+        QVERIFY(!line.contains("RETURN"));
+}
+
+bool SearchResultTest::open (Imap *imap, ImapTestServer *server, bool esearch) {
+    if (esearch)
+        server->setCapabilities(server->capabilities() << "ESEARCH");
+
+    if (!imap->connectToHost("127.0.0.1", server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select("INBOX");
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+QList<QByteArray> SearchResultTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+    return(server->commandLog());
+}
+
+QTEST_MAIN(SearchResultTest)
+
+#endif /* TEST_IMAP_SEARCH_RESULT */
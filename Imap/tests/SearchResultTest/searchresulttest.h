@@ -0,0 +1,31 @@
+#ifdef TEST_IMAP_SEARCH_RESULT
+#ifndef _SEARCH_RESULT_TEST_H_
+#define _SEARCH_RESULT_TEST_H_
+
+#include <QObject>
+
+class ImapTestServer;
+class Imap;
+
+class SearchResultTest : public QObject {
+    Q_OBJECT
+
+    public:
+        SearchResultTest (QObject *parent = 0);
+        ~SearchResultTest();
+
+    private slots:
+        void testFromSet (void);
+        void testESearch (void);
+        void testESearchCount (void);
+        void testESearchUid (void);
+        void testESearchEmpty (void);
+        void testPlainSearch (void);
+
+    private:
+        bool open (Imap *imap, ImapTestServer *server, bool esearch);
+        QList<QByteArray> close (Imap *imap, ImapTestServer *server);
+};
+
+#endif /* !_SEARCH_RESULT_TEST_H_ */
+#endif /* TEST_IMAP_SEARCH_RESULT */
@@ -0,0 +1,18 @@
+######################################################################
+# Imap Sequence Set Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += . ../../src/
+INCLUDEPATH += . ../../src/
+
+DEFINES += TEST_IMAP_SEQUENCE_SET
+
+QT += testlib
+
+# Input
+HEADERS += sequencesettest.h \
+           ../../src/imapsequenceset.h
+SOURCES += sequencesettest.cpp \
+           ../../src/imapsequenceset.cpp
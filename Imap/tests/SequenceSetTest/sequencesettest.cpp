@@ -0,0 +1,80 @@
+#ifdef TEST_IMAP_SEQUENCE_SET
+
+#include <QtTest>
+
+#include "imapsequenceset.h"
+
+#include "sequencesettest.h"
+
+SequenceSetTest::SequenceSetTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+SequenceSetTest::~SequenceSetTest() {
+}
+
+void SequenceSetTest::testFromString (void) {
+    ImapSequenceSet set = ImapSequenceSet::fromString("9:12,1:5,7");
+    QCOMPARE(set.toString(), QString("1:5,7,9:12"));
+    QCOMPARE(set.rangeCount(), 3);
+    QCOMPARE(set.count(), (quint64)10);
+
+    set = ImapSequenceSet::fromString("5:*");
+    QCOMPARE(set.first(), 5U);
+    QCOMPARE(set.last(), 0xffffffffU);
+}
+
+void SequenceSetTest::testToList (void) {
+    ImapSequenceSet set = ImapSequenceSet::fromString("1:3,7,10:11");
+    QCOMPARE(set.toList(), QList<int>() << 1 << 2 << 3 << 7 << 10 << 11);
+    QCOMPARE(ImapSequenceSet::fromList(set.toList()), set);
+    QVERIFY(ImapSequenceSet().toList().isEmpty());
+}
+
+/* '*' has no known end: no list of 4 billion values. */
+void SequenceSetTest::testToListOpenEnded (void) {
+    QVERIFY(ImapSequenceSet::fromString("1:*").toList().isEmpty());
+    QVERIFY(ImapSequenceSet(1, 0x7fffffff).toList().isEmpty());
+
+    ImapSequenceSet set(4294967290U, 0xffffffff);
+    QCOMPARE(set.toList().size(), 6);
+}
+
+/* Parts fit in maxLength, in order, and cover the set. */
+void SequenceSetTest::testSplit (void) {
+    ImapSequenceSet set;
+    for (uint uid = 1; uid < 1000; uid += 2)
+        set.add(uid);
+    set.add(5000, 6000);
+
+    QList<ImapSequenceSet> parts = set.split(100);
+    QVERIFY(parts.size() > 1);
+
+    ImapSequenceSet merged;
+    uint last = 0;
+    foreach (const ImapSequenceSet& part, parts) {
+        QVERIFY(part.toString().size() <= 100);
+        QVERIFY(part.first() > last);
+        last = part.last();
+        merged.add(part);
+    }
+    QCOMPARE(merged, set);
+
+    QCOMPARE(set.split(100000).size(), 1);
+    QVERIFY(ImapSequenceSet().split(100).isEmpty());
+}
+
+/* A range is never cut, even longer than maxLength. */
+void SequenceSetTest::testSplitLongRange (void) {
+    ImapSequenceSet set = ImapSequenceSet::fromString("1,1000000:2000000,3");
+    QList<ImapSequenceSet> parts = set.split(5);
+
+    QCOMPARE(parts.size(), 2);
+    QCOMPARE(parts[0].toString(), QString("1,3"));
+    QCOMPARE(parts[1].toString(), QString("1000000:2000000"));
+}
+
+QTEST_MAIN(SequenceSetTest)
+
+#endif /* TEST_IMAP_SEQUENCE_SET */
@@ -0,0 +1,23 @@
+#ifdef TEST_IMAP_SEQUENCE_SET
+#ifndef _SEQUENCE_SET_TEST_H_
+#define _SEQUENCE_SET_TEST_H_
+
+#include <QObject>
+
+class SequenceSetTest : public QObject {
+    Q_OBJECT
+
+    public:
+        SequenceSetTest (QObject *parent = 0);
+        ~SequenceSetTest();
+
+    private slots:
+        void testFromString (void);
+        void testToList (void);
+        void testToListOpenEnded (void);
+        void testSplit (void);
+        void testSplitLongRange (void);
+};
+
+#endif /* !_SEQUENCE_SET_TEST_H_ */
+#endif /* TEST_IMAP_SEQUENCE_SET */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Client Side Sort Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_SORT
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += sorttest.h
+SOURCES += sorttest.cpp
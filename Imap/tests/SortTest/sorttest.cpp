@@ -0,0 +1,156 @@
+#ifdef TEST_IMAP_SORT
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imaplisting.h"
+#include "imapsort.h"
+#include "imap.h"
+
+#include "sorttest.h"
+
+static QList<uint> _uids (uint a, uint b, uint c) {
+    QList<uint> uids;
+    uids << a << b << c;
+    return(uids);
+}
+
+static QList<uint> _sort (const ImapListing *listing, const ImapSortCriteria& criteria) {
+    ImapSorter sorter(listing, criteria);
+    sorter.update();
+    return(sorter.uids());
+}
+
+SortTest::SortTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+SortTest::~SortTest() {
+}
+
+void SortTest::testCriteria (void) {
+    ImapSortCriteria criteria(ImapSortCriteria::Date, true);
+    criteria.append(ImapSortCriteria::Subject);
+    QCOMPARE(criteria.toString(), QString("(REVERSE DATE SUBJECT)"));
+    QVERIFY(ImapSorter::isSupported(criteria));
+    QCOMPARE(ImapSorter::listingFields(criteria),
+             ImapListing::Fields(ImapListing::Uid | ImapListing::InternalDate | ImapListing::Subject));
+
+    criteria.append(ImapSortCriteria::Cc);
+    QVERIFY(!ImapSorter::isSupported(criteria));
+    QVERIFY(!ImapSorter::isSupported(ImapSortCriteria()));
+
+    // The listing lacks the sizes.
+    ImapListing listing(ImapListing::Uid | ImapListing::Subject);
+    ImapSorter sorter(&listing, ImapSortCriteria(ImapSortCriteria::Size));
+    QVERIFY(!sorter.isValid());
+}
+
+void SortTest::testSort (void) {
+    ImapListing listing(ImapListing::AllFields);
+    appendMessage(&listing, 10, 300, "01-Jan-2020 10:00:00 +0000", "Re: Beta", "bob");
+    appendMessage(&listing, 11, 100, "03-Jan-2020 10:00:00 +0000", "Alpha", "Carol");
+    appendMessage(&listing, 12, 200, "02-Jan-2020 10:00:00 +0000", "beta", "alice");
+
+    QCOMPARE(_sort(&listing, ImapSortCriteria(ImapSortCriteria::Arrival)), _uids(10, 12, 11));
+    QCOMPARE(_sort(&listing, ImapSortCriteria(ImapSortCriteria::Size)), _uids(11, 12, 10));
+    QCOMPARE(_sort(&listing, ImapSortCriteria(ImapSortCriteria::Size, true)), _uids(10, 12, 11));
+    QCOMPARE(_sort(&listing, ImapSortCriteria(ImapSortCriteria::From)), _uids(12, 10, 11));
+
+    // Equal base subjects keep the listing order...
+    QCOMPARE(_sort(&listing, ImapSortCriteria(ImapSortCriteria::Subject)), _uids(11, 10, 12));
+
+    // ...unless a second key tells them apart.
+    ImapSortCriteria criteria(ImapSortCriteria::Subject);
+    criteria.append(ImapSortCriteria::Arrival, true);
+    QCOMPARE(_sort(&listing, criteria), _uids(11, 12, 10));
+}
+
+void SortTest::testIncremental (void) {
+    ImapListing listing(ImapListing::Uid | ImapListing::InternalDate);
+    appendMessage(&listing, 10, 0, "01-Jan-2020 10:00:00 +0000", "", "");
+    appendMessage(&listing, 11, 0, "03-Jan-2020 10:00:00 +0000", "", "");
+    appendMessage(&listing, 12, 0, "02-Jan-2020 10:00:00 +0000", "", "");
+
+    ImapSorter sorter(&listing, ImapSortCriteria(ImapSortCriteria::Arrival));
+    sorter.update();
+    QCOMPARE(sorter.uids(), _uids(10, 12, 11));
+
+    appendMessage(&listing, 13, 0, "31-Dec-2019 10:00:00 +0000", "", "");
+    appendMessage(&listing, 14, 0, "02-Jan-2020 10:00:00 +0000", "", "");
+    sorter.update();
+
+    QList<uint> uids;
+    uids << 13 << 10 << 12 << 14 << 11;
+    QCOMPARE(sorter.uids(), uids);
+    QCOMPARE(sorter.count(), 5);
+    QCOMPARE(sorter.indexAt(0), 3);
+    QCOMPARE(sorter.uidAt(4), 11u);
+
+    listing.clear();
+    appendMessage(&listing, 20, 0, "01-Jan-2020 10:00:00 +0000", "", "");
+    sorter.update();
+    QCOMPARE(sorter.count(), 1);
+    QCOMPARE(sorter.uidAt(0), 20u);
+}
+
+/* Without SORT the listing is kept, later calls fetch what was added. */
+void SortTest::testServerListing (void) {
+    ImapTestServer server(10);
+    Imap imap;
+    QVERIFY(imap.connectToHost("127.0.0.1", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    delete imap.select("INBOX");
+
+    // "Weekly status report #n", by base subject.
+    QList<uint> uids;
+    QVERIFY(imap.sort(ImapSortCriteria(ImapSortCriteria::Subject), &uids));
+    QCOMPARE(uids.size(), 10);
+    QCOMPARE(uids.mid(0, 3), _uids(1, 10, 2));
+
+    QVERIFY(imap.sort(ImapSortCriteria(ImapSortCriteria::Subject), &uids));
+    QCOMPARE(uids.size(), 10);
+
+    QVERIFY(imap.append("INBOX", QByteArray("Subject: new\r\n\r\nnew\r\n")));
+    QVERIFY(imap.append("INBOX", QByteArray("Subject: new\r\n\r\nnew\r\n")));
+    QVERIFY(imap.sort(ImapSortCriteria(ImapSortCriteria::Subject, true), &uids));
+    QCOMPARE(uids.size(), 12);
+    QCOMPARE(uids.mid(8, 4), QList<uint>() << 12 << 11 << 10 << 1);
+
+    // Selecting the same mailbox again keeps the listing.
+    delete imap.select("INBOX");
+    QVERIFY(imap.sort(ImapSortCriteria(ImapSortCriteria::Subject), &uids));
+    QCOMPARE(uids.size(), 12);
+
+    imap.logout();
+    imap.disconnectFromHost();
+    server.waitForSession();
+
+    QList<QByteArray> fetches;
+    foreach (const QByteArray& line, server.commandLog()) {
+        if (line.contains("FETCH"))
+            fetches.append(line);
+    }
+    QCOMPARE(fetches, QList<QByteArray>() << "FETCH 1:* (UID ENVELOPE)"
+                                          << "UID FETCH 11:* (UID ENVELOPE)"
+                                          << "UID FETCH 11:* (UID ENVELOPE)"
+                                          << "UID FETCH 13:* (UID ENVELOPE)");
+}
+
+void SortTest::appendMessage (ImapListing *listing, uint uid, int size,
+                              const char *date, const char *subject,
+                              const char *mailbox)
+{
+    QByteArray response = "* " + QByteArray::number(listing->count() + 1) + " FETCH (UID " +
+                          QByteArray::number(uid) + " RFC822.SIZE " + QByteArray::number(size) +
+                          " INTERNALDATE \"" + date + "\" ENVELOPE (NIL \"" + subject +
+                          "\" ((NIL NIL \"" + mailbox + "\" \"example.com\"))" +
+                          " NIL NIL NIL NIL NIL NIL NIL))\r\n";
+    QVERIFY(listing->appendFetchResponse(response));
+}
+
+QTEST_MAIN(SortTest)
+
+#endif /* TEST_IMAP_SORT */
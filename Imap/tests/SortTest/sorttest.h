@@ -0,0 +1,29 @@
+#ifdef TEST_IMAP_SORT
+#ifndef _SORT_TEST_H_
+#define _SORT_TEST_H_
+
+#include <QObject>
+
+class ImapListing;
+
+class SortTest : public QObject {
+    Q_OBJECT
+
+    public:
+        SortTest (QObject *parent = 0);
+        ~SortTest();
+
+    private slots:
+        void testCriteria (void);
+        void testSort (void);
+        void testIncremental (void);
+        void testServerListing (void);
+
+    private:
+        void appendMessage (ImapListing *listing, uint uid, int size,
+                            const char *date, const char *subject,
+                            const char *mailbox);
+};
+
+#endif /* !_SORT_TEST_H_ */
+#endif /* TEST_IMAP_SORT */
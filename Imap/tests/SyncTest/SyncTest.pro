@@ -0,0 +1,16 @@
+######################################################################
+# Imap Synchronization Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_SYNC
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += synctest.h
+SOURCES += synctest.cpp
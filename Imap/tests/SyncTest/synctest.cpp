@@ -0,0 +1,154 @@
+#ifdef TEST_IMAP_SYNC
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapmessage.h"
+#include "imapsync.h"
+#include "imap.h"
+
+#include "synctest.h"
+
+#define SYNC_TEST_MESSAGES      (50)
+
+SyncTest::SyncTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+SyncTest::~SyncTest() {
+}
+
+void SyncTest::testInitial (void) {
+    ImapTestServer server(SYNC_TEST_MESSAGES);
+    ImapSyncState state("INBOX");
+    ImapSyncDelta delta;
+    QVERIFY(synchronize(&server, &state, &delta));
+
+    QCOMPARE(delta.added()->count(), SYNC_TEST_MESSAGES);
+    QVERIFY(delta.changed().isEmpty());
+    QVERIFY(delta.removed().isEmpty());
+    QCOMPARE(state.uids(), ImapSequenceSet(1, SYNC_TEST_MESSAGES));
+
+    // Server flags: \Seen but one out of four, \Flagged one out of ten.
+    QVERIFY(state.hasFlags(1));
+    QCOMPARE(state.flags(1), (ImapMessageFlags)ImapMessageSeen);
+    QCOMPARE(state.flags(4), (ImapMessageFlags)0);
+    QCOMPARE(state.flags(10), (ImapMessageFlags)(ImapMessageSeen | ImapMessageFlagged));
+}
+
+/* Without CONDSTORE the flags of every message come back,
+ * none of them changed. */
+void SyncTest::testUnchanged (void) {
+    ImapTestServer server(SYNC_TEST_MESSAGES);
+    ImapSyncState state("INBOX");
+    ImapSyncDelta delta;
+    QVERIFY(synchronize(&server, &state, &delta));
+    QVERIFY(synchronize(&server, &state, &delta));
+
+    QVERIFY(delta.isEmpty());
+    QCOMPARE(state.uids(), ImapSequenceSet(1, SYNC_TEST_MESSAGES));
+}
+
+void SyncTest::testFlagsChanged (void) {
+    ImapTestServer server(SYNC_TEST_MESSAGES);
+    ImapSyncState state("INBOX");
+    ImapSyncDelta delta;
+    QVERIFY(synchronize(&server, &state, &delta));
+
+    QVERIFY(store(&server, 4, ImapMessageSeen | ImapMessageFlagged));
+    QVERIFY(store(&server, 7, 0));
+    QVERIFY(synchronize(&server, &state, &delta));
+
+    QHash<uint, ImapMessageFlags> changed = delta.changed();
+    QCOMPARE(changed.size(), 2);
+    QCOMPARE(changed.value(4), (ImapMessageFlags)(ImapMessageSeen | ImapMessageFlagged));
+    QCOMPARE(changed.value(7), (ImapMessageFlags)0);
+    QCOMPARE(delta.added()->count(), 0);
+    QCOMPARE(state.flags(4), changed.value(4));
+
+    QVERIFY(synchronize(&server, &state, &delta));
+    QVERIFY(delta.isEmpty());
+}
+
+void SyncTest::testStateStream (void) {
+    ImapSyncState state("INBOX");
+    state.setUidValidity(7);
+    state.setUidNext(12);
+    state.setUids(ImapSequenceSet::fromString("1:5,9:11"));
+    state.setFlags(1, ImapMessageSeen);
+    state.setFlags(9, ImapMessageFlagged | ImapMessage::keywordFlag("$Forwarded"));
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << state;
+
+    ImapSyncState loaded;
+    QDataStream in(data);
+    in >> loaded;
+    QCOMPARE(in.status(), QDataStream::Ok);
+    QCOMPARE(loaded.mailbox(), QString("INBOX"));
+    QCOMPARE(loaded.uidValidity(), 7U);
+    QCOMPARE(loaded.uidNext(), 12U);
+    QCOMPARE(loaded.uids(), state.uids());
+    QCOMPARE(loaded.flags(1), state.flags(1));
+    QCOMPARE(loaded.flags(9), state.flags(9));
+    QVERIFY(!loaded.hasFlags(2));
+}
+
+/* States saved before flags were kept: UIDs only. */
+void SyncTest::testStateStreamWithoutFlags (void) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << QString("INBOX") << (quint32)7 << (quint32)12 << (quint64)0;
+    out << ImapSequenceSet(1, 5);
+
+    ImapSyncState loaded;
+    QDataStream in(data);
+    in >> loaded;
+    QCOMPARE(in.status(), QDataStream::Ok);
+    QCOMPARE(loaded.uids(), ImapSequenceSet(1, 5));
+    QVERIFY(!loaded.hasFlags(1));
+}
+
+/* One session: the test server serves one connection at a time. */
+bool SyncTest::synchronize (ImapTestServer *server,
+                            ImapSyncState *state,
+                            ImapSyncDelta *delta)
+{
+    Imap imap;
+    if (!imap.connectToHost("127.0.0.1", server->listen()))
+        return(false);
+    if (!imap.login("user", "secret"))
+        return(false);
+
+    bool ok = imap.synchronize(state, delta);
+    imap.logout();
+    imap.disconnectFromHost();
+    server->waitForSession();
+    return(ok);
+}
+
+/* Replace the flags of uid, from another session. */
+bool SyncTest::store (ImapTestServer *server, uint uid, ImapMessageFlags flags) {
+    Imap imap;
+    if (!imap.connectToHost("127.0.0.1", server->listen()))
+        return(false);
+    if (!imap.login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap.select("INBOX");
+    delete mailbox;
+
+    bool ok = mailbox != NULL &&
+              imap.storeFlags(ImapSequenceSet(uid), flags, ~flags & ImapMessageSystemFlags);
+    imap.logout();
+    imap.disconnectFromHost();
+    server->waitForSession();
+    return(ok);
+}
+
+QTEST_MAIN(SyncTest)
+
+#endif /* TEST_IMAP_SYNC */
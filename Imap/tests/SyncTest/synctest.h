@@ -0,0 +1,33 @@
+#ifdef TEST_IMAP_SYNC
+#ifndef _SYNC_TEST_H_
+#define _SYNC_TEST_H_
+
+#include <QObject>
+
+#include "imapmessage.h"
+
+class ImapTestServer;
+class ImapSyncState;
+class ImapSyncDelta;
+
+class SyncTest : public QObject {
+    Q_OBJECT
+
+    public:
+        SyncTest (QObject *parent = 0);
+        ~SyncTest();
+
+    private slots:
+        void testInitial (void);
+        void testUnchanged (void);
+        void testFlagsChanged (void);
+        void testStateStream (void);
+        void testStateStreamWithoutFlags (void);
+
+    private:
+        bool synchronize (ImapTestServer *server, ImapSyncState *state, ImapSyncDelta *delta);
+        bool store (ImapTestServer *server, uint uid, ImapMessageFlags flags);
+};
+
+#endif /* !_SYNC_TEST_H_ */
+#endif /* TEST_IMAP_SYNC */
@@ -0,0 +1,16 @@
+######################################################################
+# Imap Message Threading Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_THREAD
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += threadtest.h
+SOURCES += threadtest.cpp
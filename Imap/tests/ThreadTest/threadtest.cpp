@@ -0,0 +1,231 @@
+#ifdef TEST_IMAP_THREAD
+
+#include <QtTest>
+
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imapthread.h"
+#include "imap.h"
+
+#include "threadtest.h"
+
+#define THREAD_TEST_MESSAGES        (100000)
+#define THREAD_TEST_REPLIES         (10)
+#define THREAD_TEST_DEPTH           (100000)
+#define THREAD_TEST_MAX_MSECS       (5000)
+
+static QStringList _references (const QString& reference) {
+    QStringList references;
+    if (!reference.isEmpty())
+        references.append(reference);
+    return(references);
+}
+
+ThreadTest::ThreadTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+ThreadTest::~ThreadTest() {
+}
+
+void ThreadTest::testBaseSubject (void) {
+    bool isReply;
+
+    QCOMPARE(ImapThreader::baseSubject("Hello  World", &isReply), QString("hello world"));
+    QVERIFY(!isReply);
+    QCOMPARE(ImapThreader::baseSubject("Re: Hello", &isReply), QString("hello"));
+    QVERIFY(isReply);
+    QCOMPARE(ImapThreader::baseSubject("RE: Fwd: re[2]: Hello"), QString("hello"));
+    QCOMPARE(ImapThreader::baseSubject("[list] Re: Hello (fwd)"), QString("hello"));
+    QCOMPARE(ImapThreader::baseSubject("[Fwd: Re: Hello]", &isReply), QString("hello"));
+    QVERIFY(isReply);
+    QCOMPARE(ImapThreader::baseSubject("[list]"), QString("[list]"));
+    QCOMPARE(ImapThreader::baseSubject("Reply to all"), QString("reply to all"));
+    QCOMPARE(ImapThreader::baseSubject(QString()), QString());
+}
+
+void ThreadTest::testThreadResponse (void) {
+    ImapThread root;
+    QVERIFY(root.appendThreadResponse("* THREAD (2)(3 6 (4 23)(44 7 96))((11)(12))\r\n"));
+
+    QCOMPARE(root.childCount(), 3);
+    QCOMPARE(root.messageCount(), 10);
+    QCOMPARE(root.toString(), QString("(2)(3 6 (4 23)(44 7 96))((11)(12))"));
+
+    ImapThread *thread = root.childAt(1);
+    QCOMPARE(thread->uid(), 3u);
+    QCOMPARE(thread->childAt(0)->uid(), 6u);
+    QCOMPARE(thread->childAt(0)->childCount(), 2);
+    QCOMPARE(thread->childAt(0)->parent(), thread);
+
+    QList<uint> uids;
+    uids << 3 << 6 << 4 << 23 << 44 << 7 << 96;
+    QCOMPARE(thread->uids(), uids);
+
+    QVERIFY(root.childAt(2)->isDummy());
+    QCOMPARE(root.childAt(2)->messageCount(), 2);
+
+    ImapThread empty;
+    QVERIFY(empty.appendThreadResponse("* THREAD\r\n"));
+    QCOMPARE(empty.childCount(), 0);
+
+    ImapThread broken;
+    QVERIFY(!broken.appendThreadResponse("* THREAD (2 (3)\r\n"));
+}
+
+void ThreadTest::testReferences (void) {
+    ImapThreader threader(ImapThreader::References);
+    addConversation(&threader);
+
+    ImapThread *root = threader.thread();
+    QCOMPARE(root->toString(), QString("(7)(1 (2)(3)(6))((4)(5))"));
+    QCOMPARE(root->messageCount(), 7);
+    delete root;
+}
+
+void ThreadTest::testOrderedSubject (void) {
+    ImapThreader threader(ImapThreader::OrderedSubject);
+    addConversation(&threader);
+
+    ImapThread *root = threader.thread();
+    QCOMPARE(root->toString(), QString("(7)(1 (2)(3)(6))(4 5)"));
+    delete root;
+}
+
+void ThreadTest::testReferenceLoop (void) {
+    QDateTime sent = QDateTime::fromTime_t(1000);
+
+    ImapThreader threader;
+    threader.addMessage(1, "<a@x>", _references("<b@x>"), "Loop", sent);
+    threader.addMessage(2, "<b@x>", _references("<a@x>"), "Loop", sent.addSecs(1));
+    threader.addMessage(3, "<a@x>", QStringList(), "Duplicate id", sent.addSecs(2));
+
+    ImapThread *root = threader.thread();
+    QCOMPARE(root->messageCount(), 3);
+    delete root;
+}
+
+void ThreadTest::testLargeFolder (void) {
+    QDateTime sent = QDateTime::fromTime_t(1000000000);
+
+    ImapThreader threader;
+    threader.reserve(THREAD_TEST_MESSAGES);
+    for (int i = 0; i < THREAD_TEST_MESSAGES; ++i) {
+        int thread = i / THREAD_TEST_REPLIES;
+        int reply = i % THREAD_TEST_REPLIES;
+
+        QString subject = QString("Subject %1").arg(thread);
+        QStringList references;
+        if (reply > 0) {
+            subject.prepend("Re: ");
+            references.append(QString("%1.%2@example.com").arg(thread).arg(reply - 1));
+        }
+        threader.addMessage(i + 1, QString("%1.%2@example.com").arg(thread).arg(reply),
+                            references, subject, sent.addSecs(i));
+    }
+
+    QTime timer;
+    timer.start();
+    ImapThread *root = threader.thread();
+    int elapsed = timer.elapsed();
+    QVERIFY(elapsed < THREAD_TEST_MAX_MSECS);
+
+    QCOMPARE(root->childCount(), THREAD_TEST_MESSAGES / THREAD_TEST_REPLIES);
+    QCOMPARE(root->messageCount(), THREAD_TEST_MESSAGES);
+    QCOMPARE(root->childAt(0)->uids().size(), THREAD_TEST_REPLIES);
+    delete root;
+}
+
+/*
+ * One conversation where each message replies to the previous one,
+ * added from the last reply: no step may recurse down the tree.
+ */
+void ThreadTest::testDeepThread (void) {
+    QDateTime sent = QDateTime::fromTime_t(1000000000);
+
+    ImapThreader threader;
+    threader.reserve(THREAD_TEST_DEPTH);
+    for (int i = THREAD_TEST_DEPTH; i > 0; --i) {
+        QStringList references;
+        if (i > 1)
+            references.append(QString("%1@deep.example.com").arg(i - 1));
+        threader.addMessage(i, QString("%1@deep.example.com").arg(i), references,
+                            (i > 1) ? "Re: Deep" : "Deep", sent.addSecs(i));
+    }
+
+    QTime timer;
+    timer.start();
+    ImapThread *root = threader.thread();
+    int elapsed = timer.elapsed();
+    QVERIFY(elapsed < THREAD_TEST_MAX_MSECS);
+
+    QCOMPARE(root->childCount(), 1);
+    QList<uint> uids = root->uids();
+    QCOMPARE(uids.size(), THREAD_TEST_DEPTH);
+    QCOMPARE(uids.first(), 1U);
+    QCOMPARE(uids.last(), (uint)THREAD_TEST_DEPTH);
+
+    ImapThread *thread = root->childAt(0);
+    int depth = 1;
+    while (thread->childCount() == 1) {
+        thread = thread->childAt(0);
+        depth++;
+    }
+    QCOMPARE(depth, THREAD_TEST_DEPTH);
+    QCOMPARE(thread->uid(), (uint)THREAD_TEST_DEPTH);
+    delete root;
+}
+
+/*
+ * Without THREAD on the server the References header is fetched:
+ * each message of a ten replies to the previous one. In-Reply-To
+ * alone would only tie them to a common missing parent.
+ */
+void ThreadTest::testServerReferences (void) {
+    ImapTestServer server(25);
+    Imap imap;
+    QVERIFY(imap.connectToHost("127.0.0.1", server.listen()));
+    QVERIFY(imap.login("user", "secret"));
+    delete imap.select("INBOX");
+
+    ImapThread *root = imap.thread(ImapThreader::References);
+    QVERIFY(root != NULL);
+    QCOMPARE(root->toString(), QString("(1 2 3 4 5 6 7 8 9)"
+                                       "(10 11 12 13 14 15 16 17 18 19)"
+                                       "(20 21 22 23 24 25)"));
+    delete root;
+
+    root = imap.thread(ImapThreader::OrderedSubject);
+    QVERIFY(root != NULL);
+    QCOMPARE(root->childCount(), 25);
+    delete root;
+
+    imap.logout();
+    imap.disconnectFromHost();
+    server.waitForSession();
+
+    QList<QByteArray> log = server.commandLog();
+    QVERIFY(log.contains("UID FETCH 1:25 (UID ENVELOPE BODY.PEEK[HEADER.FIELDS (REFERENCES)])"));
+    QVERIFY(log.contains("UID FETCH 1:25 (UID ENVELOPE)"));
+}
+
+/*
+ * 1 "Hello", 2 and 3 its replies, 6 a reply by subject only.
+ * 4 and 5 reply to a missing message, 7 to another one.
+ */
+void ThreadTest::addConversation (ImapThreader *threader) {
+    QDateTime sent = QDateTime::fromTime_t(1000);
+
+    threader->addMessage(1, "a@x", QStringList(), "Hello", sent.addSecs(1));
+    threader->addMessage(2, "b@x", _references("a@x"), "Re: Hello", sent.addSecs(2));
+    threader->addMessage(3, "<c@x>", _references("<a@x>"), "Re: Hello", sent.addSecs(3));
+    threader->addMessage(4, "d@x", _references("x@x"), "Other", sent.addSecs(4));
+    threader->addMessage(5, "e@x", _references("x@x"), "Re: Other", sent.addSecs(5));
+    threader->addMessage(6, "f@x", QStringList(), "Re: Hello", sent.addSecs(6));
+    threader->addMessage(7, "g@x", _references("y@x"), "Lonely", sent);
+}
+
+QTEST_MAIN(ThreadTest)
+
+#endif /* TEST_IMAP_THREAD */
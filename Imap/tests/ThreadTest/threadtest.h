@@ -0,0 +1,31 @@
+#ifdef TEST_IMAP_THREAD
+#ifndef _THREAD_TEST_H_
+#define _THREAD_TEST_H_
+
+#include <QObject>
+
+class ImapThreader;
+
+class ThreadTest : public QObject {
+    Q_OBJECT
+
+    public:
+        ThreadTest (QObject *parent = 0);
+        ~ThreadTest();
+
+    private slots:
+        void testBaseSubject (void);
+        void testThreadResponse (void);
+        void testReferences (void);
+        void testOrderedSubject (void);
+        void testReferenceLoop (void);
+        void testLargeFolder (void);
+        void testDeepThread (void);
+        void testServerReferences (void);
+
+    private:
+        void addConversation (ImapThreader *threader);
+};
+
+#endif /* !_THREAD_TEST_H_ */
+#endif /* TEST_IMAP_THREAD */
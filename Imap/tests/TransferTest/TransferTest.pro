@@ -0,0 +1,16 @@
+######################################################################
+# Imap APPEND, MULTIAPPEND, UID COPY and UID MOVE Tests
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+DEFINES += TEST_IMAP_TRANSFER
+
+include(../common/imaptestserver.pri)
+
+# Input
+HEADERS += transfertest.h
+SOURCES += transfertest.cpp
@@ -0,0 +1,270 @@
+#ifdef TEST_IMAP_TRANSFER
+
+#include <QBuffer>
+#include <QtTest>
+
+#include "imapsequenceset.h"
+#include "imaptestserver.h"
+#include "imapmailbox.h"
+#include "imap.h"
+
+#include "transfertest.h"
+
+#define TRANSFER_TEST_MESSAGES      (10)
+
+/* Commands of the log starting with prefix. */
+static int _transferCount (const QList<QByteArray>& log, const char *prefix) {
+    int count = 0;
+    foreach (const QByteArray& command, log) {
+        if (command.startsWith(prefix))
+            count++;
+    }
+    return(count);
+}
+
+static QByteArray _transferMessage (int index) {
+    return("From: alice@example.com\r\n"
+           "Subject: Transfer #" + QByteArray::number(index) + "\r\n"
+           "\r\n" + ImapTestServer::body(index, 300));
+}
+
+TransferTest::TransferTest (QObject *parent)
+    : QObject(parent)
+{
+}
+
+TransferTest::~TransferTest() {
+}
+
+void TransferTest::testAppend (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QByteArray message = _transferMessage(1);
+    uint uid = 0;
+    QVERIFY(imap.append("INBOX", message, ImapMessageSeen | ImapMessageFlagged,
+                        QDateTime(), &uid));
+    QCOMPARE(uid, (uint)(TRANSFER_TEST_MESSAGES + 1));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QCOMPARE(server.appendedMessages().size(), 1);
+    QCOMPARE(server.appendedMessages().first(), message);
+
+    QCOMPARE(_transferCount(log, "APPEND "), 1);
+    foreach (const QByteArray& command, log) {
+        if (!command.startsWith("APPEND "))
+            continue;
+        QVERIFY(command.contains("(\\Flagged \\Seen)"));
+        QVERIFY(command.endsWith("{" + QByteArray::number(message.size()) + "+}"));
+    }
+}
+
+/* No LITERAL+: each literal waits for the continuation request. */
+void TransferTest::testAppendSynchronizing (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    server.setCapabilities(withoutCapabilities(QStringList() << "LITERAL+"));
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QByteArray message = _transferMessage(2);
+    uint uid = 0;
+    QVERIFY(imap.append("INBOX", message, 0, QDateTime(), &uid));
+    QCOMPARE(uid, (uint)(TRANSFER_TEST_MESSAGES + 1));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QCOMPARE(server.appendedMessages(), QList<QByteArray>() << message);
+    foreach (const QByteArray& command, log) {
+        if (command.startsWith("APPEND "))
+            QVERIFY(command.endsWith("{" + QByteArray::number(message.size()) + "}"));
+    }
+}
+
+void TransferTest::testMultiAppend (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QList<QByteArray> messages;
+    QList<QIODevice *> devices;
+    for (int i = 0; i < 3; ++i) {
+        messages.append(_transferMessage(i));
+        QBuffer *buffer = new QBuffer(this);
+        buffer->setData(messages.last());
+        buffer->open(QIODevice::ReadOnly);
+        devices.append(buffer);
+    }
+
+    ImapSequenceSet uids;
+    QVERIFY(imap.multiAppend("INBOX", devices, QList<ImapMessageFlags>(),
+                             QList<QDateTime>(), &uids));
+    QCOMPARE(uids, ImapSequenceSet(TRANSFER_TEST_MESSAGES + 1, TRANSFER_TEST_MESSAGES + 3));
+    qDeleteAll(devices);
+
+    QList<QByteArray> log = close(&imap, &server);
+    QCOMPARE(server.appendedMessages(), messages);
+    QCOMPARE(_transferCount(log, "APPEND "), 1);
+}
+
+/* No MULTIAPPEND: one APPEND per message, same result. */
+void TransferTest::testMultiAppendSeparate (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    server.setCapabilities(withoutCapabilities(QStringList() << "MULTIAPPEND"));
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QList<QByteArray> messages;
+    QList<QIODevice *> devices;
+    for (int i = 0; i < 3; ++i) {
+        messages.append(_transferMessage(i));
+        QBuffer *buffer = new QBuffer(this);
+        buffer->setData(messages.last());
+        buffer->open(QIODevice::ReadOnly);
+        devices.append(buffer);
+    }
+
+    ImapSequenceSet uids;
+    QVERIFY(imap.multiAppend("INBOX", devices, QList<ImapMessageFlags>(),
+                             QList<QDateTime>(), &uids));
+    QCOMPARE(uids, ImapSequenceSet(TRANSFER_TEST_MESSAGES + 1, TRANSFER_TEST_MESSAGES + 3));
+    qDeleteAll(devices);
+
+    QList<QByteArray> log = close(&imap, &server);
+    QCOMPARE(server.appendedMessages(), messages);
+    QCOMPARE(_transferCount(log, "APPEND "), 3);
+}
+
+void TransferTest::testUidCopy (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSequenceSet newUids;
+    QVERIFY(imap.uidCopy(ImapSequenceSet(1, 3), "Archive", &newUids));
+    QCOMPARE(newUids, ImapSequenceSet(TRANSFER_TEST_MESSAGES + 1, TRANSFER_TEST_MESSAGES + 3));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("UID COPY 1:3 \"Archive\""));
+    QCOMPARE(_transferCount(log, "UID STORE"), 0);
+}
+
+/* A sparse set is split, the COPYUID of each part gathered. */
+void TransferTest::testUidCopySparse (void) {
+    ImapTestServer server(6000);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSequenceSet uids;
+    for (uint uid = 1; uid < 6000; uid += 2)
+        uids.add(uid);
+
+    ImapSequenceSet newUids;
+    QVERIFY(imap.uidCopy(uids, "Archive", &newUids));
+    QCOMPARE(newUids, ImapSequenceSet(6001, 9000));
+
+    QVERIFY(imap.uidMove(uids, "Trash", &newUids));
+    QCOMPARE(newUids, ImapSequenceSet(6001, 12000));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(_transferCount(log, "UID COPY") > 1);
+    QCOMPARE(_transferCount(log, "UID COPY"), _transferCount(log, "UID MOVE"));
+    foreach (const QByteArray& command, log)
+        QVERIFY(command.size() < 8000);
+}
+
+/* Without MOVE, UID EXPUNGE is split as well. */
+void TransferTest::testUidMoveSparse (void) {
+    ImapTestServer server(6000);
+    server.setCapabilities(withoutCapabilities(QStringList() << "MOVE"));
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSequenceSet uids;
+    for (uint uid = 2; uid <= 6000; uid += 2)
+        uids.add(uid);
+    QVERIFY(imap.uidMove(uids, "Archive"));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(_transferCount(log, "UID EXPUNGE") > 1);
+    QCOMPARE(_transferCount(log, "UID EXPUNGE"), _transferCount(log, "UID COPY"));
+    foreach (const QByteArray& command, log)
+        QVERIFY(command.size() < 8000);
+}
+
+void TransferTest::testUidMove (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    ImapSequenceSet newUids;
+    QVERIFY(imap.uidMove(ImapSequenceSet(1, 3), "Archive", &newUids));
+    QCOMPARE(newUids, ImapSequenceSet(TRANSFER_TEST_MESSAGES + 1, TRANSFER_TEST_MESSAGES + 3));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("UID MOVE 1:3 \"Archive\""));
+    QCOMPARE(_transferCount(log, "UID COPY"), 0);
+    QCOMPARE(_transferCount(log, "UID STORE"), 0);
+}
+
+/* No MOVE: copy, flag and expunge only the moved messages. */
+void TransferTest::testUidMoveUidPlus (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    server.setCapabilities(withoutCapabilities(QStringList() << "MOVE"));
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QVERIFY(imap.uidMove(ImapSequenceSet(1, 3), "Archive"));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("UID COPY 1:3 \"Archive\""));
+    QVERIFY(log.contains("UID STORE 1:3 +FLAGS (\\Deleted)"));
+    QVERIFY(log.contains("UID EXPUNGE 1:3"));
+    QVERIFY(!log.contains("EXPUNGE"));
+}
+
+/* Neither MOVE nor UIDPLUS: never a plain EXPUNGE, the moved
+ * messages are left flagged \Deleted. */
+void TransferTest::testUidMoveNoUidPlus (void) {
+    ImapTestServer server(TRANSFER_TEST_MESSAGES);
+    server.setCapabilities(withoutCapabilities(QStringList() << "MOVE" << "UIDPLUS"));
+    Imap imap;
+    QVERIFY(open(&imap, &server));
+
+    QVERIFY(imap.uidMove(ImapSequenceSet(1, 3), "Archive"));
+    QCOMPARE(imap.searchSet("DELETED", true), ImapSequenceSet(1, 3));
+
+    QList<QByteArray> log = close(&imap, &server);
+    QVERIFY(log.contains("UID COPY 1:3 \"Archive\""));
+    QCOMPARE(_transferCount(log, "EXPUNGE"), 0);
+    QCOMPARE(_transferCount(log, "UID EXPUNGE"), 0);
+}
+
+bool TransferTest::open (Imap *imap, ImapTestServer *server) {
+    if (!imap->connectToHost("127.0.0.1", server->listen()))
+        return(false);
+    if (!imap->login("user", "secret"))
+        return(false);
+
+    ImapMailbox *mailbox = imap->select("INBOX");
+    delete mailbox;
+    return(mailbox != NULL);
+}
+
+/* End the session, returns its command log. */
+QList<QByteArray> TransferTest::close (Imap *imap, ImapTestServer *server) {
+    imap->logout();
+    imap->disconnectFromHost();
+    server->waitForSession();
+    return(server->commandLog());
+}
+
+QStringList TransferTest::withoutCapabilities (const QStringList& removed) const {
+    QStringList capabilities = ImapTestServer(0).capabilities();
+    foreach (const QString& capability, removed)
+        capabilities.removeAll(capability);
+    return(capabilities);
+}
+
+QTEST_MAIN(TransferTest)
+
+#endif /* TEST_IMAP_TRANSFER */
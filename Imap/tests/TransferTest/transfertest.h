@@ -0,0 +1,37 @@
+#ifdef TEST_IMAP_TRANSFER
+#ifndef _TRANSFER_TEST_H_
+#define _TRANSFER_TEST_H_
+
+#include <QStringList>
+#include <QObject>
+
+class ImapTestServer;
+class Imap;
+
+class TransferTest : public QObject {
+    Q_OBJECT
+
+    public:
+        TransferTest (QObject *parent = 0);
+        ~TransferTest();
+
+    private slots:
+        void testAppend (void);
+        void testAppendSynchronizing (void);
+        void testMultiAppend (void);
+        void testMultiAppendSeparate (void);
+        void testUidCopy (void);
+        void testUidCopySparse (void);
+        void testUidMove (void);
+        void testUidMoveUidPlus (void);
+        void testUidMoveNoUidPlus (void);
+        void testUidMoveSparse (void);
+
+    private:
+        bool open (Imap *imap, ImapTestServer *server);
+        QList<QByteArray> close (Imap *imap, ImapTestServer *server);
+        QStringList withoutCapabilities (const QStringList& removed) const;
+};
+
+#endif /* !_TRANSFER_TEST_H_ */
+#endif /* TEST_IMAP_TRANSFER */
@@ -0,0 +1,148 @@
+#ifndef _IMAP_TEST_SERVER_H_
+#define _IMAP_TEST_SERVER_H_
+
+#include <QStringList>
+#include <QHash>
+#include <QSemaphore>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThread>
+#ifndef QT_NO_OPENSSL
+    #include <QSslCertificate>
+#endif
+
+class ImapParser;
+class QTcpSocket;
+class QIODevice;
+
+/**
+ * Scripted IMAP server stand-in for the tests and benchmarks.
+ *
+ * Serves, in its own thread and one connection at a time, a synthetic
+ * INBOX of "messages" text messages of "bodySize" bytes each. UIDs match
+ * the sequence numbers. Each command is answered after "latency" ms,
+ * to simulate the round trip of a remote server.
+ *
+ * Sessions are plain TCP, or TLS with setSsl().
+ * Supported: CAPABILITY, LOGIN, AUTHENTICATE PLAIN, COMPRESS DEFLATE,
+ * SELECT/EXAMINE, [UID] FETCH (envelopes, References, BODYSTRUCTURE, BODY[1]),
+ * [UID] SEARCH (ALL, NOT, flags, KEYWORD and text keys, RETURN options
+ * when ESEARCH is set in the capabilities, literal strings), [UID] STORE,
+ * [UID] COPY/MOVE, EXPUNGE, APPEND/MULTIAPPEND, IDLE, NOOP and LOGOUT.
+ * During IDLE the server sends what push() queued, as it comes.
+ *
+ * Byte and command counts are those of the last finished session.
+ */
+class ImapTestServer : public QThread {
+    Q_OBJECT
+
+    public:
+        ImapTestServer (int messages, QObject *parent = 0);
+        ~ImapTestServer();
+
+        quint16 listen (void);
+        void close (void);
+
+        bool waitForSession (int msecs = 30000);
+        void push (const QByteArray& data);
+
+        // Properties
+        int messageCount (void) const;
+        void setFlags (int message, const QByteArray& flags);
+
+        int bodySize (void) const;
+        void setBodySize (int bytes);
+
+        QByteArray bodyEncoding (void) const;
+        void setBodyEncoding (const QByteArray& encoding);
+
+        int latency (void) const;
+        void setLatency (int msecs);
+
+        QStringList capabilities (void) const;
+        void setCapabilities (const QStringList& capabilities);
+
+        QStringList rejectedSearchKeys (void) const;
+        void setRejectedSearchKeys (const QStringList& keys);
+
+        bool isSsl (void) const;
+        void setSsl (bool ssl);
+
+        bool isCompressed (void) const;
+        qint64 bytesSent (void) const;
+        qint64 bytesReceived (void) const;
+        qint64 payloadSent (void) const;
+        int commandCount (void) const;
+        QList<QByteArray> commandLog (void) const;
+        QList<QByteArray> appendedMessages (void) const;
+
+#ifndef QT_NO_OPENSSL
+        static QSslCertificate certificate (void);
+#endif
+        static QByteArray subject (int message);
+        static QByteArray body (int message, int size);
+
+    protected:
+        void run (void);
+
+    private:
+        void serve (QTcpSocket *socket);
+        bool serveCommand (const QByteArray& tag, const QByteArray& command);
+
+        bool fetch (const QByteArray& tag, const QByteArray& command, bool uid);
+        void search (const QByteArray& tag, const QByteArray& arguments, bool uid);
+        bool append (const QByteArray& tag, const QByteArray& command);
+        bool idle (const QByteArray& tag);
+        void store (const QByteArray& tag, const QByteArray& command, bool uid);
+
+        QByteArray readLine (bool *ok);
+        bool readLiterals (QByteArray *command);
+        QByteArray readBytes (int size, bool *ok);
+        void send (const QByteArray& data);
+        void flush (void);
+
+        QList<int> messageSet (const QByteArray& set) const;
+        bool matches (int message, const QByteArray& criteria) const;
+        bool matchKey (int message, ImapParser *parser, bool *known) const;
+        QByteArray envelope (int message) const;
+        QByteArray references (int message) const;
+        QByteArray encodedBody (int message) const;
+        QByteArray flags (int message) const;
+        bool hasFlag (int message, const QByteArray& flag) const;
+
+    private:
+        QStringList m_capabilities;
+        QStringList m_rejectedSearchKeys;
+        QSemaphore m_listening;
+        QSemaphore m_sessions;
+        QAtomicInt m_closing;
+        QTcpSocket *m_socket;
+        QIODevice *m_device;
+        quint16 m_port;
+
+        QByteArray m_bodyEncoding;
+        int m_messages;
+        int m_bodySize;
+        int m_latency;
+        bool m_ssl;
+
+        // Flags changed by STORE, kept across sessions.
+        QHash<int, QList<QByteArray> > m_flags;
+
+        // Responses for the IDLE, from the test thread.
+        QMutex m_pushMutex;
+        QByteArray m_pushed;
+
+        // Session
+        QByteArray m_output;
+        qint64 m_bytesReceived;
+        qint64 m_payloadSent;
+        qint64 m_bytesSent;
+        QList<QByteArray> m_commandLog;
+        QList<QByteArray> m_appended;
+        bool m_compressed;
+        int m_commands;
+        int m_copied;
+};
+
+#endif /* !_IMAP_TEST_SERVER_H_ */
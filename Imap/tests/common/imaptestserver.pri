@@ -0,0 +1,12 @@
+######################################################################
+# Imap library and local test server, for the tests against a server
+######################################################################
+
+include(../../src/imap.pri)
+
+DEPENDPATH += $$PWD
+INCLUDEPATH += $$PWD
+QT += testlib
+
+HEADERS += $$PWD/imaptestserver.h
+SOURCES += $$PWD/imaptestserver.cpp